@@ -4,6 +4,7 @@
 #include <fc/optional.hpp>
 #include <fc/filesystem.hpp>
 #include <fc/io/json.hpp>
+#include <fc/crypto/sha256.hpp>
 #include <fc/variant_object.hpp>
 #include <fc/reflect/variant.hpp>
 #include <fc/exception/exception.hpp>
@@ -31,10 +32,12 @@ private:
   std::string _to_variant_function;
   std::string _from_variant_function;
   bool _obscure_in_log_files;
+  bool _direct_json;
 public:
   type_mapping(const std::string& type_name) :
     _type_name(type_name),
-    _obscure_in_log_files(false)
+    _obscure_in_log_files(false),
+    _direct_json(false)
   {}
   std::string get_type_name() { return _type_name; }
   virtual std::string get_cpp_parameter_type() = 0;
@@ -43,6 +46,9 @@ public:
   virtual void set_from_variant_function(const std::string& from_variant_function) { _from_variant_function = from_variant_function; }
   virtual void set_obscure_in_log_files() { _obscure_in_log_files = true; }
   virtual bool get_obscure_in_log_files() const { return _obscure_in_log_files; }
+  virtual void set_direct_json() { _direct_json = true; }
+  /** true if results of this type can be written with bts::api::write_direct_json */
+  virtual bool get_direct_json() const { return _direct_json; }
   virtual std::string convert_object_of_type_to_variant(const std::string& object_name);
   virtual std::string convert_variant_to_object_of_type(const std::string& variant_name);
   virtual std::string create_value_of_type_from_variant(const fc::variant& value);
@@ -115,6 +121,7 @@ public:
   {}
   virtual std::string get_cpp_parameter_type() override { return "const std::vector<" + _contained_type->get_cpp_return_type() + ">&"; }
   virtual std::string get_cpp_return_type() override { return "std::vector<" + _contained_type->get_cpp_return_type() + ">"; }
+  virtual bool get_direct_json() const override { return _contained_type->get_direct_json(); }
 };
 typedef std::shared_ptr<sequence_type_mapping> sequence_type_mapping_ptr;
 
@@ -155,6 +162,7 @@ struct method_description
   type_mapping_ptr return_type;
   parameter_description_list parameters;
   bool is_const;
+  bool cacheable;
   bts::api::method_prerequisites prerequisites; // actually, a bitmask of method_prerequisites
   std::vector<std::string> aliases;
 };
@@ -177,13 +185,17 @@ public:
   void load_api_description(const fc::path& api_description_filename, bool load_types);
   void generate_interface_file(const fc::path& api_description_output_dir, const std::string& generated_filename_suffix);
   void generate_rpc_client_files(const fc::path& rpc_client_output_dir, const std::string& generated_filename_suffix);
+  void generate_binary_rpc_client_files(const fc::path& rpc_client_output_dir, const std::string& generated_filename_suffix);
   void generate_rpc_server_files(const fc::path& rpc_server_output_dir, const std::string& generated_filename_suffix);
   void generate_client_files(const fc::path& client_output_dir, const std::string& generated_filename_suffix);
 private:
   void write_includes_to_stream(std::ostream& stream);
   void generate_prerequisite_checks_to_stream(const method_description& method, std::ostream& stream);
+  void generate_positional_parameter_parsing_to_stream(const method_description& method, std::ostream& stream);
   void generate_positional_server_implementation_to_stream(const method_description& method, const std::string& server_classname, std::ostream& stream);
   void generate_named_server_implementation_to_stream(const method_description& method, const std::string& server_classname, std::ostream& stream);
+  void generate_binary_server_implementation_to_stream(const method_description& method, const std::string& server_classname, std::ostream& stream);
+  void generate_direct_json_server_implementation_to_stream(const method_description& method, const std::string& server_classname, std::ostream& stream);
   void generate_server_call_to_client_to_stream(const method_description& method, std::ostream& stream);
   std::string generate_detailed_description_for_method(const method_description& method);
 #if BTS_GLOBAL_API_LOG
@@ -200,6 +212,7 @@ private:
   bts::api::method_prerequisites load_prerequisites(const fc::variant& json_prerequisites);
   void load_method_descriptions(const fc::variants& json_method_descriptions);
   std::string generate_signature_for_method(const method_description& method, const std::string& class_name, bool include_default_parameters);
+  std::string generate_binary_schema_digest();
 };
 
 std::string word_wrap(const std::string& text, const std::string& line_prefix, const std::string first_line_prefix = "", unsigned wrap_column = 120)
@@ -335,6 +348,9 @@ void api_generator::load_type_map(const fc::variants& json_type_map)
     if (json_type.contains("obscure_in_log_files") &&
         json_type["obscure_in_log_files"].as_bool())
       mapping->set_obscure_in_log_files();
+    if (json_type.contains("direct_json") &&
+        json_type["direct_json"].as_bool())
+      mapping->set_direct_json();
 
     FC_ASSERT(_type_map.find(json_type_name) == _type_map.end(), 
               "Error, type ${type_name} is already registered", ("type_name", json_type_name));
@@ -406,6 +422,10 @@ void api_generator::load_method_descriptions(const fc::variants& method_descript
       method.is_const = json_method_description.contains("is_const") && 
                                json_method_description["is_const"].as_bool();
 
+      method.cacheable = json_method_description.contains("cacheable") &&
+                         json_method_description["cacheable"].as_bool();
+      FC_ASSERT(!method.cacheable || method.is_const, "cacheable methods must also be const");
+
       FC_ASSERT(json_method_description.contains("prerequisites"), "method entry missing \"prerequisites\"");
       method.prerequisites = load_prerequisites(json_method_description["prerequisites"]);
 
@@ -483,6 +503,22 @@ std::string api_generator::generate_signature_for_method(const method_descriptio
   return method_signature.str();
 }
 
+// The binary encoding has no field names or type tags, so both ends must agree on every method's
+// signature.  This hashes all of them; clients send it in their handshake and the server refuses
+// binary calls from clients generated from a different api description.
+std::string api_generator::generate_binary_schema_digest()
+{
+  std::ostringstream schema;
+  for (const method_description& method : _methods)
+  {
+    schema << method.name << "(";
+    for (const parameter_description& parameter : method.parameters)
+      schema << parameter.type->get_cpp_return_type() << ",";
+    schema << ")" << method.return_type->get_cpp_return_type() << "\n";
+  }
+  return fc::sha256::hash(schema.str()).str();
+}
+
 void api_generator::write_generated_file_header(std::ostream& stream)
 {
   stream << "//                                   _           _    __ _ _      \n";
@@ -636,9 +672,99 @@ void api_generator::generate_rpc_client_files(const fc::path& rpc_client_output_
   cpp_file << "} } // end namespace bts::rpc_stubs\n";
 }
 
+void api_generator::generate_binary_rpc_client_files(const fc::path& rpc_client_output_dir, const std::string& generated_filename_suffix)
+{
+  std::string client_classname = _api_classname + "_binary_rpc_client";
+
+  fc::path client_header_path = rpc_client_output_dir / "include" / "bts" / "rpc_stubs";
+  fc::create_directories(client_header_path); // creates dirs for both header and cpp
+  fc::path client_header_filename = client_header_path / (client_classname + ".hpp");
+  fc::path client_cpp_filename = rpc_client_output_dir / (client_classname + ".cpp");
+  std::ofstream header_file(client_header_filename.string() + generated_filename_suffix);
+  std::ofstream cpp_file(client_cpp_filename.string() + generated_filename_suffix);
+
+  write_generated_file_header(header_file);
+  header_file << "#pragma once\n\n";
+  header_file << "#include <fc/rpc/json_connection.hpp>\n";
+  header_file << "#include <bts/api/" << _api_classname << ".hpp>\n\n";
+  header_file << "namespace bts { namespace rpc_stubs {\n\n";
+  header_file << "  /**\n";
+  header_file << "   * Calls the same methods as " << _api_classname << "_rpc_client, but sends the parameters and\n";
+  header_file << "   * receives the result packed with fc::raw instead of as JSON.  Call binary_rpc_handshake()\n";
+  header_file << "   * once after logging in.\n";
+  header_file << "   */\n";
+  header_file << "  class " << client_classname << " : public bts::api::" << _api_classname << "\n";
+  header_file << "  {\n";
+  header_file << "  public:\n";
+  header_file << "    static const char* const binary_schema_digest;\n\n";
+  header_file << "    virtual fc::rpc::json_connection_ptr get_json_connection() const = 0;\n";
+  header_file << "    void binary_rpc_handshake() const;\n\n";
+  for (const method_description& method : _methods)
+    header_file << "    " << generate_signature_for_method(method, "", true) << " override;\n";
+  header_file << "  private:\n";
+  header_file << "    std::vector<char> binary_call(const std::string& method_name, const std::vector<char>& packed_parameters) const;\n";
+  header_file << "  };\n\n";
+  header_file << "} } // end namespace bts::rpc_stubs\n";
+
+  write_generated_file_header(cpp_file);
+  cpp_file << "#define DEFAULT_LOGGER \"rpc\"\n";
+  cpp_file << "#include <bts/rpc_stubs/" << client_classname << ".hpp>\n";
+  cpp_file << "#include <bts/api/conversion_functions.hpp>\n";
+  cpp_file << "#include <fc/crypto/base64.hpp>\n";
+  cpp_file << "#include <fc/io/raw.hpp>\n";
+  cpp_file << "#include <fc/io/raw_variant.hpp>\n";
+  write_includes_to_stream(cpp_file);
+  cpp_file << "\n";
+  cpp_file << "namespace bts { namespace rpc_stubs {\n\n";
+
+  cpp_file << "const char* const " << client_classname << "::binary_schema_digest = \"" << generate_binary_schema_digest() << "\";\n\n";
+
+  cpp_file << "void " << client_classname << "::binary_rpc_handshake() const\n";
+  cpp_file << "{\n";
+  cpp_file << "  get_json_connection()->async_call(\"binary_rpc_handshake\", std::vector<fc::variant>{fc::variant(binary_schema_digest)}).wait();\n";
+  cpp_file << "}\n\n";
+
+  cpp_file << "std::vector<char> " << client_classname << "::binary_call(const std::string& method_name, const std::vector<char>& packed_parameters) const\n";
+  cpp_file << "{\n";
+  cpp_file << "  std::string encoded_parameters = fc::base64_encode((unsigned char const*)packed_parameters.data(), packed_parameters.size());\n";
+  cpp_file << "  fc::variant result = get_json_connection()->async_call(\"binary_call\", std::vector<fc::variant>{fc::variant(method_name), fc::variant(encoded_parameters)}).wait();\n";
+  cpp_file << "  std::string packed_result = fc::base64_decode(result.as_string());\n";
+  cpp_file << "  return std::vector<char>(packed_result.begin(), packed_result.end());\n";
+  cpp_file << "}\n\n";
+
+  for (const method_description& method : _methods)
+  {
+    cpp_file << generate_signature_for_method(method, client_classname, false) << "\n";
+    cpp_file << "{\n";
+    cpp_file << "  fc::datastream<size_t> size_stream;\n";
+    for (const parameter_description& parameter : method.parameters)
+      cpp_file << "  fc::raw::pack(size_stream, " << parameter.name << ");\n";
+    cpp_file << "  std::vector<char> packed_parameters(size_stream.tellp());\n";
+    if (!method.parameters.empty())
+    {
+      cpp_file << "  fc::datastream<char*> parameter_stream(packed_parameters.data(), packed_parameters.size());\n";
+      for (const parameter_description& parameter : method.parameters)
+        cpp_file << "  fc::raw::pack(parameter_stream, " << parameter.name << ");\n";
+    }
+    cpp_file << "\n";
+    if (std::dynamic_pointer_cast<void_type_mapping>(method.return_type))
+      cpp_file << "  binary_call(\"" << method.name << "\", packed_parameters);\n";
+    else
+    {
+      cpp_file << "  std::vector<char> packed_result = binary_call(\"" << method.name << "\", packed_parameters);\n";
+      cpp_file << "  return fc::raw::unpack<" << method.return_type->get_cpp_return_type() << ">(packed_result);\n";
+    }
+    cpp_file << "}\n";
+  }
+  cpp_file << "\n";
+  cpp_file << "} } // end namespace bts::rpc_stubs\n";
+}
+
 void api_generator::generate_prerequisite_checks_to_stream(const method_description& method, std::ostream& stream)
 {
-  if (method.prerequisites == bts::api::no_prerequisites)
+  // thread_safe only affects where the server runs the method, there is nothing to check
+  const int prerequisites_to_check = method.prerequisites & ~bts::api::thread_safe;
+  if (prerequisites_to_check == bts::api::no_prerequisites)
     stream << "  // this method has no prerequisites\n\n";
   else
     stream << "  // check all of this method's prerequisites\n";
@@ -662,7 +788,7 @@ void api_generator::generate_prerequisite_checks_to_stream(const method_descript
   if (method.prerequisites & bts::api::connected_to_network)
     stream << "  verify_connected_to_network();\n";
 
-  if (method.prerequisites != bts::api::no_prerequisites)
+  if (prerequisites_to_check != bts::api::no_prerequisites)
     stream << "  // done checking prerequisites\n\n";
 }
 
@@ -690,13 +816,8 @@ void api_generator::generate_server_call_to_client_to_stream(const method_descri
     stream << "  return fc::variant(result);\n";
 }
 
-void api_generator::generate_positional_server_implementation_to_stream(const method_description& method, const std::string& server_classname, std::ostream& stream)
+void api_generator::generate_positional_parameter_parsing_to_stream(const method_description& method, std::ostream& stream)
 {
-  stream << "fc::variant " << server_classname << "::" << method.name << "_positional(fc::rpc::json_connection* json_connection, const fc::variants& parameters)\n";
-  stream << "{\n";
-
-  generate_prerequisite_checks_to_stream(method, stream);
-
   unsigned parameter_index = 0;
   for (const parameter_description& parameter : method.parameters)
   {
@@ -720,11 +841,43 @@ void api_generator::generate_positional_server_implementation_to_stream(const me
     }
     ++parameter_index;
   }
+}
+
+void api_generator::generate_positional_server_implementation_to_stream(const method_description& method, const std::string& server_classname, std::ostream& stream)
+{
+  stream << "fc::variant " << server_classname << "::" << method.name << "_positional(fc::rpc::json_connection* json_connection, const fc::variants& parameters)\n";
+  stream << "{\n";
 
+  generate_prerequisite_checks_to_stream(method, stream);
+  generate_positional_parameter_parsing_to_stream(method, stream);
   generate_server_call_to_client_to_stream(method, stream);
   stream << "}\n\n";
 }
 
+void api_generator::generate_direct_json_server_implementation_to_stream(const method_description& method, const std::string& server_classname, std::ostream& stream)
+{
+  stream << "std::string " << server_classname << "::" << method.name << "_positional_json(fc::rpc::json_connection* json_connection, const fc::variants& parameters)\n";
+  stream << "{\n";
+
+  generate_prerequisite_checks_to_stream(method, stream);
+  generate_positional_parameter_parsing_to_stream(method, stream);
+
+  stream << "\n";
+  stream << "  " << method.return_type->get_cpp_return_type() << " result = get_client()->" << method.name << "(";
+  bool first_parameter = true;
+  for (const parameter_description& parameter : method.parameters)
+  {
+    if (first_parameter)
+      first_parameter = false;
+    else
+      stream << ", ";
+    stream << parameter.name;
+  }
+  stream << ");\n";
+  stream << "  return bts::api::to_direct_json(result);\n";
+  stream << "}\n\n";
+}
+
 void api_generator::generate_named_server_implementation_to_stream(const method_description& method, const std::string& server_classname, std::ostream& stream)
 {
   stream << "fc::variant " << server_classname << "::" << method.name << "_named(fc::rpc::json_connection* json_connection, const fc::variant_object& parameters)\n";
@@ -758,6 +911,45 @@ void api_generator::generate_named_server_implementation_to_stream(const method_
   stream << "}\n\n";
 }
 
+void api_generator::generate_binary_server_implementation_to_stream(const method_description& method, const std::string& server_classname, std::ostream& stream)
+{
+  stream << "std::vector<char> " << server_classname << "::" << method.name << "_binary(fc::rpc::json_connection* json_connection, const std::vector<char>& packed_parameters)\n";
+  stream << "{\n";
+
+  generate_prerequisite_checks_to_stream(method, stream);
+
+  // binary clients always send every parameter, their stubs fill in the defaults
+  if (!method.parameters.empty())
+    stream << "  fc::datastream<const char*> parameter_stream(packed_parameters.data(), packed_parameters.size());\n";
+  for (const parameter_description& parameter : method.parameters)
+  {
+    stream << "  " << parameter.type->get_cpp_return_type() << " " << parameter.name << ";\n";
+    stream << "  fc::raw::unpack(parameter_stream, " << parameter.name << ");\n";
+  }
+
+  stream << "\n";
+  stream << "  ";
+  if (!std::dynamic_pointer_cast<void_type_mapping>(method.return_type))
+    stream << method.return_type->get_cpp_return_type() << " result = ";
+  stream << "get_client()->" << method.name << "(";
+  bool first_parameter = true;
+  for (const parameter_description& parameter : method.parameters)
+  {
+    if (first_parameter)
+      first_parameter = false;
+    else
+      stream << ", ";
+    stream << parameter.name;
+  }
+  stream << ");\n";
+
+  if (std::dynamic_pointer_cast<void_type_mapping>(method.return_type))
+    stream << "  return std::vector<char>();\n";
+  else
+    stream << "  return fc::raw::pack(result);\n";
+  stream << "}\n\n";
+}
+
 std::string api_generator::generate_detailed_description_for_method(const method_description& method)
 {
   std::ostringstream description;
@@ -814,12 +1006,19 @@ void api_generator::generate_rpc_server_files(const fc::path& rpc_server_output_
   header_file << "    virtual void verify_connected_to_network() const = 0;\n\n";
   header_file << "    virtual void store_method_metadata(const bts::api::method_data& method_metadata) = 0;\n";
   header_file << "    fc::variant direct_invoke_positional_method(const std::string& method_name, const fc::variants& parameters);\n";
+  header_file << "    std::vector<char> direct_invoke_binary_method(const std::string& method_name, fc::rpc::json_connection* json_connection, const std::vector<char>& packed_parameters);\n";
+  header_file << "    static const char* const binary_schema_digest;\n";
+  header_file << "    static bool has_direct_json_result(const std::string& method_name);\n";
+  header_file << "    std::string direct_invoke_positional_method_to_json(const std::string& method_name, const fc::variants& parameters);\n";
   header_file << "    void register_" << _api_classname << "_methods(const fc::rpc::json_connection_ptr& json_connection);\n\n";
   header_file << "    void register_" << _api_classname << "_method_metadata();\n\n";
   for (const method_description& method : _methods)
   {
     header_file << "    fc::variant " << method.name << "_positional(fc::rpc::json_connection* json_connection, const fc::variants& parameters);\n";
     header_file << "    fc::variant " << method.name << "_named(fc::rpc::json_connection* json_connection, const fc::variant_object& parameters);\n";
+    header_file << "    std::vector<char> " << method.name << "_binary(fc::rpc::json_connection* json_connection, const std::vector<char>& packed_parameters);\n";
+    if (method.return_type->get_direct_json())
+      header_file << "    std::string " << method.name << "_positional_json(fc::rpc::json_connection* json_connection, const fc::variants& parameters);\n";
   }
 
   header_file << "  };\n\n";
@@ -830,16 +1029,34 @@ void api_generator::generate_rpc_server_files(const fc::path& rpc_server_output_
   server_cpp_file << "#include <bts/rpc_stubs/" << server_classname << ".hpp>\n";
   server_cpp_file << "#include <bts/api/api_metadata.hpp>\n";
   server_cpp_file << "#include <bts/api/conversion_functions.hpp>\n";
+  server_cpp_file << "#include <bts/api/direct_json.hpp>\n";
+  server_cpp_file << "#include <fc/io/raw.hpp>\n";
+  server_cpp_file << "#include <fc/io/raw_variant.hpp>\n";
   server_cpp_file << "#include <boost/bind.hpp>\n";
   write_includes_to_stream(server_cpp_file);
   server_cpp_file << "\n";
+
+  // reflected structs marked direct_json are written member by member; template types like optionals
+  // and pairs are handled by write_direct_json's own overloads
+  server_cpp_file << "namespace bts { namespace api {\n";
+  for (const type_map_type::value_type& type : _type_map)
+  {
+    if (std::dynamic_pointer_cast<fundamental_type_mapping>(type.second) && type.second->get_direct_json() &&
+        type.second->get_cpp_return_type().find('<') == std::string::npos)
+      server_cpp_file << "  template<> struct direct_json_traits<" << type.second->get_cpp_return_type() << "> : std::true_type {};\n";
+  }
+  server_cpp_file << "} } // end namespace bts::api\n\n";
   server_cpp_file << "namespace bts { namespace rpc_stubs {\n\n";
+  server_cpp_file << "const char* const " << server_classname << "::binary_schema_digest = \"" << generate_binary_schema_digest() << "\";\n\n";
 
   // Generate the method bodies
   for (const method_description& method : _methods)
   {
     generate_positional_server_implementation_to_stream(method, server_classname, server_cpp_file);
     generate_named_server_implementation_to_stream(method, server_classname, server_cpp_file);
+    generate_binary_server_implementation_to_stream(method, server_classname, server_cpp_file);
+    if (method.return_type->get_direct_json())
+      generate_direct_json_server_implementation_to_stream(method, server_classname, server_cpp_file);
   }
 
   // Generate a function that registers all of the methods with the JSON-RPC dispatcher
@@ -907,7 +1124,8 @@ void api_generator::generate_rpc_server_files(const fc::path& rpc_server_output_
         server_cpp_file << "\"" << alias << "\"";
       }
     }
-    server_cpp_file << "}};\n";
+    server_cpp_file << "},\n";
+    server_cpp_file << "      /* cacheable */ " << (method.cacheable ? "true" : "false") << "};\n";
       
     server_cpp_file << "    store_method_metadata(" << method.name << "_method_metadata);\n";
     server_cpp_file << "  }\n\n";
@@ -923,6 +1141,45 @@ void api_generator::generate_rpc_server_files(const fc::path& rpc_server_output_
     server_cpp_file << "    return " << method.name << "_positional(nullptr, parameters);\n";
   }
   server_cpp_file << "  FC_ASSERT(false, \"shouldn't happen\");\n";
+  server_cpp_file << "}\n\n";
+
+  server_cpp_file << "std::vector<char> " << server_classname << "::direct_invoke_binary_method(const std::string& method_name, fc::rpc::json_connection* json_connection, const std::vector<char>& packed_parameters)\n";
+  server_cpp_file << "{\n";
+  for (const method_description& method : _methods)
+  {
+    server_cpp_file << "  if (method_name == \"" << method.name << "\")\n";
+    server_cpp_file << "    return " << method.name << "_binary(json_connection, packed_parameters);\n";
+  }
+  server_cpp_file << "  FC_THROW_EXCEPTION(fc::invalid_arg_exception, \"method ${method_name} is not available over binary rpc\", (\"method_name\", method_name));\n";
+  server_cpp_file << "}\n\n";
+
+  server_cpp_file << "bool " << server_classname << "::has_direct_json_result(const std::string& method_name)\n";
+  server_cpp_file << "{\n";
+  server_cpp_file << "  static const std::set<std::string> direct_json_methods = {";
+  bool first_direct_json_method = true;
+  for (const method_description& method : _methods)
+  {
+    if (!method.return_type->get_direct_json())
+      continue;
+    if (!first_direct_json_method)
+      server_cpp_file << ",";
+    first_direct_json_method = false;
+    server_cpp_file << "\n    \"" << method.name << "\"";
+  }
+  server_cpp_file << "};\n";
+  server_cpp_file << "  return direct_json_methods.find(method_name) != direct_json_methods.end();\n";
+  server_cpp_file << "}\n\n";
+
+  server_cpp_file << "std::string " << server_classname << "::direct_invoke_positional_method_to_json(const std::string& method_name, const fc::variants& parameters)\n";
+  server_cpp_file << "{\n";
+  for (const method_description& method : _methods)
+  {
+    if (!method.return_type->get_direct_json())
+      continue;
+    server_cpp_file << "  if (method_name == \"" << method.name << "\")\n";
+    server_cpp_file << "    return " << method.name << "_positional_json(nullptr, parameters);\n";
+  }
+  server_cpp_file << "  FC_THROW_EXCEPTION(fc::invalid_arg_exception, \"method ${method_name} has no direct json writer\", (\"method_name\", method_name));\n";
   server_cpp_file << "}\n";
 
   server_cpp_file << "\n";
@@ -1011,6 +1268,7 @@ void api_generator::generate_client_files(const fc::path& client_output_dir, con
   interceptor_cpp_file << "#include <bts/api/global_api_logger.hpp>\n";
   interceptor_cpp_file << "#include <bts/api/conversion_functions.hpp>\n";
 #endif
+  interceptor_cpp_file << "#include <bts/api/rpc_stats.hpp>\n";
   interceptor_cpp_file << "#include <bts/rpc_stubs/" << interceptor_classname << ".hpp>\n\n";
   interceptor_cpp_file << "namespace bts { namespace rpc_stubs {\n\n";
 
@@ -1029,29 +1287,32 @@ void api_generator::generate_client_files(const fc::path& client_output_dir, con
     interceptor_cpp_file << "    scope_exit() : start_time(fc::time_point::now()) {}\n";
     interceptor_cpp_file << "    ~scope_exit() { dlog(\"RPC call " << method.name << " finished in ${time} ms\", (\"time\", (fc::time_point::now() - start_time).count() / 1000)); }\n";
     interceptor_cpp_file << "  } execution_time_logger;\n";
+    interceptor_cpp_file << "  static bts::api::method_call_stats& call_stats = bts::api::rpc_stats::get_instance().get_method_stats(\"" << method.name << "\");\n";
+    interceptor_cpp_file << "  bts::api::method_call_timer call_timer(call_stats);\n";
     interceptor_cpp_file << "  try\n";
     interceptor_cpp_file << "  {\n";
     interceptor_cpp_file << "    ";
     bool is_void = !!std::dynamic_pointer_cast<void_type_mapping>(method.return_type);
-#if BTS_GLOBAL_API_LOG
     if( !is_void )
       interceptor_cpp_file << method.return_type->get_cpp_return_type() << " result = ";
+#if BTS_GLOBAL_API_LOG
     else
       interceptor_cpp_file << "std::nullptr_t result = nullptr;\n    ";
-#else
-    if( !is_void )
-      interceptor_cpp_file << "return ";
 #endif
     std::list<std::string> args;
     for (const parameter_description& param : method.parameters)
       args.push_back(param.name);
     interceptor_cpp_file << "get_impl()->" << method.name << "(" << boost::join(args, ", ") << ");\n";
+    interceptor_cpp_file << "    call_timer.succeeded();\n";
 #if BTS_GLOBAL_API_LOG
     create_global_api_exit_log_for_method( interceptor_cpp_file, interceptor_classname, method );
     if( !is_void )
       interceptor_cpp_file << "\n    return result;\n";
     else
       interceptor_cpp_file << "\n    return;\n";
+#else
+    if( !is_void )
+      interceptor_cpp_file << "    return result;\n";
 #endif
     interceptor_cpp_file << "  }\n";
     interceptor_cpp_file << "  FC_RETHROW_EXCEPTIONS(warn, \"\")\n";
@@ -1174,6 +1435,7 @@ int main(int argc, char*argv[])
     if (option_variables.count("rpc-stub-output-dir"))
     {
       generator.generate_rpc_client_files(option_variables["rpc-stub-output-dir"].as<std::string>(), option_variables["generated-file-suffix"].as<std::string>());
+      generator.generate_binary_rpc_client_files(option_variables["rpc-stub-output-dir"].as<std::string>(), option_variables["generated-file-suffix"].as<std::string>());
       generator.generate_rpc_server_files(option_variables["rpc-stub-output-dir"].as<std::string>(), option_variables["generated-file-suffix"].as<std::string>());
       generator.generate_client_files(option_variables["rpc-stub-output-dir"].as<std::string>(), option_variables["generated-file-suffix"].as<std::string>());
     }
@@ -7,6 +7,7 @@
 #include <iostream>
 
 #include <fc/exception/exception.hpp>
+#include <fc/thread/scoped_lock.hpp>
 
 namespace bts { namespace api {
 
@@ -42,6 +43,7 @@ namespace detail
         if( name == "debug_get_client_name" )
             return 0;
         uint64_t call_id = (uint64_t) next_id.fetch_add( 1 );
+        fc::scoped_lock<fc::mutex> lock( this->active_loggers_mutex );
         for( api_logger* logger : this->active_loggers )
             logger->log_call_started( call_id, target, name, args );
         return call_id;
@@ -51,6 +53,7 @@ namespace detail
     {
         if( name == "debug_get_client_name" )
             return;
+        fc::scoped_lock<fc::mutex> lock( this->active_loggers_mutex );
         for( api_logger* logger : this->active_loggers )
             logger->log_call_finished( call_id, target, name, args, result );
         return;
@@ -102,6 +105,7 @@ void api_logger::connect()
     if( g == NULL )
         return;
     
+    fc::scoped_lock<fc::mutex> lock( g->active_loggers_mutex );
     g->active_loggers.push_back( this );
     this->is_connected = true;
     return;
@@ -115,6 +119,7 @@ void api_logger::disconnect()
     if( g == NULL )
         return;
 
+    fc::scoped_lock<fc::mutex> lock( g->active_loggers_mutex );
     size_t n = g->active_loggers.size();
     for( size_t i=0; i<n; i++ )
     {
@@ -12,6 +12,9 @@ namespace bts { namespace api {
     wallet_open          = 2,
     wallet_unlocked      = 4,
     connected_to_network = 8,
+    /** the method only reads thread-safe state (e.g. a chain_snapshot), so the RPC server
+     *  may run it on a worker thread, concurrently with other calls */
+    thread_safe          = 16
   };
 
   enum parameter_classification
@@ -72,11 +75,13 @@ namespace bts { namespace api {
     uint32_t                    prerequisites;
     std::string                 detailed_description;
     std::vector<std::string>    aliases;
+    /** the result only depends on the parameters and the head block, so the RPC server may cache it */
+    bool                        cacheable;
   };
 
 } } // end namespace bts::api
 
-FC_REFLECT_ENUM(bts::api::method_prerequisites, (no_prerequisites)(json_authenticated)(wallet_open)(wallet_unlocked)(connected_to_network))
+FC_REFLECT_ENUM(bts::api::method_prerequisites, (no_prerequisites)(json_authenticated)(wallet_open)(wallet_unlocked)(connected_to_network)(thread_safe))
 FC_REFLECT_ENUM( bts::api::parameter_classification, (required_positional)(required_positional_hidden)(optional_positional)(optional_named) )
 FC_REFLECT( bts::api::parameter_data, (name)(type)(classification)(default_value) )
-FC_REFLECT( bts::api::method_data, (name)(description)(return_type)(parameters)(prerequisites)(detailed_description)(aliases) )
+FC_REFLECT( bts::api::method_data, (name)(description)(return_type)(parameters)(prerequisites)(detailed_description)(aliases)(cacheable) )
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <fc/io/json.hpp>
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/variant.hpp>
+
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bts { namespace api {
+
+   /**
+    *  Writes the same JSON that fc::json::to_string( fc::variant( value ) ) would, without building the
+    *  intermediate variant tree for large results.
+    *
+    *  Only vectors, pairs, optionals and the reflected structs that direct_json_traits is specialized for
+    *  (the api generator does this for types marked "direct_json" in types.json) are written directly.
+    *  Those structs must not have a custom to_variant.  Everything else, including every leaf value, is
+    *  written through fc::variant so the output stays byte-identical to the variant path.
+    */
+   template<typename T>
+   struct direct_json_traits : std::false_type {};
+
+   // declared up front so each overload can see the others when it recurses
+   template<typename T>
+   void write_direct_json( std::string& out, const T& value );
+   template<typename T>
+   void write_direct_json( std::string& out, const std::vector<T>& values );
+   inline void write_direct_json( std::string& out, const std::vector<char>& values );
+   template<typename A, typename B>
+   void write_direct_json( std::string& out, const std::pair<A,B>& value );
+   template<typename T>
+   void write_direct_json( std::string& out, const fc::optional<T>& value );
+
+   namespace detail
+   {
+      template<typename T>
+      struct direct_json_member_writer
+      {
+         direct_json_member_writer( std::string& o, const T& v ) : out( o ), value( v ) {}
+
+         template<typename Member, class Class, Member (Class::*member)>
+         void operator()( const char* name )const
+         {
+            if( !first )
+               out += ',';
+            first = false;
+            // member names are C++ identifiers, so they never need escaping
+            out += '"';
+            out += name;
+            out += "\":";
+            write_direct_json( out, value.*member );
+         }
+
+         std::string&  out;
+         const T&      value;
+         mutable bool  first = true;
+      };
+
+      template<typename T>
+      void write_direct_json_value( std::string& out, const T& value, std::true_type )
+      {
+         out += '{';
+         fc::reflector<T>::visit( direct_json_member_writer<T>( out, value ) );
+         out += '}';
+      }
+
+      template<typename T>
+      void write_direct_json_value( std::string& out, const T& value, std::false_type )
+      {
+         out += fc::json::to_string( fc::variant( value ) );
+      }
+   } // detail
+
+   template<typename T>
+   void write_direct_json( std::string& out, const T& value )
+   {
+      detail::write_direct_json_value( out, value, std::integral_constant<bool, direct_json_traits<T>::value>() );
+   }
+
+   template<typename T>
+   void write_direct_json( std::string& out, const std::vector<T>& values )
+   {
+      out += '[';
+      for( size_t i = 0; i < values.size(); ++i )
+      {
+         if( i != 0 )
+            out += ',';
+         write_direct_json( out, values[ i ] );
+      }
+      out += ']';
+   }
+
+   /** fc writes byte vectors as hex strings, not arrays */
+   inline void write_direct_json( std::string& out, const std::vector<char>& values )
+   {
+      out += fc::json::to_string( fc::variant( values ) );
+   }
+
+   template<typename A, typename B>
+   void write_direct_json( std::string& out, const std::pair<A,B>& value )
+   {
+      out += '[';
+      write_direct_json( out, value.first );
+      out += ',';
+      write_direct_json( out, value.second );
+      out += ']';
+   }
+
+   template<typename T>
+   void write_direct_json( std::string& out, const fc::optional<T>& value )
+   {
+      if( value.valid() )
+         write_direct_json( out, *value );
+      else
+         out += "null";
+   }
+
+   template<typename T>
+   std::string to_direct_json( const T& value )
+   {
+      std::string out;
+      write_direct_json( out, value );
+      return out;
+   }
+
+} } // bts::api
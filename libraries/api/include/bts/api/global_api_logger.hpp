@@ -4,6 +4,7 @@
 #if BTS_GLOBAL_API_LOG
 
 #include <fc/variant.hpp>
+#include <fc/thread/mutex.hpp>
 
 namespace bts { namespace api {
 
@@ -41,7 +42,10 @@ public:
     
     static global_api_logger* the_instance;
 
+    // calls dispatched to RPC worker threads are logged from those threads, so
+    // active_loggers is only touched while holding active_loggers_mutex
     std::vector< api_logger* > active_loggers;
+    fc::mutex active_loggers_mutex;
 };
 
 } } // end namespace bts::api
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <fc/time.hpp>
+#include <fc/variant_object.hpp>
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace bts { namespace api {
+
+  /**
+   *  Call counters and a latency histogram for one API method.  Everything is a relaxed atomic, so
+   *  recording a call never takes a lock no matter which thread the method ran on.
+   *
+   *  Latencies are bucketed by powers of two microseconds, so reported percentiles are upper bounds
+   *  within a factor of two; max and average are exact.
+   */
+  class method_call_stats
+  {
+     public:
+        static const uint32_t latency_bucket_count = 40;
+
+        /** the Prometheus metric families each method reports */
+        enum prometheus_family
+        {
+           latency_family,
+           failures_family,
+           in_flight_family,
+           http_bytes_in_family,
+           http_bytes_out_family,
+           prometheus_family_count
+        };
+
+        method_call_stats( const std::string& method_name );
+
+        void                 call_started();
+        void                 call_finished( const fc::microseconds& duration, bool succeeded );
+        /** request and reply sizes are only known for calls made over HTTP */
+        void                 record_http_bytes( uint64_t bytes_in, uint64_t bytes_out );
+
+        const std::string&   get_method_name()const { return _method_name; }
+        uint64_t             get_call_count()const { return _calls.load( std::memory_order_relaxed ); }
+        fc::variant_object   get_summary()const;
+        /** appends this method's samples of one family in the Prometheus text exposition format */
+        void                 write_prometheus_samples( prometheus_family family, std::string& out )const;
+
+     private:
+        /** upper bound, in microseconds, of the bucket the given percentile falls in */
+        uint64_t             get_percentile( double percentile )const;
+
+        std::string                                                 _method_name;
+        std::atomic<uint64_t>                                       _calls;
+        std::atomic<uint64_t>                                       _failures;
+        std::atomic<uint64_t>                                       _total_time_us;
+        std::atomic<uint64_t>                                       _max_time_us;
+        std::atomic<uint64_t>                                       _in_flight;
+        std::atomic<uint64_t>                                       _max_in_flight;
+        std::atomic<uint64_t>                                       _http_bytes_in;
+        std::atomic<uint64_t>                                       _http_bytes_out;
+        std::array<std::atomic<uint64_t>, latency_bucket_count>    _latency_buckets;
+  };
+
+  /**
+   *  The registry of per-method stats.  The generated API interceptor looks each method's stats up once
+   *  and keeps a reference, so the registry lock is only taken the first time a method is called.
+   */
+  class rpc_stats
+  {
+     public:
+        static rpc_stats&     get_instance();
+
+        method_call_stats&    get_method_stats( const std::string& method_name );
+
+        /** calls slower than this are logged; zero disables the slow-call log */
+        void                  set_slow_call_threshold( const fc::microseconds& threshold );
+        fc::microseconds      get_slow_call_threshold()const;
+
+        fc::variant_object    get_statistics()const;
+        std::string           get_prometheus_text()const;
+
+     private:
+        rpc_stats();
+
+        mutable std::mutex                                          _registry_mutex;
+        std::map<std::string, std::unique_ptr<method_call_stats>>  _method_stats;
+        std::atomic<int64_t>                                        _slow_call_threshold_us;
+  };
+
+  /** records one call in a method's stats when it goes out of scope, as a failure unless succeeded() was called */
+  class method_call_timer
+  {
+     public:
+        method_call_timer( method_call_stats& stats );
+        ~method_call_timer();
+
+        void                succeeded() { _succeeded = true; }
+
+     private:
+        method_call_stats&  _stats;
+        fc::time_point      _start_time;
+        bool                _succeeded;
+  };
+
+} } // bts::api
@@ -0,0 +1,221 @@
+#include <bts/api/rpc_stats.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+namespace bts { namespace api {
+
+  namespace
+  {
+     void update_max( std::atomic<uint64_t>& maximum, uint64_t value )
+     {
+        uint64_t current = maximum.load( std::memory_order_relaxed );
+        while( value > current && !maximum.compare_exchange_weak( current, value, std::memory_order_relaxed ) )
+           ;
+     }
+
+     uint32_t latency_bucket( uint64_t microseconds )
+     {
+        uint32_t bucket = 0;
+        while( microseconds > 0 && bucket < method_call_stats::latency_bucket_count - 1 )
+        {
+           microseconds >>= 1;
+           ++bucket;
+        }
+        return bucket;
+     }
+  }
+
+  method_call_stats::method_call_stats( const std::string& method_name )
+  :_method_name( method_name ),
+   _calls( 0 ),
+   _failures( 0 ),
+   _total_time_us( 0 ),
+   _max_time_us( 0 ),
+   _in_flight( 0 ),
+   _max_in_flight( 0 ),
+   _http_bytes_in( 0 ),
+   _http_bytes_out( 0 )
+  {
+     for( auto& bucket : _latency_buckets )
+        bucket.store( 0, std::memory_order_relaxed );
+  }
+
+  void method_call_stats::call_started()
+  {
+     update_max( _max_in_flight, _in_flight.fetch_add( 1, std::memory_order_relaxed ) + 1 );
+  }
+
+  void method_call_stats::call_finished( const fc::microseconds& duration, bool succeeded )
+  {
+     const uint64_t duration_us = std::max<int64_t>( duration.count(), 0 );
+     _in_flight.fetch_sub( 1, std::memory_order_relaxed );
+     _calls.fetch_add( 1, std::memory_order_relaxed );
+     if( !succeeded )
+        _failures.fetch_add( 1, std::memory_order_relaxed );
+     _total_time_us.fetch_add( duration_us, std::memory_order_relaxed );
+     update_max( _max_time_us, duration_us );
+     _latency_buckets[ latency_bucket( duration_us ) ].fetch_add( 1, std::memory_order_relaxed );
+
+     const fc::microseconds threshold = rpc_stats::get_instance().get_slow_call_threshold();
+     if( threshold.count() > 0 && duration >= threshold )
+        fc_wlog( fc::logger::get( "rpc" ), "Slow RPC call ${method} took ${ms} ms${failed}",
+                 ("method",_method_name)("ms",duration_us / 1000)("failed",succeeded ? "" : " and failed") );
+  }
+
+  void method_call_stats::record_http_bytes( uint64_t bytes_in, uint64_t bytes_out )
+  {
+     _http_bytes_in.fetch_add( bytes_in, std::memory_order_relaxed );
+     _http_bytes_out.fetch_add( bytes_out, std::memory_order_relaxed );
+  }
+
+  uint64_t method_call_stats::get_percentile( double percentile )const
+  {
+     const uint64_t calls = _calls.load( std::memory_order_relaxed );
+     if( calls == 0 )
+        return 0;
+     const uint64_t rank = std::max<uint64_t>( 1, uint64_t( calls * percentile + 0.5 ) );
+     uint64_t seen = 0;
+     for( uint32_t i = 0; i < latency_bucket_count; ++i )
+     {
+        seen += _latency_buckets[ i ].load( std::memory_order_relaxed );
+        if( seen >= rank )
+           return std::min( uint64_t( 1 ) << i, _max_time_us.load( std::memory_order_relaxed ) );
+     }
+     return _max_time_us.load( std::memory_order_relaxed );
+  }
+
+  fc::variant_object method_call_stats::get_summary()const
+  {
+     const uint64_t calls = _calls.load( std::memory_order_relaxed );
+     fc::mutable_variant_object summary;
+     summary["calls"] = calls;
+     summary["failures"] = _failures.load( std::memory_order_relaxed );
+     summary["average_us"] = calls ? _total_time_us.load( std::memory_order_relaxed ) / calls : 0;
+     summary["p50_us"] = get_percentile( 0.50 );
+     summary["p99_us"] = get_percentile( 0.99 );
+     summary["max_us"] = _max_time_us.load( std::memory_order_relaxed );
+     summary["in_flight"] = _in_flight.load( std::memory_order_relaxed );
+     summary["max_in_flight"] = _max_in_flight.load( std::memory_order_relaxed );
+     summary["http_bytes_in"] = _http_bytes_in.load( std::memory_order_relaxed );
+     summary["http_bytes_out"] = _http_bytes_out.load( std::memory_order_relaxed );
+     return summary;
+  }
+
+  void method_call_stats::write_prometheus_samples( prometheus_family family, std::string& out )const
+  {
+     std::ostringstream text;
+     const std::string label = "{method=\"" + _method_name + "\"";
+
+     switch( family )
+     {
+        case latency_family:
+        {
+           uint64_t cumulative = 0;
+           for( uint32_t i = 0; i < latency_bucket_count; ++i )
+           {
+              cumulative += _latency_buckets[ i ].load( std::memory_order_relaxed );
+              text << "bts_rpc_latency_seconds_bucket" << label << ",le=\"" << ( uint64_t( 1 ) << i ) / 1000000.0 << "\"} " << cumulative << "\n";
+           }
+           text << "bts_rpc_latency_seconds_bucket" << label << ",le=\"+Inf\"} " << cumulative << "\n";
+           text << "bts_rpc_latency_seconds_sum" << label << "} " << _total_time_us.load( std::memory_order_relaxed ) / 1000000.0 << "\n";
+           text << "bts_rpc_latency_seconds_count" << label << "} " << _calls.load( std::memory_order_relaxed ) << "\n";
+           break;
+        }
+        case failures_family:
+           text << "bts_rpc_failures_total" << label << "} " << _failures.load( std::memory_order_relaxed ) << "\n";
+           break;
+        case in_flight_family:
+           text << "bts_rpc_in_flight" << label << "} " << _in_flight.load( std::memory_order_relaxed ) << "\n";
+           break;
+        case http_bytes_in_family:
+           text << "bts_rpc_http_bytes_in_total" << label << "} " << _http_bytes_in.load( std::memory_order_relaxed ) << "\n";
+           break;
+        case http_bytes_out_family:
+           text << "bts_rpc_http_bytes_out_total" << label << "} " << _http_bytes_out.load( std::memory_order_relaxed ) << "\n";
+           break;
+        default:
+           break;
+     }
+     out += text.str();
+  }
+
+  rpc_stats::rpc_stats()
+  :_slow_call_threshold_us( 0 )
+  {
+  }
+
+  rpc_stats& rpc_stats::get_instance()
+  {
+     static rpc_stats instance;
+     return instance;
+  }
+
+  method_call_stats& rpc_stats::get_method_stats( const std::string& method_name )
+  {
+     std::lock_guard<std::mutex> lock( _registry_mutex );
+     std::unique_ptr<method_call_stats>& stats = _method_stats[ method_name ];
+     if( !stats )
+        stats.reset( new method_call_stats( method_name ) );
+     return *stats;
+  }
+
+  void rpc_stats::set_slow_call_threshold( const fc::microseconds& threshold )
+  {
+     _slow_call_threshold_us.store( threshold.count(), std::memory_order_relaxed );
+  }
+
+  fc::microseconds rpc_stats::get_slow_call_threshold()const
+  {
+     return fc::microseconds( _slow_call_threshold_us.load( std::memory_order_relaxed ) );
+  }
+
+  fc::variant_object rpc_stats::get_statistics()const
+  {
+     fc::mutable_variant_object methods;
+     std::lock_guard<std::mutex> lock( _registry_mutex );
+     for( const auto& item : _method_stats )
+        if( item.second->get_call_count() > 0 )
+           methods[ item.first ] = item.second->get_summary();
+     return methods;
+  }
+
+  std::string rpc_stats::get_prometheus_text()const
+  {
+     // each family's TYPE line and samples must form one block, so families go in the outer loop
+     static const char* const type_lines[ method_call_stats::prometheus_family_count ] =
+     {
+        "# TYPE bts_rpc_latency_seconds histogram\n",
+        "# TYPE bts_rpc_failures_total counter\n",
+        "# TYPE bts_rpc_in_flight gauge\n",
+        "# TYPE bts_rpc_http_bytes_in_total counter\n",
+        "# TYPE bts_rpc_http_bytes_out_total counter\n"
+     };
+
+     std::string out;
+     std::lock_guard<std::mutex> lock( _registry_mutex );
+     for( uint32_t family = 0; family < method_call_stats::prometheus_family_count; ++family )
+     {
+        out += type_lines[ family ];
+        for( const auto& item : _method_stats )
+           item.second->write_prometheus_samples( method_call_stats::prometheus_family( family ), out );
+     }
+     return out;
+  }
+
+  method_call_timer::method_call_timer( method_call_stats& stats )
+  :_stats( stats ),
+   _start_time( fc::time_point::now() ),
+   _succeeded( false )
+  {
+     _stats.call_started();
+  }
+
+  method_call_timer::~method_call_timer()
+  {
+     _stats.call_finished( fc::time_point::now() - _start_time, _succeeded );
+  }
+
+} } // bts::api
@@ -1,3 +1,4 @@
+#include <bts/blockchain/balance_operations.hpp>
 #include <bts/blockchain/chain_database.hpp>
 #include <bts/blockchain/chain_database_impl.hpp>
 #include <bts/blockchain/checkpoints.hpp>
@@ -121,7 +122,17 @@ namespace bts { namespace blockchain {
 
           _pending_transaction_db.open( data_dir / "index/pending_transaction_db" );
 
-          _address_to_trx_index.open( data_dir / "index/address_to_trx_db" );
+          // Replaces the index keyed by transaction id, which could only be read whole
+          _address_to_trx_rebuild_marker = data_dir / "index/address_transaction_index.rebuild";
+          if( fc::exists( data_dir / "index/address_to_trx_db" ) )
+          {
+              std::ofstream( _address_to_trx_rebuild_marker.generic_string().c_str() ).flush();
+              FC_ASSERT( fc::exists( _address_to_trx_rebuild_marker ), "Unable to write ${marker}",
+                         ("marker",_address_to_trx_rebuild_marker) );
+              fc::remove_all( data_dir / "index/address_to_trx_db" );
+          }
+          _rebuild_address_to_trx_index = fc::exists( _address_to_trx_rebuild_marker );
+          _address_to_trx_index.open( data_dir / "index/address_transaction_index" );
           _burn_db.open( data_dir / "index/burn_db" );
 
           _slot_record_db.open( data_dir / "index/slot_record_db" );
@@ -161,11 +172,29 @@ namespace bts { namespace blockchain {
                   _delegate_votes.emplace( record.net_votes(), record.id );
           }
 
+          if( _rebuild_address_to_trx_index )
+              ilog( "Rebuilding address transaction index..." );
           for( auto iter = _id_to_transaction_record_db.begin(); iter.valid(); ++iter )
           {
-              const transaction& trx = iter.value().trx;
+              const transaction_record& record = iter.value();
+              const transaction& trx = record.trx;
               if( trx.expiration > self->now() )
                   _unique_transactions.emplace( trx, _chain_id );
+
+              if( _rebuild_address_to_trx_index )
+              {
+                  for( const address& addr : get_transaction_addresses( record ) )
+                      self->index_transaction( addr, record.chain_location, iter.key() );
+              }
+          }
+          if( _rebuild_address_to_trx_index )
+          {
+              // A synced write syncs every write before it, so the index is on disk before the marker goes
+              const auto last_entry = _address_to_trx_index.last();
+              if( last_entry.valid() )
+                  _address_to_trx_index.store( last_entry.key(), last_entry.value(), true );
+              fc::remove( _address_to_trx_rebuild_marker );
+              _rebuild_address_to_trx_index = false;
           }
 
           for( auto iter = _feed_index_to_record.begin(); iter.valid(); ++iter )
@@ -184,6 +213,34 @@ namespace bts { namespace blockchain {
 
       } FC_CAPTURE_AND_RETHROW() }
 
+      set<address> chain_database_impl::get_transaction_addresses( const transaction_record& record )const
+      { try {
+          set<address> addresses;
+          for( const operation& op : record.trx.operations )
+          {
+              switch( operation_type_enum( op.type ) )
+              {
+                  case deposit_op_type:
+                  {
+                      const set<address> owners = balance_record( op.as<deposit_operation>().condition ).owners();
+                      addresses.insert( owners.begin(), owners.end() );
+                      break;
+                  }
+                  case withdraw_op_type:
+                  {
+                      const obalance_record balance = self->get_balance_record( op.as<withdraw_operation>().balance_id );
+                      if( !balance.valid() ) break;
+                      const set<address> owners = balance->owners();
+                      addresses.insert( owners.begin(), owners.end() );
+                      break;
+                  }
+                  default:
+                      break;
+              }
+          }
+          return addresses;
+      } FC_CAPTURE_AND_RETHROW() }
+
       void chain_database_impl::clear_invalidation_of_future_blocks()
       {
         for (auto block_id_itr = _revalidatable_future_blocks_db.begin(); block_id_itr.valid(); ++block_id_itr)
@@ -680,23 +737,25 @@ namespace bts { namespace blockchain {
       } FC_CAPTURE_AND_RETHROW( (block_id) ) }
 
       void chain_database_impl::apply_transactions( const full_block& block,
-                                                    const pending_chain_state_ptr& pending_state )
+                                                    const pending_chain_state_ptr& pending_state,
+                                                    vector<transaction_evaluation_state_ptr>& transaction_states )
       {
          ilog( "Applying transactions from block: ${n}", ("n",block.block_num) );
          uint32_t trx_num = 0;
          try
          {
+            transaction_states.reserve( block.user_transactions.size() );
             for( const auto& trx : block.user_transactions )
             {
                transaction_evaluation_state_ptr trx_eval_state = std::make_shared<transaction_evaluation_state>( pending_state.get() );
                trx_eval_state->evaluate( trx, _skip_signature_verification );
 
-               // TODO:  capture the evaluation state with a callback for wallets...
-               // summary.transaction_states.emplace_back( std::move(trx_eval_state) );
-
                transaction_location trx_loc( block.block_num, trx_num );
                transaction_record record( trx_loc, *trx_eval_state);
                pending_state->store_transaction( trx.id(), record );
+
+               // Kept for observers, so the wallet can scan the block without evaluating it again
+               transaction_states.push_back( std::move( trx_eval_state ) );
                ++trx_num;
             }
          } FC_RETHROW_EXCEPTIONS( warn, "", ("trx_num",trx_num) )
@@ -798,6 +857,13 @@ namespace bts { namespace blockchain {
              FC_CAPTURE_AND_THROW( invalid_delegate_signee, (expected_delegate.id) );
       } FC_CAPTURE_AND_RETHROW( (block_data) ) }
 
+      void chain_database_impl::refresh_latest_read_snapshot()
+      { try {
+          auto snapshot = self->create_read_snapshot();
+          std::lock_guard<std::mutex> lock( _latest_read_snapshot_mutex );
+          _latest_read_snapshot = snapshot;
+      } FC_CAPTURE_AND_RETHROW() }
+
       void chain_database_impl::update_head_block( const full_block& block_data )
       { try {
           _head_block_header = block_data;
@@ -982,12 +1048,12 @@ namespace bts { namespace blockchain {
             pay_delegate( pending_state, block_signee, block_id, *block_record );
 
             if( block_data.block_num < BTS_V0_4_9_FORK_BLOCK_NUM )
-                apply_transactions( block_data, pending_state );
+                apply_transactions( block_data, pending_state, summary.transaction_states );
 
             execute_markets( block_data.timestamp, pending_state );
 
             if( block_data.block_num >= BTS_V0_4_9_FORK_BLOCK_NUM )
-                apply_transactions( block_data, pending_state );
+                apply_transactions( block_data, pending_state, summary.transaction_states );
 
             update_active_delegate_list( block_data, pending_state );
 
@@ -1086,6 +1152,8 @@ namespace bts { namespace blockchain {
          while( iter != _unique_transactions.end() && iter->expiration <= self->now() )
              iter = _unique_transactions.erase( iter );
 
+         refresh_latest_read_snapshot();
+
          //Schedule the observer notifications for later; the chain is in a
          //non-premptable state right now, and observers may yield.
          if( (now() - block_data.timestamp).to_seconds() < BTS_BLOCKCHAIN_BLOCK_INTERVAL_SEC )
@@ -1163,6 +1231,8 @@ namespace bts { namespace blockchain {
          else
              _head_block_header = self->get_block_header( _head_block_id );
 
+         refresh_latest_read_snapshot();
+
          //Schedule the observer notifications for later; the chain is in a
          //non-premptable state right now, and observers may yield.
          for( chain_observer* o : _observers )
@@ -1388,6 +1458,8 @@ namespace bts { namespace blockchain {
               my->populate_indexes();
           }
 
+          my->refresh_latest_read_snapshot();
+
           //  process the pending transactions to cache by fees
           for( auto pending_itr = my->_pending_transaction_db.begin(); pending_itr.valid(); ++pending_itr )
           {
@@ -1423,6 +1495,11 @@ namespace bts { namespace blockchain {
 
    void chain_database::close()
    { try {
+      {
+         std::lock_guard<std::mutex> lock( my->_latest_read_snapshot_mutex );
+         my->_latest_read_snapshot.reset();
+      }
+
       my->_block_num_to_id_db.close();
       my->_block_id_to_block_record_db.close();
       my->_block_id_to_block_data_db.close();
@@ -1637,6 +1714,120 @@ namespace bts { namespace blockchain {
       return get_block( block_id );
    } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
+   chain_snapshot_ptr chain_database::create_read_snapshot()const
+   { try {
+      std::unique_ptr<detail::chain_snapshot_impl> impl( new detail::chain_snapshot_impl );
+      // Nothing in here yields, so the head block can't change while the snapshots are taken
+      impl->_head_block_header = my->_head_block_header;
+      impl->_head_block_id = my->_head_block_id;
+      impl->_block_num_to_id_db = my->_block_num_to_id_db.create_snapshot();
+      impl->_block_id_to_block_record_db = my->_block_id_to_block_record_db.create_snapshot();
+      impl->_block_id_to_block_data_db = my->_block_id_to_block_data_db.create_snapshot();
+      impl->_id_to_transaction_record_db = my->_id_to_transaction_record_db.create_snapshot();
+      return std::make_shared<chain_snapshot>( std::move( impl ) );
+   } FC_CAPTURE_AND_RETHROW() }
+
+   chain_snapshot_ptr chain_database::get_latest_read_snapshot()const
+   {
+      std::lock_guard<std::mutex> lock( my->_latest_read_snapshot_mutex );
+      FC_ASSERT( my->_latest_read_snapshot, "Database is not open!" );
+      return my->_latest_read_snapshot;
+   }
+
+   chain_snapshot::chain_snapshot( std::unique_ptr<detail::chain_snapshot_impl> impl )
+   : my( std::move( impl ) )
+   {
+   }
+
+   chain_snapshot::~chain_snapshot()
+   {
+   }
+
+   uint32_t chain_snapshot::get_head_block_num()const
+   {
+      return my->_head_block_header.block_num;
+   }
+
+   block_id_type chain_snapshot::get_head_block_id()const
+   {
+      return my->_head_block_id;
+   }
+
+   signed_block_header chain_snapshot::get_head_block()const
+   {
+      return my->_head_block_header;
+   }
+
+   block_id_type chain_snapshot::get_block_id( uint32_t block_num )const
+   { try {
+      FC_ASSERT( block_num <= get_head_block_num() );
+      return my->_block_num_to_id_db.fetch( block_num );
+   } FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+   oblock_record chain_snapshot::get_block_record( const block_id_type& block_id )const
+   { try {
+      return my->_block_id_to_block_record_db.fetch_optional( block_id );
+   } FC_CAPTURE_AND_RETHROW( (block_id) ) }
+
+   oblock_record chain_snapshot::get_block_record( uint32_t block_num )const
+   { try {
+      if( block_num > get_head_block_num() )
+         return oblock_record();
+      const auto block_id = my->_block_num_to_id_db.fetch_optional( block_num );
+      if( !block_id.valid() )
+         return oblock_record();
+      return get_block_record( *block_id );
+   } FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+   full_block chain_snapshot::get_block( const block_id_type& block_id )const
+   { try {
+      return my->_block_id_to_block_data_db.fetch( block_id );
+   } FC_CAPTURE_AND_RETHROW( (block_id) ) }
+
+   full_block chain_snapshot::get_block( uint32_t block_num )const
+   { try {
+      return get_block( get_block_id( block_num ) );
+   } FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+   vector<vector<char>> chain_snapshot::get_packed_blocks( uint32_t first_block_num, uint32_t max_count )const
+   { try {
+      vector<vector<char>> packed_blocks;
+      if( first_block_num > get_head_block_num() )
+         return packed_blocks;
+      max_count = std::min( max_count, get_head_block_num() - first_block_num + 1 );
+      packed_blocks.reserve( max_count );
+
+      for( auto itr = my->_block_num_to_id_db.lower_bound( first_block_num );
+           itr.valid() && packed_blocks.size() < max_count; ++itr )
+      {
+         if( itr.key() != first_block_num + packed_blocks.size() )
+            break;
+         packed_blocks.push_back( my->_block_id_to_block_data_db.fetch_raw( itr.value() ) );
+      }
+
+      return packed_blocks;
+   } FC_CAPTURE_AND_RETHROW( (first_block_num)(max_count) ) }
+
+   otransaction_record chain_snapshot::get_transaction( const transaction_id_type& trx_id )const
+   { try {
+      return my->_id_to_transaction_record_db.fetch_optional( trx_id );
+   } FC_CAPTURE_AND_RETHROW( (trx_id) ) }
+
+   vector<transaction_record> chain_snapshot::get_transactions_for_block( const block_id_type& block_id )const
+   { try {
+      const auto block_record = my->_block_id_to_block_record_db.fetch( block_id );
+      vector<transaction_record> result;
+      result.reserve( block_record.user_transaction_ids.size() );
+
+      for( const auto& trx_id : block_record.user_transaction_ids )
+      {
+         auto otrx_record = get_transaction( trx_id );
+         if( !otrx_record ) FC_CAPTURE_AND_THROW( unknown_transaction, (trx_id) );
+         result.emplace_back( *otrx_record );
+      }
+      return result;
+   } FC_CAPTURE_AND_RETHROW( (block_id) ) }
+
    signed_block_header chain_database::get_head_block()const
    {
       return my->_head_block_header;
@@ -3814,30 +4005,71 @@ namespace bts { namespace blockchain {
       return my->_asset_proposal_db.fetch_optional( std::make_pair(asset_id,proposal_id) );
    }
 
-   void chain_database::index_transaction( const address& addr, const transaction_id_type& trx_id )
+   void chain_database::index_transaction( const address& addr, const transaction_location& location,
+                                           const transaction_id_type& trx_id )
    {
       if( my->_track_stats )
-         my->_address_to_trx_index.store( std::make_pair(addr,trx_id), char(0) );
+         my->_address_to_trx_index.store( std::make_pair( addr, location ), trx_id );
    }
 
-   vector<transaction_record> chain_database::fetch_address_transactions( const address& addr )
-   {
+   vector<transaction_record> chain_database::fetch_address_transactions( const address& addr, uint32_t first_block_num )const
+   { try {
       FC_ASSERT( my->_track_stats );
       vector<transaction_record> results;
-      auto itr = my->_address_to_trx_index.lower_bound( std::make_pair(addr, transaction_id_type()) );
-      while( itr.valid() )
+      auto itr = my->_address_to_trx_index.lower_bound( std::make_pair( addr, transaction_location( first_block_num, 0 ) ) );
+      for( ; itr.valid(); ++itr )
       {
-         auto key = itr.key();
+         const auto key = itr.key();
          if( key.first != addr )
             break;
 
-         if( auto otrx = get_transaction( key.second ) )
-            results.push_back( *otrx );
-
-         ++itr;
+         // Entries for a popped block can outlive its transactions
+         const otransaction_record record = my->_id_to_transaction_record_db.fetch_optional( itr.value() );
+         if( record.valid() && record->chain_location == key.second )
+            results.push_back( *record );
       }
       return results;
-   }
+   } FC_CAPTURE_AND_RETHROW( (addr)(first_block_num) ) }
+
+   address_sync_delta chain_database::get_address_sync_delta( const address& addr, uint32_t first_block_num )const
+   { try {
+      address_sync_delta delta;
+      delta.head_block = get_head_block();
+
+      // An idle client costs a single header read
+      if( first_block_num > delta.head_block.block_num )
+         return delta;
+
+      // A full sync needs every balance; otherwise only those the new transactions touched can have changed
+      const bool full_sync = first_block_num == 0;
+      if( full_sync )
+         delta.balances = get_balances_for_address( addr );
+
+      const auto add_balance = [&]( const balance_id_type& balance_id )
+      {
+         if( delta.balances.count( balance_id ) > 0 )
+            return;
+         const obalance_record balance = get_balance_record( balance_id );
+         if( balance.valid() && ( balance->is_owner( addr ) || balance->id() == addr ) )
+            delta.balances[ balance_id ] = *balance;
+      };
+
+      for( transaction_record& record : fetch_address_transactions( addr, first_block_num ) )
+      {
+         for( const operation& op : record.trx.operations )
+         {
+            if( full_sync ) break;
+            if( operation_type_enum( op.type ) == deposit_op_type )
+               add_balance( op.as<deposit_operation>().condition.get_address() );
+            else if( operation_type_enum( op.type ) == withdraw_op_type )
+               add_balance( op.as<withdraw_operation>().balance_id );
+         }
+
+         const transaction_id_type id = record.trx.id();
+         delta.transactions[ id ] = std::move( record );
+      }
+      return delta;
+   } FC_CAPTURE_AND_RETHROW( (addr)(first_block_num) ) }
 
    void chain_database::track_chain_statistics( bool status )
    {
@@ -3995,6 +4227,11 @@ namespace bts { namespace blockchain {
        interface.insert_into_id_map = [&]( const transaction_id_type& id, const transaction_record& record )
        {
            my->_id_to_transaction_record_db.store( id, record );
+           if( my->_track_stats )
+           {
+               for( const address& addr : my->get_transaction_addresses( record ) )
+                   index_transaction( addr, record.chain_location, id );
+           }
        };
 
        interface.insert_into_unique_set = [&]( const transaction& trx )
@@ -4005,6 +4242,12 @@ namespace bts { namespace blockchain {
 
        interface.erase_from_id_map = [&]( const transaction_id_type& id )
        {
+           const otransaction_record record = my->_id_to_transaction_record_db.fetch_optional( id );
+           if( record.valid() && my->_track_stats )
+           {
+               for( const address& addr : my->get_transaction_addresses( *record ) )
+                   my->_address_to_trx_index.remove( std::make_pair( addr, record->chain_location ) );
+           }
            my->_id_to_transaction_record_db.remove( id );
        };
 
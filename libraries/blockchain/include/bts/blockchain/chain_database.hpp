@@ -6,7 +6,7 @@
 
 namespace bts { namespace blockchain {
 
-   namespace detail { class chain_database_impl; }
+   namespace detail { class chain_database_impl; class chain_snapshot_impl; }
 
    class transaction_evaluation_state;
    typedef std::shared_ptr<transaction_evaluation_state> transaction_evaluation_state_ptr;
@@ -15,6 +15,8 @@ namespace bts { namespace blockchain {
    {
       full_block                                    block_data;
       pending_chain_state_ptr                       applied_changes;
+      /** evaluation state of each of the block's user transactions, in block order */
+      vector<transaction_evaluation_state_ptr>      transaction_states;
    };
 
    struct block_fork_data
@@ -70,6 +72,16 @@ namespace bts { namespace blockchain {
    };
    typedef fc::optional<fork_record> ofork_record;
 
+   /** what changed for an address from a given block up to the head block, for light clients */
+   struct address_sync_delta
+   {
+       /** the head block the delta reaches, signed by its delegate; the next sync starts after it */
+       signed_block_header                           head_block;
+       /** current state of the address's balances touched since the given block; every balance on a full sync */
+       map<balance_id_type, balance_record>          balances;
+       map<transaction_id_type, transaction_record>  transactions;
+   };
+
    class chain_observer
    {
       public:
@@ -86,6 +98,45 @@ namespace bts { namespace blockchain {
          virtual void block_applied( const block_summary& summary ) = 0;
    };
 
+   /**
+    *  A consistent, read-only view of the block and transaction history of a
+    *  chain_database as of the head block at the time it was created.  Blocks
+    *  pushed (or popped) afterwards are not visible through it.
+    *
+    *  Unlike the chain_database itself, a chain_snapshot may be read from any
+    *  thread, so block serving and history queries can run on worker threads
+    *  without racing push_block.  It must not outlive the chain_database.
+    */
+   class chain_snapshot
+   {
+      public:
+         chain_snapshot( std::unique_ptr<detail::chain_snapshot_impl> impl );
+         ~chain_snapshot();
+
+         uint32_t                    get_head_block_num()const;
+         block_id_type               get_head_block_id()const;
+         signed_block_header         get_head_block()const;
+
+         block_id_type               get_block_id( uint32_t block_num )const;
+         oblock_record               get_block_record( const block_id_type& block_id )const;
+         oblock_record               get_block_record( uint32_t block_num )const;
+         full_block                  get_block( const block_id_type& block_id )const;
+         full_block                  get_block( uint32_t block_num )const;
+         /**
+          *  Returns up to max_count consecutive blocks starting at first_block_num, each one
+          *  fc::raw packed exactly as it is stored, so they can be forwarded without being
+          *  unpacked.  Fewer blocks are returned if the head block is reached.
+          */
+         vector<vector<char>>        get_packed_blocks( uint32_t first_block_num, uint32_t max_count )const;
+
+         otransaction_record         get_transaction( const transaction_id_type& trx_id )const;
+         vector<transaction_record>  get_transactions_for_block( const block_id_type& block_id )const;
+
+      private:
+         unique_ptr<detail::chain_snapshot_impl> my;
+   };
+   typedef std::shared_ptr<const chain_snapshot> chain_snapshot_ptr;
+
    class chain_database : public chain_interface, public std::enable_shared_from_this<chain_database>
    {
       public:
@@ -163,8 +214,12 @@ namespace bts { namespace blockchain {
 
          optional<time_point_sec>    get_next_producible_block_timestamp( const vector<account_id_type>& delegate_ids )const;
 
-         virtual void                index_transaction( const address& addr, const transaction_id_type& trx_id ) override;
-         vector<transaction_record>  fetch_address_transactions( const address& addr );
+         virtual void                index_transaction( const address& addr, const transaction_location& location,
+                                                        const transaction_id_type& trx_id ) override;
+         /** the transactions involving addr in chain order, starting with those in block first_block_num */
+         vector<transaction_record>  fetch_address_transactions( const address& addr, uint32_t first_block_num = 0 )const;
+         /** everything a light client at first_block_num must fetch to catch up with the head; 0 means a full sync */
+         address_sync_delta          get_address_sync_delta( const address& addr, uint32_t first_block_num )const;
 
          uint32_t                    get_block_num( const block_id_type& )const;
          signed_block_header         get_block_header( const block_id_type& )const;
@@ -173,6 +228,19 @@ namespace bts { namespace blockchain {
          digest_block                get_block_digest( uint32_t block_num )const;
          full_block                  get_block( const block_id_type& )const;
          full_block                  get_block( uint32_t block_num )const;
+
+         /**
+          *  Creates a read-only view of the chain as of the current head block which can
+          *  be handed to other threads.  Must be called from the thread that pushes blocks.
+          */
+         chain_snapshot_ptr          create_read_snapshot()const;
+
+         /**
+          *  Returns a snapshot of the chain as of the most recently applied block.  The
+          *  snapshot is refreshed every time the head block changes, and unlike
+          *  create_read_snapshot() this may be called from any thread.
+          */
+         chain_snapshot_ptr          get_latest_read_snapshot()const;
          vector<transaction_record>  get_transactions_for_block( const block_id_type& )const;
          signed_block_header         get_head_block()const;
          virtual uint32_t            get_head_block_num()const override;
@@ -395,4 +463,5 @@ namespace bts { namespace blockchain {
 } } // bts::blockchain
 
 FC_REFLECT( bts::blockchain::block_fork_data, (next_blocks)(is_linked)(is_valid)(invalid_reason)(is_included)(is_known) )
+FC_REFLECT( bts::blockchain::address_sync_delta, (head_block)(balances)(transactions) )
 FC_REFLECT( bts::blockchain::fork_record, (block_id)(signing_delegate)(transaction_count)(latency)(size)(timestamp)(is_valid)(invalid_reason)(is_current_fork) )
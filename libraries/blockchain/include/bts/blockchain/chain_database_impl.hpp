@@ -5,6 +5,8 @@
 #include <bts/db/fast_level_map.hpp>
 #include <fc/thread/mutex.hpp>
 
+#include <mutex>
+
 namespace bts { namespace blockchain {
 
    struct fee_index
@@ -33,6 +35,8 @@ namespace bts { namespace blockchain {
             void                                        clear_invalidation_of_future_blocks();
             digest_type                                 initialize_genesis( const optional<path>& genesis_file );
             void                                        populate_indexes();
+            /** the owners of the balances a transaction deposits to or withdraws from */
+            set<address>                                get_transaction_addresses( const transaction_record& record )const;
 
             std::pair<block_id_type, block_fork_data>   store_and_index( const block_id_type& id, const full_block& blk );
             void                                        clear_pending(  const full_block& blk );
@@ -45,7 +49,8 @@ namespace bts { namespace blockchain {
             void                                        mark_included( const block_id_type& id, bool state );
             void                                        verify_header( const full_block&, const public_key_type& block_signee );
             void                                        apply_transactions( const full_block& block,
-                                                                            const pending_chain_state_ptr& );
+                                                                            const pending_chain_state_ptr&,
+                                                                            vector<transaction_evaluation_state_ptr>& transaction_states );
             void                                        pay_delegate( const pending_chain_state_ptr& pending_state,
                                                                       const public_key_type& block_signee,
                                                                       const block_id_type& block_id,
@@ -79,9 +84,15 @@ namespace bts { namespace blockchain {
 
             void                                        revalidate_pending();
 
+            void                                        refresh_latest_read_snapshot();
+
             fc::future<void> _revalidate_pending;
             fc::mutex        _push_block_mutex;
 
+            /** read by other threads, so it is guarded by a real mutex rather than an fc::mutex */
+            mutable std::mutex                                                          _latest_read_snapshot_mutex;
+            chain_snapshot_ptr                                                          _latest_read_snapshot;
+
             /**
              *  Used to track the cumulative effect of all pending transactions that are known,
              *  new incomming transactions are evaluated relative to this state.
@@ -164,9 +175,16 @@ namespace bts { namespace blockchain {
 
             /**
              *  This index is to facilitate light weight clients and is intended mostly for
-             *  block explorers and other APIs serving data.
+             *  block explorers and other APIs serving data.  It is kept in chain order, so
+             *  a client polling for new transactions reads only those since its last poll.
              */
-            bts::db::level_map< pair<address,transaction_id_type>, int>                 _address_to_trx_index;
+            bts::db::level_map<pair<address,transaction_location>, transaction_id_type> _address_to_trx_index;
+            /**
+             *  set when the index replaced one from before it was kept in chain order, to be filled on open; the
+             *  marker file stays on disk until the rebuild finishes, so an interrupted rebuild is redone
+             */
+            bool                                                                        _rebuild_address_to_trx_index = false;
+            fc::path                                                                    _address_to_trx_rebuild_marker;
 
             bts::db::level_map<pair<asset_id_type,address>, object_id_type>             _auth_db;
             bts::db::level_map<pair<asset_id_type,proposal_id_type>, proposal_record>   _asset_proposal_db;
@@ -175,6 +193,18 @@ namespace bts { namespace blockchain {
 
             bool _track_stats = true;
       };
+
+      class chain_snapshot_impl
+      {
+         public:
+            signed_block_header                                                         _head_block_header;
+            block_id_type                                                               _head_block_id;
+
+            bts::db::level_map<uint32_t,block_id_type>::snapshot                        _block_num_to_id_db;
+            bts::db::level_map<block_id_type,block_record>::snapshot                    _block_id_to_block_record_db;
+            bts::db::level_map<block_id_type,full_block>::snapshot                      _block_id_to_block_data_db;
+            bts::db::level_map<transaction_id_type,transaction_record>::snapshot        _id_to_transaction_record_db;
+      };
   } // end namespace bts::blockchain::detail
 } } // end namespace bts::blockchain
 
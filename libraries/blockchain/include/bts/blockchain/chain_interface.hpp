@@ -221,7 +221,8 @@ namespace bts { namespace blockchain {
 
          virtual void                       set_market_transactions( vector<market_transaction> trxs )      = 0;
 
-         virtual void                       index_transaction( const address& addr, const transaction_id_type& trx_id ) = 0;
+         virtual void                       index_transaction( const address& addr, const transaction_location& location,
+                                                               const transaction_id_type& trx_id ) = 0;
 
          template<typename T, typename U>
          optional<T> lookup( const U& key )const
@@ -147,7 +147,8 @@ namespace bts { namespace blockchain {
          /**
           *  This is a pass through method that goes stright to chain database whether or not transaction ID is valid
           */
-         virtual void                  index_transaction( const address& addr, const transaction_id_type& trx_id ) override;
+         virtual void                  index_transaction( const address& addr, const transaction_location& location,
+                                                          const transaction_id_type& trx_id ) override;
 
          unordered_map< chain_property_type, variant>                       properties;
 
@@ -184,6 +184,17 @@ namespace bts { namespace blockchain {
 
       uint32_t block_num;
       uint32_t trx_num;
+
+      friend bool operator == ( const transaction_location& a, const transaction_location& b )
+      {
+         return a.block_num == b.block_num && a.trx_num == b.trx_num;
+      }
+
+      friend bool operator < ( const transaction_location& a, const transaction_location& b )
+      {
+         if( a.block_num != b.block_num ) return a.block_num < b.block_num;
+         return a.trx_num < b.trx_num;
+      }
    };
    typedef optional<transaction_location> otransaction_location;
 
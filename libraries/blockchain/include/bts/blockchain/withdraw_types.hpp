@@ -98,6 +98,20 @@ namespace bts { namespace blockchain {
    };
    typedef fc::optional<memo_status> omemo_status;
 
+   /**
+    *  A receiver key with its public key computed up front, for trial decrypting many memos with the
+    *  same key without deriving the public key again for each one.
+    */
+   struct memo_receiver_key
+   {
+      memo_receiver_key(){}
+      memo_receiver_key( const fc::ecc::private_key& key )
+      :private_key(key),public_key(key.get_public_key()){}
+
+      fc::ecc::private_key private_key;
+      fc::ecc::public_key  public_key;
+   };
+
    struct withdraw_with_signature
    {
       static const uint8_t    type;
@@ -106,6 +120,7 @@ namespace bts { namespace blockchain {
       :owner(owner_arg){}
 
       omemo_status     decrypt_memo_data( const fc::ecc::private_key& receiver_key, bool ignore_owner = false )const;
+      omemo_status     decrypt_memo_data( const memo_receiver_key& receiver_key, bool ignore_owner = false )const;
       public_key_type  encrypt_memo_data( const fc::ecc::private_key& one_time_private_key,
                                       const fc::ecc::public_key&  to_public_key,
                                       const fc::ecc::private_key& from_private_key,
@@ -149,6 +164,7 @@ namespace bts { namespace blockchain {
       digest_type             agreement_digest;
 
       omemo_status decrypt_memo_data( const fc::ecc::private_key& receiver_key )const;
+      omemo_status decrypt_memo_data( const memo_receiver_key& receiver_key )const;
       public_key_type encrypt_memo_data( const fc::ecc::private_key& one_time_private_key,
                                       const fc::ecc::public_key&  to_public_key,
                                       const fc::ecc::private_key& from_private_key,
@@ -48,20 +48,30 @@ namespace bts { namespace blockchain {
    }
 
    omemo_status withdraw_with_signature::decrypt_memo_data( const fc::ecc::private_key& receiver_key, bool ignore_owner )const
+   {
+      return decrypt_memo_data( memo_receiver_key( receiver_key ), ignore_owner );
+   }
+
+   omemo_status withdraw_with_signature::decrypt_memo_data( const memo_receiver_key& receiver_key, bool ignore_owner )const
    { try {
       try {
          FC_ASSERT( memo.valid() );
-         auto secret = receiver_key.get_shared_secret( memo->one_time_key );
-         extended_private_key ext_receiver_key(receiver_key);
+         auto secret = receiver_key.private_key.get_shared_secret( memo->one_time_key );
+
+         // Decrypting is far cheaper than deriving the owner key, and with the wrong secret the padding
+         // check almost always fails, so most keys that aren't the receiver stop here
+         const std::vector<char> memo_bytes = fc::aes_decrypt( secret, memo->encrypted_memo_data );
+
+         extended_private_key ext_receiver_key(receiver_key.private_key);
 
-         fc::ecc::private_key secret_private_key = ext_receiver_key.child( fc::sha256::hash(secret),
-                                                                           extended_private_key::public_derivation );
+         fc::ecc::private_key secret_private_key = ext_receiver_key.public_child( fc::sha256::hash(secret),
+                                                                                  receiver_key.public_key );
          auto secret_public_key = secret_private_key.get_public_key();
 
          if( !ignore_owner && owner != address( secret_public_key ) )
             return omemo_status();
 
-         auto memo = decrypt_memo_data( secret );
+         auto memo = fc::raw::unpack<memo_data>( memo_bytes );
 
          bool has_valid_signature = false;
          if( memo.memo_flags == from_memo && !( memo.from == public_key_type() && memo.from_signature == 0 ) )
@@ -127,14 +137,19 @@ namespace bts { namespace blockchain {
    }
 
    omemo_status withdraw_with_escrow::decrypt_memo_data( const fc::ecc::private_key& receiver_key )const
+   {
+      return decrypt_memo_data( memo_receiver_key( receiver_key ) );
+   }
+
+   omemo_status withdraw_with_escrow::decrypt_memo_data( const memo_receiver_key& receiver_key )const
    { try {
        try {
          FC_ASSERT( memo.valid() );
-         auto secret = receiver_key.get_shared_secret( memo->one_time_key );
-         extended_private_key ext_receiver_key(receiver_key);
+         auto secret = receiver_key.private_key.get_shared_secret( memo->one_time_key );
+         extended_private_key ext_receiver_key(receiver_key.private_key);
 
-         fc::ecc::private_key secret_private_key = ext_receiver_key.child( fc::sha256::hash(secret),
-                                                                           extended_private_key::public_derivation );
+         fc::ecc::private_key secret_private_key = ext_receiver_key.public_child( fc::sha256::hash(secret),
+                                                                                  receiver_key.public_key );
          auto secret_public_key = secret_private_key.get_public_key();
 
          //if( receiver != address(secret_public_key) )
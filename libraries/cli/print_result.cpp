@@ -105,6 +105,14 @@ namespace bts { namespace cli {
       out << pretty_transaction_list( transactions, client );
     };
 
+    _command_to_function["wallet_account_transaction_history_page"] = []( std::ostream& out, const fc::variants& arguments, const fc::variant& result, cptr client )
+    {
+      const auto& page = result.as<transaction_history_page>();
+      out << pretty_transaction_list( page.transactions, client );
+      if( page.next_cursor.valid() )
+        out << "next cursor: " << fc::json::to_string( *page.next_cursor ) << "\n";
+    };
+
     _command_to_function["wallet_transaction_history_experimental"] = []( std::ostream& out, const fc::variants& arguments, const fc::variant& result, cptr client )
     {
       const auto& transactions = result.as<set<pretty_transaction_experimental>>();
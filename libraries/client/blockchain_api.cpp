@@ -123,9 +123,10 @@ block_id_type detail::client_impl::blockchain_get_block_hash( uint32_t block_num
    return _chain_db->get_block(block_number).id();
 }
 
+// Called from RPC worker threads (thread_safe in blockchain_api.json), so only use the read snapshot
 uint32_t detail::client_impl::blockchain_get_block_count() const
 {
-   return _chain_db->get_head_block_num();
+   return _chain_db->get_latest_read_snapshot()->get_head_block_num();
 }
 
 oaccount_record detail::client_impl::blockchain_get_account( const string& account )const
@@ -244,15 +245,17 @@ pair<transaction_id_type, transaction_record> detail::client_impl::blockchain_ge
    return std::make_pair( record->trx.id(), *record );
 } FC_CAPTURE_AND_RETHROW( (transaction_id_prefix)(exact) ) }
 
+// Called from RPC worker threads (thread_safe in blockchain_api.json), so only use the read snapshot
 oblock_record detail::client_impl::blockchain_get_block( const string& block )const
 {
    try
    {
       ASSERT_TASK_NOT_PREEMPTED(); // make sure no cancel gets swallowed by catch(...)
+      const auto chain = _chain_db->get_latest_read_snapshot();
       if( block.size() == string( block_id_type() ).size() )
-         return _chain_db->get_block_record( block_id_type( block ) );
+         return chain->get_block_record( block_id_type( block ) );
       else
-         return _chain_db->get_block_record( std::stoi( block ) );
+         return chain->get_block_record( std::stoi( block ) );
    }
    catch( ... )
    {
@@ -297,11 +300,34 @@ map<balance_id_type, balance_record> detail::client_impl::blockchain_list_addres
     return result;
 }
 map<transaction_id_type, transaction_record> detail::client_impl::blockchain_list_address_transactions( const string& raw_addr,
-                                                                                                        const time_point& after )const
-{
+                                                                                                        uint32_t first_block_num )const
+{ try {
+   address addr;
+   try {
+       addr = address( raw_addr );
+   } catch (...) {
+       addr = address( pts_address( raw_addr ) );
+   }
+
    map<transaction_id_type,transaction_record> results;
+   for( auto&& record : _chain_db->fetch_address_transactions( addr, first_block_num ) )
+   {
+      const transaction_id_type id = record.trx.id();
+      results[ id ] = std::move( record );
+   }
    return results;
-}
+} FC_CAPTURE_AND_RETHROW( (raw_addr)(first_block_num) ) }
+
+address_sync_delta detail::client_impl::blockchain_sync_address( const string& raw_addr, uint32_t first_block_num )const
+{ try {
+   address addr;
+   try {
+       addr = address( raw_addr );
+   } catch (...) {
+       addr = address( pts_address( raw_addr ) );
+   }
+   return _chain_db->get_address_sync_delta( addr, first_block_num );
+} FC_CAPTURE_AND_RETHROW( (raw_addr)(first_block_num) ) }
 
 map<balance_id_type, balance_record> detail::client_impl::blockchain_list_key_balances( const public_key_type& key )const
 {
@@ -532,13 +558,15 @@ market_history_points client_impl::blockchain_market_price_history( const std::s
                                                start_time, duration, granularity );
 }
 
+// Called from RPC worker threads (thread_safe in blockchain_api.json), so only use the read snapshot
 map<transaction_id_type, transaction_record> client_impl::blockchain_get_block_transactions( const string& block )const
 {
+   const auto chain = _chain_db->get_latest_read_snapshot();
    vector<transaction_record> transactions;
    if( block.size() == 40 )
-      transactions = _chain_db->get_transactions_for_block( block_id_type( block ) );
+      transactions = chain->get_transactions_for_block( block_id_type( block ) );
    else
-      transactions = _chain_db->get_transactions_for_block( _chain_db->get_block_id( std::stoi( block ) ) );
+      transactions = chain->get_transactions_for_block( chain->get_block_id( std::stoi( block ) ) );
 
    map<transaction_id_type, transaction_record> transactions_map;
    for( const auto& transaction : transactions )
@@ -139,6 +139,9 @@ program_options::variables_map parse_option_variables(int argc, char** argv)
          ("rpcport", program_options::value<uint16_t>(), "Set port to listen for JSON-RPC connections")
          ("httpdendpoint", program_options::value<string>(), "Set interface/port to listen for HTTP JSON-RPC connections")
          ("httpport", program_options::value<uint16_t>(), "Set port to listen for HTTP JSON-RPC connections")
+         ("rpc-worker-threads", program_options::value<uint32_t>(), "Set number of threads used to parse and serialize HTTP JSON-RPC calls and run thread-safe methods")
+         ("rpc-response-cache-size", program_options::value<uint32_t>(), "Cache up to this many results of cacheable HTTP JSON-RPC calls per block (0 disables the cache)")
+         ("rpc-slow-call-threshold-ms", program_options::value<uint32_t>(), "Log API calls that take at least this many milliseconds (0 disables the slow-call log)")
 
          ("chain-server-port", program_options::value<uint16_t>(), "Run a chain server on this port")
 
@@ -538,6 +541,12 @@ void client_impl::configure_rpc_server(config& cfg,
          cfg.rpc.httpd_endpoint = fc::ip::endpoint::from_string(option_variables["httpdendpoint"].as<string>());
       if (option_variables.count("httpport"))
          cfg.rpc.httpd_endpoint.set_port(option_variables["httpport"].as<uint16_t>());
+      if (option_variables.count("rpc-worker-threads"))
+         cfg.rpc.rpc_worker_threads = option_variables["rpc-worker-threads"].as<uint32_t>();
+      if (option_variables.count("rpc-response-cache-size"))
+         cfg.rpc.rpc_response_cache_size = option_variables["rpc-response-cache-size"].as<uint32_t>();
+      if (option_variables.count("rpc-slow-call-threshold-ms"))
+         cfg.rpc.rpc_slow_call_threshold_ms = option_variables["rpc-slow-call-threshold-ms"].as<uint32_t>();
 
       if (cfg.rpc.rpc_user.empty() ||
           cfg.rpc.rpc_password.empty())
@@ -1,3 +1,4 @@
+#include <bts/api/rpc_stats.hpp>
 #include <bts/blockchain/time.hpp>
 #include <bts/client/client.hpp>
 #include <bts/client/client_impl.hpp>
@@ -185,6 +186,16 @@ std::string client_impl::debug_get_client_name() const
    return this->_config.client_debug_name;
 }
 
+fc::variant_object client_impl::debug_get_rpc_response_cache_stats() const
+{
+   return _rpc_server->get_response_cache_statistics();
+}
+
+fc::variant_object client_impl::debug_get_rpc_stats() const
+{
+   return bts::api::rpc_stats::get_instance().get_statistics();
+}
+
 static std::string _generate_deterministic_private_key(const std::string& prefix, int32_t index)
 {
    std::string seed = prefix;
@@ -19,6 +19,21 @@ method_map_type client_impl::meta_help() const
    return _rpc_server->meta_help();
 }
 
+uint32_t client_impl::subscribe( const fc::variant& filter )
+{
+   return _rpc_server->subscribe( filter );
+}
+
+void client_impl::unsubscribe( uint32_t subscription_id )
+{
+   _rpc_server->unsubscribe( subscription_id );
+}
+
+fc::variants client_impl::poll_notices( uint32_t subscription_id, uint32_t timeout_sec )
+{
+   return _rpc_server->poll_notices( subscription_id, timeout_sec );
+}
+
 variant_object client_impl::get_info()const
 {
    const auto now = blockchain::now();
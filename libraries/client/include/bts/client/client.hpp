@@ -40,7 +40,10 @@ namespace bts { namespace client {
       : enable(false),
         rpc_endpoint(fc::ip::endpoint::from_string("127.0.0.1:0")),
         httpd_endpoint(fc::ip::endpoint::from_string("127.0.0.1:0")),
-        htdocs("./htdocs")
+        htdocs("./htdocs"),
+        rpc_worker_threads(2),
+        rpc_response_cache_size(0),
+        rpc_slow_call_threshold_ms(0)
       {}
 
       bool             enable;
@@ -49,6 +52,12 @@ namespace bts { namespace client {
       fc::ip::endpoint rpc_endpoint;
       fc::ip::endpoint httpd_endpoint;
       fc::path         htdocs;
+      /** threads used to parse requests, serialize responses and run thread_safe methods; 0 disables them */
+      uint32_t         rpc_worker_threads;
+      /** the most results of cacheable methods to keep for the current block; 0 disables the cache */
+      uint32_t         rpc_response_cache_size;
+      /** API calls taking at least this long are logged to the rpc logger; 0 disables the slow-call log */
+      uint32_t         rpc_slow_call_threshold_ms;
 
       bool is_valid() const; /* Currently just checks if rpc port is set */
     };
@@ -218,7 +227,7 @@ namespace bts { namespace client {
 extern const std::string BTS_MESSAGE_MAGIC;
 
 FC_REFLECT(bts::client::client_notification, (timestamp)(message)(signature) )
-FC_REFLECT( bts::client::rpc_server_config, (enable)(rpc_user)(rpc_password)(rpc_endpoint)(httpd_endpoint)(htdocs) )
+FC_REFLECT( bts::client::rpc_server_config, (enable)(rpc_user)(rpc_password)(rpc_endpoint)(httpd_endpoint)(htdocs)(rpc_worker_threads)(rpc_response_cache_size)(rpc_slow_call_threshold_ms) )
 FC_REFLECT( bts::client::chain_server_config, (enabled)(listen_port) )
 FC_REFLECT( bts::client::config,
             (rpc)(default_peers)(chain_servers)(chain_server)(mail_server_enabled)
@@ -24,6 +24,12 @@ mail::message detail::client_impl::mail_fetch_message(const mail::message_id_typ
    return _mail_server->fetch_message(inventory_id);
 }
 
+std::vector<mail::message> detail::client_impl::mail_fetch_messages(const std::vector<mail::message_id_type>& inventory_ids) const
+{
+   FC_ASSERT(_mail_server, "Mail server not enabled!");
+   return _mail_server->fetch_messages(inventory_ids);
+}
+
 std::multimap<mail::client::mail_status, mail::message_id_type> detail::client_impl::mail_get_processing_messages() const
 {
    FC_ASSERT(_mail_client);
@@ -151,6 +151,12 @@ uint32_t detail::client_impl::wallet_set_transaction_expiration_time( uint32_t s
     return _wallet->get_transaction_expiration();
 }
 
+bts::wallet::coin_selection_strategy_enum detail::client_impl::wallet_set_coin_selection_strategy( const bts::wallet::coin_selection_strategy_enum& strategy )
+{
+    _wallet->set_coin_selection_strategy( strategy );
+    return _wallet->get_coin_selection_strategy();
+}
+
 void detail::client_impl::wallet_lock()
 {
   _wallet->lock();
@@ -438,6 +444,40 @@ wallet_transaction_record detail::client_impl::wallet_transfer_from(
     return record;
 }
 
+vector<bts::wallet::batch_transfer_result> detail::client_impl::wallet_batch_transfer(
+        const string& from_account_name,
+        const string& asset_symbol,
+        const vector<bts::wallet::batch_transfer_output>& outputs,
+        const vote_selection_method& selection_method )
+{
+    vector<transaction_builder_ptr> builders;
+    auto results = _wallet->batch_transfer( from_account_name, asset_symbol, outputs, selection_method, builders );
+    for( const auto& builder : builders )
+    {
+        // A transaction the network rejects only fails its own payments
+        try
+        {
+            network_broadcast_transaction( builder->transaction_record.trx );
+        }
+        catch( const fc::canceled_exception& )
+        {
+            throw;
+        }
+        catch( const fc::exception& e )
+        {
+            const transaction_id_type transaction_id = builder->transaction_record.trx.id();
+            for( auto& result : results )
+            {
+                if( result.transaction_id.valid() && *result.transaction_id == transaction_id )
+                    result.error = e.to_string();
+            }
+            // Otherwise the cached record would stay pending and keep its inputs reserved
+            _wallet->remove_transaction_record( string( builder->transaction_record.record_id ) );
+        }
+    }
+    return results;
+}
+
 balance_id_type detail::client_impl::wallet_multisig_get_balance_id(
                                         uint32_t m,
                                         const vector<address>& addresses )const
@@ -887,21 +927,17 @@ vector<pretty_transaction> detail::client_impl::wallet_account_transaction_histo
                                                                                     uint32_t start_block_num,
                                                                                     uint32_t end_block_num )const
 { try {
-  const auto history = _wallet->get_pretty_transaction_history( account_name, start_block_num, end_block_num, asset_symbol );
-  if( limit == 0 || abs( limit ) >= history.size() )
-  {
-      return history;
-  }
-  else if( limit > 0 )
-  {
-      return vector<pretty_transaction>( history.begin(), history.begin() + limit );
-  }
-  else
-  {
-      return vector<pretty_transaction>( history.end() - abs( limit ), history.end() );
-  }
+  return _wallet->get_pretty_transaction_history_page( account_name, asset_symbol, limit, start_block_num, end_block_num ).transactions;
 } FC_RETHROW_EXCEPTIONS( warn, "") }
 
+transaction_history_page detail::client_impl::wallet_account_transaction_history_page( const string& account_name,
+                                                                                       const string& asset_symbol,
+                                                                                       int32_t limit,
+                                                                                       const optional<transaction_history_key>& cursor )const
+{ try {
+  return _wallet->get_pretty_transaction_history_page( account_name, asset_symbol, limit, 0, -1, cursor );
+} FC_RETHROW_EXCEPTIONS( warn, "", ("account_name",account_name)("asset_symbol",asset_symbol)("limit",limit)("cursor",cursor) ) }
+
 void detail::client_impl::wallet_remove_transaction( const string& transaction_id )
 { try {
    _wallet->remove_transaction_record( transaction_id );
@@ -113,6 +113,29 @@ namespace bts { namespace db {
            return tmp;
         } FC_RETHROW_EXCEPTIONS( warn, "error fetching key ${key}", ("key",k) ); }
 
+        /**
+         *  Returns the value exactly as it is stored in the database (fc::raw packed)
+         *  without unpacking it, for callers that only need to forward the bytes.
+         */
+        std::vector<char> fetch_raw( const Key& k )
+        { try {
+           FC_ASSERT( is_open(), "Database is not open!" );
+
+           std::vector<char> kslice = fc::raw::pack( k );
+           ldb::Slice ks( kslice.data(), kslice.size() );
+           std::string value;
+           auto status = _db->Get( _read_options, ks, &value );
+           if( status.IsNotFound() )
+           {
+             FC_THROW_EXCEPTION( fc::key_not_found_exception, "unable to find key ${key}", ("key",k) );
+           }
+           if( !status.ok() )
+           {
+               FC_THROW_EXCEPTION( level_map_failure, "database error: ${msg}", ("msg", status.ToString() ) );
+           }
+           return std::vector<char>( value.begin(), value.end() );
+        } FC_RETHROW_EXCEPTIONS( warn, "error fetching key ${key}", ("key",k) ); }
+
         class iterator
         {
            public:
@@ -262,6 +285,101 @@ namespace bts { namespace db {
            return true;
         } FC_RETHROW_EXCEPTIONS( warn, "error reading last item from database" ); }
 
+        /**
+         *  A consistent, read-only view of the database as it was when the snapshot was
+         *  created, backed by a LevelDB snapshot.  Writes made after the snapshot was taken
+         *  are not visible through it, so it can be read from another thread while the
+         *  owner of the level_map keeps writing.  The snapshot must not outlive the open
+         *  database it was created from.
+         */
+        class snapshot
+        {
+           public:
+             snapshot(){}
+
+             bool valid()const { return !!_snapshot; }
+
+             fc::optional<Value> fetch_optional( const Key& k )const
+             { try {
+                std::string value;
+                if( !get( k, value ) ) return fc::optional<Value>();
+                fc::datastream<const char*> ds( value.c_str(), value.size() );
+                Value tmp;
+                fc::raw::unpack( ds, tmp );
+                return tmp;
+             } FC_RETHROW_EXCEPTIONS( warn, "error fetching key ${key}", ("key",k) ); }
+
+             Value fetch( const Key& k )const
+             { try {
+                auto value = fetch_optional( k );
+                if( !value.valid() )
+                  FC_THROW_EXCEPTION( fc::key_not_found_exception, "unable to find key ${key}", ("key",k) );
+                return *value;
+             } FC_RETHROW_EXCEPTIONS( warn, "error fetching key ${key}", ("key",k) ); }
+
+             std::vector<char> fetch_raw( const Key& k )const
+             { try {
+                std::string value;
+                if( !get( k, value ) )
+                  FC_THROW_EXCEPTION( fc::key_not_found_exception, "unable to find key ${key}", ("key",k) );
+                return std::vector<char>( value.begin(), value.end() );
+             } FC_RETHROW_EXCEPTIONS( warn, "error fetching key ${key}", ("key",k) ); }
+
+             iterator lower_bound( const Key& key )const
+             { try {
+                FC_ASSERT( valid(), "Invalid snapshot!" );
+
+                std::vector<char> kslice = fc::raw::pack( key );
+                ldb::Slice key_slice( kslice.data(), kslice.size() );
+
+                ldb::ReadOptions options = _iter_options;
+                options.snapshot = _snapshot.get();
+                iterator itr( _db->NewIterator( options ) );
+                itr._it->Seek( key_slice );
+                return itr;
+             } FC_RETHROW_EXCEPTIONS( warn, "error finding ${key}", ("key",key) ) }
+
+           private:
+             friend class level_map;
+
+             bool get( const Key& k, std::string& value )const
+             {
+                FC_ASSERT( valid(), "Invalid snapshot!" );
+
+                std::vector<char> kslice = fc::raw::pack( k );
+                ldb::Slice ks( kslice.data(), kslice.size() );
+                ldb::ReadOptions options = _read_options;
+                options.snapshot = _snapshot.get();
+                auto status = _db->Get( options, ks, &value );
+                if( status.IsNotFound() )
+                  return false;
+                if( !status.ok() )
+                {
+                    FC_THROW_EXCEPTION( level_map_failure, "database error: ${msg}", ("msg", status.ToString() ) );
+                }
+                return true;
+             }
+
+             ldb::DB*                             _db = nullptr;
+             std::shared_ptr<const ldb::Snapshot> _snapshot;
+             ldb::ReadOptions                     _read_options;
+             ldb::ReadOptions                     _iter_options;
+        };
+
+        snapshot create_snapshot()const
+        { try {
+           FC_ASSERT( is_open(), "Database is not open!" );
+
+           snapshot snap;
+           ldb::DB* db = _db.get();
+           snap._db = db;
+           snap._snapshot = std::shared_ptr<const ldb::Snapshot>( db->GetSnapshot(),
+                                                                  [db]( const ldb::Snapshot* s ) { db->ReleaseSnapshot( s ); } );
+           snap._read_options = _read_options;
+           snap._iter_options = _iter_options;
+           return snap;
+        } FC_RETHROW_EXCEPTIONS( warn, "error creating snapshot" ) }
+
         /** this class allows batched, atomic database writes.
          *  usage:
          *  {
@@ -17,8 +17,9 @@ namespace bts { namespace light_wallet {
    {
        vector<char>                                 encrypted_private_key;
        account_record                               user_account;
-       fc::time_point                               last_balance_sync_time;
-       fc::time_point                               last_transaction_sync_time;
+       fc::time_point                               last_sync_time;
+       /** the first block not yet synced; the caches hold everything before it */
+       uint32_t                                     next_sync_block = 0;
        map<balance_id_type,balance_record>          balance_record_cache;
        map<transaction_id_type,transaction_record>  transaction_record_cache;
        map<asset_id_type,asset_record>              asset_record_cache;
@@ -72,6 +73,8 @@ namespace bts { namespace light_wallet {
                         const string& to_account_name, 
                         const string& memo );
 
+         /** fetches the balance and transaction changes since the last sync */
+         void sync( bool resync_all = false );
          void sync_balance( bool resync_all = false);
          void sync_transactions();
 
@@ -86,12 +89,15 @@ namespace bts { namespace light_wallet {
          fc::path                         _wallet_file;
          optional<fc::ecc::private_key>   _private_key;
          optional<light_wallet_data>      _data;
+         /** asset_record_cache by symbol, rebuilt when the wallet is opened */
+         map<string,asset_id_type>        _asset_ids_by_symbol;
    };
 
 } }
 FC_REFLECT( bts::light_wallet::light_wallet_data,
             (encrypted_private_key)
             (user_account)
+            (next_sync_block)
             (balance_record_cache)
             (transaction_record_cache)
             (asset_record_cache)
@@ -56,6 +56,10 @@ void light_wallet::open( const fc::path& wallet_json )
 {
    _wallet_file = wallet_json;
    _data = fc::json::from_file<light_wallet_data>( wallet_json );
+
+   _asset_ids_by_symbol.clear();
+   for( const auto& item : _data->asset_record_cache )
+      _asset_ids_by_symbol[item.second.symbol] = item.first;
 }
 
 void light_wallet::save()
@@ -68,6 +72,7 @@ void light_wallet::close()
    _wallet_file = fc::path();
    _private_key.reset();
    _data.reset();
+   _asset_ids_by_symbol.clear();
 }
 
 void light_wallet::unlock( const string& password )
@@ -107,6 +112,7 @@ void light_wallet::create( const fc::path& wallet_json,
    // initialize the wallet data
    _wallet_file = wallet_json;
    _data = light_wallet_data();
+   _asset_ids_by_symbol.clear();
 
    // derive the brain wallet key
    fc::sha256::encoder enc;
@@ -229,55 +235,69 @@ asset light_wallet::get_fee( const string& symbol )
 } FC_CAPTURE_AND_RETHROW( (symbol) ) }
 
 
-void light_wallet::sync_balance( bool resync_all )
+void light_wallet::sync( bool resync_all )
 { try {
    FC_ASSERT( is_open() );
 
    if( resync_all )
    {
-     _data->last_balance_sync_time = fc::time_point();
+     _data->last_sync_time = fc::time_point();
+     _data->next_sync_block = 0;
      _data->balance_record_cache.clear();
    }
 
-   if( _data->last_balance_sync_time + fc::seconds(10) > fc::time_point::now() )
+   if( _data->last_sync_time + fc::seconds(10) > fc::time_point::now() )
       return; // too fast
 
-   auto sync_time = bts::blockchain::now();
+   auto delta = _rpc.blockchain_sync_address( string(address(_data->user_account.active_key())),
+                                              _data->next_sync_block );
+   _data->last_sync_time = fc::time_point::now();
 
-   auto new_balances = _rpc.blockchain_list_address_balances( string(address(_data->user_account.active_key())),
-                                                              _data->last_balance_sync_time );
-   for( auto item : new_balances )
-      _data->balance_record_cache[item.first] = item.second;
+   // A server behind the blocks we already have can't tell us anything new
+   if( delta.head_block.block_num + 1 < _data->next_sync_block )
+      return;
 
-   _data->last_balance_sync_time = sync_time;
-} FC_CAPTURE_AND_RETHROW() }
+   for( const auto& item : delta.balances )
+   {
+      if( item.second.balance == 0 )
+         _data->balance_record_cache.erase( item.first );
+      else
+         _data->balance_record_cache[item.first] = item.second;
+   }
+   for( const auto& item : delta.transactions )
+      _data->transaction_record_cache[item.first] = item.second;
 
+   _data->next_sync_block = delta.head_block.block_num + 1;
+} FC_CAPTURE_AND_RETHROW( (resync_all) ) }
 
-void light_wallet::sync_transactions()
+void light_wallet::sync_balance( bool resync_all )
 {
-   FC_ASSERT( is_open() );
-   if( _data->last_transaction_sync_time + fc::seconds(10) > fc::time_point::now() )
-      return; // too fast
+   sync( resync_all );
+}
 
-   auto sync_time = bts::blockchain::now();
-   auto new_trxs = _rpc.blockchain_list_address_transactions( string(address(_data->user_account.active_key())),
-                                                              _data->last_transaction_sync_time );
-   for( auto item : new_trxs )
-      _data->transaction_record_cache[item.first] = item.second;
-   _data->last_transaction_sync_time = sync_time;
+void light_wallet::sync_transactions()
+{
+   sync();
 }
 
 optional<asset_record> light_wallet::get_asset_record( const string& symbol )
 { try {
    if( is_open() )
    {
-      for( auto item : _data->asset_record_cache )
-         if( item.second.symbol == symbol )
-            return item.second;
+      auto id_itr = _asset_ids_by_symbol.find( symbol );
+      if( id_itr != _asset_ids_by_symbol.end() )
+      {
+         auto record_itr = _data->asset_record_cache.find( id_itr->second );
+         if( record_itr != _data->asset_record_cache.end() )
+            return record_itr->second;
+      }
    }
    auto result = _rpc.blockchain_get_asset( symbol );
-   if( result )
+   if( result && is_open() )
+   {
       _data->asset_record_cache[result->id] = *result;
+      _asset_ids_by_symbol[result->symbol] = result->id;
+   }
    return result;
 } FC_CAPTURE_AND_RETHROW( (symbol) ) }
 
@@ -9,7 +9,10 @@
 #include <fc/io/json.hpp>
 #include <fc/network/tcp_socket.hpp>
 
+#include <atomic>
 #include <queue>
+#include <set>
+#include <thread>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
@@ -34,6 +37,8 @@ using namespace boost::multi_index;
 namespace detail {
 #define BTS_MAIL_CLIENT_DATABASE_VERSION 1
 #define BTS_MAIL_CLIENT_MAX_INVENTORY_SIZE 1000
+//Proof-of-work attempts a worker makes between checks of the slice clock
+#define BTS_MAIL_CLIENT_PROOF_OF_WORK_CLOCK_INTERVAL 4096
 
 struct mail_record {
     mail_record(string sender = string(),
@@ -108,6 +113,51 @@ struct mail_index_record {
     fc::time_point_sec timestamp;
 };
 
+/**
+ * Hashes a message for proof-of-work without re-packing it for every nonce. The fields packed ahead of the
+ * nonce are hashed once and the encoder state copied per attempt; the fields after it are packed once.
+ */
+class proof_of_work_hasher {
+public:
+    proof_of_work_hasher(const message& content) {
+        fc::raw::pack(_prefix, content.type);
+        fc::raw::pack(_prefix, content.recipient);
+
+        _suffix = fc::raw::pack(content.timestamp);
+        auto data = fc::raw::pack(content.data);
+        _suffix.insert(_suffix.end(), data.begin(), data.end());
+    }
+
+    message_id_type hash(uint64_t nonce)const {
+        fc::ripemd160::encoder enc(_prefix);
+        fc::raw::pack(enc, nonce);
+        enc.write(_suffix.data(), _suffix.size());
+        return enc.result();
+    }
+
+private:
+    fc::ripemd160::encoder _prefix;
+    vector<char> _suffix;
+};
+
+//State shared between the proof-of-work supervisor, its workers, and cancel_message
+struct proof_of_work_job {
+    proof_of_work_job(const message_id_type& message_id, const ripemd160& target)
+        : message_id(message_id),
+          target(target),
+          canceled(false),
+          found(false),
+          winning_nonce(0)
+    {}
+
+    message_id_type message_id;
+    ripemd160 target;
+    std::atomic<bool> canceled;
+    std::atomic<bool> found;
+    //Written only by the worker which flips found
+    uint64_t winning_nonce;
+};
+
 class client_impl {
 protected:
     //Dummy types to act as mnemonics for multi_index indices
@@ -129,9 +179,11 @@ public:
     job_queue _proof_of_work_jobs;
     fc::future<void> _proof_of_work_worker;
 
+    std::shared_ptr<proof_of_work_job> _proof_of_work_job;
+    vector<std::unique_ptr<fc::thread>> _proof_of_work_threads;
+
     job_queue _transmit_message_jobs;
     fc::future<void> _transmit_message_worker;
-    fc::thread _proof_of_work_thread;
 
     fc::future<void> _archive_indexing_future;
     fc::thread _archive_indexing_thread;
@@ -180,10 +232,17 @@ public:
         : self(self),
           _wallet(wallet),
           _chain(chain),
-          _proof_of_work_thread("Mail client proof-of-work thread"),
           _archive_indexing_thread("Mail client indexing thread")
-    {}
+    {
+        const uint32_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+        _proof_of_work_threads.reserve(thread_count);
+        for (uint32_t i = 0; i < thread_count; ++i)
+            _proof_of_work_threads.push_back(std::unique_ptr<fc::thread>(
+                new fc::thread("Mail client proof-of-work thread " + std::to_string(i))));
+    }
     ~client_impl(){
+        if (_proof_of_work_job)
+            _proof_of_work_job->canceled = true;
         _proof_of_work_worker.cancel_and_wait("Mail client destroyed");
         _archive_indexing_future.cancel_and_wait();
 
@@ -346,56 +405,83 @@ public:
     void schedule_proof_of_work(const message_id_type& message_id) {
         schedule_generic_task<message_id_type>(_proof_of_work_jobs, _proof_of_work_worker, message_id,
                                                [this](message_id_type message_id){
-            //Use a unique_ptr to ensure deletion, but a raw pointer to copy into the worker thread
-            std::unique_ptr<mail_record> email_uptr(new mail_record(_processing_db.fetch(message_id)));
-            mail_record* email = email_uptr.get();
+            mail_record email = _processing_db.fetch(message_id);
 
-            if (email->status != client::canceled && email->proof_of_work_target != ripemd160()) {
-                email->status = client::proof_of_work;
-                _processing_db.store(email->id, *email);
+            if (email.status != client::canceled && email.proof_of_work_target != ripemd160()) {
+                email.status = client::proof_of_work;
+                _processing_db.store(email.id, email);
             } else {
                 //Don't have a proof-of-work target or message canceled; cannot continue
-                email->status = client::failed;
-                email->failure_reason = (email->status == client::canceled?
-                                             "Canceled by user." :
-                                             "No proof of work target. Cannot do proof of work.");
-                _processing_db.store(email->id, *email);
+                email.status = client::failed;
+                email.failure_reason = (email.status == client::canceled?
+                                            "Canceled by user." :
+                                            "No proof of work target. Cannot do proof of work.");
+                _processing_db.store(email.id, email);
                 return;
             }
 
-            std::unique_ptr<fc::future<void>> slave_handle_uptr(new fc::future<void>());
-            fc::future<void>* slave_handle = slave_handle_uptr.get();
-            while (_processing_db.fetch(message_id).status != client::canceled &&
-                   email->content.id() > email->proof_of_work_target) {
-                email->content.timestamp = blockchain::now();
-                _processing_db.store(email->id, *email);
+            auto job = std::make_shared<proof_of_work_job>(message_id, email.proof_of_work_target);
+            _proof_of_work_job = job;
+            job->found = email.content.id() <= job->target;
+
+            //Each round refreshes the timestamp, then every thread searches its own stride of nonces
+            //until one of them finds a hash under the target, the message is canceled, or the round ends
+            const uint32_t worker_count = _proof_of_work_threads.size();
+            while (!job->canceled && !job->found) {
+                email.content.timestamp = blockchain::now();
+                _processing_db.store(email.id, email);
+
+                auto hasher = std::make_shared<const proof_of_work_hasher>(email.content);
+                const uint64_t first_nonce = email.content.nonce;
+                const fc::time_point round_end = fc::time_point::now() + fc::seconds(1);
+
+                vector<fc::future<uint64_t>> workers;
+                workers.reserve(worker_count);
+                for (uint32_t i = 0; i < worker_count; ++i)
+                    workers.push_back(_proof_of_work_threads[i]->async([job, hasher, first_nonce, round_end, worker_count, i]() -> uint64_t {
+                        uint64_t attempts = 0;
+                        uint64_t nonce = first_nonce + i;
+                        while (!job->found.load(std::memory_order_relaxed) &&
+                               !job->canceled.load(std::memory_order_relaxed)) {
+                            if (hasher->hash(nonce) <= job->target) {
+                                if (!job->found.exchange(true))
+                                    job->winning_nonce = nonce;
+                                break;
+                            }
+                            nonce += worker_count;
+                            if (++attempts % BTS_MAIL_CLIENT_PROOF_OF_WORK_CLOCK_INTERVAL == 0 &&
+                                fc::time_point::now() >= round_end)
+                                break;
+                        }
+                        return attempts;
+                    }, "Mail client proof-of-work worker"));
 
+                uint64_t most_attempts = 0;
                 try {
-                    *slave_handle = _proof_of_work_thread.async([email, slave_handle] {
-                        fc::time_point start_time = fc::time_point::now();
-                        while (!slave_handle->canceled() &&
-                               fc::time_point::now() - start_time < fc::seconds(1) &&
-                               email->content.id() > email->proof_of_work_target)
-                            ++email->content.nonce;
-                    }, "Mail client proof-of-work worker");
-
-                    slave_handle->wait();
+                    for (auto& worker : workers)
+                        most_attempts = std::max(most_attempts, worker.wait());
                 } catch (fc::canceled_exception&) {
-                    slave_handle->cancel();
-                    _proof_of_work_thread.quit();
+                    //Workers hold their own references to the job, so they can be left to notice the flag
+                    job->canceled = true;
                     throw;
                 }
+
+                if (job->found)
+                    email.content.nonce = job->winning_nonce;
+                else
+                    email.content.nonce = first_nonce + (most_attempts + 1) * worker_count;
             }
+            _proof_of_work_job.reset();
 
-            if (_processing_db.fetch(message_id).status == client::canceled) {
-                email->status = client::failed;
-                email->failure_reason = "Canceled by user.";
-                _processing_db.store(message_id, *email);
+            if (job->canceled) {
+                email.status = client::failed;
+                email.failure_reason = "Canceled by user.";
+                _processing_db.store(message_id, email);
                 return;
             }
 
-            _processing_db.store(email->id, *email);
-            schedule_transmit_message(email->id);
+            _processing_db.store(email.id, email);
+            schedule_transmit_message(email.id);
             fc::yield();
         }, "Mail client proof-of-work supervisor");
     }
@@ -664,98 +750,136 @@ public:
                         return;
                     }
 
-                    int received = BTS_MAIL_CLIENT_MAX_INVENTORY_SIZE;
-                    while (received == BTS_MAIL_CLIENT_MAX_INVENTORY_SIZE) {
+                    //Sends one request and waits for its reply; a reply carrying an error is returned as it is
+                    auto call_server = [&](int64_t id, const string& method, const vector<variant>& params) {
                         mutable_variant_object request;
-                        request["id"] = 0;
-                        request["method"] = "mail_fetch_inventory";
-                        request["params"] = vector<variant>({variant(address(account.owner_address())),
-                                                             variant(last_check_time),
-                                                             variant(BTS_MAIL_CLIENT_MAX_INVENTORY_SIZE)});
+                        request["id"] = id;
+                        request["method"] = method;
+                        request["params"] = params;
 
                         fc::json::to_stream(sock, variant_object(request));
                         string raw_response;
                         fc::getline(sock, raw_response);
                         variant_object response = fc::json::from_string(raw_response).as<variant_object>();
 
-                        if (response["id"].as_int64() != 0)
-                            wlog("Server response has wrong ID... attempting to press on. Expected: 0; got: ${r}",
-                                 ("r", response["id"]));
+                        if (response["id"].as_int64() != id)
+                            wlog("Server response has wrong ID... attempting to press on. Expected: ${id}; got: ${r}",
+                                 ("id", id)("r", response["id"]));
+                        return response;
+                    };
+
+                    //The inventory is paged by receive time, which the server only reports to the second, so the
+                    //last second of each page is fetched again and the messages already seen are skipped
+                    fc::time_point start_time = last_check_time;
+                    std::set<message_id_type> seen_messages;
+                    bool bulk_fetch_supported = true;
+                    int received = BTS_MAIL_CLIENT_MAX_INVENTORY_SIZE;
+                    bool found_new_messages = true;
+                    while (received == BTS_MAIL_CLIENT_MAX_INVENTORY_SIZE && found_new_messages) {
+                        vector<variant> params({variant(address(account.owner_address())),
+                                                variant(start_time),
+                                                variant(BTS_MAIL_CLIENT_MAX_INVENTORY_SIZE)});
+                        variant_object response = call_server(0, "mail_fetch_inventory", params);
                         if (response.contains("error")) {
                             elog("Server ${server} gave error ${error} on request ${request}",
-                                 ("server", server)("error", response["error"])("request", request));
+                                 ("server", server)("error", response["error"])("request", params));
                             sock.close();
                             return;
                         }
 
                         inventory_type results = response["result"].as<inventory_type>();
                         received = results.size();
-
-                        for (std::pair<fc::time_point, message_id_type> email : results) {
-                            request["id"] = 1;
-                            request["method"] = "mail_fetch_message";
-                            request["params"] = vector<variant>({variant(email.second)});
-
-                            fc::json::to_stream(sock, variant_object(request));
-                            fc::getline(sock, raw_response);
-                            response = fc::json::from_string(raw_response).as<variant_object>();
-
-                            if (response["id"].as_int64() != 1)
-                                wlog("Server response has wrong ID... attempting to press on. Expected: 1; got: ${r}",
-                                     ("r", response["id"]));
-                            if (response.contains("error")) {
-                                elog("Server ${server} gave error ${error} on request ${request}",
-                                     ("server", server)("error", response["error"])("request", request));
-                                sock.close();
-                                return;
+                        if (!results.empty())
+                            start_time = results.back().first;
+
+                        vector<message_id_type> new_messages;
+                        for (const auto& email : results)
+                            if (seen_messages.insert(email.second).second)
+                                new_messages.push_back(email.second);
+                        found_new_messages = !new_messages.empty();
+
+                        //Download the new messages BTS_MAIL_BULK_FETCH_LIMIT at a time rather than one per request
+                        for (size_t batch_start = 0; batch_start < new_messages.size();
+                             batch_start += BTS_MAIL_BULK_FETCH_LIMIT) {
+                            const size_t batch_end = std::min<size_t>(new_messages.size(),
+                                                                      batch_start + BTS_MAIL_BULK_FETCH_LIMIT);
+                            const vector<message_id_type> batch(new_messages.begin() + batch_start,
+                                                                new_messages.begin() + batch_end);
+                            vector<message> ciphertexts;
+
+                            if (bulk_fetch_supported) {
+                                params = vector<variant>({variant(batch)});
+                                response = call_server(1, "mail_fetch_messages", params);
+                                if (response.contains("error")) {
+                                    //Servers older than mail_fetch_messages don't know it; fetch from them one at a time
+                                    wlog("Server ${server} gave error ${error} on mail_fetch_messages; "
+                                         "fetching messages one at a time", ("server", server)("error", response["error"]));
+                                    bulk_fetch_supported = false;
+                                } else
+                                    ciphertexts = response["result"].as<vector<message>>();
                             }
-
-                            message ciphertext = response["result"].as<message>();
-                            message plaintext = _wallet->mail_open(account.owner_address(), ciphertext);
-                            email_header header;
-                            header.id = ciphertext.id();
-                            if (plaintext.type == mail::email) {
-                                signed_email_message email = plaintext.as<signed_email_message>();
-                                try {
-                                   header.sender = _wallet->get_key_label(email.from());
-                                } catch (fc::exception& e) {
-                                   header.sender = "INVALID SIGNATURE";
-                                }
-                                header.subject = std::move(email.subject);
-                            } else if (plaintext.type == mail::transaction_notice) {
-                                transaction_notice_message notice = plaintext.as<transaction_notice_message>();
-                                try {
-                                   header.sender = _wallet->get_key_label(notice.from());
-                                } catch (fc::exception& e) {
-                                   header.sender = "INVALID SIGNATURE";
+                            if (!bulk_fetch_supported) {
+                                for (const message_id_type& message_id : batch) {
+                                    params = vector<variant>({variant(message_id)});
+                                    response = call_server(1, "mail_fetch_message", params);
+                                    if (response.contains("error")) {
+                                        elog("Server ${server} gave error ${error} on request ${request}",
+                                             ("server", server)("error", response["error"])("request", params));
+                                        sock.close();
+                                        return;
+                                    }
+                                    ciphertexts.push_back(response["result"].as<message>());
                                 }
-                                header.subject = "Transaction Notification";
-                                _wallet->scan_transaction(notice.trx.id().str(), true);
-                                self->new_transaction_notifier(notice);
                             }
-                            header.recipient = account.name;
-                            header.timestamp = plaintext.timestamp;
-                            mail_archive_record record(std::move(ciphertext), header, account.owner_address());
-                            bool new_mail = false;
-
-                            if (auto optional_record = _archive.fetch_optional(email.second)) {
-                                record = *optional_record;
-                                if (record.status == client::accepted) {
-                                    //We sent this message, but it's still newly received mail
-                                    new_mail = true;
-                                    record.status = client::received;
+
+                            for (message& ciphertext : ciphertexts) {
+                                message_id_type message_id = ciphertext.id();
+                                message plaintext = _wallet->mail_open(account.owner_address(), ciphertext);
+                                email_header header;
+                                header.id = message_id;
+                                if (plaintext.type == mail::email) {
+                                    signed_email_message email = plaintext.as<signed_email_message>();
+                                    try {
+                                       header.sender = _wallet->get_key_label(email.from());
+                                    } catch (fc::exception& e) {
+                                       header.sender = "INVALID SIGNATURE";
+                                    }
+                                    header.subject = std::move(email.subject);
+                                } else if (plaintext.type == mail::transaction_notice) {
+                                    transaction_notice_message notice = plaintext.as<transaction_notice_message>();
+                                    try {
+                                       header.sender = _wallet->get_key_label(notice.from());
+                                    } catch (fc::exception& e) {
+                                       header.sender = "INVALID SIGNATURE";
+                                    }
+                                    header.subject = "Transaction Notification";
+                                    _wallet->scan_transaction(notice.trx.id().str(), true);
+                                    self->new_transaction_notifier(notice);
                                 }
-                            } else
-                                new_mail = true;
+                                header.recipient = account.name;
+                                header.timestamp = plaintext.timestamp;
+                                mail_archive_record record(std::move(ciphertext), header, account.owner_address());
+                                bool new_mail = false;
+
+                                if (auto optional_record = _archive.fetch_optional(message_id)) {
+                                    record = *optional_record;
+                                    if (record.status == client::accepted) {
+                                        //We sent this message, but it's still newly received mail
+                                        new_mail = true;
+                                        record.status = client::received;
+                                    }
+                                } else
+                                    new_mail = true;
 
-                            record.mail_servers.insert(std::move(server));
+                                record.mail_servers.insert(std::move(server));
 
-                            _archive.store(email.second, record);
-                            _mail_index.insert(header);
+                                _archive.store(message_id, record);
+                                _mail_index.insert(header);
 
-                            if (new_mail) {
-                                _inbox.store(header.id, header);
-                                ++_messages_in;
+                                if (new_mail) {
+                                    _inbox.store(header.id, header);
+                                    ++_messages_in;
+                                }
                             }
                         }
                     }
@@ -813,6 +937,8 @@ void client::cancel_message(message_id_type message_id)
         detail::mail_record cancel_mail = itr.value();
         cancel_mail.status = canceled;
         my->_processing_db.store(message_id, cancel_mail);
+        if (my->_proof_of_work_job && my->_proof_of_work_job->message_id == message_id)
+            my->_proof_of_work_job->canceled = true;
     }
 }
 
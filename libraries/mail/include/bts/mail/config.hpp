@@ -1,7 +1,11 @@
 #pragma once
 
 #define BTS_MAIL_INVENTORY_FETCH_LIMIT 4096
+#define BTS_MAIL_BULK_FETCH_LIMIT 256
 #define BTS_MAIL_MAX_MESSAGE_SIZE_BYTES (1024*1024)
 #define BTS_MAIL_MAX_MESSAGE_AGE (fc::minutes(5))
+#define BTS_MAIL_MESSAGE_TTL (fc::days(30))
+#define BTS_MAIL_EXPIRATION_INTERVAL (fc::minutes(10))
+#define BTS_MAIL_MAX_MESSAGES_PER_RECIPIENT 10000
 #define BTS_MAIL_PROOF_OF_WORK_TARGET (fc::ripemd160("000ffffffdeadbeeffffffffffffffffffffffff"))
 #define BTS_MAIL_DEFAULT_MAIL_SERVERS (std::unordered_set<std::string>({"nathanhourt.com"}))
@@ -9,4 +9,5 @@ namespace bts { namespace mail {
     FC_DECLARE_DERIVED_EXCEPTION(invalid_proof_of_work, mail_exception, 70003, "invalid proof-of-work");
     FC_DECLARE_DERIVED_EXCEPTION(message_too_large, mail_exception, 70004, "message too large");
     FC_DECLARE_DERIVED_EXCEPTION(message_already_stored, mail_exception, 70005, "message already stored");
+    FC_DECLARE_DERIVED_EXCEPTION(recipient_quota_exceeded, mail_exception, 70006, "recipient quota exceeded");
 } } // namespace bts::mail
@@ -21,6 +21,10 @@ namespace bts { namespace mail {
     *  mail_store( owner, message )
     *  mail_fetch_inventory( owner, start_time, limit ) => vector<message_id_type>
     *  mail_fetch_message( message_id_type )
+    *  mail_fetch_messages( vector<message_id_type> ) => vector<message>
+    *
+    *  Messages are deleted BTS_MAIL_MESSAGE_TTL after the server received them, and no recipient may have
+    *  more than BTS_MAIL_MAX_MESSAGES_PER_RECIPIENT messages stored at once.
     */
     class server : public std::enable_shared_from_this<server>
     {
@@ -37,6 +41,8 @@ namespace bts { namespace mail {
                                           const fc::time_point start, 
                                           uint32_t limit = BTS_MAIL_INVENTORY_FETCH_LIMIT )const;
           message fetch_message( const message_id_type& inventory_id )const;
+          /** messages which have expired or were never stored are left out of the result */
+          std::vector<message> fetch_messages( const std::vector<message_id_type>& inventory_ids )const;
 
        private:
           std::unique_ptr<detail::server_impl> my;
@@ -5,8 +5,11 @@
 #include <bts/blockchain/time.hpp>
 #include <fc/reflect/variant.hpp>
 #include <fc/crypto/ripemd160.hpp>
+#include <fc/thread/thread.hpp>
 #include <fc/time.hpp>
 
+#include <unordered_map>
+
 namespace bts { namespace mail {
 
 struct mail_index
@@ -26,6 +29,24 @@ bool operator == ( const mail_index& a, const mail_index& b )
    return a.owner == b.owner && a.received == b.received;
 }
 
+/** inventory entries in the order they expire */
+struct mail_expiration_index
+{
+   fc::time_point              received;
+   bts::blockchain::address    owner;
+};
+
+bool operator < ( const mail_expiration_index& a, const mail_expiration_index& b )
+{
+   if( a.received < b.received ) return true;
+   if( a.received == b.received ) return a.owner < b.owner;
+   return false;
+}
+bool operator == ( const mail_expiration_index& a, const mail_expiration_index& b )
+{
+   return a.received == b.received && a.owner == b.owner;
+}
+
 }  } // bts::mail
 
 namespace bts { namespace mail {
@@ -40,13 +61,35 @@ namespace bts { namespace mail {
             server_impl( const fc::path& data_dir )
             {
                _mail_inventory_db.open( data_dir / "mail_inventory_db" );
+               _mail_expiration_db.open( data_dir / "mail_expiration_db" );
                _mail_data_db.open( data_dir / "mail_data_db" );
+
+               /* Servers created before messages expired have no expiration index yet */
+               const bool index_expiration = !_mail_expiration_db.begin().valid();
+               for( auto itr = _mail_inventory_db.begin(); itr.valid(); ++itr )
+               {
+                  const auto key = itr.key();
+                  ++_recipient_message_counts[ key.owner ];
+                  if( index_expiration )
+                     _mail_expiration_db.store( mail_expiration_index{ key.received, key.owner }, itr.value() );
+               }
+
+               _expiration_task_done = fc::async( [this](){ expire_messages_task(); }, "mail_expire_messages_task" );
             }
 
             ~server_impl()
             {
+               try {
+                  _expiration_task_done.cancel_and_wait( "server_impl::~server_impl()" );
+               }
+               catch( const fc::exception& e )
+               {
+                  wlog( "error stopping mail expiration task: ${e}", ("e",e.to_detail_string()) );
+               }
+
                try {
                   _mail_inventory_db.close();
+                  _mail_expiration_db.close();
                   _mail_data_db.close();
                } 
                catch ( const fc::exception& e )
@@ -67,10 +110,62 @@ namespace bts { namespace mail {
                if( _mail_data_db.fetch_optional(inventory_id) )
                   FC_THROW_EXCEPTION( message_already_stored, "Message already stored on server." );
 
-               _mail_inventory_db.store( mail_index{msg.recipient,fc::time_point::now()}, inventory_id );
+               uint32_t& message_count = _recipient_message_counts[ msg.recipient ];
+               if( message_count >= BTS_MAIL_MAX_MESSAGES_PER_RECIPIENT )
+                  FC_THROW_EXCEPTION( recipient_quota_exceeded,
+                                      "Recipient already has ${count} messages stored on this server.",
+                                      ("count", message_count) );
+
+               const auto received = fc::time_point::now();
+               _mail_inventory_db.store( mail_index{msg.recipient,received}, inventory_id );
+               _mail_expiration_db.store( mail_expiration_index{received,msg.recipient}, inventory_id );
                _mail_data_db.store( inventory_id, msg );
+               ++message_count;
             } FC_CAPTURE_AND_RETHROW( (msg) ) }
 
+            /**
+             *  Deletes every message received more than BTS_MAIL_MESSAGE_TTL ago, oldest first, then reschedules
+             *  itself.  Runs on the server's thread, so it never interleaves with a store or fetch.
+             */
+            void expire_messages_task()
+            {
+               try
+               {
+                  const auto expiration = fc::time_point::now() - BTS_MAIL_MESSAGE_TTL;
+                  uint32_t expired = 0;
+                  for( auto itr = _mail_expiration_db.begin(); itr.valid() && itr.key().received < expiration; )
+                  {
+                     const auto key = itr.key();
+                     const auto inventory_id = itr.value();
+                     ++itr;
+
+                     _mail_data_db.remove( inventory_id );
+                     _mail_inventory_db.remove( mail_index{key.owner,key.received} );
+                     _mail_expiration_db.remove( key );
+
+                     const auto count_itr = _recipient_message_counts.find( key.owner );
+                     if( count_itr != _recipient_message_counts.end() && --count_itr->second == 0 )
+                        _recipient_message_counts.erase( count_itr );
+                     ++expired;
+                  }
+                  if( expired > 0 )
+                     ilog( "Expired ${n} mail messages", ("n",expired) );
+               }
+               catch( const fc::canceled_exception& )
+               {
+                  throw;
+               }
+               catch( const fc::exception& e )
+               {
+                  wlog( "error expiring mail messages: ${e}", ("e",e.to_detail_string()) );
+               }
+
+               if( !_expiration_task_done.canceled() )
+                  _expiration_task_done = fc::schedule( [this](){ expire_messages_task(); },
+                                                        fc::time_point::now() + BTS_MAIL_EXPIRATION_INTERVAL,
+                                                        "mail_expire_messages_task" );
+            }
+
             inventory_type fetch_inventory( const bts::blockchain::address& owner, 
                                             const fc::time_point start, 
                                             uint32_t limit = BTS_MAIL_INVENTORY_FETCH_LIMIT )
@@ -99,6 +194,22 @@ namespace bts { namespace mail {
                return _mail_data_db.fetch( inventory_id );
             } FC_CAPTURE_AND_RETHROW( (inventory_id) ) }
 
+            vector<message> fetch_messages( const vector<message_id_type>& inventory_ids )
+            { try {
+               FC_ASSERT( inventory_ids.size() <= BTS_MAIL_BULK_FETCH_LIMIT,
+                          "Cannot fetch more than ${limit} messages at once.", ("limit",BTS_MAIL_BULK_FETCH_LIMIT) );
+
+               vector<message> result;
+               result.reserve( inventory_ids.size() );
+               for( const auto& inventory_id : inventory_ids )
+               {
+                  auto msg = _mail_data_db.fetch_optional( inventory_id );
+                  if( msg.valid() )
+                     result.push_back( std::move( *msg ) );
+               }
+               return result;
+            } FC_CAPTURE_AND_RETHROW( (inventory_ids) ) }
+
             void check_incoming_message( const message& msg )
             { try {
                auto now = blockchain::now();
@@ -121,8 +232,12 @@ namespace bts { namespace mail {
             } FC_CAPTURE_AND_RETHROW( (msg) ) }
 
          private:
-            bts::db::level_pod_map< mail_index, message_id_type >   _mail_inventory_db;
-            bts::db::level_map< message_id_type, message >          _mail_data_db;
+            bts::db::level_pod_map< mail_index, message_id_type >               _mail_inventory_db;
+            bts::db::level_pod_map< mail_expiration_index, message_id_type >    _mail_expiration_db;
+            bts::db::level_map< message_id_type, message >                      _mail_data_db;
+
+            std::unordered_map< bts::blockchain::address, uint32_t >             _recipient_message_counts;
+            fc::future<void>                                                     _expiration_task_done;
       };
 
    } // namespace detail
@@ -156,7 +271,12 @@ namespace bts { namespace mail {
    {
       return my->fetch_message( inventory_id );
    }
+   vector<message> server::fetch_messages( const vector<message_id_type>& inventory_ids )const
+   {
+      return my->fetch_messages( inventory_ids );
+   }
 
 } } // bts::mail
 
 FC_REFLECT( bts::mail::mail_index, (owner)(received) );
+FC_REFLECT( bts::mail::mail_expiration_index, (received)(owner) );
@@ -1,7 +1,13 @@
 #include <algorithm>
+#include <deque>
+#include <limits>
+#include <map>
 #include <bts/net/chain_downloader.hpp>
 #include <bts/net/chain_server_commands.hpp>
+#include <bts/net/config.hpp>
 
+#include <fc/compress/lzma.hpp>
+#include <fc/optional.hpp>
 #include <fc/network/tcp_socket.hpp>
 #include <fc/io/raw_variant.hpp>
 #include <fc/thread/thread.hpp>
@@ -13,112 +19,334 @@ namespace bts { namespace net {
         public:
           chain_downloader* self;
 
-          std::unique_ptr<fc::tcp_socket> _client_socket;
           std::vector<fc::ip::endpoint> _chain_servers;
+          bool _compression_enabled = false;
 
-          void connect_to_chain_server()
+          /// Blocks are unpacked here so the thread running the callback only has to apply them
+          fc::thread _decode_thread;
+
+          chain_downloader_impl()
+            : _decode_thread("chain_downloader decode")
+          {}
+
+          std::shared_ptr<fc::tcp_socket> connect_to_chain_server(const fc::ip::endpoint& server)
           { try {
-              _client_socket = std::unique_ptr<fc::tcp_socket>(new fc::tcp_socket);
-              while(!_client_socket->is_open() && !_chain_servers.empty()) {
-                  auto next_server = _chain_servers.back();
-                  _chain_servers.pop_back();
-                  _client_socket = std::unique_ptr<fc::tcp_socket>(new fc::tcp_socket);
-                  try
-                  {
-                      ilog("Attempting to connect to chain server ${s}", ("s",next_server));
-                      _client_socket->connect_to(next_server);
-                  }
-                  catch ( const fc::canceled_exception& )
-                  {
-                      throw;
+              auto client_socket = std::make_shared<fc::tcp_socket>();
+              try
+              {
+                  ilog("Attempting to connect to chain server ${s}", ("s",server));
+                  client_socket->connect_to(server);
+              }
+              catch ( const fc::canceled_exception& )
+              {
+                  throw;
+              }
+              catch (const fc::exception& e) {
+                  wlog("Failed to connect to chain_server: ${e}", ("e", e.to_detail_string()));
+                  client_socket->close();
+                  return std::shared_ptr<fc::tcp_socket>();
+              }
+
+              uint32_t protocol_version = -1;
+              fc::raw::unpack(*client_socket, protocol_version);
+              if (protocol_version != PROTOCOL_VERSION) {
+                  wlog("Can't talk to chain server; he's using protocol ${srv} and I'm using ${cli}!",
+                       ("srv", protocol_version)("cli", PROTOCOL_VERSION));
+                  fc::raw::pack(*client_socket, finish);
+                  client_socket->close();
+                  return std::shared_ptr<fc::tcp_socket>();
+              }
+              return client_socket;
+          } FC_RETHROW_EXCEPTIONS(error, "", ("server", server)) }
+
+          /**
+           * Connects to every chain server we know about. A server which cannot be reached or speaks a different
+           * protocol is removed from _chain_servers, so it is not retried. connected_servers receives the endpoint
+           * of each returned socket, in the same order.
+           */
+          std::vector<std::shared_ptr<fc::tcp_socket>> connect_to_chain_servers(std::vector<fc::ip::endpoint>& connected_servers)
+          {
+              std::vector<std::shared_ptr<fc::tcp_socket>> sockets;
+              const auto servers = _chain_servers;
+              for (const auto& server : servers) {
+                  auto client_socket = connect_to_chain_server(server);
+                  if (client_socket) {
+                      sockets.push_back(client_socket);
+                      connected_servers.push_back(server);
+                  } else {
+                      drop_chain_server(server);
                   }
-                  catch (const fc::exception& e) {
-                      wlog("Failed to connect to chain_server: ${e}", ("e", e.to_detail_string()));
-                      _client_socket->close();
-                      continue;
+              }
+              return sockets;
+          }
+
+          void drop_chain_server(const fc::ip::endpoint& server)
+          {
+              _chain_servers.erase(std::remove(_chain_servers.begin(), _chain_servers.end(), server), _chain_servers.end());
+          }
+
+          static std::vector<blockchain::full_block> decode_block_range(const block_range_chunk& chunk)
+          { try {
+              std::vector<char> uncompressed_data;
+              const std::vector<char>* data = &chunk.data;
+              if (chunk.compressed) {
+                  uncompressed_data = fc::lzma_decompress(chunk.data);
+                  data = &uncompressed_data;
+              }
+
+              std::vector<blockchain::full_block> blocks(chunk.block_count);
+              fc::datastream<const char*> ds(data->data(), data->size());
+              for (auto& block : blocks)
+                  fc::raw::unpack(ds, block);
+              return blocks;
+          } FC_RETHROW_EXCEPTIONS(error, "", ("first_block_number", chunk.first_block_number)("block_count", chunk.block_count)) }
+
+          /**
+           * Downloads blocks first_block_number through last_block_number by spreading ranges of blocks across all
+           * of the sockets, keeping several ranges outstanding on each. Ranges are unpacked on _decode_thread and
+           * handed to the callback in order. Ranges held by a connection which fails are handed back and requested
+           * from the remaining connections. next_block_number is advanced past every block delivered, even if this
+           * throws, so the caller knows where to resume.
+           */
+          void get_block_ranges(const std::vector<std::shared_ptr<fc::tcp_socket>>& sockets,
+                                const std::function<void (const blockchain::full_block&, uint32_t)>& new_block_callback,
+                                uint32_t& next_block_number, uint32_t last_block_number,
+                                fc::time_point& checkpoint)
+          {
+              const uint32_t first_block_number = next_block_number;
+              typedef fc::future<std::vector<blockchain::full_block>> decoded_range_future;
+              std::map<uint32_t, decoded_range_future> decoded_ranges;
+              std::deque<block_range_request> unassigned_ranges;
+              // Ranges requested on any connection but not yet received; a connection only quits once this drops to
+              // zero, because a failing connection may still hand its ranges back
+              size_t ranges_in_flight = 0;
+              for (uint32_t range_start = first_block_number; range_start <= last_block_number;
+                   range_start += BTS_NET_CHAIN_DOWNLOADER_BLOCKS_PER_RANGE) {
+                  block_range_request request;
+                  request.first_block_number = range_start;
+                  request.block_count = std::min<uint32_t>(BTS_NET_CHAIN_DOWNLOADER_BLOCKS_PER_RANGE,
+                                                           last_block_number - range_start + 1);
+                  request.compress = _compression_enabled;
+                  unassigned_ranges.push_back(request);
+              }
+              // Don't let the servers get too far ahead of the callback, but always request a range which comes
+              // before every decoded one: the callback can't drain the buffer without it, e.g. once a failed
+              // connection hands back an early range
+              size_t live_connections = sockets.size();
+              const auto may_request_range = [&](const block_range_request& request) {
+                  return decoded_ranges.empty() ||
+                         decoded_ranges.size() < live_connections * BTS_NET_CHAIN_DOWNLOADER_PIPELINE_DEPTH * 2 ||
+                         request.first_block_number < decoded_ranges.begin()->first;
+              };
+
+              std::vector<fc::future<void>> connection_futures;
+              for (const auto& client_socket : sockets) {
+                  connection_futures.push_back(fc::async([&, client_socket]{
+                      std::deque<block_range_request> outstanding_ranges;
+                      try {
+                          while (true) {
+                              while (outstanding_ranges.size() < BTS_NET_CHAIN_DOWNLOADER_PIPELINE_DEPTH &&
+                                     !unassigned_ranges.empty() && may_request_range(unassigned_ranges.front())) {
+                                  outstanding_ranges.push_back(unassigned_ranges.front());
+                                  unassigned_ranges.pop_front();
+                                  ++ranges_in_flight;
+                                  fc::raw::pack(*client_socket, get_block_range);
+                                  fc::raw::pack(*client_socket, outstanding_ranges.back());
+                              }
+                              if (outstanding_ranges.empty()) {
+                                  if (unassigned_ranges.empty() && ranges_in_flight == 0)
+                                      break;
+                                  fc::usleep(fc::milliseconds(10));
+                                  continue;
+                              }
+
+                              auto chunk = std::make_shared<block_range_chunk>();
+                              fc::raw::unpack(*client_socket, *chunk);
+                              checkpoint = fc::time_point::now();
+
+                              const block_range_request& request = outstanding_ranges.front();
+                              FC_ASSERT(chunk->first_block_number == request.first_block_number &&
+                                        chunk->block_count == request.block_count,
+                                        "Chain server sent us a different range than we asked for",
+                                        ("request", request)("first_block_number", chunk->first_block_number)
+                                        ("block_count", chunk->block_count));
+                              decoded_ranges[request.first_block_number] =
+                                      _decode_thread.async([chunk]{ return decode_block_range(*chunk); }, "decode_block_range");
+                              outstanding_ranges.pop_front();
+                              --ranges_in_flight;
+                          }
+                      } catch (const fc::canceled_exception&) {
+                          throw;
+                      } catch (const fc::exception& e) {
+                          wlog("Lost chain server ${remote} while fetching blocks: ${e}",
+                               ("remote", client_socket->remote_endpoint())("e", e.to_detail_string()));
+                          // Give the ranges we didn't get back so another server can send them
+                          unassigned_ranges.insert(unassigned_ranges.begin(), outstanding_ranges.begin(), outstanding_ranges.end());
+                          ranges_in_flight -= outstanding_ranges.size();
+                          --live_connections;
+                          client_socket->close();
+                      }
+                  }, "chain_downloader connection"));
+              }
+
+              try {
+                  while (next_block_number <= last_block_number) {
+                      auto decoded_range = decoded_ranges.find(next_block_number);
+                      if (decoded_range == decoded_ranges.end()) {
+                          if (std::all_of(connection_futures.begin(), connection_futures.end(),
+                                          [](const fc::future<void>& f) { return f.ready(); }))
+                              break;
+                          fc::usleep(fc::milliseconds(10));
+                          continue;
+                      }
+
+                      auto blocks = decoded_range->second.wait();
+                      decoded_ranges.erase(decoded_range);
+                      for (const auto& block : blocks) {
+                          checkpoint = fc::time_point::now();
+                          new_block_callback(block, last_block_number - next_block_number + 1);
+                          ++next_block_number;
+                      }
                   }
+              } catch (...) {
+                  for (auto& connection_future : connection_futures)
+                      connection_future.cancel_and_wait(__FUNCTION__);
+                  throw;
+              }
+
+              for (auto& connection_future : connection_futures)
+                  connection_future.wait();
+          }
+
+          /**
+           * Streams blocks from next_block_number until the server runs out of blocks, including any that it gets
+           * while we're downloading. next_block_number is advanced past every block delivered.
+           */
+          void get_blocks_from_server_head(fc::tcp_socket& client_socket,
+                                           const std::function<void (const blockchain::full_block&, uint32_t)>& new_block_callback,
+                                           uint32_t& next_block_number, fc::time_point& checkpoint)
+          {
+              fc::raw::pack(client_socket, get_blocks_from_number);
+              fc::raw::pack(client_socket, next_block_number);
+
+              uint32_t blocks_to_retrieve = 0;
+              fc::raw::unpack(client_socket, blocks_to_retrieve);
+              while(blocks_to_retrieve > 0)
+              {
+                  ilog("Server at ${remote} is sending us ${num} blocks.",
+                       ("remote", client_socket.remote_endpoint())("num", blocks_to_retrieve));
+                  for (; blocks_to_retrieve > 0; --blocks_to_retrieve)
+                  {
+                      checkpoint = fc::time_point::now();
+                      blockchain::full_block block;
+                      fc::raw::unpack(client_socket, block);
 
-                  uint32_t protocol_version = -1;
-                  fc::raw::unpack(*_client_socket, protocol_version);
-                  if (protocol_version != PROTOCOL_VERSION) {
-                      wlog("Can't talk to chain server; he's using protocol ${srv} and I'm using ${cli}!",
-                           ("srv", protocol_version)("cli", PROTOCOL_VERSION));
-                      fc::raw::pack(*_client_socket, finish);
-                      _client_socket->close();
+                      new_block_callback(block, blocks_to_retrieve);
+                      ++next_block_number;
                   }
+                  fc::raw::unpack(client_socket, blocks_to_retrieve);
               }
-          } FC_RETHROW_EXCEPTIONS(error, "") }
+          }
 
           void get_all_blocks(std::function<void (const blockchain::full_block&, uint32_t)> new_block_callback,
                               uint32_t first_block_number)
           { try {
               if (!new_block_callback)
                   return;
+              if (first_block_number == 0)
+                  first_block_number = 1;
 
               fc::future<void> work_future;
               while(!_chain_servers.empty()) {
+                 std::vector<std::shared_ptr<fc::tcp_socket>> sockets;
+                 std::vector<fc::ip::endpoint> connected_servers;
+                 // The server we are talking to outside of get_block_ranges, which is the one to blame if that fails
+                 fc::optional<fc::ip::endpoint> current_server;
                  try {
                     fc::time_point checkpoint = fc::time_point::now();
 
                     work_future = fc::async([&]{
-                       connect_to_chain_server();
+                       sockets = connect_to_chain_servers(connected_servers);
                        checkpoint = fc::time_point::now();
-                       FC_ASSERT(_client_socket->is_open(), "unable to connect to any chain server");
-                       ilog("Connected to ${remote}; requesting blocks after ${num}",
-                            ("remote", _client_socket->remote_endpoint())("num", first_block_number));
+                       FC_ASSERT(!sockets.empty(), "unable to connect to any chain server");
+
+                       // Only ask for ranges every server is able to send in full; anything newer is streamed
+                       // from one server at the end
+                       uint32_t last_common_block_number = std::numeric_limits<uint32_t>::max();
+                       for (size_t i = 0; i < sockets.size(); ++i) {
+                           current_server = connected_servers[i];
+                           uint32_t head_block_number = 0;
+                           fc::raw::pack(*sockets[i], get_head_block_number);
+                           fc::raw::unpack(*sockets[i], head_block_number);
+                           last_common_block_number = std::min(last_common_block_number, head_block_number);
+                       }
+                       current_server.reset();
+                       checkpoint = fc::time_point::now();
+                       ilog("Connected to ${n} chain servers; requesting blocks ${first} through ${last}",
+                            ("n", sockets.size())("first", first_block_number)("last", last_common_block_number));
 
                        ulog("Starting fast-sync of blocks from ${num}", ("num", first_block_number));
                        auto start_time = fc::time_point::now();
+                       const uint32_t first_block_requested = first_block_number;
 
-                       fc::raw::pack(*_client_socket, get_blocks_from_number);
-                       fc::raw::pack(*_client_socket, first_block_number);
-
-                       uint32_t blocks_to_retrieve = 0;
-                       uint32_t blocks_in = 0;
-                       fc::raw::unpack(*_client_socket, blocks_to_retrieve);
-                       ilog("Server at ${remote} is sending us ${num} blocks.",
-                            ("remote", _client_socket->remote_endpoint())("num", blocks_to_retrieve));
-
-                       while(blocks_to_retrieve > 0)
-                       {
-                           checkpoint = fc::time_point::now();
-                           blockchain::full_block block;
-                           fc::raw::unpack(*_client_socket, block);
-
-                           new_block_callback(block, blocks_to_retrieve);
-                           --blocks_to_retrieve;
-                           ++blocks_in;
-
-                           if(blocks_to_retrieve == 0) {
-                               fc::raw::unpack(*_client_socket, blocks_to_retrieve);
-                               if(blocks_to_retrieve > 0)
-                                   ilog("Server at ${remote} is sending us ${num} blocks.",
-                                        ("remote", _client_socket->remote_endpoint())("num", blocks_to_retrieve));
-                           }
-                       }
+                       if (first_block_number <= last_common_block_number)
+                           get_block_ranges(sockets, new_block_callback, first_block_number, last_common_block_number, checkpoint);
+                       FC_ASSERT(first_block_number > last_common_block_number,
+                                 "chain servers stopped sending blocks", ("next_block_number", first_block_number));
+
+                       auto streaming_socket = std::find_if(sockets.begin(), sockets.end(),
+                                                            [](const std::shared_ptr<fc::tcp_socket>& s) { return s->is_open(); });
+                       FC_ASSERT(streaming_socket != sockets.end(), "lost connection to all chain servers");
+                       current_server = connected_servers[streaming_socket - sockets.begin()];
+                       get_blocks_from_server_head(**streaming_socket, new_block_callback, first_block_number, checkpoint);
+                       current_server.reset();
                        checkpoint = fc::time_point::now();
 
+                       const uint32_t blocks_in = first_block_number - first_block_requested;
                        ulog("Finished fast-syncing ${num} blocks at ${rate} blocks/sec.",
                             ("num", blocks_in)("rate", blocks_in/((fc::time_point::now() - start_time).count() / 1000000.0)));
-                       wlog("Finished getting ${num} blocks from ${remote} at ${rate} blocks/sec.",
-                            ("num", blocks_in)("remote", _client_socket->remote_endpoint())
+                       wlog("Finished getting ${num} blocks from ${n} chain servers at ${rate} blocks/sec.",
+                            ("num", blocks_in)("n", sockets.size())
                             ("rate", blocks_in/((fc::time_point::now() - start_time).count() / 1000000.0)));
-                       fc::raw::pack(*_client_socket, finish);
+                       for (const auto& client_socket : sockets)
+                           if (client_socket->is_open())
+                               fc::raw::pack(*client_socket, finish);
                     }, "get_all_blocks worker");
 
                     while(!work_future.ready()) {
-                        if(fc::time_point::now() - checkpoint > fc::seconds(1)) {
+                        if(fc::time_point::now() - checkpoint > fc::seconds(5)) {
                             work_future.cancel_and_wait("Timed out");
                             FC_THROW("Timed out");
                         }
                         fc::sleep_until(fc::time_point::now() + fc::milliseconds(500));
                     }
+                    work_future.wait();
+                    return;
                  } catch(fc::canceled_exception) {
                       work_future.cancel_and_wait();
                       throw;
+                 } catch (const fc::exception& e) {
+                      wlog("Fast-sync interrupted at block ${num}; falling back to the remaining chain servers: ${e}",
+                           ("num", first_block_number)("e", e.to_detail_string()));
                  }
-                 FC_CAPTURE_AND_LOG((_client_socket->remote_endpoint()))
+
+                 // Drop the servers which failed us and retry from where we stopped with the others. If none of the
+                 // connections is known to have failed, drop the one we were talking to so we can't loop forever.
+                 bool dropped_server = false;
+                 for (size_t i = 0; i < sockets.size(); ++i) {
+                     if (!sockets[i]->is_open()) {
+                         drop_chain_server(connected_servers[i]);
+                         dropped_server = true;
+                     }
+                 }
+                 if (!dropped_server && current_server)
+                     drop_chain_server(*current_server);
+                 else if (!dropped_server && !connected_servers.empty())
+                     drop_chain_server(connected_servers.front());
+                 for (const auto& client_socket : sockets)
+                     client_socket->close();
               }
+              FC_THROW("Ran out of chain servers before downloading every block", ("next_block_number", first_block_number));
           } FC_RETHROW_EXCEPTIONS(error, "", ("first_block_number", first_block_number)) }
       };
     } //namespace detail
@@ -149,6 +377,11 @@ namespace bts { namespace net {
         my->_chain_servers.shrink_to_fit();
     }
 
+    void chain_downloader::set_compression_enabled(bool enabled)
+    {
+        my->_compression_enabled = enabled;
+    }
+
     fc::future<void> chain_downloader::get_all_blocks(std::function<void(const blockchain::full_block&,
                                                                          uint32_t)>
                                                                new_block_callback,
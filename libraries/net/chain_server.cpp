@@ -1,7 +1,9 @@
 #include <bts/net/stcp_socket.hpp>
 #include <bts/net/chain_server.hpp>
 #include <bts/net/chain_server_commands.hpp>
+#include <bts/net/config.hpp>
 
+#include <fc/compress/lzma.hpp>
 #include <fc/io/raw_variant.hpp>
 #include <fc/thread/thread.hpp>
 #include <fc/network/ip.hpp>
@@ -16,6 +18,8 @@ namespace bts { namespace net {
 
             fc::tcp_server _server_socket;
             std::shared_ptr<bts::blockchain::chain_database> _chain_db;
+            /// The thread which owns _chain_db; workers only read the chain through snapshots created there
+            fc::thread* _chain_thread;
             fc::future<void> _accept_loop_handle;
             std::set<fc::thread*> _idle_threads;
             std::set<fc::thread*> _busy_threads;
@@ -25,6 +29,7 @@ namespace bts { namespace net {
 
             chain_server_impl(std::shared_ptr<bts::blockchain::chain_database> chain_ptr, uint16_t port)
               : _chain_db(chain_ptr),
+                _chain_thread(&fc::thread::current()),
                 _target_thread_count(std::thread::hardware_concurrency()),
                 _max_thread_count(std::thread::hardware_concurrency() * 2)
             {
@@ -70,6 +75,10 @@ namespace bts { namespace net {
                 }
             }
 
+            bts::blockchain::chain_snapshot_ptr get_chain_snapshot() {
+                return _chain_thread->async([this]{ return _chain_db->create_read_snapshot(); }, "create_read_snapshot").wait();
+            }
+
             void handle_get_blocks_from_number(fc::tcp_socket& connection_socket) {
               try {
                 uint32_t start_block;
@@ -77,19 +86,21 @@ namespace bts { namespace net {
                 if (start_block == 0) start_block = 1;
                 uint32_t end_block = start_block;
 
-                while (end_block <= _chain_db->get_head_block_num()) {
-                    end_block = _chain_db->get_head_block_num();
+                auto chain = get_chain_snapshot();
+                while (end_block <= chain->get_head_block_num()) {
+                    end_block = chain->get_head_block_num();
                     auto blocks_to_send = end_block - start_block + 1;
                     fc::raw::pack(connection_socket, blocks_to_send);
 
                     ilog("Sending blocks from ${start} to ${finish} to ${remote}",
                          ("start", start_block)("finish", end_block)("remote", connection_socket.remote_endpoint()));
                     for (; start_block <= end_block; ++start_block) {
-                        fc::raw::pack(connection_socket, _chain_db->get_block(start_block));
+                        fc::raw::pack(connection_socket, chain->get_block(start_block));
                         if (start_block % 10 == 0)
                             fc::yield();
                     }
                     end_block = start_block;
+                    chain = get_chain_snapshot();
                 }
 
                 // Now sending zero more blocks...
@@ -97,6 +108,42 @@ namespace bts { namespace net {
               } FC_RETHROW_EXCEPTIONS(error, "", ("remote_endpoint", connection_socket.remote_endpoint()))
             }
 
+            void handle_get_head_block_number(fc::tcp_socket& connection_socket) {
+              try {
+                fc::raw::pack(connection_socket, get_chain_snapshot()->get_head_block_num());
+              } FC_RETHROW_EXCEPTIONS(error, "", ("remote_endpoint", connection_socket.remote_endpoint()))
+            }
+
+            void handle_get_block_range(fc::tcp_socket& connection_socket) {
+              try {
+                block_range_request request;
+                fc::raw::unpack(connection_socket, request);
+                FC_ASSERT(request.block_count <= BTS_NET_CHAIN_SERVER_MAX_BLOCKS_PER_RANGE,
+                          "Client requested too many blocks at once", ("request", request));
+                if (request.first_block_number == 0) request.first_block_number = 1;
+
+                // Blocks are forwarded exactly as they are stored, without being unpacked
+                const auto packed_blocks = get_chain_snapshot()->get_packed_blocks(request.first_block_number, request.block_count);
+
+                block_range_chunk chunk;
+                chunk.first_block_number = request.first_block_number;
+                chunk.block_count = packed_blocks.size();
+                size_t total_size = 0;
+                for (const auto& packed_block : packed_blocks)
+                    total_size += packed_block.size();
+                chunk.data.reserve(total_size);
+                for (const auto& packed_block : packed_blocks)
+                    chunk.data.insert(chunk.data.end(), packed_block.begin(), packed_block.end());
+
+                if (request.compress && !chunk.data.empty()) {
+                    chunk.data = fc::lzma_compress(chunk.data);
+                    chunk.compressed = true;
+                }
+
+                fc::raw::pack(connection_socket, chunk);
+              } FC_RETHROW_EXCEPTIONS(error, "", ("remote_endpoint", connection_socket.remote_endpoint()))
+            }
+
             void serve_client(fc::tcp_socket* connection_socket) {
               try {
                 FC_ASSERT(connection_socket->is_open());
@@ -111,6 +158,12 @@ namespace bts { namespace net {
                       case get_blocks_from_number:
                         handle_get_blocks_from_number(*connection_socket);
                         break;
+                      case get_head_block_number:
+                        handle_get_head_block_number(*connection_socket);
+                        break;
+                      case get_block_range:
+                        handle_get_block_range(*connection_socket);
+                        break;
                       case finish:
                         break;
                     }
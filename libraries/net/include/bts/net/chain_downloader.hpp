@@ -39,14 +39,24 @@ namespace bts { namespace net {
          * @param servers Vector of chain_server endpoints
          */
         void add_chain_servers(const std::vector<fc::ip::endpoint>& servers);
+        /**
+         * @brief Ask chain_servers to lzma compress the blocks they send. This saves bandwidth when the servers are
+         * remote, but costs CPU on both ends, so it is off by default.
+         */
+        void set_compression_enabled(bool enabled);
 
         /**
-         * @brief Asynchronously retrieve all new blocks from one of the available chain_server nodes
+         * @brief Asynchronously retrieve all new blocks from the available chain_server nodes
+         *
+         * Blocks are requested in ranges spread across every chain_server we can connect to, with several ranges
+         * outstanding on each connection. They are unpacked on a separate thread, and the callback is always
+         * called in block order.
          * @param new_block_callback Callback function taking the newly downloaded block and the count of blocks remaining
          * @param first_block_number The first block number to download. Defaults to 0, which means to download all
          * blocks in chain.
          * @return A future monitoring the function downloading blocks. When this future completes, all blocks have
-         * been downloaded.
+         * been downloaded. If a chain_server fails, the download resumes from the remaining servers; if they all
+         * fail first, the future completes with an exception.
          *
          * If new_block_callback is unset, a valid future is still returned, but nothing will be done and the
          * function monitored by the future will return immediately.
@@ -26,6 +26,15 @@ namespace bts { namespace net {
      *      full_block objects. When the server has finished sending these blocks, it repeats the procedure for
      *      any new blocks which have been made in the interim, so another count is sent, followed by that number
      *      of blocks. When the server sends a count of 0, there are no blocks, and the command is complete.
+     * * get_head_block_number
+     *      This command takes no arguments. The server responds with the number of its current head block.
+     * * get_block_range
+     *      This command takes a block_range_request: the number of the first block, the maximum number of blocks to
+     *      send (at most BTS_NET_CHAIN_SERVER_MAX_BLOCKS_PER_RANGE), and whether the reply should be compressed. The
+     *      server responds with a single block_range_chunk holding the blocks as they are stored on disk, packed back
+     *      to back and optionally lzma compressed. Fewer blocks than requested are sent if the server's head block is
+     *      reached. Since commands are handled in order, a client may send several get_block_range commands before
+     *      reading the replies.
      *
      * All block numbers are of type uint32_t
      */
@@ -7,14 +7,37 @@
 
 #include <fc/reflect/reflect.hpp>
 
-const static uint32_t PROTOCOL_VERSION = 0;
+#include <vector>
+
+const static uint32_t PROTOCOL_VERSION = 1;
 
 namespace bts { namespace net { namespace detail {
     enum chain_server_commands {
         finish = 0,
-        get_blocks_from_number
+        get_blocks_from_number,
+        get_head_block_number,
+        get_block_range
+    };
+
+    struct block_range_request {
+        uint32_t first_block_number = 0;
+        uint32_t block_count = 0;
+        bool     compress = false;
+    };
+
+    /**
+     * A run of consecutive blocks, each one fc::raw packed as a full_block and concatenated into data. If
+     * compressed is set, data has been run through fc::lzma_compress as a whole.
+     */
+    struct block_range_chunk {
+        uint32_t          first_block_number = 0;
+        uint32_t          block_count = 0;
+        bool              compressed = false;
+        std::vector<char> data;
     };
 } } } //namespace bts::net::detail
 
-FC_REFLECT_ENUM(bts::net::detail::chain_server_commands, (finish)(get_blocks_from_number))
+FC_REFLECT_ENUM(bts::net::detail::chain_server_commands, (finish)(get_blocks_from_number)(get_head_block_number)(get_block_range))
 FC_REFLECT_TYPENAME(bts::net::detail::chain_server_commands)
+FC_REFLECT(bts::net::detail::block_range_request, (first_block_number)(block_count)(compress))
+FC_REFLECT(bts::net::detail::block_range_chunk, (first_block_number)(block_count)(compressed)(data))
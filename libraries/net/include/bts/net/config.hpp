@@ -35,6 +35,14 @@
 
 #define BTS_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES        (1024 * 1024)
 
+/**
+ * Messages we relay are kept in a cache so we can answer fetch requests from our
+ * peers.  They are dropped after this many blocks, or sooner (oldest first) if the
+ * cache grows beyond BTS_NET_MAX_MESSAGE_CACHE_SIZE_IN_BYTES.
+ */
+#define BTS_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS        2
+#define BTS_NET_MAX_MESSAGE_CACHE_SIZE_IN_BYTES         (64 * 1024 * 1024)
+
 /**
  * We prevent a peer from offering us a list of blocks which, if we fetched them
  * all, would result in a blockchain that extended into the future.
@@ -57,3 +65,13 @@
  * but haven't yet fetched drops below this
  */
 #define BTS_NET_MIN_BLOCK_IDS_TO_PREFETCH               10000
+
+/**
+ * The chain_downloader fetches blocks from chain_servers in ranges of this many
+ * blocks, keeping up to BTS_NET_CHAIN_DOWNLOADER_PIPELINE_DEPTH ranges outstanding
+ * on each server connection.  A chain_server refuses to send more than
+ * BTS_NET_CHAIN_SERVER_MAX_BLOCKS_PER_RANGE blocks in a single range.
+ */
+#define BTS_NET_CHAIN_DOWNLOADER_BLOCKS_PER_RANGE       200
+#define BTS_NET_CHAIN_DOWNLOADER_PIPELINE_DEPTH         4
+#define BTS_NET_CHAIN_SERVER_MAX_BLOCKS_PER_RANGE       2000
@@ -43,6 +43,7 @@
 #include <fc/io/json.hpp>
 #include <fc/io/enum_type.hpp>
 #include <fc/crypto/rand.hpp>
+#include <fc/crypto/city.hpp>
 #include <fc/network/rate_limiting.hpp>
 
 #include <bts/net/node.hpp>
@@ -98,26 +99,42 @@ namespace bts { namespace net {
   namespace detail
   {
     namespace bmi = boost::multi_index;
+
+    struct message_hash_hasher
+    {
+      size_t operator()( const fc::uint160_t& hash_to_hash ) const
+      {
+        return fc::city_hash_size_t( hash_to_hash.data(), hash_to_hash.data_size() );
+      }
+    };
+
+    /**
+     * Holds recently broadcast messages so we can answer fetch requests from our peers
+     * without going back to the client.  Messages are dropped when they are more than
+     * BTS_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS blocks old, or when the total size of the
+     * cached messages would exceed BTS_NET_MAX_MESSAGE_CACHE_SIZE_IN_BYTES (oldest first).
+     *
+     * Message bodies are stored behind a shared_ptr so serving the same message to many
+     * peers doesn't copy it.
+     */
     class blockchain_tied_message_cache
     {
     private:
-      static const uint32_t cache_duration_in_blocks = 2;
-
       struct message_hash_index{};
       struct message_contents_hash_index{};
-      struct block_clock_index{};
+      struct age_index{};
       struct message_info
       {
-        message_hash_type message_hash;
-        message           message_body;
-        uint32_t          block_clock_when_received;
+        message_hash_type               message_hash;
+        std::shared_ptr<const message>  message_body;
+        uint32_t                        block_clock_when_received;
 
         // for network performance stats
         message_propagation_data propagation_data;
         fc::uint160_t     message_contents_hash; // hash of whatever the message contains (if it's a transaction, this is the transaction id, if it's a block, it's the block_id)
 
         message_info( const message_hash_type& message_hash,
-                      const message&           message_body,
+                      const std::shared_ptr<const message>& message_body,
                       uint32_t                 block_clock_when_received,
                       const message_propagation_data& propagation_data,
                       fc::uint160_t            message_contents_hash ) :
@@ -127,39 +144,77 @@ namespace bts { namespace net {
           propagation_data( propagation_data ),
           message_contents_hash( message_contents_hash )
         {}
+
+        size_t size_in_bytes() const { return sizeof(message_info) + message_body->data.size(); }
       };
+      // the sequenced index keeps messages in the order they were received, which is also
+      // block_clock order, so the oldest message is always at the front
       typedef boost::multi_index_container
         < message_info,
-            bmi::indexed_by< bmi::ordered_unique< bmi::tag<message_hash_index>,
-                                                  bmi::member<message_info, message_hash_type, &message_info::message_hash> >,
-                             bmi::ordered_non_unique< bmi::tag<message_contents_hash_index>,
-                                                      bmi::member<message_info, fc::uint160_t, &message_info::message_contents_hash> >,
-                             bmi::ordered_non_unique< bmi::tag<block_clock_index>,
-                                                      bmi::member<message_info, uint32_t, &message_info::block_clock_when_received> > >
+            bmi::indexed_by< bmi::hashed_unique< bmi::tag<message_hash_index>,
+                                                 bmi::member<message_info, message_hash_type, &message_info::message_hash>,
+                                                 message_hash_hasher >,
+                             bmi::hashed_non_unique< bmi::tag<message_contents_hash_index>,
+                                                     bmi::member<message_info, fc::uint160_t, &message_info::message_contents_hash>,
+                                                     message_hash_hasher >,
+                             bmi::sequenced< bmi::tag<age_index> > >
         > message_cache_container;
 
       message_cache_container _message_cache;
 
       uint32_t block_clock;
+      uint64_t _max_size_in_bytes;
+      uint64_t _size_in_bytes;
+
+      uint64_t _hit_count;
+      uint64_t _miss_count;
+      uint64_t _expired_count;
+      uint64_t _evicted_count;
+
+      void erase_oldest();
 
     public:
       blockchain_tied_message_cache() :
-        block_clock( 0 )
+        block_clock( 0 ),
+        _max_size_in_bytes( BTS_NET_MAX_MESSAGE_CACHE_SIZE_IN_BYTES ),
+        _size_in_bytes( 0 ),
+        _hit_count( 0 ),
+        _miss_count( 0 ),
+        _expired_count( 0 ),
+        _evicted_count( 0 )
       {}
       void block_accepted();
       void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
                         const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
-      message get_message( const message_hash_type& hash_of_message_to_lookup );
+      std::shared_ptr<const message> get_message( const message_hash_type& hash_of_message_to_lookup );
       message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
       size_t size() const { return _message_cache.size(); }
+      uint64_t size_in_bytes() const { return _size_in_bytes; }
+      uint64_t max_size_in_bytes() const { return _max_size_in_bytes; }
+      void set_max_size_in_bytes( uint64_t max_size_in_bytes );
+      fc::variant_object get_statistics() const;
     };
 
+    void blockchain_tied_message_cache::erase_oldest()
+    {
+      auto& age_idx = _message_cache.get<age_index>();
+      _size_in_bytes -= age_idx.front().size_in_bytes();
+      age_idx.pop_front();
+    }
+
     void blockchain_tied_message_cache::block_accepted()
     {
       ++block_clock;
-      if( block_clock > cache_duration_in_blocks )
-        _message_cache.get<block_clock_index>().erase(_message_cache.get<block_clock_index>().begin(),
-                                                      _message_cache.get<block_clock_index>().lower_bound(block_clock - cache_duration_in_blocks ) );
+      if( block_clock > BTS_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS )
+      {
+        const uint32_t oldest_block_clock_to_keep = block_clock - BTS_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS;
+        auto& age_idx = _message_cache.get<age_index>();
+        while( !age_idx.empty() && age_idx.front().block_clock_when_received < oldest_block_clock_to_keep )
+        {
+          erase_oldest();
+          ++_expired_count;
+        }
+      }
     }
 
     void blockchain_tied_message_cache::cache_message( const message& message_to_cache,
@@ -167,19 +222,33 @@ namespace bts { namespace net {
                                                      const message_propagation_data& propagation_data,
                                                      const fc::uint160_t& message_content_hash )
     {
-      _message_cache.insert( message_info(hash_of_message_to_cache,
-                                         message_to_cache,
-                                         block_clock,
-                                         propagation_data,
-                                         message_content_hash ) );
+      auto result = _message_cache.insert( message_info(hash_of_message_to_cache,
+                                                        std::make_shared<const message>( message_to_cache ),
+                                                        block_clock,
+                                                        propagation_data,
+                                                        message_content_hash ) );
+      if( !result.second )
+        return;
+      _size_in_bytes += result.first->size_in_bytes();
+
+      // never evict the message we just inserted, even if it alone is over budget
+      while( _size_in_bytes > _max_size_in_bytes && _message_cache.size() > 1 )
+      {
+        erase_oldest();
+        ++_evicted_count;
+      }
     }
 
-    message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
+    std::shared_ptr<const message> blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
     {
       message_cache_container::index<message_hash_index>::type::const_iterator iter =
          _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
       if( iter != _message_cache.get<message_hash_index>().end() )
+      {
+        ++_hit_count;
         return iter->message_body;
+      }
+      ++_miss_count;
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
@@ -195,6 +264,31 @@ namespace bts { namespace net {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
+    void blockchain_tied_message_cache::set_max_size_in_bytes( uint64_t max_size_in_bytes )
+    {
+      _max_size_in_bytes = max_size_in_bytes;
+      while( _size_in_bytes > _max_size_in_bytes && !_message_cache.empty() )
+      {
+        erase_oldest();
+        ++_evicted_count;
+      }
+    }
+
+    fc::variant_object blockchain_tied_message_cache::get_statistics() const
+    {
+      fc::mutable_variant_object stats;
+      stats["message_count"] = _message_cache.size();
+      stats["size_in_bytes"] = _size_in_bytes;
+      stats["max_size_in_bytes"] = _max_size_in_bytes;
+      stats["hit_count"] = _hit_count;
+      stats["miss_count"] = _miss_count;
+      const uint64_t lookup_count = _hit_count + _miss_count;
+      stats["hit_rate"] = lookup_count ? double(_hit_count) / lookup_count : 0.0;
+      stats["expired_count"] = _expired_count;
+      stats["evicted_count"] = _evicted_count;
+      return stats;
+    }
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     // This specifies configuration info for the local node.  It's stored as JSON
@@ -2467,13 +2561,13 @@ namespace bts { namespace net { namespace detail {
       {
         try
         {
-          message requested_message = _message_cache.get_message( item_hash );
+          std::shared_ptr<const message> requested_message = _message_cache.get_message( item_hash );
           dlog( "received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ( "endpoint", originating_peer->get_remote_endpoint() )
-               ( "id", requested_message.id() ) );
-          reply_messages.push_back( requested_message );
+               ( "id", item_hash ) );
+          reply_messages.push_back( *requested_message );
           if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
+            last_block_message_sent = *requested_message;
           continue;
         }
         catch ( fc::key_not_found_exception& )
@@ -4342,7 +4436,7 @@ namespace bts { namespace net { namespace detail {
       ilog( "node._new_received_sync_items size: ${size}", ("size", _new_received_sync_items.size() ) );
       ilog( "node._items_to_fetch size: ${size}", ("size", _items_to_fetch.size() ) );
       ilog( "node._new_inventory size: ${size}", ("size", _new_inventory.size() ) );
-      ilog( "node._message_cache size: ${size}", ("size", _message_cache.size() ) );
+      ilog( "node._message_cache size: ${size} (${bytes} bytes)", ("size", _message_cache.size() )("bytes", _message_cache.size_in_bytes() ) );
       for( const peer_connection_ptr& peer : _active_connections )
       {
         ilog( "  peer ${endpoint}", ("endpoint", peer->get_remote_endpoint() ) );
@@ -4607,6 +4701,8 @@ namespace bts { namespace net { namespace detail {
         _maximum_number_of_sync_blocks_to_prefetch = params["maximum_number_of_sync_blocks_to_prefetch"].as<uint32_t>();
       if (params.contains("maximum_blocks_per_peer_during_syncing"))
         _maximum_blocks_per_peer_during_syncing = params["maximum_blocks_per_peer_during_syncing"].as<uint32_t>();
+      if (params.contains("maximum_message_cache_size_in_bytes"))
+        _message_cache.set_max_size_in_bytes(params["maximum_message_cache_size_in_bytes"].as<uint64_t>());
 
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -4629,6 +4725,8 @@ namespace bts { namespace net { namespace detail {
         result["maximum_number_of_sync_blocks_to_prefetch"] = _maximum_number_of_sync_blocks_to_prefetch;
       if (_maximum_blocks_per_peer_during_syncing != BTS_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING)
       result["maximum_blocks_per_peer_during_syncing"] = _maximum_blocks_per_peer_during_syncing;
+      if (_message_cache.max_size_in_bytes() != BTS_NET_MAX_MESSAGE_CACHE_SIZE_IN_BYTES)
+        result["maximum_message_cache_size_in_bytes"] = _message_cache.max_size_in_bytes();
       return result;
     }
 
@@ -4697,6 +4795,7 @@ namespace bts { namespace net { namespace detail {
       info["node_public_key"] = _node_public_key;
       info["node_id"] = _node_id;
       info["firewalled"] = _is_firewalled;
+      info["message_cache"] = _message_cache.get_statistics();
       return info;
     }
     fc::variant_object node_impl::network_get_usage_stats() const
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <bts/blockchain/chain_database.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include <memory>
+#include <string>
+
+namespace bts { namespace rpc {
+  using namespace bts::blockchain;
+
+  namespace detail { class response_cache_impl; }
+
+  struct cached_response
+  {
+     fc::variant  result;
+     /** result already serialized, so HTTP replies can be sent without serializing it again */
+     std::string  json;
+  };
+  typedef std::shared_ptr<const cached_response> cached_response_ptr;
+
+  /**
+   *  Caches the results of RPC methods marked "cacheable" in the api description, whose results only
+   *  depend on their parameters and the chain state.  Entries are keyed by method, parameters and head
+   *  block id, and the whole cache is dropped whenever the chain state changes.
+   */
+  class response_cache : public chain_observer
+  {
+     public:
+        response_cache( const chain_database_ptr& chain_db, uint32_t max_entries );
+        virtual ~response_cache();
+
+        /** must be called before the method runs, so a block arriving mid-call can't mislabel the result */
+        std::string          make_key( const std::string& method_name, const fc::variants& parameters )const;
+
+        /** bumped by every clear(); take it with make_key and hand it to store() */
+        uint64_t             get_generation()const;
+
+        cached_response_ptr  find( const std::string& key );
+        /** does nothing if the cache was cleared since generation was read, since the result may be stale */
+        void                 store( const std::string& key, const cached_response_ptr& response, uint64_t generation );
+        void                 clear();
+
+        fc::variant_object   get_statistics()const;
+
+        virtual void state_changed( const pending_chain_state_ptr& state )override;
+        virtual void block_applied( const block_summary& summary )override;
+
+     private:
+        std::unique_ptr<detail::response_cache_impl> my;
+  };
+  typedef std::shared_ptr<response_cache> response_cache_ptr;
+
+} } // bts::rpc
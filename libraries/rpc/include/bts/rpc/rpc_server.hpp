@@ -32,6 +32,8 @@ namespace bts { namespace rpc {
 
        /// used to invoke json methods from the cli without going over the network
        fc::variant direct_invoke_method(const std::string& method_name, const fc::variants& arguments);
+       /// same as a binary_call over a json connection: the parameters and result are packed with fc::raw
+       std::vector<char> direct_invoke_binary_method(const std::string& method_name, const std::vector<char>& packed_parameters);
 
        const bts::api::method_data& get_method_data(const std::string& method_name);
        std::vector<bts::api::method_data> get_all_method_data() const;
@@ -47,6 +49,14 @@ namespace bts { namespace rpc {
 
        fc::optional<fc::ip::endpoint> get_rpc_endpoint() const;
        fc::optional<fc::ip::endpoint> get_httpd_endpoint() const;
+
+       /** subscriptions made through the api, whose notices are queued until poll_notices fetches them */
+       uint32_t     subscribe( const fc::variant& filter );
+       void         unsubscribe( uint32_t subscription_id );
+       fc::variants poll_notices( uint32_t subscription_id, uint32_t timeout_sec );
+
+       /** hits, misses and size of the cache of cacheable method results */
+       fc::variant_object get_response_cache_statistics() const;
      protected:
        friend class bts::rpc::detail::rpc_server_impl;
 
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <bts/blockchain/chain_database.hpp>
+
+#include <fc/time.hpp>
+
+#include <functional>
+#include <memory>
+
+namespace bts { namespace rpc {
+  using namespace bts::blockchain;
+
+  namespace detail { class subscription_manager_impl; }
+
+  /** what a subscriber wants to hear about; a notice is only sent for blocks that match something */
+  struct subscription_filter
+  {
+     /** notify for every block, even if nothing else in the filter matched */
+     bool                                 new_blocks = false;
+     /** balances owned by these addresses that were created or changed */
+     std::set<address>                    addresses;
+     /** fills in these markets, given as (quote symbol, base symbol) */
+     std::set<std::pair<string, string>>  markets;
+     /** updates to these accounts, and balances owned by their active or owner keys */
+     std::set<string>                     accounts;
+  };
+
+  struct subscription_notice
+  {
+     uint32_t                    subscription_id = 0;
+     uint32_t                    block_num = 0;
+     block_id_type               block_id;
+     fc::time_point_sec          timestamp;
+     vector<balance_record>      balances;
+     vector<market_transaction>  market_transactions;
+     vector<account_record>      accounts;
+  };
+
+  /**
+   *  Computes what changed in each applied block once and hands each subscriber the parts of it that
+   *  match its filter, so clients don't have to poll for new blocks, fills and incoming transfers.
+   *
+   *  Subscribers either provide a handler that is called with each notice (used for the persistent
+   *  JSON connection, where the notice is pushed back down the socket) or have their notices queued
+   *  until they call poll() (used for HTTP long-polling).  Queued subscriptions that go unpolled for
+   *  too long are dropped.
+   */
+  class subscription_manager : public chain_observer
+  {
+     public:
+        typedef std::function<void( const subscription_notice& )> notice_handler;
+
+        subscription_manager( const chain_database_ptr& chain_db );
+        virtual ~subscription_manager();
+
+        uint32_t                     subscribe( const subscription_filter& filter, const notice_handler& handler );
+        uint32_t                     subscribe( const subscription_filter& filter );
+        void                         unsubscribe( uint32_t subscription_id );
+        /** true if subscription_id exists and queues its notices for poll(); false once it has been dropped */
+        bool                         is_queued( uint32_t subscription_id )const;
+
+        /** returns the notices queued for subscription_id, waiting up to timeout for one to arrive */
+        vector<subscription_notice>  poll( uint32_t subscription_id, const fc::microseconds& timeout );
+
+        uint32_t                     get_subscription_count()const;
+
+        virtual void state_changed( const pending_chain_state_ptr& state )override {}
+        virtual void block_applied( const block_summary& summary )override;
+
+     private:
+        std::unique_ptr<detail::subscription_manager_impl> my;
+  };
+  typedef std::shared_ptr<subscription_manager> subscription_manager_ptr;
+
+} } // bts::rpc
+
+FC_REFLECT( bts::rpc::subscription_filter, (new_blocks)(addresses)(markets)(accounts) )
+FC_REFLECT( bts::rpc::subscription_notice, (subscription_id)(block_num)(block_id)(timestamp)(balances)(market_transactions)(accounts) )
@@ -0,0 +1,107 @@
+#include <bts/rpc/response_cache.hpp>
+
+#include <fc/io/json.hpp>
+
+#include <unordered_map>
+
+namespace bts { namespace rpc {
+
+  namespace detail
+  {
+     class response_cache_impl
+     {
+        public:
+           chain_database_ptr                                        _chain_db;
+           uint32_t                                                  _max_entries = 0;
+           std::unordered_map<std::string, cached_response_ptr>      _responses;
+           /** a call that started before a clear() must not store its result after it */
+           uint64_t                                                  _generation = 0;
+
+           uint64_t                                                  _hits = 0;
+           uint64_t                                                  _misses = 0;
+           uint64_t                                                  _invalidations = 0;
+     };
+  } // detail
+
+  response_cache::response_cache( const chain_database_ptr& chain_db, uint32_t max_entries )
+  :my( new detail::response_cache_impl() )
+  {
+     my->_chain_db = chain_db;
+     my->_max_entries = max_entries;
+     my->_chain_db->add_observer( this );
+  }
+
+  response_cache::~response_cache()
+  {
+     my->_chain_db->remove_observer( this );
+  }
+
+  std::string response_cache::make_key( const std::string& method_name, const fc::variants& parameters )const
+  {
+     std::string key = method_name;
+     key += '\0';
+     key += fc::json::to_string( parameters );
+     key += '\0';
+     key += my->_chain_db->get_head_block_id().str();
+     return key;
+  }
+
+  uint64_t response_cache::get_generation()const
+  {
+     return my->_generation;
+  }
+
+  cached_response_ptr response_cache::find( const std::string& key )
+  {
+     const auto itr = my->_responses.find( key );
+     if( itr == my->_responses.end() )
+     {
+        ++my->_misses;
+        return cached_response_ptr();
+     }
+     ++my->_hits;
+     return itr->second;
+  }
+
+  void response_cache::store( const std::string& key, const cached_response_ptr& response, uint64_t generation )
+  {
+     if( my->_max_entries == 0 || generation != my->_generation )
+        return;
+     // every entry goes stale at the next block anyway, so there's no point in anything smarter than
+     // starting over when full
+     if( my->_responses.size() >= my->_max_entries )
+        clear();
+     my->_responses[ key ] = response;
+  }
+
+  void response_cache::clear()
+  {
+     ++my->_generation;
+     if( my->_responses.empty() )
+        return;
+     my->_responses.clear();
+     ++my->_invalidations;
+  }
+
+  fc::variant_object response_cache::get_statistics()const
+  {
+     fc::mutable_variant_object statistics;
+     statistics["entries"] = my->_responses.size();
+     statistics["max_entries"] = my->_max_entries;
+     statistics["hits"] = my->_hits;
+     statistics["misses"] = my->_misses;
+     statistics["invalidations"] = my->_invalidations;
+     return statistics;
+  }
+
+  void response_cache::state_changed( const pending_chain_state_ptr& state )
+  {
+     clear();
+  }
+
+  void response_cache::block_applied( const block_summary& summary )
+  {
+     clear();
+  }
+
+} } // bts::rpc
@@ -1,8 +1,11 @@
 #define DEFAULT_LOGGER "rpc"
 
+#include <bts/api/rpc_stats.hpp>
 #include <bts/wallet/exceptions.hpp>
 #include <bts/rpc/exceptions.hpp>
 #include <bts/rpc/rpc_server.hpp>
+#include <bts/rpc/response_cache.hpp>
+#include <bts/rpc/subscription_manager.hpp>
 #include <bts/utilities/git_revision.hpp>
 
 #include <boost/algorithm/string/join.hpp>
@@ -24,10 +27,16 @@
 
 #include <iomanip>
 #include <limits>
+#include <mutex>
 #include <sstream>
 
 #include <bts/rpc_stubs/common_api_rpc_server.hpp>
 
+/** the most calls we'll accept in a single JSON-RPC batch request */
+#define BTS_RPC_MAX_CALLS_PER_BATCH 1000
+/** the longest an HTTP client may wait in poll_notices */
+#define BTS_RPC_MAX_POLL_TIMEOUT_SEC 60
+
 namespace bts { namespace rpc {
 
   using namespace client;
@@ -48,6 +57,9 @@ namespace bts { namespace rpc {
          http_callback_type                                _http_file_callback;
          std::unordered_set<fc::rpc::json_connection_ptr>  _open_json_connections;
          fc::mutex                                         _rpc_mutex; // locked to prevent executing two rpc calls at once
+         /** threads for JSON parsing/serialization and thread_safe methods, so they don't tie up _thread */
+         std::vector<std::unique_ptr<fc::thread>>          _worker_threads;
+         uint32_t                                          _next_worker_thread = 0;
 
          typedef std::map<std::string, bts::api::method_data> method_map_type;
          method_map_type _method_map;
@@ -55,8 +67,21 @@ namespace bts { namespace rpc {
          /** the map of alias and method name */
          std::map<std::string, std::string>     _alias_map;
 
-         /** the set of connections that have successfully logged in */
+         /** the set of connections that have successfully logged in; thread_safe methods check it from
+          *  worker threads, so it is only touched while holding _authenticated_connection_mutex */
          std::unordered_set<fc::rpc::json_connection*> _authenticated_connection_set;
+         mutable std::mutex                             _authenticated_connection_mutex;
+
+         /** created on first use when _config.rpc_response_cache_size is set */
+         response_cache_ptr                                                    _response_cache;
+
+         /** json connections that have passed the binary rpc handshake */
+         std::unordered_set<fc::rpc::json_connection*> _binary_rpc_connection_set;
+
+         /** created on the first subscribe call, since the chain isn't open when we are constructed */
+         subscription_manager_ptr                                              _subscriptions;
+         /** subscriptions pushed to each json connection, dropped when the connection closes */
+         std::unordered_map<fc::rpc::json_connection*, std::set<uint32_t>>     _connection_subscriptions;
 
          rpc_server_impl(bts::client::client* client) :
            _client(client),
@@ -65,6 +90,35 @@ namespace bts { namespace rpc {
 
          void shutdown_rpc_server();
 
+         bool is_authenticated( fc::rpc::json_connection* json_connection )const
+         {
+            std::lock_guard<std::mutex> lock( _authenticated_connection_mutex );
+            return _authenticated_connection_set.count( json_connection ) != 0;
+         }
+
+         void start_worker_threads( uint32_t thread_count )
+         {
+            while( _worker_threads.size() < thread_count )
+               _worker_threads.emplace_back( new fc::thread( "rpc worker " + std::to_string( _worker_threads.size() ) ) );
+         }
+
+         void stop_worker_threads()
+         {
+            for( const auto& worker_thread : _worker_threads )
+               worker_thread->quit();
+            _worker_threads.clear();
+         }
+
+         /** runs f on the next worker thread and waits for the result, or just runs f if there are no workers */
+         template<typename Functor>
+         auto run_on_worker_thread( Functor&& f, const char* description ) -> decltype( f() )
+         {
+            if( _worker_threads.empty() )
+               return f();
+            fc::thread* worker_thread = _worker_threads[ _next_worker_thread++ % _worker_threads.size() ].get();
+            return worker_thread->async( std::forward<Functor>( f ), description ).wait();
+         }
+
          virtual bts::api::common_api* get_client() const override;
          virtual void verify_json_connection_is_authenticated(fc::rpc::json_connection* json_connection) const override;
          virtual void verify_wallet_is_open() const override;
@@ -125,6 +179,11 @@ namespace bts { namespace rpc {
                 s.add_header("Expires","0");
                 return;
             }
+            if( path == "/metrics") {
+                s.add_header("Content-Type",  "text/plain; version=0.0.4");
+                s.add_header("Cache-Control",  "no-cache, no-store, must-revalidate");
+                return;
+            }
 
             auto pos = path.rfind('.');
             if(pos != std::string::npos) {
@@ -143,6 +202,8 @@ namespace bts { namespace rpc {
             // dlog( "${r}", ("r",r.path) );
              fc::http::reply::status_code status = fc::http::reply::OK;
 
+             // fc::http::server closes the socket as soon as this handler returns, so tell the client not to
+             // expect to reuse the connection; persistent connections are served on the JSON-RPC port instead
              s.add_header( "Connection", "close" );
 
              fc::oexception internal_server_error;
@@ -205,6 +266,14 @@ namespace bts { namespace rpc {
                   //  dlog( "RPC ${r}", ("r",r.path) );
                     status = handle_http_rpc( r, s );
                 }
+                else if( path == "/metrics" )
+                {
+                    // per-method call stats in the Prometheus text exposition format
+                    const std::string metrics = bts::api::rpc_stats::get_instance().get_prometheus_text();
+                    s.set_status( fc::http::reply::OK );
+                    s.set_length( metrics.size() );
+                    s.write( metrics.c_str(), metrics.size() );
+                }
                 else if( _http_file_callback )
                 {
                    _http_file_callback( path, s );
@@ -282,6 +351,77 @@ namespace bts { namespace rpc {
              fc_ilog( fc::logger::get("rpc"), "Completed ${path} ${status} in ${ms}ms", ("path",r.path)("status",(int)status)("ms",(end_time - begin_time).count()/1000));
          }
 
+         /**
+          * Handles one JSON-RPC call, returning the reply object for it.  status is set to the HTTP status
+          * the reply would get if it were sent on its own.  Throws if the call is malformed.
+          *
+          * If direct_json_result is given and the method's result type has a generated direct JSON writer,
+          * the result is written there as JSON text instead of being added to the reply object.
+          */
+         fc::variant_object handle_rpc_call( const fc::http::request& r, const fc::variant& call,
+                                             fc::http::reply::status_code& status,
+                                             fc::optional<std::string>* direct_json_result = nullptr )
+         {
+                const fc::variant_object& rpc_call = call.get_object();
+                fc::string method_name = rpc_call["method"].as_string();
+                auto params = rpc_call["params"].get_array();
+                auto params_log = fc::json::to_string(rpc_call["params"]);
+                if(method_name.find("wallet") != std::string::npos || method_name.find("priv") != std::string::npos)
+                    params_log = "***";
+                fc_ilog( fc::logger::get("rpc"), "Processing ${path} ${method} (${params})", ("path",r.path)("method",method_name)("params",params_log));
+
+                fc::mutable_variant_object  result;
+                result["id"]     =  rpc_call["id"];
+
+                auto call_itr = _alias_map.find( method_name );
+                if( call_itr != _alias_map.end() )
+                {
+                   try
+                   {
+                      const bts::api::method_data& method_data = _method_map[call_itr->second];
+                      if( method_data.cacheable && _config.rpc_response_cache_size > 0 )
+                      {
+                         const cached_response_ptr response = dispatch_cacheable_method( method_data, params );
+                         if( direct_json_result )
+                            *direct_json_result = response->json;
+                         else
+                            result["result"] = response->result;
+                      }
+                      else if( direct_json_result && !method_data.method && has_direct_json_result( method_data.name ) )
+                         *direct_json_result = run_with_method_locking( method_data, [&]{ return direct_invoke_positional_method_to_json( method_data.name, params ); } );
+                      else
+                         result["result"] = dispatch_authenticated_method(method_data, params);
+                      status = fc::http::reply::OK;
+                   }
+                   catch ( const fc::canceled_exception& )
+                   {
+                       throw;
+                   }
+                   catch ( const fc::exception& e )
+                   {
+                       status = fc::http::reply::InternalServerError;
+                       result["error"] = fc::mutable_variant_object("message",e.to_string())( "detail",e.to_detail_string() )("code",e.code());
+                   }
+                }
+                else
+                {
+                    fc_ilog( fc::logger::get("rpc"), "Invalid Method ${path} ${method}", ("path",r.path)("method",method_name));
+                    elog( "Invalid Method ${path} ${method}", ("path",r.path)("method",method_name));
+                    std::string message = "Invalid Method: " + method_name;
+                    status = fc::http::reply::NotFound;
+                    result["error"] = fc::mutable_variant_object( "message", message );
+                }
+                return result;
+         }
+
+         /** request and reply sizes are only known here, calls over JSON connections aren't counted */
+         void record_http_bytes( const std::string& method_name, uint64_t bytes_in, uint64_t bytes_out )
+         {
+            auto call_itr = _alias_map.find( method_name );
+            if( call_itr != _alias_map.end() )
+               bts::api::rpc_stats::get_instance().get_method_stats( call_itr->second ).record_http_bytes( bytes_in, bytes_out );
+         }
+
          fc::http::reply::status_code handle_http_rpc(const fc::http::request& r, const fc::http::server::response& s )
          {
                 fc::http::reply::status_code status = fc::http::reply::OK;
@@ -292,59 +432,101 @@ namespace bts { namespace rpc {
                 fc::optional<std::string> invalid_rpc_request_message;
 
                 try {
-                   auto rpc_call = fc::json::from_string( str ).get_object();
-                   method_name = rpc_call["method"].as_string();
-                   auto params = rpc_call["params"].get_array();
-                   auto params_log = fc::json::to_string(rpc_call["params"]);
-                   if(method_name.find("wallet") != std::string::npos || method_name.find("priv") != std::string::npos)
-                       params_log = "***";
-                   fc_ilog( fc::logger::get("rpc"), "Processing ${path} ${method} (${params})", ("path",r.path)("method",method_name)("params",params_log));
-
-                   auto call_itr = _alias_map.find( method_name );
-                   if( call_itr != _alias_map.end() )
+                   fc::variant request = run_on_worker_thread( [&]{ return fc::json::from_string( str ); }, "parse_rpc_request" );
+                   fc::variant result;
+                   fc::optional<std::string> direct_json_result;
+                   if( request.is_array() )
                    {
-                      fc::mutable_variant_object  result;
-                      result["id"]     =  rpc_call["id"];
-                      try
-                      {
-                         result["result"] = dispatch_authenticated_method(_method_map[call_itr->second], params);
-                         auto reply = fc::json::to_string( result );
-                         status = fc::http::reply::OK;
-                         s.set_status( status );
-                      }
-                      catch ( const fc::canceled_exception& )
-                      {
-                          throw;
-                      }
-                      catch ( const fc::exception& e )
+                      // JSON-RPC 2.0 batch: each call gets its own entry in the reply, in order, and the
+                      // HTTP status is OK as long as the batch itself is well formed
+                      const fc::variants& calls = request.get_array();
+                      method_name = "batch of " + std::to_string( calls.size() );
+                      FC_ASSERT( !calls.empty(), "Empty batch" );
+                      FC_ASSERT( calls.size() <= BTS_RPC_MAX_CALLS_PER_BATCH, "Too many calls in batch, the limit is ${max}",
+                                 ("max", BTS_RPC_MAX_CALLS_PER_BATCH) );
+
+                      fc::variants results;
+                      results.reserve( calls.size() );
+                      for( const fc::variant& call : calls )
                       {
-                          status = fc::http::reply::InternalServerError;
-                          s.set_status( status );
-                          result["error"] = fc::mutable_variant_object("message",e.to_string())( "detail",e.to_detail_string() )("code",e.code());
+                         fc::http::reply::status_code call_status;
+                         try
+                         {
+                            results.emplace_back( handle_rpc_call( r, call, call_status ) );
+                         }
+                         catch ( const fc::canceled_exception& )
+                         {
+                            throw;
+                         }
+                         catch ( const fc::exception& e )
+                         {
+                            results.emplace_back( fc::mutable_variant_object( "id", fc::variant() )
+                                                  ( "error", fc::mutable_variant_object( "message", "Invalid RPC Request" )
+                                                                                       ( "detail", e.to_detail_string() ) ) );
+                         }
                       }
-                      //ilog( "${e}", ("e",result) );
-                      auto reply = fc::json::to_string( result );
-                      s.set_length( reply.size() );
-                      s.write( reply.c_str(), reply.size() );
-                      auto reply_log = reply.size() > 253 ? reply.substr(0,253) + ".." :  reply;
-                      fc_ilog( fc::logger::get("rpc"), "Result ${path} ${method}: ${reply}", ("path",r.path)("method",method_name)("reply",reply_log));
-                      return status;
+                      result = std::move( results );
+                      status = fc::http::reply::OK;
+                   }
+                   else
+                   {
+                      method_name = request.get_object()["method"].as_string();
+                      result = handle_rpc_call( r, request, status, &direct_json_result );
+                   }
+
+                   //ilog( "${e}", ("e",result) );
+                   s.set_status( status );
+                   // The reply is written out piece by piece so large results and batches are never copied into
+                   // one string. fc::http::server needs the length up front, so each piece is serialized first.
+                   std::vector<std::string> reply_parts;
+                   if( direct_json_result )
+                   {
+                      // same layout as serializing the {id, result} object
+                      reply_parts.push_back( "{\"id\":" + fc::json::to_string( result.get_object()["id"] ) + ",\"result\":" );
+                      reply_parts.push_back( std::move( *direct_json_result ) );
+                      reply_parts.push_back( "}" );
+                   }
+                   else if( request.is_array() )
+                   {
+                      reply_parts = run_on_worker_thread( [&]{
+                         std::vector<std::string> parts;
+                         parts.reserve( result.get_array().size() * 2 + 1 );
+                         for( const fc::variant& entry : result.get_array() )
+                         {
+                            parts.push_back( parts.empty() ? "[" : "," );
+                            parts.push_back( fc::json::to_string( entry ) );
+                         }
+                         parts.push_back( "]" );
+                         return parts;
+                      }, "serialize_rpc_result" );
                    }
+                   else
+                      reply_parts.push_back( run_on_worker_thread( [&]{ return fc::json::to_string( result ); }, "serialize_rpc_result" ) );
+
+                   size_t reply_size = 0;
+                   for( const std::string& part : reply_parts )
+                      reply_size += part.size();
+                   s.set_length( reply_size );
+                   for( const std::string& part : reply_parts )
+                      s.write( part.c_str(), part.size() );
+                   if( !request.is_array() )
+                      record_http_bytes( method_name, r.body.size(), reply_size );
                    else
                    {
-                       fc_ilog( fc::logger::get("rpc"), "Invalid Method ${path} ${method}", ("path",r.path)("method",method_name));
-                       elog( "Invalid Method ${path} ${method}", ("path",r.path)("method",method_name));
-                       std::string message = "Invalid Method: " + method_name;
-                       fc::mutable_variant_object  result;
-                       result["id"]     =  rpc_call["id"];
-                       status = fc::http::reply::NotFound;
-                       s.set_status( status );
-                       result["error"] = fc::mutable_variant_object( "message", message );
-                       auto reply = fc::json::to_string( result );
-                       s.set_length( reply.size() );
-                       s.write( reply.c_str(), reply.size() );
-                       return status;
+                      // batch entries are charged the size of their own call and reply entry, the
+                      // brackets and separators around them aren't attributed to any method
+                      const fc::variants& calls = request.get_array();
+                      for( size_t i = 0; i < calls.size() && 2 * i + 1 < reply_parts.size(); ++i )
+                         if( calls[i].is_object() && calls[i].get_object().contains( "method" ) && calls[i].get_object()["method"].is_string() )
+                            record_http_bytes( calls[i].get_object()["method"].as_string(),
+                                               fc::json::to_string( calls[i] ).size(), reply_parts[ 2 * i + 1 ].size() );
                    }
+                   std::string reply;
+                   for( auto part = reply_parts.begin(); part != reply_parts.end() && reply.size() <= 253; ++part )
+                      reply.append( *part, 0, 254 - reply.size() );
+                   auto reply_log = reply.size() > 253 ? reply.substr(0,253) + ".." :  reply;
+                   fc_ilog( fc::logger::get("rpc"), "Result ${path} ${method}: ${reply}", ("path",r.path)("method",method_name)("reply",reply_log));
+                   return status;
                 }
                 catch ( const fc::canceled_exception& )
                 {
@@ -407,6 +589,12 @@ namespace bts { namespace rpc {
               json_con->exec().on_complete([this,receipt,sock](fc::exception_ptr e){
                   ilog("json_con exited");
                   sock->close();
+                  drop_connection_subscriptions(receipt.first->get());
+                  _binary_rpc_connection_set.erase(receipt.first->get());
+                  {
+                    std::lock_guard<std::mutex> lock(_authenticated_connection_mutex);
+                    _authenticated_connection_set.erase(receipt.first->get());
+                  }
                   _open_json_connections.erase(receipt.first);
                   if( e )
                     elog("Connection exited with error: ${error}", ("error", e->what()));
@@ -422,6 +610,14 @@ namespace bts { namespace rpc {
             // the login method is a special case that is only used for raw json connections
             // (not for the CLI or HTTP(s) json rpc)
             con->add_method("login", boost::bind(&rpc_server_impl::login, this, capture_con, _1));
+            // on a json connection, subscriptions push their notices back down the connection instead of
+            // queueing them for poll_notices.  These are registered ahead of the generated api methods of the
+            // same name, since json_connection keeps the first method added under each name.
+            const std::weak_ptr<fc::rpc::json_connection> weak_con = con;
+            for (const char* method_name : {"subscribe", "unsubscribe"})
+              con->add_method(method_name, boost::bind(&rpc_server_impl::dispatch_connection_subscription_method, this, weak_con, std::string(method_name), _1));
+            con->add_method("binary_rpc_handshake", boost::bind(&rpc_server_impl::binary_rpc_handshake, this, capture_con, _1));
+            con->add_method("binary_call", boost::bind(&rpc_server_impl::dispatch_binary_call, this, capture_con, _1));
             for (const method_map_type::value_type& method : _method_map)
             {
               if (method.second.method)
@@ -433,6 +629,15 @@ namespace bts { namespace rpc {
                 for ( auto alias : method.second.aliases )
                     con->add_method(alias, bind_method);
               }
+              else if (method.second.cacheable && _config.rpc_response_cache_size > 0)
+              {
+                // registered ahead of the generated method of the same name, which would bypass the cache
+                auto bind_method = boost::bind(&rpc_server_impl::dispatch_cacheable_method_from_json_connection,
+                                                          this, capture_con, method.second, _1);
+                con->add_method(method.first, bind_method);
+                for ( auto alias : method.second.aliases )
+                    con->add_method(alias, bind_method);
+              }
             }
 
             register_common_api_methods(con);
@@ -443,17 +648,66 @@ namespace bts { namespace rpc {
                                                          const fc::variants& arguments)
         {
           // ilog( "arguments: ${params}", ("params",arguments) );
-          if ((method_data.prerequisites & bts::api::json_authenticated) &&
-              _authenticated_connection_set.find(con) == _authenticated_connection_set.end())
+          if ((method_data.prerequisites & bts::api::json_authenticated) && !is_authenticated(con))
             FC_THROW_EXCEPTION( login_required, "not logged in");
           return dispatch_authenticated_method(method_data, arguments);
         }
 
+        fc::variant dispatch_cacheable_method_from_json_connection(fc::rpc::json_connection* con,
+                                                                   const bts::api::method_data& method_data,
+                                                                   const fc::variants& arguments)
+        {
+          if ((method_data.prerequisites & bts::api::json_authenticated) && !is_authenticated(con))
+            FC_THROW_EXCEPTION( login_required, "not logged in");
+          return dispatch_cacheable_method(method_data, arguments)->result;
+        }
+
         fc::variant dispatch_authenticated_method(const bts::api::method_data& method_data,
                                                   const fc::variants& arguments_from_caller)
         {
+          return run_with_method_locking(method_data, [&]{ return invoke_method(method_data, arguments_from_caller); });
+        }
+
+        cached_response_ptr dispatch_cacheable_method(const bts::api::method_data& method_data,
+                                                      const fc::variants& arguments_from_caller)
+        {
+          if (!_response_cache)
+            _response_cache = std::make_shared<response_cache>(_client->get_chain(), _config.rpc_response_cache_size);
+
+          const uint64_t generation = _response_cache->get_generation();
+          const std::string key = _response_cache->make_key(method_data.name, arguments_from_caller);
+          cached_response_ptr response = _response_cache->find(key);
+          if (response)
+            return response;
+
+          auto new_response = std::make_shared<cached_response>();
+          new_response->result = dispatch_authenticated_method(method_data, arguments_from_caller);
+          new_response->json = run_on_worker_thread([&]{ return fc::json::to_string(new_response->result); }, "serialize_cached_rpc_result");
+          _response_cache->store(key, new_response, generation);
+          return new_response;
+        }
+
+        template<typename Functor>
+        auto run_with_method_locking(const bts::api::method_data& method_data, Functor&& f) -> decltype( f() )
+        {
+          // thread_safe methods don't touch anything the rpc mutex protects, so let them run
+          // alongside whatever the main thread is doing
+          if ((method_data.prerequisites & bts::api::thread_safe) && !_worker_threads.empty())
+            return run_on_worker_thread(std::forward<Functor>(f), method_data.name.c_str());
+
+          // poll_notices waits up to BTS_RPC_MAX_POLL_TIMEOUT_SEC for a notice.  It only touches the
+          // subscriptions, and nothing yields before the wait, so it runs without the rpc mutex rather
+          // than holding up every other call while it waits
+          if (method_data.name == "poll_notices")
+            return f();
+
           fc::scoped_lock<fc::mutex> lock(_rpc_mutex);
+          return f();
+        }
 
+        fc::variant invoke_method(const bts::api::method_data& method_data,
+                                  const fc::variants& arguments_from_caller)
+        {
           if (!method_data.method)
           {
             // then this is a method using our new generated code
@@ -533,6 +787,70 @@ namespace bts { namespace rpc {
         }
 
         fc::variant login( fc::rpc::json_connection* json_connection, const fc::variants& params );
+
+        /**
+         *  The binary encoding packs parameters and results with fc::raw instead of building JSON, which
+         *  is much cheaper for large results.  Both sides must be generated from the same api
+         *  description, which the handshake checks before any binary calls are accepted.
+         */
+        fc::variant binary_rpc_handshake( fc::rpc::json_connection* json_connection, const fc::variants& params )
+        {
+          verify_json_connection_is_authenticated( json_connection );
+          FC_ASSERT( params.size() == 1, "usage: binary_rpc_handshake <schema_digest>" );
+          const std::string client_digest = params[0].as_string();
+          FC_ASSERT( client_digest == binary_schema_digest,
+                     "Binary RPC schema mismatch, the server has ${server} and the client has ${client}",
+                     ("server",binary_schema_digest)("client",client_digest) );
+          _binary_rpc_connection_set.insert( json_connection );
+          return fc::variant( true );
+        }
+
+        fc::variant dispatch_binary_call( fc::rpc::json_connection* json_connection, const fc::variants& params )
+        {
+          FC_ASSERT( _binary_rpc_connection_set.count( json_connection ), "binary_rpc_handshake must be called first" );
+          FC_ASSERT( params.size() == 2, "usage: binary_call <method_name> <base64 parameters>" );
+
+          auto alias_itr = _alias_map.find( params[0].as_string() );
+          if( alias_itr == _alias_map.end() )
+            FC_THROW_EXCEPTION( unknown_method, "Invalid command ${command}", ("command", params[0].as_string()) );
+          const bts::api::method_data& method_data = _method_map[ alias_itr->second ];
+          FC_ASSERT( !method_data.method, "${method} is not available over binary rpc", ("method", method_data.name) );
+
+          const std::string encoded_parameters = params[1].as_string();
+          return run_with_method_locking( method_data, [&]() -> fc::variant
+          {
+            const std::string packed_parameters = fc::base64_decode( encoded_parameters );
+            const std::vector<char> packed_result = direct_invoke_binary_method( method_data.name, json_connection,
+                                                       std::vector<char>( packed_parameters.begin(), packed_parameters.end() ) );
+            return fc::variant( fc::base64_encode( (unsigned char const*)packed_result.data(), packed_result.size() ) );
+          } );
+        }
+
+        subscription_manager& get_subscriptions()
+        {
+          if( !_subscriptions )
+            _subscriptions = std::make_shared<subscription_manager>( _client->get_chain() );
+          return *_subscriptions;
+        }
+
+        /**
+         *  subscribe and unsubscribe on a json connection act on that connection: notices are pushed
+         *  to it as "subscription_notice" calls, and only its own subscriptions can be dropped.  Over
+         *  HTTP and the CLI the api methods queue notices until they are fetched with poll_notices.
+         */
+        fc::variant dispatch_connection_subscription_method( const std::weak_ptr<fc::rpc::json_connection>& weak_connection,
+                                                             const std::string& method_name,
+                                                             const fc::variants& params );
+
+        void drop_connection_subscriptions( fc::rpc::json_connection* json_connection )
+        {
+          auto itr = _connection_subscriptions.find( json_connection );
+          if( itr == _connection_subscriptions.end() )
+            return;
+          for( uint32_t subscription_id : itr->second )
+            _subscriptions->unsubscribe( subscription_id );
+          _connection_subscriptions.erase( itr );
+        }
     };
 
     bts::api::common_api* rpc_server_impl::get_client() const
@@ -541,8 +859,7 @@ namespace bts { namespace rpc {
     }
     void rpc_server_impl::verify_json_connection_is_authenticated(fc::rpc::json_connection* json_connection) const
     {
-      if (json_connection &&
-          _authenticated_connection_set.find(json_connection) == _authenticated_connection_set.end())
+      if (json_connection && !is_authenticated(json_connection))
         FC_THROW("The RPC connection must be logged in before executing this command");
     }
     void rpc_server_impl::verify_wallet_is_open() const
@@ -577,10 +894,41 @@ namespace bts { namespace rpc {
       FC_ASSERT( params.size() == 2 );
       FC_ASSERT( params[0].as_string() == _config.rpc_user );
       FC_ASSERT( params[1].as_string() == _config.rpc_password );
+      std::lock_guard<std::mutex> lock( _authenticated_connection_mutex );
       _authenticated_connection_set.insert( json_connection );
       return fc::variant( true );
     }
 
+    fc::variant rpc_server_impl::dispatch_connection_subscription_method( const std::weak_ptr<fc::rpc::json_connection>& weak_connection,
+                                                                          const std::string& method_name,
+                                                                          const fc::variants& params )
+    {
+      const fc::rpc::json_connection_ptr json_connection = weak_connection.lock();
+      FC_ASSERT( json_connection, "Connection closed" );
+      verify_json_connection_is_authenticated( json_connection.get() );
+
+      if( method_name == "subscribe" )
+      {
+        FC_ASSERT( params.size() == 1, "usage: subscribe <filter>" );
+        const subscription_filter filter = params[0].as<subscription_filter>();
+        // the connection may close while a notice is on its way, so only hold on to it while pushing
+        const uint32_t subscription_id = get_subscriptions().subscribe( filter, [weak_connection]( const subscription_notice& notice )
+        {
+          if( const fc::rpc::json_connection_ptr connection = weak_connection.lock() )
+            connection->notice( "subscription_notice", fc::variants{ fc::variant( notice ) } );
+        } );
+        _connection_subscriptions[ json_connection.get() ].insert( subscription_id );
+        return fc::variant( subscription_id );
+      }
+
+      FC_ASSERT( params.size() == 1, "usage: unsubscribe <subscription_id>" );
+      const uint32_t subscription_id = params[0].as<uint32_t>();
+      auto itr = _connection_subscriptions.find( json_connection.get() );
+      FC_ASSERT( itr != _connection_subscriptions.end() && itr->second.erase( subscription_id ), "Unknown subscription" );
+      get_subscriptions().unsubscribe( subscription_id );
+      return fc::variant( true );
+    }
+
     std::string rpc_server_impl::help(const std::string& command_name) const
     {
       std::string help_string;
@@ -655,6 +1003,9 @@ namespace bts { namespace rpc {
       // just to be safe, destroy the  servers inside this try/catch block in case they throw
       my->_tcp_serv.reset();
       my->_httpd.reset();
+      my->_subscriptions.reset();
+      my->_response_cache.reset();
+      my->stop_worker_threads();
     }
     catch ( const fc::exception& e )
     {
@@ -670,6 +1021,8 @@ namespace bts { namespace rpc {
     try
     {
       my->_config = cfg;
+      my->start_worker_threads(cfg.rpc_worker_threads);
+      bts::api::rpc_stats::get_instance().set_slow_call_threshold(fc::milliseconds(cfg.rpc_slow_call_threshold_ms));
       my->_tcp_serv = std::make_shared<fc::tcp_server>();
       int attempts = 0;
       bool success = false;
@@ -706,6 +1059,8 @@ namespace bts { namespace rpc {
     try
     {
       my->_config = cfg;
+      my->start_worker_threads(cfg.rpc_worker_threads);
+      bts::api::rpc_stats::get_instance().set_slow_call_threshold(fc::milliseconds(cfg.rpc_slow_call_threshold_ms));
       auto m = my.get();
       my->_httpd = std::make_shared<fc::http::server>();
       int attempts = 0;
@@ -738,6 +1093,13 @@ namespace bts { namespace rpc {
     return my->direct_invoke_method(method_name, arguments);
   }
 
+  std::vector<char> rpc_server::direct_invoke_binary_method(const std::string& method_name, const std::vector<char>& packed_parameters)
+  {
+    const bts::api::method_data& method_data = get_method_data(method_name);
+    FC_ASSERT( !method_data.method, "${method} is not available over binary rpc", ("method", method_data.name) );
+    return my->run_with_method_locking( method_data, [&]{ return my->direct_invoke_binary_method( method_data.name, nullptr, packed_parameters ); } );
+  }
+
   const bts::api::method_data& rpc_server::get_method_data(const std::string& method_name)
   {
     auto iter = my->_alias_map.find(method_name);
@@ -819,6 +1181,29 @@ namespace bts { namespace rpc {
      return my->_method_map;
   }
 
+  uint32_t rpc_server::subscribe( const fc::variant& filter )
+  {
+     return my->get_subscriptions().subscribe( filter.as<subscription_filter>() );
+  }
+
+  void rpc_server::unsubscribe( uint32_t subscription_id )
+  {
+     FC_ASSERT( my->get_subscriptions().is_queued( subscription_id ), "Unknown subscription" );
+     my->get_subscriptions().unsubscribe( subscription_id );
+  }
+
+  fc::variants rpc_server::poll_notices( uint32_t subscription_id, uint32_t timeout_sec )
+  {
+     FC_ASSERT( my->get_subscriptions().is_queued( subscription_id ), "Unknown subscription" );
+     timeout_sec = std::min( timeout_sec, uint32_t( BTS_RPC_MAX_POLL_TIMEOUT_SEC ) );
+     const std::vector<subscription_notice> notices = my->get_subscriptions().poll( subscription_id, fc::seconds( timeout_sec ) );
+     fc::variants result;
+     result.reserve( notices.size() );
+     for( const subscription_notice& notice : notices )
+        result.emplace_back( notice );
+     return result;
+  }
+
   fc::optional<fc::ip::endpoint> rpc_server::get_rpc_endpoint() const
   {
     if (my->_tcp_serv)
@@ -833,6 +1218,12 @@ namespace bts { namespace rpc {
     return fc::optional<fc::ip::endpoint>();
   }
 
+  fc::variant_object rpc_server::get_response_cache_statistics() const
+  {
+    if (!my->_response_cache)
+      return fc::mutable_variant_object("entries", 0)("max_entries", my->_config.rpc_response_cache_size);
+    return my->_response_cache->get_statistics();
+  }
 
   exception::exception(fc::log_message&& m) :
     fc::exception(fc::move(m)) {}
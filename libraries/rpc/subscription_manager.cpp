@@ -0,0 +1,272 @@
+#include <bts/rpc/subscription_manager.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/thread/future.hpp>
+
+#include <deque>
+
+/** the most notices a polled subscription will hold before dropping the oldest */
+#define BTS_RPC_MAX_QUEUED_NOTICES_PER_SUBSCRIPTION 100
+/** polled subscriptions that haven't been polled for this long are dropped */
+#define BTS_RPC_SUBSCRIPTION_IDLE_TIMEOUT_SEC (60*5)
+
+namespace bts { namespace rpc {
+
+  namespace detail
+  {
+     struct subscription
+     {
+        bool                                             new_blocks = false;
+        std::set<address>                                addresses;
+        std::set<std::pair<asset_id_type,asset_id_type>> markets;
+        std::set<account_id_type>                        accounts;
+
+        /** set for pushed subscriptions */
+        subscription_manager::notice_handler             handler;
+
+        /** used by polled subscriptions */
+        std::deque<subscription_notice>                  queued_notices;
+        fc::promise<void>::ptr                           notice_arrived;
+        fc::time_point                                   last_polled;
+     };
+
+     /** the changes made by one block, indexed so each filter can be matched by lookup */
+     struct block_changes
+     {
+        std::unordered_map<address, vector<const balance_record*>>                            balances_by_owner;
+        std::map<std::pair<asset_id_type,asset_id_type>, vector<const market_transaction*>> fills_by_market;
+        std::unordered_map<account_id_type, const account_record*>                            accounts;
+     };
+
+     class subscription_manager_impl
+     {
+        public:
+           chain_database_ptr                  _chain_db;
+           std::map<uint32_t, subscription>    _subscriptions;
+           uint32_t                            _next_subscription_id = 1;
+
+           subscription resolve_filter( const subscription_filter& filter )const
+           {
+              subscription sub;
+              sub.new_blocks = filter.new_blocks;
+              sub.addresses = filter.addresses;
+              for( const auto& market : filter.markets )
+                 sub.markets.insert( std::make_pair( _chain_db->get_asset_id( market.first ),
+                                                     _chain_db->get_asset_id( market.second ) ) );
+              for( const string& account_name : filter.accounts )
+              {
+                 const oaccount_record account = _chain_db->get_account_record( account_name );
+                 FC_ASSERT( account.valid(), "Unknown account: ${name}", ("name",account_name) );
+                 sub.accounts.insert( account->id );
+                 sub.addresses.insert( account->owner_address() );
+                 sub.addresses.insert( account->active_address() );
+              }
+              return sub;
+           }
+
+           uint32_t add_subscription( subscription&& sub )
+           {
+              const uint32_t subscription_id = _next_subscription_id++;
+              _subscriptions.emplace( subscription_id, std::move( sub ) );
+              return subscription_id;
+           }
+
+           static block_changes index_block_changes( const block_summary& summary )
+           {
+              block_changes changes;
+              const pending_chain_state& applied = *summary.applied_changes;
+              for( const auto& item : applied._balance_id_to_record )
+                 for( const address& owner : item.second.owners() )
+                    changes.balances_by_owner[ owner ].push_back( &item.second );
+              for( const market_transaction& fill : applied.market_transactions )
+                 changes.fills_by_market[ fill.bid_price.asset_pair() ].push_back( &fill );
+              for( const auto& item : applied._account_id_to_record )
+                 changes.accounts[ item.first ] = &item.second;
+              return changes;
+           }
+
+           /** returns true if anything in the block matched sub's filter */
+           static bool match( const subscription& sub, const block_changes& changes, subscription_notice& notice )
+           {
+              std::set<const balance_record*> matched_balances;
+              for( const address& addr : sub.addresses )
+              {
+                 const auto itr = changes.balances_by_owner.find( addr );
+                 if( itr != changes.balances_by_owner.end() )
+                    matched_balances.insert( itr->second.begin(), itr->second.end() );
+              }
+              for( const balance_record* balance : matched_balances )
+                 notice.balances.push_back( *balance );
+
+              for( const auto& market : sub.markets )
+              {
+                 const auto itr = changes.fills_by_market.find( market );
+                 if( itr != changes.fills_by_market.end() )
+                    for( const market_transaction* fill : itr->second )
+                       notice.market_transactions.push_back( *fill );
+              }
+
+              for( const account_id_type account_id : sub.accounts )
+              {
+                 const auto itr = changes.accounts.find( account_id );
+                 if( itr != changes.accounts.end() )
+                    notice.accounts.push_back( *itr->second );
+              }
+
+              return sub.new_blocks || !notice.balances.empty() || !notice.market_transactions.empty() || !notice.accounts.empty();
+           }
+
+           void expire_idle_subscriptions()
+           {
+              const fc::time_point expiration = fc::time_point::now() - fc::seconds( BTS_RPC_SUBSCRIPTION_IDLE_TIMEOUT_SEC );
+              auto itr = _subscriptions.begin();
+              while( itr != _subscriptions.end() )
+              {
+                 const subscription& sub = itr->second;
+                 if( !sub.handler && !sub.notice_arrived && sub.last_polled < expiration )
+                 {
+                    ilog( "dropping idle subscription ${id}", ("id",itr->first) );
+                    itr = _subscriptions.erase( itr );
+                 }
+                 else
+                 {
+                    ++itr;
+                 }
+              }
+           }
+     };
+  } // detail
+
+  subscription_manager::subscription_manager( const chain_database_ptr& chain_db )
+  :my( new detail::subscription_manager_impl() )
+  {
+     my->_chain_db = chain_db;
+     my->_chain_db->add_observer( this );
+  }
+
+  subscription_manager::~subscription_manager()
+  {
+     my->_chain_db->remove_observer( this );
+  }
+
+  uint32_t subscription_manager::subscribe( const subscription_filter& filter, const notice_handler& handler )
+  { try {
+     FC_ASSERT( handler );
+     detail::subscription sub = my->resolve_filter( filter );
+     sub.handler = handler;
+     return my->add_subscription( std::move( sub ) );
+  } FC_CAPTURE_AND_RETHROW( (filter) ) }
+
+  uint32_t subscription_manager::subscribe( const subscription_filter& filter )
+  { try {
+     detail::subscription sub = my->resolve_filter( filter );
+     sub.last_polled = fc::time_point::now();
+     return my->add_subscription( std::move( sub ) );
+  } FC_CAPTURE_AND_RETHROW( (filter) ) }
+
+  void subscription_manager::unsubscribe( uint32_t subscription_id )
+  {
+     const auto itr = my->_subscriptions.find( subscription_id );
+     if( itr == my->_subscriptions.end() )
+        return;
+     // wake up anyone long-polling this subscription so they see it is gone
+     if( itr->second.notice_arrived )
+        itr->second.notice_arrived->set_value();
+     my->_subscriptions.erase( itr );
+  }
+
+  bool subscription_manager::is_queued( uint32_t subscription_id )const
+  {
+     const auto itr = my->_subscriptions.find( subscription_id );
+     return itr != my->_subscriptions.end() && !itr->second.handler;
+  }
+
+  vector<subscription_notice> subscription_manager::poll( uint32_t subscription_id, const fc::microseconds& timeout )
+  { try {
+     auto itr = my->_subscriptions.find( subscription_id );
+     FC_ASSERT( itr != my->_subscriptions.end(), "Unknown subscription" );
+     FC_ASSERT( !itr->second.handler, "Notices for this subscription are pushed to its connection" );
+     FC_ASSERT( !itr->second.notice_arrived, "This subscription is already being polled" );
+
+     if( itr->second.queued_notices.empty() && timeout > fc::microseconds() )
+     {
+        fc::promise<void>::ptr notice_arrived( new fc::promise<void>( "subscription_notice_arrived" ) );
+        itr->second.notice_arrived = notice_arrived;
+        try
+        {
+           notice_arrived->wait( timeout );
+        }
+        catch( const fc::timeout_exception& )
+        {
+        }
+
+        // the subscription may have been dropped while we waited
+        itr = my->_subscriptions.find( subscription_id );
+        FC_ASSERT( itr != my->_subscriptions.end(), "Unknown subscription" );
+        itr->second.notice_arrived.reset();
+     }
+
+     itr->second.last_polled = fc::time_point::now();
+     vector<subscription_notice> notices( std::make_move_iterator( itr->second.queued_notices.begin() ),
+                                          std::make_move_iterator( itr->second.queued_notices.end() ) );
+     itr->second.queued_notices.clear();
+     return notices;
+  } FC_CAPTURE_AND_RETHROW( (subscription_id)(timeout) ) }
+
+  uint32_t subscription_manager::get_subscription_count()const
+  {
+     return my->_subscriptions.size();
+  }
+
+  void subscription_manager::block_applied( const block_summary& summary )
+  {
+     my->expire_idle_subscriptions();
+     if( my->_subscriptions.empty() )
+        return;
+
+     const detail::block_changes changes = detail::subscription_manager_impl::index_block_changes( summary );
+
+     // handlers write to sockets and may yield, letting subscriptions come and go, so collect
+     // everything to push before calling any of them
+     vector<std::pair<subscription_manager::notice_handler, subscription_notice>> pushes;
+     for( auto& item : my->_subscriptions )
+     {
+        detail::subscription& sub = item.second;
+        subscription_notice notice;
+        if( !detail::subscription_manager_impl::match( sub, changes, notice ) )
+           continue;
+
+        notice.subscription_id = item.first;
+        notice.block_num = summary.block_data.block_num;
+        notice.block_id = summary.block_data.id();
+        notice.timestamp = summary.block_data.timestamp;
+
+        if( sub.handler )
+        {
+           pushes.emplace_back( sub.handler, std::move( notice ) );
+        }
+        else
+        {
+           sub.queued_notices.push_back( std::move( notice ) );
+           if( sub.queued_notices.size() > BTS_RPC_MAX_QUEUED_NOTICES_PER_SUBSCRIPTION )
+              sub.queued_notices.pop_front();
+           if( sub.notice_arrived && !sub.notice_arrived->ready() )
+              sub.notice_arrived->set_value();
+        }
+     }
+
+     for( const auto& push : pushes )
+     {
+        try
+        {
+           push.first( push.second );
+        }
+        catch( const fc::exception& e )
+        {
+           wlog( "error pushing notice for subscription ${id}: ${e}", ("id",push.second.subscription_id)("e",e.to_detail_string()) );
+        }
+     }
+  }
+
+} } // bts::rpc
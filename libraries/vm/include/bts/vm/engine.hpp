@@ -66,11 +66,14 @@ namespace bts { namespace vm {
              return stack_index ? stack[stack.size()-stack_index].get_string() : op_value.get_string();
           }
 
+          const fc::variants& get_stack()const { return stack; }
+
        private:
           fc::variants stack;
    };
 
 } }
 
-FC_REFLECT_ENUM( bts::vm::engine::op_code, (ADD)(SUB)(MULT)(DIV)(PUSH)(LT)(GT)(LTEQ)(GTEQ)(NOT_OP)(POP) )
-FC_REFLECT( bts::vm::engine::operation, (code)(arg1)(arg2)(arg0) )
+FC_REFLECT_ENUM( bts::vm::engine::op_code, (ADD)(SUB)(MULT)(DIV)(PUSH)(LT)(GT)(LTEQ)(GTEQ)(EQ)(NEQ)(NOT_OP)(POP)
+                 (PUSH_CHILD)(SET_CHILD)(PUSH_INDEX)(SET_INDEX)(SET)(PUSH_SIZE) )
+FC_REFLECT( bts::vm::engine::operation, (code)(arg1)(arg2)(arg3)(arg0) )
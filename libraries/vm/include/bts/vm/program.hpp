@@ -0,0 +1,108 @@
+#pragma once
+#include <bts/vm/engine.hpp>
+#include <fc/variant_object.hpp>
+
+namespace bts { namespace vm {
+
+   enum value_type
+   {
+      int64_type,
+      bool_type,
+      string_type,
+      object_type,
+      /** only seen while compiling: a child looked up at run time, checked before it is first used */
+      dynamic_type
+   };
+
+   /**
+    *  A register of a compiled program.  Strings and objects are references into the program's
+    *  constants or its inputs, so copying a value never allocates.
+    */
+   struct value
+   {
+      value_type                  type   = int64_type;
+      int64_t                     number = 0; ///< int64_type and bool_type
+      const std::string*          string = nullptr;
+      const fc::variant_object*   object = nullptr;
+   };
+
+   /**
+    *  An engine operation list validated and compiled to typed register code.
+    *
+    *  The interpreter's operations have no jumps, so the stack depth before every operation is known
+    *  ahead of time and each stack slot becomes a register.  Operands are resolved to register numbers,
+    *  operand types are checked once here rather than on every use, and children of constant objects are
+    *  looked up while compiling.  The inputs are the stack the interpreter would start from, bottom first.
+    *
+    *  Compiled programs support int64, bool, string and object values.  Operations on anything else,
+    *  SET_CHILD, which has to copy the object it modifies, and the unfinished PUSH_INDEX and SET_INDEX are
+    *  rejected by compile().  Operation lists from untrusted sources must pass compile() before they are
+    *  run on any consensus path.
+    */
+   class program
+   {
+      public:
+         enum op_code : uint16_t
+         {
+            move_op,
+            add_int64,
+            sub_int64,
+            mult_int64,
+            div_int64,
+            lt_int64,
+            gt_int64,
+            lteq_int64,
+            gteq_int64,
+            eq_int64,
+            neq_int64,
+            eq_bool,
+            neq_bool,
+            eq_string,
+            neq_string,
+            not_bool,
+            not_int64,
+            load_child,
+            object_size,
+            check_type
+         };
+
+         /** dst = a op b; check_type keeps the expected type in b */
+         struct instruction
+         {
+            uint16_t code;
+            uint16_t dst;
+            uint16_t a;
+            uint16_t b;
+         };
+
+         program( program&& ) = default;
+         program& operator=( program&& ) = default;
+         program( const program& ) = delete;
+         program& operator=( const program& ) = delete;
+
+         static program compile( const vector<engine::operation>& ops, const vector<value_type>& input_types );
+
+         /**
+          *  Runs the program, leaving the final stack at the bottom of registers.  Registers may be reused
+          *  across runs; the inputs must outlive them.
+          */
+         void            run( const vector<variant>& inputs, vector<value>& registers )const;
+         /** runs the program and returns the final stack, as engine::execute would leave it */
+         vector<variant> execute( const vector<variant>& inputs )const;
+
+         const vector<instruction>& get_instructions()const { return _instructions; }
+
+      private:
+         program(){}
+
+         vector<value_type>   _input_types;
+         vector<instruction>  _instructions;
+         vector<variant>      _constants;
+         vector<value>        _constant_values;
+         uint16_t             _stack_size  = 0;
+         uint16_t             _result_size = 0;
+   };
+
+} } // bts::vm
+
+FC_REFLECT_ENUM( bts::vm::value_type, (int64_type)(bool_type)(string_type)(object_type)(dynamic_type) )
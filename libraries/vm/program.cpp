@@ -0,0 +1,416 @@
+#include <bts/vm/program.hpp>
+
+#include <limits>
+
+namespace bts { namespace vm {
+
+   namespace
+   {
+      /** operands with this bit set refer to constants until compile() knows how many stack registers there are */
+      const uint16_t constant_flag = 0x8000;
+
+      value to_value( const variant& v )
+      {
+         value result;
+         switch( v.get_type() )
+         {
+            case variant::int64_type:
+               result.type = int64_type;
+               result.number = v.as_int64();
+               break;
+            case variant::uint64_type:
+               FC_ASSERT( v.as_uint64() <= uint64_t( std::numeric_limits<int64_t>::max() ), "", ("value",v) );
+               result.type = int64_type;
+               result.number = v.as_int64();
+               break;
+            case variant::bool_type:
+               result.type = bool_type;
+               result.number = v.as_bool();
+               break;
+            case variant::string_type:
+               result.type = string_type;
+               result.string = &v.get_string();
+               break;
+            case variant::object_type:
+               result.type = object_type;
+               result.object = &v.get_object();
+               break;
+            default:
+               FC_THROW_EXCEPTION( fc::invalid_arg_exception, "Compiled programs only support int64, bool, string and object values", ("value",v) );
+         }
+         return result;
+      }
+
+      variant to_variant( const value& v )
+      {
+         switch( v.type )
+         {
+            case int64_type:
+               return variant( v.number );
+            case bool_type:
+               return variant( v.number != 0 );
+            case string_type:
+               return variant( *v.string );
+            case object_type:
+               return variant( *v.object );
+            default:
+               break;
+         }
+         FC_THROW_EXCEPTION( fc::invalid_arg_exception, "Register has no value" );
+      }
+
+      const int64_t int64_min = std::numeric_limits<int64_t>::min();
+      const int64_t int64_max = std::numeric_limits<int64_t>::max();
+
+      int64_t checked_add( int64_t a, int64_t b )
+      {
+         FC_ASSERT( b <= 0 || a <= int64_max - b, "Integer overflow", ("a",a)("b",b) );
+         FC_ASSERT( b >= 0 || a >= int64_min - b, "Integer overflow", ("a",a)("b",b) );
+         return a + b;
+      }
+
+      int64_t checked_sub( int64_t a, int64_t b )
+      {
+         FC_ASSERT( b >= 0 || a <= int64_max + b, "Integer overflow", ("a",a)("b",b) );
+         FC_ASSERT( b <= 0 || a >= int64_min + b, "Integer overflow", ("a",a)("b",b) );
+         return a - b;
+      }
+
+      int64_t checked_mult( int64_t a, int64_t b )
+      {
+         if( a > 0 )
+            FC_ASSERT( b > 0 ? a <= int64_max / b : b >= int64_min / a, "Integer overflow", ("a",a)("b",b) );
+         else if( a < 0 )
+            FC_ASSERT( b > 0 ? a >= int64_min / b : b >= int64_max / a, "Integer overflow", ("a",a)("b",b) );
+         return a * b;
+      }
+
+      int64_t checked_div( int64_t a, int64_t b )
+      {
+         FC_ASSERT( b != 0, "Division by zero" );
+         FC_ASSERT( a != int64_min || b != -1, "Integer overflow", ("a",a)("b",b) );
+         return a / b;
+      }
+   }
+
+   program program::compile( const vector<engine::operation>& ops, const vector<value_type>& input_types )
+   { try {
+      program result;
+      result._input_types = input_types;
+
+      vector<value_type> slots = input_types;
+      for( const auto type : slots )
+         FC_ASSERT( type != dynamic_type, "Input types must be known" );
+      size_t stack_size = slots.size();
+
+      const auto add_constant = [&]( const variant& constant ) -> uint16_t
+      {
+         to_value( constant );
+         FC_ASSERT( result._constants.size() < constant_flag, "Too many constants" );
+         result._constants.push_back( constant );
+         return constant_flag | uint16_t( result._constants.size() - 1 );
+      };
+
+      const auto type_of = [&]( uint16_t reg ) -> value_type
+      {
+         if( reg & constant_flag )
+            return to_value( result._constants[ reg & ~constant_flag ] ).type;
+         return slots[ reg ];
+      };
+
+      const auto emit = [&]( op_code code, uint16_t dst, uint16_t a, uint16_t b )
+      {
+         result._instructions.push_back( instruction{ code, dst, a, b } );
+      };
+
+      /** a stack index counts down from the top; zero means the operation's own constant */
+      const auto operand = [&]( const engine::operation& op, int16_t stack_index ) -> uint16_t
+      {
+         if( stack_index == 0 )
+            return add_constant( op.arg0 );
+         FC_ASSERT( stack_index > 0 && size_t( stack_index ) <= slots.size(), "Stack index out of range",
+                    ("stack_index",stack_index)("depth",slots.size()) );
+         return uint16_t( slots.size() - stack_index );
+      };
+
+      const auto top = [&]() -> uint16_t
+      {
+         FC_ASSERT( !slots.empty(), "Stack is empty" );
+         return uint16_t( slots.size() - 1 );
+      };
+
+      /** checks a register holds the given type, checking lookups of unknown type once at run time */
+      const auto require = [&]( uint16_t reg, value_type type )
+      {
+         const value_type actual = type_of( reg );
+         if( actual == dynamic_type )
+         {
+            emit( check_type, reg, reg, type );
+            slots[ reg ] = type;
+            return;
+         }
+         FC_ASSERT( actual == type, "Operand has the wrong type", ("expected",type)("actual",actual) );
+      };
+
+      const auto push = [&]( value_type type ) -> uint16_t
+      {
+         slots.push_back( type );
+         stack_size = std::max( stack_size, slots.size() );
+         FC_ASSERT( stack_size < constant_flag, "Stack too deep" );
+         return uint16_t( slots.size() - 1 );
+      };
+
+      for( uint32_t pcount = 0; pcount < ops.size(); ++pcount )
+      { try {
+         const engine::operation& op = ops[ pcount ];
+         const engine::op_code code = op.code;
+         switch( code )
+         {
+            case engine::PUSH:
+            {
+               const uint16_t src = operand( op, op.arg1 );
+               const value_type type = type_of( src );
+               emit( move_op, push( type ), src, 0 );
+               break;
+            }
+            case engine::SET:
+            {
+               FC_ASSERT( op.arg1 != 0 );
+               const uint16_t dst = operand( op, op.arg1 );
+               const uint16_t src = operand( op, op.arg2 );
+               emit( move_op, dst, src, 0 );
+               slots[ dst ] = type_of( src );
+               break;
+            }
+            case engine::POP:
+               top();
+               slots.pop_back();
+               break;
+            case engine::ADD:
+            case engine::SUB:
+            case engine::MULT:
+            case engine::DIV:
+            case engine::LT:
+            case engine::GT:
+            case engine::LTEQ:
+            case engine::GTEQ:
+            {
+               const uint16_t dst = top();
+               const uint16_t src = operand( op, op.arg1 );
+               require( dst, int64_type );
+               require( src, int64_type );
+
+               /* indexed by engine::op_code, which puts PUSH between the arithmetic and the comparisons */
+               static const op_code codes[] = { add_int64, sub_int64, mult_int64, div_int64, move_op,
+                                                lt_int64, gt_int64, lteq_int64, gteq_int64 };
+               emit( codes[ code ], dst, dst, src );
+               slots[ dst ] = code >= engine::LT ? bool_type : int64_type;
+               break;
+            }
+            case engine::EQ:
+            case engine::NEQ:
+            {
+               const uint16_t dst = top();
+               const uint16_t src = operand( op, op.arg1 );
+               value_type type = type_of( dst );
+               if( type == dynamic_type )
+                  type = type_of( src );
+               FC_ASSERT( type != dynamic_type, "Cannot compare two values of unknown type" );
+               require( dst, type );
+               require( src, type );
+
+               const bool equal = code == engine::EQ;
+               switch( type )
+               {
+                  case int64_type:  emit( equal ? eq_int64 : neq_int64, dst, dst, src ); break;
+                  case bool_type:   emit( equal ? eq_bool : neq_bool, dst, dst, src ); break;
+                  case string_type: emit( equal ? eq_string : neq_string, dst, dst, src ); break;
+                  default:          FC_ASSERT( false, "Compiled programs cannot compare objects" );
+               }
+               slots[ dst ] = bool_type;
+               break;
+            }
+            case engine::NOT_OP:
+            {
+               const uint16_t dst = top();
+               const uint16_t src = operand( op, op.arg1 );
+               if( type_of( src ) == int64_type )
+               {
+                  emit( not_int64, dst, src, 0 );
+               }
+               else
+               {
+                  require( src, bool_type );
+                  emit( not_bool, dst, src, 0 );
+               }
+               slots[ dst ] = bool_type;
+               break;
+            }
+            case engine::PUSH_CHILD:
+            {
+               const uint16_t object = operand( op, op.arg1 );
+               const uint16_t key = operand( op, op.arg2 );
+               require( object, object_type );
+               require( key, string_type );
+
+               if( (object & constant_flag) && (key & constant_flag) )
+               {
+                  const auto& constant_object = result._constants[ object & ~constant_flag ].get_object();
+                  const auto& constant_key = result._constants[ key & ~constant_flag ].get_string();
+                  const uint16_t child = add_constant( constant_object[ constant_key ] );
+                  const value_type type = type_of( child );
+                  emit( move_op, push( type ), child, 0 );
+               }
+               else
+               {
+                  emit( load_child, push( dynamic_type ), object, key );
+               }
+               break;
+            }
+            case engine::SET_CHILD:
+               FC_THROW_EXCEPTION( fc::invalid_arg_exception, "Compiled programs cannot modify objects" );
+            case engine::PUSH_INDEX:
+            case engine::SET_INDEX:
+               FC_THROW_EXCEPTION( fc::invalid_arg_exception, "Compiled programs do not support arrays" );
+            case engine::PUSH_SIZE:
+            {
+               const uint16_t object = operand( op, op.arg1 );
+               require( object, object_type );
+               emit( object_size, push( int64_type ), object, 0 );
+               break;
+            }
+            default:
+               FC_THROW_EXCEPTION( fc::invalid_arg_exception, "Unknown operation" );
+         }
+      } FC_CAPTURE_AND_RETHROW( (pcount)(ops[pcount]) ) }
+
+      FC_ASSERT( stack_size + result._constants.size() <= std::numeric_limits<uint16_t>::max(), "Too many registers" );
+      result._stack_size = uint16_t( stack_size );
+      result._result_size = uint16_t( slots.size() );
+
+      /* Constants follow the stack registers */
+      const auto resolve = [&]( uint16_t& reg )
+      {
+         if( reg & constant_flag )
+            reg = result._stack_size + ( reg & ~constant_flag );
+      };
+      for( auto& ins : result._instructions )
+      {
+         resolve( ins.a );
+         if( ins.code != check_type )
+            resolve( ins.b );
+      }
+
+      result._constant_values.reserve( result._constants.size() );
+      for( const auto& constant : result._constants )
+         result._constant_values.push_back( to_value( constant ) );
+
+      return result;
+   } FC_CAPTURE_AND_RETHROW( (input_types) ) }
+
+   void program::run( const vector<variant>& inputs, vector<value>& registers )const
+   {
+      FC_ASSERT( inputs.size() == _input_types.size(), "", ("inputs",inputs.size())("expected",_input_types.size()) );
+
+      registers.resize( _stack_size + _constant_values.size() );
+      for( size_t i = 0; i < inputs.size(); ++i )
+      {
+         registers[ i ] = to_value( inputs[ i ] );
+         FC_ASSERT( registers[ i ].type == _input_types[ i ], "", ("input",i)("expected",_input_types[ i ]) );
+      }
+      std::copy( _constant_values.begin(), _constant_values.end(), registers.begin() + _stack_size );
+
+      const auto set_int64 = [&]( uint16_t reg, int64_t number )
+      {
+         registers[ reg ].type = int64_type;
+         registers[ reg ].number = number;
+      };
+      const auto set_bool = [&]( uint16_t reg, bool flag )
+      {
+         registers[ reg ].type = bool_type;
+         registers[ reg ].number = flag;
+      };
+
+      for( const instruction& ins : _instructions )
+      {
+         const value& a = registers[ ins.a ];
+         const value& b = registers[ ins.b ];
+         switch( ins.code )
+         {
+            case move_op:
+               registers[ ins.dst ] = a;
+               break;
+            case add_int64:
+               set_int64( ins.dst, checked_add( a.number, b.number ) );
+               break;
+            case sub_int64:
+               set_int64( ins.dst, checked_sub( a.number, b.number ) );
+               break;
+            case mult_int64:
+               set_int64( ins.dst, checked_mult( a.number, b.number ) );
+               break;
+            case div_int64:
+               set_int64( ins.dst, checked_div( a.number, b.number ) );
+               break;
+            case lt_int64:
+               set_bool( ins.dst, a.number < b.number );
+               break;
+            case gt_int64:
+               set_bool( ins.dst, a.number > b.number );
+               break;
+            case lteq_int64:
+               set_bool( ins.dst, a.number <= b.number );
+               break;
+            case gteq_int64:
+               set_bool( ins.dst, a.number >= b.number );
+               break;
+            case eq_int64:
+            case eq_bool:
+               set_bool( ins.dst, a.number == b.number );
+               break;
+            case neq_int64:
+            case neq_bool:
+               set_bool( ins.dst, a.number != b.number );
+               break;
+            case eq_string:
+               set_bool( ins.dst, *a.string == *b.string );
+               break;
+            case neq_string:
+               set_bool( ins.dst, *a.string != *b.string );
+               break;
+            case not_bool:
+            case not_int64:
+               set_bool( ins.dst, a.number == 0 );
+               break;
+            case load_child:
+            {
+               const auto itr = a.object->find( *b.string );
+               FC_ASSERT( itr != a.object->end(), "Object has no child ${key}", ("key",*b.string) );
+               registers[ ins.dst ] = to_value( itr->value() );
+               break;
+            }
+            case object_size:
+               set_int64( ins.dst, a.object->size() );
+               break;
+            case check_type:
+               FC_ASSERT( a.type == value_type( ins.b ), "Value has the wrong type", ("expected",value_type( ins.b ))("actual",a.type) );
+               break;
+            default:
+               FC_ASSERT( false, "Unknown instruction" );
+         }
+      }
+   }
+
+   vector<variant> program::execute( const vector<variant>& inputs )const
+   {
+      vector<value> registers;
+      run( inputs, registers );
+
+      vector<variant> result;
+      result.reserve( _result_size );
+      for( uint16_t i = 0; i < _result_size; ++i )
+         result.push_back( to_variant( registers[ i ] ) );
+      return result;
+   }
+
+} } // bts::vm
@@ -0,0 +1,112 @@
+#include <bts/vm/program.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/time.hpp>
+
+#include <iostream>
+
+using namespace bts::vm;
+
+namespace
+{
+   engine::operation make_op( engine::op_code code, int16_t arg1, const variant& arg0 = variant(), int16_t arg2 = 0 )
+   {
+      engine::operation op;
+      op.code = code;
+      op.arg1 = arg1;
+      op.arg2 = arg2;
+      op.arg3 = 0;
+      op.arg0 = arg0;
+      return op;
+   }
+
+   /** an int64 input run through a long chain of arithmetic, then compared */
+   vector<engine::operation> arithmetic_ops()
+   {
+      vector<engine::operation> ops;
+      ops.push_back( make_op( engine::PUSH, 1 ) );
+      for( int i = 0; i < 100; ++i )
+      {
+         ops.push_back( make_op( engine::ADD, 0, variant( int64_t( 3 ) ) ) );
+         ops.push_back( make_op( engine::MULT, 0, variant( int64_t( 2 ) ) ) );
+         ops.push_back( make_op( engine::SUB, 0, variant( int64_t( i ) ) ) );
+         ops.push_back( make_op( engine::DIV, 0, variant( int64_t( 2 ) ) ) );
+      }
+      ops.push_back( make_op( engine::LT, 0, variant( int64_t( 1000000 ) ) ) );
+      return ops;
+   }
+
+   /** checks of an object input's children, the shape of a condition on a record */
+   vector<engine::operation> child_lookup_ops()
+   {
+      vector<engine::operation> ops;
+      for( int i = 0; i < 20; ++i )
+      {
+         ops.push_back( make_op( engine::PUSH_CHILD, 1 + 2 * i, variant( "balance" ) ) );
+         ops.push_back( make_op( engine::GT, 0, variant( int64_t( i ) ) ) );
+         ops.push_back( make_op( engine::PUSH_CHILD, 2 + 2 * i, variant( "owner" ) ) );
+         ops.push_back( make_op( engine::EQ, 0, variant( "init0" ) ) );
+      }
+      return ops;
+   }
+
+   /** the interpreter has no inputs, so they are pushed as constants ahead of the program */
+   vector<engine::operation> with_inputs( const vector<variant>& inputs, const vector<engine::operation>& ops )
+   {
+      vector<engine::operation> result;
+      for( const auto& input : inputs )
+         result.push_back( make_op( engine::PUSH, 0, input ) );
+      result.insert( result.end(), ops.begin(), ops.end() );
+      return result;
+   }
+
+   void benchmark( const std::string& name, const vector<engine::operation>& ops,
+                   const vector<variant>& inputs, const vector<value_type>& input_types, uint32_t iterations )
+   {
+      const auto interpreted_ops = with_inputs( inputs, ops );
+      const program compiled = program::compile( ops, input_types );
+
+      engine check_engine;
+      check_engine.execute( interpreted_ops );
+      FC_ASSERT( fc::json::to_string( variant( check_engine.get_stack() ) ) == fc::json::to_string( variant( compiled.execute( inputs ) ) ),
+                 "Compiled program disagrees with the interpreter" );
+
+      fc::time_point start = fc::time_point::now();
+      for( uint32_t i = 0; i < iterations; ++i )
+      {
+         engine e;
+         e.execute( interpreted_ops );
+      }
+      const fc::microseconds interpreted_time = fc::time_point::now() - start;
+
+      vector<value> registers;
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < iterations; ++i )
+         compiled.run( inputs, registers );
+      const fc::microseconds compiled_time = fc::time_point::now() - start;
+
+      std::cout << name << ": " << ops.size() << " operations, " << compiled.get_instructions().size() << " instructions\n"
+                << "   interpreter: " << interpreted_time.count() / double( iterations ) << " us/run\n"
+                << "   compiled:    " << compiled_time.count() / double( iterations ) << " us/run\n";
+   }
+}
+
+/**
+ *  Compares engine::execute against compiled programs on the same operations, after checking both leave
+ *  the same stack.  Takes the number of runs per benchmark as its only argument.
+ */
+int main( int argc, char** argv )
+{
+   const uint32_t iterations = argc > 1 ? std::stoul( argv[1] ) : 100000;
+
+   benchmark( "arithmetic", arithmetic_ops(), { variant( int64_t( 7 ) ) }, { int64_type }, iterations );
+
+   fc::mutable_variant_object record;
+   record["owner"] = "init0";
+   record["balance"] = int64_t( 100000 );
+   record["asset"] = "BTS";
+   record["expiration"] = int64_t( 1420070400 );
+   benchmark( "child lookups", child_lookup_ops(), { variant( record ) }, { object_type }, iterations );
+
+   return 0;
+}
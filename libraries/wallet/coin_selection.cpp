@@ -0,0 +1,137 @@
+#include <bts/wallet/coin_selection.hpp>
+#include <bts/wallet/config.hpp>
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace bts { namespace wallet {
+
+   void coin_selector::store( int32_t account_index, const balance_record& record )
+   {
+      const balance_id_type balance_id = record.id();
+      remove( balance_id );
+
+      // Balances that can't be spent yet, such as vesting ones, are kept too; select() checks what is spendable
+      const auto owner = record.owner();
+      if( record.balance <= 0 || !owner.valid() )
+         return;
+
+      indexed_balance balance;
+      balance.account_index = account_index;
+      balance.asset_id = record.asset_id();
+      balance.amount = record.balance;
+      balance.owner = *owner;
+
+      _spendable_sets[ spendable_set_key( account_index, balance.asset_id ) ].emplace( balance.amount, balance_id );
+      _balances[ balance_id ] = balance;
+   }
+
+   void coin_selector::remove( const balance_id_type& balance_id )
+   {
+      const auto iter = _balances.find( balance_id );
+      if( iter == _balances.end() )
+         return;
+
+      const indexed_balance& balance = iter->second;
+      const auto set_iter = _spendable_sets.find( spendable_set_key( balance.account_index, balance.asset_id ) );
+      if( set_iter != _spendable_sets.end() )
+      {
+         set_iter->second.erase( std::make_pair( balance.amount, balance_id ) );
+         if( set_iter->second.empty() )
+            _spendable_sets.erase( set_iter );
+      }
+      _balances.erase( iter );
+   }
+
+   void coin_selector::clear()
+   {
+      _balances.clear();
+      _spendable_sets.clear();
+   }
+
+   vector<selected_balance> coin_selector::select( int32_t account_index, const asset& amount,
+                                                   const coin_selection_strategy_enum strategy,
+                                                   const unordered_map<balance_id_type, share_type>& reserved,
+                                                   const std::function<share_type( const balance_id_type& )>& get_spendable )const
+   {
+      vector<selected_balance> selected;
+      const auto set_iter = _spendable_sets.find( spendable_set_key( account_index, amount.asset_id ) );
+      if( set_iter == _spendable_sets.end() )
+         return selected;
+      const spendable_set& balances = set_iter->second;
+
+      share_type remaining = amount.amount;
+      std::unordered_set<balance_id_type> considered;
+
+      const auto get_available = [&]( const balance_id_type& balance_id ) -> share_type
+      {
+         share_type available = get_spendable( balance_id );
+         const auto reserved_iter = reserved.find( balance_id );
+         if( reserved_iter != reserved.end() )
+            available -= reserved_iter->second;
+         return available;
+      };
+
+      // Returns true once the amount is covered
+      const auto take = [&]( const balance_id_type& balance_id, const share_type available ) -> bool
+      {
+         if( available <= 0 )
+            return false;
+
+         selected_balance selection;
+         selection.balance_id = balance_id;
+         selection.owner = _balances.at( balance_id ).owner;
+         selection.amount = std::min( available, remaining );
+         selected.push_back( selection );
+
+         remaining -= selection.amount;
+         return remaining <= 0;
+      };
+
+      const auto take_largest_first = [&]()
+      {
+         for( auto iter = balances.rbegin(); iter != balances.rend(); ++iter )
+         {
+            if( !considered.insert( iter->second ).second ) continue;
+            if( take( iter->second, get_available( iter->second ) ) ) return;
+         }
+      };
+
+      if( remaining <= 0 )
+         return selected;
+
+      switch( strategy )
+      {
+         case minimize_inputs_selection:
+         {
+            for( auto iter = balances.lower_bound( std::make_pair( remaining, balance_id_type() ) ); iter != balances.end(); ++iter )
+            {
+               const share_type available = get_available( iter->second );
+               if( available >= remaining && take( iter->second, available ) )
+                  return selected;
+            }
+            break;
+         }
+         case consolidate_dust_selection:
+         {
+            uint32_t inputs = 0;
+            for( auto iter = balances.begin(); iter != balances.end() && inputs < BTS_WALLET_MAX_DUST_CONSOLIDATION_INPUTS; ++iter )
+            {
+               considered.insert( iter->second );
+               const share_type available = get_available( iter->second );
+               if( available <= 0 ) continue;
+               ++inputs;
+               if( take( iter->second, available ) )
+                  return selected;
+            }
+            break;
+         }
+         default:
+            break;
+      }
+
+      take_largest_first();
+      return selected;
+   }
+
+} } // bts::wallet
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <bts/blockchain/balance_record.hpp>
+
+#include <fc/reflect/reflect.hpp>
+
+#include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+namespace bts { namespace wallet {
+   using namespace bts::blockchain;
+
+   enum coin_selection_strategy_enum
+   {
+      /** spend the largest balances first, for few inputs without searching */
+      largest_first_selection     = 0,
+      /** spend the smallest single balance covering the amount, and fall back to largest first */
+      minimize_inputs_selection   = 1,
+      /** sweep the smallest balances into the withdrawal, then top up from the largest */
+      consolidate_dust_selection  = 2
+   };
+
+   /** one balance picked to fund a withdrawal, and how much to withdraw from it */
+   struct selected_balance
+   {
+      balance_id_type  balance_id;
+      address          owner;
+      share_type       amount = 0;
+   };
+
+   /**
+    *  The spendable balances of the wallet's accounts, sorted by amount per account and asset.  The wallet's
+    *  balance index keeps it current as balances change, so funding a withdrawal only reads the chain for the
+    *  balances it considers instead of every balance the wallet owns.
+    */
+   class coin_selector
+   {
+      public:
+         /**
+          *  Balances sort by their full amount, which bounds what is spendable from them, so a balance that
+          *  becomes spendable later is already in place; selection always checks what is actually spendable.
+          */
+         void store( int32_t account_index, const balance_record& record );
+         void remove( const balance_id_type& balance_id );
+         void clear();
+
+         /**
+          *  Picks balances of the account to withdraw the amount from.  Reserved amounts are already claimed by
+          *  transactions the chain has not seen yet.  Selects less than the amount if the account can't cover it.
+          */
+         vector<selected_balance> select( int32_t account_index, const asset& amount,
+                                          const coin_selection_strategy_enum strategy,
+                                          const unordered_map<balance_id_type, share_type>& reserved,
+                                          const std::function<share_type( const balance_id_type& )>& get_spendable )const;
+
+      private:
+         struct indexed_balance
+         {
+            int32_t        account_index;
+            asset_id_type  asset_id;
+            share_type     amount;
+            address        owner;
+         };
+         typedef std::pair<int32_t, asset_id_type>                  spendable_set_key;
+         typedef std::set<std::pair<share_type, balance_id_type>>   spendable_set;
+
+         unordered_map<balance_id_type, indexed_balance>   _balances;
+         std::map<spendable_set_key, spendable_set>        _spendable_sets;
+   };
+
+} } // bts::wallet
+
+FC_REFLECT_ENUM( bts::wallet::coin_selection_strategy_enum,
+        (largest_first_selection)
+        (minimize_inputs_selection)
+        (consolidate_dust_selection)
+        )
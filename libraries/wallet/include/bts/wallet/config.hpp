@@ -1,6 +1,8 @@
 #pragma once
 
 #define BTS_WALLET_VERSION                              uint32_t( 109 )
+/** layout version of the packed records in the wallet's typed tables */
+#define BTS_WALLET_RECORD_FORMAT_VERSION                uint8_t( 1 )
 
 #define BTS_WALLET_MIN_PASSWORD_LENGTH                  8
 #define BTS_WALLET_MIN_BRAINKEY_LENGTH                  32
@@ -10,3 +12,21 @@
 #define BTS_WALLET_DEFAULT_TRANSACTION_FEE              50000 // XTS
 
 #define BTS_WALLET_DEFAULT_TRANSACTION_EXPIRATION_SEC   3600
+
+/** blocks fetched and trial decrypted in parallel at a time by the wallet chain scan */
+#define BTS_WALLET_SCAN_BATCH_SIZE                      256
+
+/** transactions between the running balances the wallet remembers while paging through history */
+#define BTS_WALLET_HISTORY_CHECKPOINT_INTERVAL          1000
+
+/** past this many balances waiting on the wallet scan, the balance index is rebuilt from the chain instead */
+#define BTS_WALLET_MAX_UNRESOLVED_BALANCES              100000
+
+/** most of an account's smallest balances a dust consolidating withdrawal sweeps into one transaction */
+#define BTS_WALLET_MAX_DUST_CONSOLIDATION_INPUTS        20
+
+/** most payments a batch transfer packs into one transaction; titan deposits stay under ~200 bytes each */
+#define BTS_WALLET_BATCH_TRANSFER_OUTPUTS_PER_TRANSACTION 100
+
+/** child keys account recovery derives at once on the worker threads before looking them up on the chain */
+#define BTS_WALLET_KEY_RECOVERY_BATCH_SIZE              1024
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <bts/blockchain/types.hpp>
+#include <bts/blockchain/withdraw_types.hpp>
+
+#include <fc/optional.hpp>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace bts { namespace wallet {
+   using namespace bts::blockchain;
+
+   /**
+    *  Private keys of an unlocked wallet, decrypted once and kept until the wallet locks, so signing and
+    *  scanning never decrypt the same key twice.  Secrets are held in pages of their own, locked out of swap
+    *  where the platform allows it, and are zeroed when the cache is cleared.
+    *
+    *  Only the cache itself is protected: the keys find() and find_receiver_key() regenerate are ordinary
+    *  copies, so callers should hold them no longer than the operation that needs them.
+    */
+   class private_key_cache
+   {
+      public:
+         private_key_cache();
+         ~private_key_cache();
+
+         private_key_cache( const private_key_cache& ) = delete;
+         private_key_cache& operator=( const private_key_cache& ) = delete;
+
+         /** the public key must be the one the wallet filed the private key under */
+         void                            insert( const public_key_type& public_key, const private_key_type& private_key );
+
+         fc::optional<private_key_type>  find( const address& key_address )const;
+         /** the key with its public key already derived, for trial decrypting memos */
+         fc::optional<memo_receiver_key> find_receiver_key( const address& key_address )const;
+
+         size_t                          size()const { return _keys.size(); }
+         void                            clear();
+
+      private:
+         struct cached_key
+         {
+            uint32_t                     secret_index;
+            public_key_type              public_key;
+         };
+         struct secret_page;
+
+         const fc::sha256&               get_secret( uint32_t secret_index )const;
+
+         std::unordered_map<address, cached_key>     _keys;
+         std::vector<std::unique_ptr<secret_page>>   _pages;
+         bool                                        _lock_failed = false;
+   };
+
+} } // bts::wallet
@@ -5,12 +5,43 @@
 #include <bts/wallet/wallet_records.hpp>
 #include <bts/mail/message.hpp>
 
+#include <fc/thread/future.hpp>
+#include <fc/thread/thread.hpp>
+
 #include <vector>
 #include <map>
 
 namespace bts { namespace wallet {
    namespace detail { class wallet_impl; }
 
+   /** one payment of a batch transfer */
+   struct batch_transfer_output
+   {
+      string                              recipient;
+      string                              amount;
+      string                              memo;
+   };
+
+   /** what became of one payment of a batch transfer; error is empty when it was sent */
+   struct batch_transfer_result
+   {
+      string                              recipient;
+      string                              amount;
+      fc::optional<transaction_id_type>   transaction_id;
+      string                              error;
+   };
+
+   /** a batch transfer payment with its recipient and amount resolved */
+   struct batch_deposit
+   {
+      account_record                      recipient;
+      asset                               amount;
+      string                              memo;
+
+      /** throws if the payment can't be made whatever the payer's balances */
+      void                                validate()const;
+   };
+
    /**
     * @brief The transaction_builder struct simplifies the process of creating arbitrarily complex transactions.
     *
@@ -173,6 +204,22 @@ namespace bts { namespace wallet {
                                          vote_selection_method vote_method = vote_recommended,
                                          fc::optional<public_key_type> memo_sender = fc::optional<public_key_type>());
 
+      /**
+       * @brief Transfer funds from payer to many recipients at once
+       * @param payer The account to charge
+       * @param deposits The recipients, with the amount and memo for each
+       * @param vote_method The method with which to select the delegate vote for the deposited assets
+       *
+       * payer is expected to be a receive account.
+       *
+       * Works like calling deposit_asset for each deposit, except that one slate is chosen per asset for all of them,
+       * the memo encryption for all TITAN deposits runs on the wallet's worker threads at once, and no transaction
+       * notices are created.
+       */
+      transaction_builder& deposit_asset_batch(const wallet_account_record& payer,
+                                               const vector<batch_deposit>& deposits,
+                                               vote_selection_method vote_method = vote_recommended);
+
       /**
        * @brief Transfer funds from payer to a raw address
        * @param payer The account to charge
@@ -344,6 +391,13 @@ namespace bts { namespace wallet {
        *partially signed transaction. To determine if all necessary signatures are present, use the is_signed() method.
        */
       wallet_transaction_record& sign();
+      /**
+       * @brief Sign the final transaction on the given thread
+       *
+       * Works like sign(), except that only the key lookups happen on the calling thread, so many transactions can be
+       * signed at once. The builder must stay alive, and must not be touched, until the returned future completes.
+       */
+      fc::future<void> sign_on(fc::thread& signing_thread);
       bool is_signed() const
       {
          return required_signatures.size() == trx.signatures.size();
@@ -384,4 +438,7 @@ namespace bts { namespace wallet {
    typedef std::shared_ptr<transaction_builder> transaction_builder_ptr;
 } } //namespace bts::wallet
 
+FC_REFLECT( bts::wallet::batch_transfer_output, (recipient)(amount)(memo) )
+FC_REFLECT( bts::wallet::batch_transfer_result, (recipient)(amount)(transaction_id)(error) )
+FC_REFLECT( bts::wallet::batch_deposit, (recipient)(amount)(memo) )
 FC_REFLECT( bts::wallet::transaction_builder, (transaction_record)(required_signatures)(outstanding_balances)(notices) )
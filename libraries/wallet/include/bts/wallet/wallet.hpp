@@ -2,6 +2,7 @@
 
 #include <bts/blockchain/chain_database.hpp>
 #include <bts/mail/message.hpp>
+#include <bts/wallet/coin_selection.hpp>
 #include <bts/wallet/pretty.hpp>
 #include <bts/wallet/transaction_builder.hpp>
 
@@ -21,6 +22,13 @@ namespace bts { namespace wallet {
 
    typedef map<string, map<string, vector<asset>>> account_extended_balance_type;
 
+   struct transaction_history_page
+   {
+       vector<pretty_transaction>           transactions;
+       /** pass back as the cursor to continue in the same direction; unset when there is nothing more */
+       optional<transaction_history_key>    next_cursor;
+   };
+
    enum delegate_status_flags
    {
        any_delegate_status      = 0,
@@ -93,6 +101,10 @@ namespace bts { namespace wallet {
          void                   set_transaction_expiration( uint32_t secs );
          uint32_t               get_transaction_expiration()const;
 
+         /** how balances are picked to fund withdrawals; largest first unless set */
+         void                   set_coin_selection_strategy( const coin_selection_strategy_enum strategy );
+         coin_selection_strategy_enum get_coin_selection_strategy()const;
+
          float                  get_scan_progress()const;
 
          void                   set_setting( const string& name, const variant& value );
@@ -261,6 +273,17 @@ namespace bts { namespace wallet {
 
          void cache_transaction( wallet_transaction_record& transaction_record );
 
+         /**
+          *  Pays many recipients from one account, packing the payments into as few transactions as fit and signing
+          *  them all at once.  Each transaction is cached and returned in builders for broadcast; a payment that can't
+          *  be made is reported in its result without stopping the rest.
+          */
+         vector<batch_transfer_result> batch_transfer( const string& from_account_name,
+                                                       const string& asset_symbol,
+                                                       const vector<batch_transfer_output>& outputs,
+                                                       vote_selection_method vote_method,
+                                                       vector<transaction_builder_ptr>& builders );
+
          /**
           *  Multi-Part transfers provide additional security by not combining inputs, but they
           *  show up to the user as multiple unique transfers.  This is an advanced feature
@@ -572,6 +595,17 @@ namespace bts { namespace wallet {
                                                                             uint32_t start_block_num = 0,
                                                                             uint32_t end_block_num = -1,
                                                                             const string& asset_symbol = "" )const;
+         /**
+          *  Up to |limit| transactions after the cursor, or before it if limit is negative, oldest first; 0 does not
+          *  limit.  Without a cursor a negative limit starts from the most recent transaction.
+          */
+         transaction_history_page           get_pretty_transaction_history_page( const string& account_name,
+                                                                                 const string& asset_symbol,
+                                                                                 int32_t limit,
+                                                                                 uint32_t start_block_num = 0,
+                                                                                 uint32_t end_block_num = -1,
+                                                                                 const optional<transaction_history_key>& cursor
+                                                                                     = optional<transaction_history_key>() )const;
 
          void                               remove_transaction_record( const string& record_id );
 
@@ -612,3 +646,4 @@ namespace bts { namespace wallet {
 } } // bts::wallet
 
 FC_REFLECT_ENUM( bts::wallet::vote_selection_method, (vote_none)(vote_all)(vote_random)(vote_recommended) )
+FC_REFLECT( bts::wallet::transaction_history_page, (transactions)(next_cursor) )
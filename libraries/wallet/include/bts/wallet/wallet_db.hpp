@@ -6,6 +6,12 @@ namespace bts { namespace wallet {
 
    namespace detail { class wallet_db_impl; }
 
+   /** account name -> asset -> balance, as tallied through transaction history */
+   typedef map<string, map<asset_id_type, asset>> running_balances_type;
+
+   /** return false to stop the scan */
+   typedef std::function<bool( const transaction_history_key&, const wallet_transaction_record& )> transaction_history_visitor;
+
    class wallet_db
    {
       public:
@@ -35,6 +41,13 @@ namespace bts { namespace wallet {
          private_key_type       get_account_child_key( const private_key_type& active_private_key, uint32_t seq_num )const;
          private_key_type       get_account_child_key_v1( const fc::sha512& password, const address& account_address,
                                                           uint32_t seq_num )const;
+
+         // Child key derivation from already decrypted keys, safe to run on any thread
+         extended_private_key   get_master_private_key( const fc::sha512& password )const;
+         static private_key_type derive_wallet_child_key( const extended_private_key& master_private_key, uint32_t key_index );
+         static private_key_type derive_account_child_key( const private_key_type& active_private_key, uint32_t seq_num );
+         static private_key_type derive_account_child_key_v1( const extended_private_key& master_private_key,
+                                                              const address& account_address, uint32_t seq_num );
          private_key_type       generate_new_account_child_key( const fc::sha512& password, const string& account_name );
 
          void                   add_contact_account( const account_record& blockchain_account_record, const variant& private_data );
@@ -49,6 +62,8 @@ namespace bts { namespace wallet {
          // Key getters and setters
          owallet_key_record     lookup_key( const address& derived_address )const;
          void                   store_key( const key_data& key );
+         /** stores many keys, syncing the tables once at the end instead of after every write */
+         void                   store_keys( const vector<key_data>& keys );
          void                   import_key( const fc::sha512& password, const string& account_name,
                                             const private_key_type& private_key, bool move_existing );
 
@@ -56,11 +71,36 @@ namespace bts { namespace wallet {
          owallet_transaction_record lookup_transaction( const transaction_id_type& id )const;
          void store_transaction( const transaction_data& transaction );
 
+         // Transaction history in display order, read through persistent indexes; the scan starts just after
+         // start (just before it when reverse) or at the respective end when start is unset
+         static transaction_history_key get_history_key( const wallet_transaction_record& transaction_record );
+         void                   scan_account_transaction_history( const address& account_address,
+                                                                  const optional<transaction_history_key>& start, bool reverse,
+                                                                  const transaction_history_visitor& visitor )const;
+         void                   scan_asset_transaction_history( const asset_id_type asset_id,
+                                                                const optional<transaction_history_key>& start, bool reverse,
+                                                                const transaction_history_visitor& visitor )const;
+         void                   scan_transaction_history( const optional<transaction_history_key>& start, bool reverse,
+                                                          const transaction_history_visitor& visitor )const;
+
+         // Running balances remembered at points in a history so later pages don't tally from the start.  They
+         // are kept in memory only and dropped whenever a transaction at or before them changes.
+         optional<pair<transaction_history_key, running_balances_type>>
+                                lookup_running_balance_checkpoint( const string& history_name,
+                                                                   const transaction_history_key& before )const;
+         void                   store_running_balance_checkpoint( const string& history_name, const transaction_history_key& key,
+                                                                  const running_balances_type& balances );
+
          // Non-deterministic and not linked to any account
          private_key_type       generate_new_one_time_key( const fc::sha512& password );
 
+         /** owner and active keys of every wallet account, mapped to the account name */
+         map<public_key_type, string>  get_account_public_keys()const;
          map<private_key_type, string> get_account_private_keys( const fc::sha512& password )const;
 
+         /** changes whenever an account or key is stored or removed, so derived key sets know to rebuild */
+         uint64_t                      get_key_revision()const { return key_revision; }
+
          // Restore as many broken record invariants as possible
          void                   repair_records( const fc::sha512& password );
          // ********************************************************************
@@ -96,10 +136,8 @@ namespace bts { namespace wallet {
          void change_password( const fc::sha512& old_password,
                                const fc::sha512& new_password );
 
-         const unordered_map< transaction_id_type, wallet_transaction_record >& get_transactions()const
-         {
-            return transactions;
-         }
+         /** reads every transaction record from disk; use lookup_transaction for single records */
+         unordered_map< transaction_id_type, wallet_transaction_record > get_transactions()const;
          const unordered_map< int32_t,wallet_account_record >& get_accounts()const
          {
             return accounts;
@@ -116,7 +154,6 @@ namespace bts { namespace wallet {
 
          unordered_map<int32_t, wallet_account_record>                  accounts;
          map<address, wallet_key_record>                                keys;
-         unordered_map<transaction_id_type, wallet_transaction_record>  transactions;
          map<property_enum, wallet_property_record>                     properties;
          map<string, wallet_setting_record>                             settings;
 
@@ -128,18 +165,14 @@ namespace bts { namespace wallet {
          // Cache to lookup keys
          unordered_map<address, address>                                btc_to_bts_address;
 
-         // Cache to lookup transactions
-         unordered_map<transaction_id_type, transaction_id_type>        id_to_transaction_record_index;
+         uint64_t                                                       key_revision = 0;
+
+         // Transaction records are not cached; they are looked up through indexes kept on disk
 
-         void remove_item( int32_t index );
+         map<string, map<transaction_history_key, running_balances_type>> running_balance_checkpoints;
 
          template<typename T>
-         void store_and_reload_record( T& record_to_store )
-         {
-            if( record_to_store.wallet_record_index == 0 )
-               record_to_store.wallet_record_index = new_wallet_record_index();
-            store_and_reload_generic_record( generic_wallet_record( record_to_store ) );
-         }
+         void store_and_reload_record( T& record_to_store );
 
         void store_and_reload_generic_record( const generic_wallet_record& record );
 
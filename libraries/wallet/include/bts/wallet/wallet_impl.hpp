@@ -1,5 +1,7 @@
 #pragma once
 
+#include <bts/wallet/coin_selection.hpp>
+#include <bts/wallet/private_key_cache.hpp>
 #include <bts/wallet/wallet_db.hpp>
 
 #include <bts/blockchain/account_operations.hpp>
@@ -7,9 +9,64 @@
 #include <bts/blockchain/balance_operations.hpp>
 #include <bts/blockchain/feed_operations.hpp>
 #include <bts/blockchain/market_operations.hpp>
+#include <bts/blockchain/transaction_evaluation_state.hpp>
+
+#include <deque>
 
 namespace bts { namespace wallet { namespace detail {
 
+/** a deposit memo that one of the wallet's keys decrypted */
+struct decrypted_memo
+{
+    private_key_type    key;
+    public_key_type     public_key;
+    memo_status         status;
+};
+/** the decrypted memos of one transaction, indexed by operation */
+typedef vector<vector<decrypted_memo>> transaction_memos;
+
+/**
+ *  The wallet's keys prepared for trial decrypting deposit memos during a scan.  These are copies in ordinary
+ *  memory rather than the locked key cache; they are dropped when the wallet locks, once any scan still
+ *  using them finishes.
+ */
+struct memo_scan_keys
+{
+    vector<memo_receiver_key>                   keys;
+    /**
+     *  The keys that can have received a deposit to each address the wallet already holds the private key
+     *  for, such as one time keys cached from earlier scans, so deposits to them skip trying every key.
+     */
+    unordered_map<address, vector<uint32_t>>    owner_keys;
+};
+
+/** a block fetched and trial decrypted on a scanner thread, waiting to be applied to the wallet */
+struct prescanned_block
+{
+    uint32_t                                    block_num = 0;
+    full_block                                  block;
+    vector<transaction_memos>                   memos;
+
+    /** filled in when the block comes from a block_summary, so scanning it needs no chain reads */
+    vector<transaction_evaluation_state_ptr>    transaction_states;
+    optional<vector<market_transaction>>        market_transactions;
+};
+
+/** a block the chain applied, waiting for its memos to be decrypted before it is applied to the wallet */
+struct queued_block_summary
+{
+    block_summary                               summary;
+    fc::future<prescanned_block>                prescan;
+};
+
+/** a key derived on a worker thread, with the offset it was derived at */
+struct derived_key
+{
+    uint32_t                                    index = 0;
+    private_key_type                            private_key;
+    public_key_type                             public_key;
+};
+
 class wallet_impl : public chain_observer
 {
    public:
@@ -20,9 +77,16 @@ class wallet_impl : public chain_observer
        path                                       _data_directory;
        path                                       _current_wallet_path;
        fc::sha512                                 _wallet_password;
+       /** keys decrypted since the wallet was last unlocked; cleared when it locks */
+       mutable private_key_cache                  _private_key_cache;
+       mutable std::shared_ptr<const memo_scan_keys> _memo_scan_keys;
+       mutable uint64_t                           _memo_scan_keys_revision = 0;
        fc::optional<fc::time_point>               _scheduled_lock_time;
        fc::future<void>                           _relocker_done;
        fc::future<void>                           _scan_in_progress;
+       std::deque<queued_block_summary>           _queued_block_summaries;
+       fc::future<void>                           _summary_scan_done;
+       uint32_t                                   _last_queued_summary_block_num = 0;
 
        unsigned                                   _num_scanner_threads = 1;
        vector<std::unique_ptr<fc::thread>>        _scanner_threads;
@@ -40,6 +104,22 @@ class wallet_impl : public chain_observer
 
        vector<function<void( void )>>             _unlocked_upgrade_tasks;
 
+       /**
+        *  Balances owned by the wallet's private keys, and escrows one of its keys is party to.  Built
+        *  with one chain scan on first use, then kept current from block and state change summaries.
+        */
+       unordered_set<balance_id_type>             _owned_balance_ids;
+       unordered_set<balance_id_type>             _escrow_balance_ids;
+       /** balances changed by blocks not yet scanned by the wallet, which may pay one time keys it hasn't seen */
+       unordered_map<balance_id_type, uint32_t>   _unresolved_balance_ids;
+       bool                                       _balance_index_valid = false;
+       /** nonzero when the index was built before the wallet had scanned this block */
+       uint32_t                                   _balance_index_rebuild_block_num = 0;
+       /** the owned balances sorted for funding withdrawals, kept current along with the balance index */
+       coin_selector                              _coin_selector;
+       /** withdrawals of batch transfer transactions built but not yet cached, so later ones fund from other balances */
+       unordered_map<balance_id_type, share_type> _batch_reserved_balances;
+
        wallet_impl();
        ~wallet_impl();
 
@@ -62,6 +142,10 @@ class wallet_impl : public chain_observer
        *  This method is called anytime a block is applied to the chain.
        */
       virtual void block_applied( const block_summary& summary )override;
+      /** decrypts the block's memos on a scanner thread, then applies it on this thread after earlier blocks */
+      void queue_block_summary_scan( const block_summary& summary );
+      void scan_queued_block_summaries();
+      void scan_block_summary( const block_summary& summary, const prescanned_block& prescanned );
 
       void scan_market_transaction(
               const market_transaction& mtrx,
@@ -75,15 +159,32 @@ class wallet_impl : public chain_observer
 
       void scan_state();
 
-      void scan_block( uint32_t block_num, const vector<private_key_type>& keys, const time_point_sec received_time );
+      /** decrypts a key the first time it is used after unlocking, and serves it from the cache after that */
+      private_key_type get_private_key( const wallet_key_record& key_record )const;
+      map<private_key_type, string> get_account_private_keys()const;
+      void load_private_key_cache();
+      void clear_private_key_cache();
+
+      /** rebuilt only when the wallet's accounts or keys have changed since the last call */
+      std::shared_ptr<const memo_scan_keys> get_memo_scan_keys()const;
+
+      /** only reads the snapshot and the keys, so scanner threads can run it on many blocks at once */
+      static prescanned_block prescan_block( const chain_snapshot_ptr& snapshot, uint32_t block_num,
+                                             const memo_scan_keys& keys );
+      static transaction_memos decrypt_transaction_memos( const signed_transaction& transaction,
+                                                          const memo_scan_keys& keys );
+
+      static prescanned_block prescan_block_summary( const block_summary& summary, const memo_scan_keys& keys );
+      void scan_block( const prescanned_block& block, const time_point_sec received_time );
 
       wallet_transaction_record scan_transaction(
               const signed_transaction& transaction,
               uint32_t block_num,
               const time_point_sec block_timestamp,
-              const vector<private_key_type>& keys,
+              const transaction_memos& memos,
               const time_point_sec received_time,
-              bool overwrite_existing = false
+              bool overwrite_existing = false,
+              const transaction_evaluation_state* evaluation_state = nullptr
               );
 
       void scan_block_experimental( uint32_t block_num,
@@ -114,7 +215,7 @@ class wallet_impl : public chain_observer
       bool scan_withdraw( const withdraw_operation& op, wallet_transaction_record& trx_rec, asset& total_fee, public_key_type& from_pub_key );
       bool scan_withdraw_pay( const withdraw_pay_operation& op, wallet_transaction_record& trx_rec, asset& total_fee );
 
-      bool scan_deposit( const deposit_operation& op, const vector<private_key_type>& keys, wallet_transaction_record& trx_rec, asset& total_fee );
+      bool scan_deposit( const deposit_operation& op, const vector<decrypted_memo>& memos, wallet_transaction_record& trx_rec, asset& total_fee );
 
       bool scan_register_account( const register_account_operation& op, wallet_transaction_record& trx_rec );
       bool scan_update_account( const update_account_operation& op, wallet_transaction_record& trx_rec );
@@ -135,7 +236,23 @@ class wallet_impl : public chain_observer
 
       vector<wallet_transaction_record> get_pending_transactions()const;
 
+      asset_id_type get_history_asset_id( const string& asset_symbol )const;
+      bool scan_transaction_history( const string& account_name, const asset_id_type asset_id,
+                                     const optional<transaction_history_key>& start, bool reverse,
+                                     const transaction_history_visitor& visitor )const;
+      void tally_running_balances( pretty_transaction& trx, const vector<string>& account_names,
+                                   bool account_specified, running_balances_type& running_balances )const;
+
       void scan_balances();
+
+      bool index_balance( const balance_record& record );
+      void index_spendable_balance( const balance_record& record );
+      /** amounts withdrawn by the transaction and by pending ones that are still valid but not in pending_state */
+      unordered_map<balance_id_type, share_type> get_reserved_balances( const pending_chain_state_ptr& pending_state,
+                                                                        const signed_transaction& trx )const;
+      void index_balance_changes( const pending_chain_state& changes, uint32_t block_num );
+      void refresh_balance_index();
+      void invalidate_balance_index();
       void scan_registered_accounts();
       void withdraw_to_transaction( const asset& amount_to_withdraw,
                                     const string& from_account_name,
@@ -161,6 +278,11 @@ class wallet_impl : public chain_observer
       public_key_type   get_new_public_key( const string& account_name );
       address           get_new_address( const string& account_name, const string& label="" );
 
+      /** derives the keys derive_key( 0 ) through derive_key( count - 1 ) and their public keys on the worker threads */
+      vector<derived_key> derive_keys( uint32_t count, const std::function<private_key_type( uint32_t )>& derive_key )const;
+      /** files the keys under account_name, or under the account each already belongs to, in one bulk write */
+      uint32_t          import_derived_keys( const string& account_name, const vector<derived_key>& keys );
+
       void sign_transaction( signed_transaction& transaction, const unordered_set<address>& required_signatures )const;
 
       transaction_ledger_entry apply_transaction_experimental( const signed_transaction& transaction );
@@ -177,106 +299,86 @@ class wallet_impl : public chain_observer
 
 
       template<typename ConditionType>
-      bool scan_condition( const ConditionType& deposit, const asset& amount, 
-                           wallet_transaction_record& trx_rec, asset& total_fee, const vector<private_key_type>& keys )
+      bool scan_condition( const ConditionType& deposit, const asset& amount,
+                           wallet_transaction_record& trx_rec, asset& total_fee, const vector<decrypted_memo>& memos )
       {
           bool cache_deposit = false;
           if( deposit.memo ) /* titan transfer */
           {
-             vector< fc::future<void> > scan_key_progress;
-             scan_key_progress.resize( keys.size() );
-             for( uint32_t i = 0; i < keys.size(); ++i )
+             /* If I've successfully decrypted then it's for me */
+             for( const decrypted_memo& decrypted : memos )
              {
-                const auto& key = keys[i];
-                scan_key_progress[i] = fc::async([&,i](){
-                   omemo_status status;
-                   _scanner_threads[ i % _num_scanner_threads ]->async( [&]()
-                       { status =  deposit.decrypt_memo_data( key ); }, "decrypt memo" ).wait();
-                   if( status.valid() ) /* If I've successfully decrypted then it's for me */
+                const memo_status& status = decrypted.status;
+                cache_deposit = true;
+                _wallet_db.cache_memo( status, decrypted.key, _wallet_password );
+
+                auto new_entry = true;
+                if( status.memo_flags == from_memo )
+                {
+                   for( auto& entry : trx_rec.ledger_entries )
                    {
-                      cache_deposit = true;
-                      _wallet_db.cache_memo( *status, key, _wallet_password );
-
-                      auto new_entry = true;
-                      if( status->memo_flags == from_memo )
-                      {
-                         for( auto& entry : trx_rec.ledger_entries )
-                         {
-                             if( !entry.from_account.valid() ) continue;
-                             if( !entry.memo_from_account.valid() )
-                             {
-                                 const auto a1 = self->get_key_label( *entry.from_account );
-                                 const auto a2 = self->get_key_label( status->from );
-                                 if( a1 != a2 ) continue;
-                             }
-
-                             new_entry = false;
-                             if( !entry.memo_from_account.valid() )
-                             {
-                                 entry.from_account = status->from;
-
-                             }
-                             entry.to_account = key.get_public_key();
-                             entry.amount = amount;
-                             entry.memo = status->get_message();
-                             break;
-                         }
-                         if( new_entry )
-                         {
-                             auto entry = ledger_entry();
-                             entry.from_account = status->from;
-                             entry.to_account = key.get_public_key();
-                             entry.amount = amount;
-                             entry.memo = status->get_message();
-                             trx_rec.ledger_entries.push_back( entry );
-                         }
-                         auto current_key = _wallet_db.lookup_key( deposit.memo->one_time_key );
-                         if( !current_key )
-                         {
-                            key_data data;
-                            data.account_address = status->from;
-                            data.public_key      = deposit.memo->one_time_key;
-                            _wallet_db.store_key( data );
-                         }
-                      }
-                      else // to_memo
-                      {
-                         for( auto& entry : trx_rec.ledger_entries )
-                         {
-                             if( !entry.from_account.valid() ) continue;
-                             const auto a1 = self->get_key_label( *entry.from_account );
-                             const auto a2 = self->get_key_label( key.get_public_key() );
-                             if( a1 != a2 ) continue;
-
-                             new_entry = false;
-                             entry.from_account = key.get_public_key();
-                             entry.to_account = status->from;
-                             entry.amount = amount;
-                             entry.memo = status->get_message();
-                             break;
-                         }
-                         if( new_entry )
-                         {
-                             auto entry = ledger_entry();
-                             entry.from_account = key.get_public_key();
-                             entry.to_account = status->from;
-                             entry.amount = amount;
-                             entry.memo = status->get_message();
-                             trx_rec.ledger_entries.push_back( entry );
-                         }
-                      }
+                       if( !entry.from_account.valid() ) continue;
+                       if( !entry.memo_from_account.valid() )
+                       {
+                           const auto a1 = self->get_key_label( *entry.from_account );
+                           const auto a2 = self->get_key_label( status.from );
+                           if( a1 != a2 ) continue;
+                       }
+
+                       new_entry = false;
+                       if( !entry.memo_from_account.valid() )
+                       {
+                           entry.from_account = status.from;
+
+                       }
+                       entry.to_account = decrypted.public_key;
+                       entry.amount = amount;
+                       entry.memo = status.get_message();
+                       break;
+                   }
+                   if( new_entry )
+                   {
+                       auto entry = ledger_entry();
+                       entry.from_account = status.from;
+                       entry.to_account = decrypted.public_key;
+                       entry.amount = amount;
+                       entry.memo = status.get_message();
+                       trx_rec.ledger_entries.push_back( entry );
+                   }
+                   auto current_key = _wallet_db.lookup_key( deposit.memo->one_time_key );
+                   if( !current_key )
+                   {
+                      key_data data;
+                      data.account_address = status.from;
+                      data.public_key      = deposit.memo->one_time_key;
+                      _wallet_db.store_key( data );
                    }
-               });
-             } // for each key
-
-             for( auto& fut : scan_key_progress )
-             {
-                try {
-                   fut.wait();
                 }
-                catch ( const fc::exception& e )
+                else // to_memo
                 {
-                   elog( "unexpected exception ${e}", ("e",e.to_detail_string()) );
+                   for( auto& entry : trx_rec.ledger_entries )
+                   {
+                       if( !entry.from_account.valid() ) continue;
+                       const auto a1 = self->get_key_label( *entry.from_account );
+                       const auto a2 = self->get_key_label( decrypted.public_key );
+                       if( a1 != a2 ) continue;
+
+                       new_entry = false;
+                       entry.from_account = decrypted.public_key;
+                       entry.to_account = status.from;
+                       entry.amount = amount;
+                       entry.memo = status.get_message();
+                       break;
+                   }
+                   if( new_entry )
+                   {
+                       auto entry = ledger_entry();
+                       entry.from_account = decrypted.public_key;
+                       entry.to_account = status.from;
+                       entry.amount = amount;
+                       entry.memo = status.get_message();
+                       trx_rec.ledger_entries.push_back( entry );
+                   }
                 }
              }
           }
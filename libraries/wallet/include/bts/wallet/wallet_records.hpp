@@ -8,6 +8,7 @@
 #include <bts/blockchain/extended_address.hpp>
 #include <bts/blockchain/transaction.hpp>
 #include <bts/blockchain/types.hpp>
+#include <bts/wallet/config.hpp>
 
 #include <fc/io/raw_variant.hpp>
 #include <fc/optional.hpp>
@@ -54,6 +55,26 @@ namespace bts { namespace wallet {
       digest_type         agreement_digest;
    };
 
+   /**
+    *  Position of a transaction in the wallet's history indexes.  Orders the same way history is displayed:
+    *  by block, then time, then id, with unconfirmed transactions after every block.
+    */
+   struct transaction_history_key
+   {
+      uint32_t            block_num = 0;
+      fc::time_point_sec  timestamp;
+      transaction_id_type record_id;
+
+      friend bool operator < ( const transaction_history_key& a, const transaction_history_key& b )
+      {
+         return std::tie( a.block_num, a.timestamp, a.record_id ) < std::tie( b.block_num, b.timestamp, b.record_id );
+      }
+      friend bool operator == ( const transaction_history_key& a, const transaction_history_key& b )
+      {
+         return std::tie( a.block_num, a.timestamp, a.record_id ) == std::tie( b.block_num, b.timestamp, b.record_id );
+      }
+   };
+
    struct generic_wallet_record
    {
        generic_wallet_record():type(0){}
@@ -77,6 +98,28 @@ namespace bts { namespace wallet {
        fc::variant                                      data;
    };
 
+   /**
+    *  How records are kept in the wallet's typed tables: the record itself fc::raw packed, so loading
+    *  it is a plain unpack rather than a round trip through fc::variant.  The format version lets a
+    *  later release change a record layout and still recognize records packed by this one.
+    */
+   struct packed_wallet_record
+   {
+       packed_wallet_record():type(0),format_version(BTS_WALLET_RECORD_FORMAT_VERSION){}
+
+       template<typename RecordType>
+       packed_wallet_record( const RecordType& rec )
+       :type( int(RecordType::type) ),format_version(BTS_WALLET_RECORD_FORMAT_VERSION),data( fc::raw::pack( rec ) )
+       { }
+
+       template<typename RecordType>
+       RecordType as()const;
+
+       fc::enum_type<uint8_t,wallet_record_type_enum>   type;
+       uint8_t                                          format_version;
+       std::vector<char>                                data;
+   };
+
    template<wallet_record_type_enum RecordType>
    struct base_record
    {
@@ -95,7 +138,8 @@ namespace bts { namespace wallet {
       transaction_scanning,
       last_unlocked_scanned_block_number,
       default_transaction_priority_fee,
-      transaction_expiration_sec
+      transaction_expiration_sec,
+      coin_selection_strategy
    };
 
    /** Used to store key/value property pairs.
@@ -295,11 +339,23 @@ FC_REFLECT_ENUM( bts::wallet::wallet_record_type_enum,
         (setting_record_type)
         )
 
+FC_REFLECT( bts::wallet::transaction_history_key,
+            (block_num)
+            (timestamp)
+            (record_id)
+          )
+
 FC_REFLECT( bts::wallet::generic_wallet_record,
         (type)
         (data)
         )
 
+FC_REFLECT( bts::wallet::packed_wallet_record,
+        (type)
+        (format_version)
+        (data)
+        )
+
 FC_REFLECT_ENUM( bts::wallet::property_enum,
         (version)
         (next_record_number)
@@ -309,6 +365,7 @@ FC_REFLECT_ENUM( bts::wallet::property_enum,
         (last_unlocked_scanned_block_number)
         (default_transaction_priority_fee)
         (transaction_expiration_sec)
+        (coin_selection_strategy)
         )
 
 FC_REFLECT( bts::wallet::wallet_property,
@@ -435,4 +492,16 @@ namespace bts { namespace wallet {
 
           return data.as<RecordType>();
        }
+
+       template<typename RecordType>
+       RecordType packed_wallet_record::as()const
+       {
+          FC_ASSERT( (wallet_record_type_enum)type == RecordType::type, "",
+                     ("type",type)
+                     ("WithdrawType",(wallet_record_type_enum)RecordType::type) );
+          FC_ASSERT( format_version == BTS_WALLET_RECORD_FORMAT_VERSION, "Unsupported wallet record format!",
+                     ("format_version",format_version)("supported_version",BTS_WALLET_RECORD_FORMAT_VERSION) );
+
+          return fc::raw::unpack<RecordType>( data );
+       }
 } }
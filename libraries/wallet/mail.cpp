@@ -63,7 +63,7 @@ bts::mail::message wallet::mail_decrypt(const address& recipient, const bts::mai
     auto encrypted_message = ciphertext.as<mail::encrypted_message>();
     FC_ASSERT(my->_wallet_db.has_private_key(encrypted_message.onetimekey));
     owallet_key_record one_time_key = my->_wallet_db.lookup_key(encrypted_message.onetimekey);
-    private_key_type one_time_private_key = one_time_key->decrypt_private_key(my->_wallet_password);
+    private_key_type one_time_private_key = my->get_private_key(*one_time_key);
 
     auto secret = one_time_private_key.get_shared_secret(recipient_key);
     return encrypted_message.decrypt(secret);
@@ -0,0 +1,173 @@
+#include <bts/wallet/private_key_cache.hpp>
+
+#include <fc/log/logger.hpp>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <new>
+
+namespace bts { namespace wallet {
+
+   namespace
+   {
+      size_t page_size()
+      {
+#ifdef WIN32
+         static const size_t size = []{ SYSTEM_INFO info; GetSystemInfo( &info ); return size_t( info.dwPageSize ); }();
+#else
+         static const size_t size = size_t( sysconf( _SC_PAGESIZE ) );
+#endif
+         return size;
+      }
+
+      uint32_t secrets_per_page()
+      {
+         return page_size() / sizeof( fc::sha256 );
+      }
+
+      // Whole pages of their own, since locking works on pages and an unlock of a shared page would also
+      // unlock whatever else lives there
+      void* allocate_page()
+      {
+#ifdef WIN32
+         return VirtualAlloc( nullptr, page_size(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE );
+#else
+         void* page = mmap( nullptr, page_size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+         if( page == MAP_FAILED )
+            return nullptr;
+#ifdef MADV_DONTDUMP
+         madvise( page, page_size(), MADV_DONTDUMP );
+#endif
+         return page;
+#endif
+      }
+
+      void free_page( void* page )
+      {
+#ifdef WIN32
+         VirtualFree( page, 0, MEM_RELEASE );
+#else
+         munmap( page, page_size() );
+#endif
+      }
+
+      bool lock_memory( void* data, size_t size )
+      {
+#ifdef WIN32
+         return VirtualLock( data, size ) != 0;
+#else
+         return mlock( data, size ) == 0;
+#endif
+      }
+
+      void unlock_memory( void* data, size_t size )
+      {
+#ifdef WIN32
+         VirtualUnlock( data, size );
+#else
+         munlock( data, size );
+#endif
+      }
+
+      // Written through a volatile pointer so the compiler can't drop the stores as dead
+      void zero_memory( void* data, size_t size )
+      {
+         volatile char* bytes = static_cast<volatile char*>( data );
+         while( size-- > 0 )
+            *bytes++ = 0;
+      }
+   }
+
+   struct private_key_cache::secret_page
+   {
+      fc::sha256* secrets = nullptr;
+      bool        locked = false;
+
+      secret_page()
+      {
+         void* page = allocate_page();
+         if( page == nullptr )
+            throw std::bad_alloc();
+         secrets = static_cast<fc::sha256*>( page );
+         for( uint32_t i = 0; i < secrets_per_page(); ++i )
+            new( secrets + i ) fc::sha256();
+         locked = lock_memory( page, page_size() );
+      }
+
+      ~secret_page()
+      {
+         zero_memory( secrets, page_size() );
+         if( locked )
+            unlock_memory( secrets, page_size() );
+         free_page( secrets );
+      }
+   };
+
+   private_key_cache::private_key_cache()
+   {
+   }
+
+   private_key_cache::~private_key_cache()
+   {
+      clear();
+   }
+
+   void private_key_cache::insert( const public_key_type& public_key, const private_key_type& private_key )
+   {
+      const address key_address( public_key );
+      if( _keys.count( key_address ) > 0 )
+         return;
+
+      const uint32_t secret_index = _keys.size();
+      if( secret_index / secrets_per_page() >= _pages.size() )
+      {
+         _pages.emplace_back( new secret_page() );
+         if( !_pages.back()->locked && !_lock_failed )
+         {
+            _lock_failed = true;
+            wlog( "Unable to lock wallet key cache memory; decrypted keys may be swapped to disk" );
+         }
+      }
+
+      _pages[ secret_index / secrets_per_page() ]->secrets[ secret_index % secrets_per_page() ] = private_key.get_secret();
+      _keys[ key_address ] = cached_key{ secret_index, public_key };
+   }
+
+   fc::optional<private_key_type> private_key_cache::find( const address& key_address )const
+   {
+      const auto iter = _keys.find( key_address );
+      if( iter == _keys.end() )
+         return fc::optional<private_key_type>();
+      return private_key_type::regenerate( get_secret( iter->second.secret_index ) );
+   }
+
+   fc::optional<memo_receiver_key> private_key_cache::find_receiver_key( const address& key_address )const
+   {
+      const auto iter = _keys.find( key_address );
+      if( iter == _keys.end() )
+         return fc::optional<memo_receiver_key>();
+
+      memo_receiver_key receiver_key;
+      receiver_key.private_key = private_key_type::regenerate( get_secret( iter->second.secret_index ) );
+      receiver_key.public_key = iter->second.public_key;
+      return receiver_key;
+   }
+
+   void private_key_cache::clear()
+   {
+      _keys.clear();
+      _pages.clear();
+      _lock_failed = false;
+   }
+
+   const fc::sha256& private_key_cache::get_secret( uint32_t secret_index )const
+   {
+      return _pages[ secret_index / secrets_per_page() ]->secrets[ secret_index % secrets_per_page() ];
+   }
+
+} } // bts::wallet
@@ -229,6 +229,74 @@ transaction_builder& transaction_builder::deposit_asset(const bts::wallet::walle
 } FC_CAPTURE_AND_RETHROW( (recipient)(amount)(memo) ) }
 
 
+void batch_deposit::validate()const
+{
+   if( recipient.is_retracted() )
+       FC_CAPTURE_AND_THROW( account_retracted, (recipient) );
+   if( amount.amount <= 0 )
+      FC_THROW_EXCEPTION( invalid_asset_amount, "Cannot deposit a negative amount!" );
+   if( memo.size() > BTS_BLOCKCHAIN_MAX_MEMO_SIZE )
+       FC_CAPTURE_AND_THROW( memo_too_long, (memo) );
+}
+
+transaction_builder& transaction_builder::deposit_asset_batch(const wallet_account_record& payer,
+                                                              const vector<batch_deposit>& deposits,
+                                                              vote_selection_method vote_method)
+{ try {
+   for( const batch_deposit& deposit : deposits )
+      deposit.validate();
+
+   const public_key_type memo_sender = payer.active_key();
+   const private_key_type memo_sender_private_key = _wimpl->self->get_private_key(memo_sender);
+
+   map<asset_id_type, slate_id_type> slates;
+   for( const batch_deposit& deposit : deposits )
+      if( slates.find(deposit.amount.asset_id) == slates.end() )
+         slates[deposit.amount.asset_id] = _wimpl->select_slate(trx, deposit.amount.asset_id, vote_method);
+
+   // One time keys come from the payer's key chain in the wallet, so only the ECDH and memo encryption they feed can
+   // move to the worker threads
+   vector<fc::future<operation>> titan_deposits( deposits.size() );
+   for( uint32_t i = 0; i < deposits.size(); ++i )
+   {
+      if( deposits[i].recipient.is_public_account() )
+         continue;
+
+      const public_key_type recipient_key = deposits[i].recipient.active_key();
+      const asset amount = deposits[i].amount;
+      const string memo = deposits[i].memo;
+      const slate_id_type slate_id = slates[amount.asset_id];
+      const private_key_type one_time_key = _wimpl->get_new_private_key(payer.name);
+      titan_deposits[i] = _wimpl->_scanner_threads[ i % _wimpl->_num_scanner_threads ]->async( [=]() -> operation
+      {
+         transaction deposit_trx;
+         deposit_trx.deposit_to_account(recipient_key, amount, memo_sender_private_key, memo, slate_id,
+                                        memo_sender, one_time_key, from_memo);
+         return deposit_trx.operations.back();
+      }, "batch_deposit_memo" );
+   }
+
+   for( uint32_t i = 0; i < deposits.size(); ++i )
+   {
+      const batch_deposit& deposit = deposits[i];
+      if( deposit.recipient.is_public_account() )
+         trx.deposit(deposit.recipient.active_key(), deposit.amount, slates[deposit.amount.asset_id]);
+      else
+         trx.operations.push_back(titan_deposits[i].wait());
+
+      deduct_balance(payer.owner_key, deposit.amount);
+
+      ledger_entry entry;
+      entry.from_account = payer.owner_key;
+      entry.to_account = deposit.recipient.owner_key;
+      entry.amount = deposit.amount;
+      entry.memo = deposit.memo;
+      transaction_record.ledger_entries.push_back(std::move(entry));
+   }
+
+   return *this;
+} FC_CAPTURE_AND_RETHROW( (deposits) ) }
+
 transaction_builder& transaction_builder::deposit_asset_to_address(const wallet_account_record& payer,
                                                                    const address& to_addr,
                                                                    const asset& amount,
@@ -824,6 +892,32 @@ wallet_transaction_record& transaction_builder::sign()
    return transaction_record;
 } FC_CAPTURE_AND_RETHROW() }
 
+fc::future<void> transaction_builder::sign_on(fc::thread& signing_thread)
+{ try {
+   vector<private_key_type> keys;
+   keys.reserve(required_signatures.size());
+   for( const auto& address : required_signatures )
+   {
+      //Ignore exceptions; like sign(), this operates on a best-effort basis
+      try {
+         keys.push_back(_wimpl->self->get_private_key(address));
+      } catch( const fc::exception& e )
+      {
+         wlog( "unable to sign for address ${a}:\n${e}", ("a",address)("e",e.to_detail_string()) );
+      }
+   }
+
+   const auto chain_id = _wimpl->_blockchain->chain_id();
+   return signing_thread.async( [this, keys, chain_id]()
+   {
+      for( const auto& key : keys )
+         trx.sign(key, chain_id);
+
+      for( auto& notice : notices )
+         notice.first.trx = trx;
+   }, "transaction_builder_sign" );
+} FC_CAPTURE_AND_RETHROW() }
+
 std::vector<bts::mail::message> transaction_builder::encrypted_notifications()
 {
    vector<mail::message> messages;
@@ -7,6 +7,7 @@
 
 #include <bts/blockchain/time.hpp>
 
+#include <algorithm>
 #include <sstream>
 
 using namespace bts::wallet;
@@ -284,21 +285,163 @@ void wallet_impl::scan_registered_accounts()
    } );
 }
 
-void wallet_impl::scan_block( uint32_t block_num, const vector<private_key_type>& keys, const time_point_sec received_time )
+std::shared_ptr<const memo_scan_keys> wallet_impl::get_memo_scan_keys()const
 { try {
-    const full_block& block = _blockchain->get_block( block_num );
-    for( const signed_transaction& transaction : block.user_transactions )
+    if( _memo_scan_keys && _memo_scan_keys_revision == _wallet_db.get_key_revision() )
+        return _memo_scan_keys;
+
+    const auto result = std::make_shared<memo_scan_keys>();
+    map<string, vector<uint32_t>> account_key_indexes;
+
+    // Account keys come out of the unlock session's key cache with their public keys already derived
+    for( const auto& item : _wallet_db.get_account_public_keys() )
     {
+        const owallet_key_record key_record = _wallet_db.lookup_key( item.first );
+        if( !key_record.valid() || !key_record->has_private_key() ) continue;
+
         try
         {
-            scan_transaction( transaction, block_num, block.timestamp, keys, received_time );
+            get_private_key( *key_record );
+        }
+        catch( const fc::exception& e )
+        {
+            elog( "Error decrypting private key: ${e}", ("e",e.to_detail_string()) );
+            continue;
+        }
+
+        account_key_indexes[ item.second ].push_back( result->keys.size() );
+        result->keys.push_back( *_private_key_cache.find_receiver_key( key_record->get_address() ) );
+    }
+
+    // Deposits are only ever made to keys derived from an account's keys, so a key the wallet already
+    // holds can only be the owner of deposits to the account it was filed under
+    for( const auto& item : _wallet_db.get_keys() )
+    {
+        const wallet_key_record& key_record = item.second;
+        if( !key_record.has_private_key() ) continue;
+
+        const owallet_account_record account_record = _wallet_db.lookup_account( key_record.account_address );
+        if( !account_record.valid() ) continue;
+
+        const auto iter = account_key_indexes.find( account_record->name );
+        if( iter != account_key_indexes.end() )
+            result->owner_keys[ item.first ] = iter->second;
+    }
+
+    _memo_scan_keys = result;
+    _memo_scan_keys_revision = _wallet_db.get_key_revision();
+    return _memo_scan_keys;
+} FC_CAPTURE_AND_RETHROW() }
+
+prescanned_block wallet_impl::prescan_block( const chain_snapshot_ptr& snapshot, uint32_t block_num,
+                                             const memo_scan_keys& keys )
+{ try {
+    prescanned_block result;
+    result.block_num = block_num;
+    result.block = snapshot->get_block( block_num );
+    result.memos.reserve( result.block.user_transactions.size() );
+    for( const signed_transaction& transaction : result.block.user_transactions )
+        result.memos.push_back( decrypt_transaction_memos( transaction, keys ) );
+    return result;
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+transaction_memos wallet_impl::decrypt_transaction_memos( const signed_transaction& transaction,
+                                                          const memo_scan_keys& keys )
+{
+    transaction_memos memos( transaction.operations.size() );
+    for( uint32_t op_index = 0; op_index < transaction.operations.size(); ++op_index )
+    {
+        const operation& op = transaction.operations[ op_index ];
+        if( operation_type_enum( op.type ) != deposit_op_type ) continue;
+
+        const withdraw_condition condition = op.as<deposit_operation>().condition;
+        const auto try_key = [&]( uint32_t key_index, const function<omemo_status( const memo_receiver_key& )>& decrypt ) -> bool
+        {
+            const memo_receiver_key& key = keys.keys[ key_index ];
+            try
+            {
+                const omemo_status status = decrypt( key );
+                if( !status.valid() ) return false;
+                memos[ op_index ].push_back( decrypted_memo{ key.private_key, key.public_key, *status } );
+                return true;
+            }
+            catch( const fc::exception& )
+            {
+            }
+            return false;
+        };
+
+        switch( withdraw_condition_types( condition.type ) )
+        {
+            case withdraw_signature_type:
+            {
+                const auto deposit = condition.as<withdraw_with_signature>();
+                if( !deposit.memo.valid() ) break;
+                const auto decrypt = [&]( const memo_receiver_key& key ) { return deposit.decrypt_memo_data( key ); };
+
+                // Only one key can derive the owner, so once it's found the rest needn't be tried
+                const auto owner_iter = keys.owner_keys.find( deposit.owner );
+                bool found = false;
+                if( owner_iter != keys.owner_keys.end() )
+                {
+                    for( uint32_t key_index : owner_iter->second )
+                        if( (found = try_key( key_index, decrypt )) ) break;
+                }
+                for( uint32_t key_index = 0; !found && key_index < keys.keys.size(); ++key_index )
+                    found = try_key( key_index, decrypt );
+                break;
+            }
+            case withdraw_escrow_type:
+            {
+                const auto deposit = condition.as<withdraw_with_escrow>();
+                if( !deposit.memo.valid() ) break;
+                const auto decrypt = [&]( const memo_receiver_key& key ) { return deposit.decrypt_memo_data( key ); };
+                for( uint32_t key_index = 0; key_index < keys.keys.size(); ++key_index )
+                    try_key( key_index, decrypt );
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return memos;
+}
+
+prescanned_block wallet_impl::prescan_block_summary( const block_summary& summary, const memo_scan_keys& keys )
+{ try {
+    prescanned_block result;
+    result.block_num = summary.block_data.block_num;
+    result.block = summary.block_data;
+    result.transaction_states = summary.transaction_states;
+    if( summary.applied_changes )
+        result.market_transactions = summary.applied_changes->market_transactions;
+
+    result.memos.reserve( result.block.user_transactions.size() );
+    for( const signed_transaction& transaction : result.block.user_transactions )
+        result.memos.push_back( decrypt_transaction_memos( transaction, keys ) );
+    return result;
+} FC_CAPTURE_AND_RETHROW( (summary.block_data.block_num) ) }
+
+void wallet_impl::scan_block( const prescanned_block& prescanned, const time_point_sec received_time )
+{ try {
+    const uint32_t block_num = prescanned.block_num;
+    const full_block& block = prescanned.block;
+    const bool has_states = prescanned.transaction_states.size() == block.user_transactions.size();
+    for( uint32_t i = 0; i < block.user_transactions.size(); ++i )
+    {
+        try
+        {
+            scan_transaction( block.user_transactions[ i ], block_num, block.timestamp, prescanned.memos[ i ], received_time,
+                              false, has_states ? prescanned.transaction_states[ i ].get() : nullptr );
         }
         catch( ... )
         {
         }
     }
 
-    const vector<market_transaction>& market_trxs = _blockchain->get_market_transactions( block_num );
+    const vector<market_transaction>& market_trxs = prescanned.market_transactions.valid()
+                                                    ? *prescanned.market_transactions
+                                                    : _blockchain->get_market_transactions( block_num );
     for( const market_transaction& market_trx : market_trxs )
     {
         try
@@ -309,15 +452,16 @@ void wallet_impl::scan_block( uint32_t block_num, const vector<private_key_type>
         {
         }
     }
-} FC_CAPTURE_AND_RETHROW( (block_num)(received_time) ) }
+} FC_CAPTURE_AND_RETHROW( (prescanned.block_num)(received_time) ) }
 
 wallet_transaction_record wallet_impl::scan_transaction(
         const signed_transaction& transaction,
         uint32_t block_num,
         const time_point_sec block_timestamp,
-        const vector<private_key_type>& keys,
+        const transaction_memos& memos,
         const time_point_sec received_time,
-        bool overwrite_existing )
+        bool overwrite_existing,
+        const transaction_evaluation_state* evaluation_state )
 { try {
     const transaction_id_type transaction_id = transaction.id();
     const transaction_id_type& record_id = transaction_id;
@@ -418,13 +562,14 @@ wallet_transaction_record wallet_impl::scan_transaction(
     // Force scanning all deposits next because ledger reconstruction assumes such an ordering
     auto has_deposit = false;
     bool is_deposit = false;
-    for( const auto& op : transaction.operations )
+    for( uint32_t op_index = 0; op_index < transaction.operations.size(); ++op_index )
     {
+        const auto& op = transaction.operations[ op_index ];
         switch( operation_type_enum( op.type ) )
         {
             case deposit_op_type:
             {
-                is_deposit = scan_deposit( op.as<deposit_operation>(), keys, *transaction_record, total_fee );
+                is_deposit = scan_deposit( op.as<deposit_operation>(), memos[ op_index ], *transaction_record, total_fee );
                 has_deposit |= is_deposit;
                 break;
             }
@@ -538,8 +683,15 @@ wallet_transaction_record wallet_impl::scan_transaction(
 
     if( has_withdrawal )
     {
-       auto blockchain_trx_state = _blockchain->get_transaction( transaction_id );
-       if( blockchain_trx_state.valid() )
+       // Blocks scanned from a block_summary already carry their evaluation state
+       otransaction_record blockchain_trx_state;
+       if( evaluation_state == nullptr )
+       {
+          blockchain_trx_state = _blockchain->get_transaction( transaction_id );
+          if( blockchain_trx_state.valid() )
+             evaluation_state = &*blockchain_trx_state;
+       }
+       if( evaluation_state != nullptr )
        {
           if( !transaction_record->ledger_entries.empty() )
           {
@@ -550,7 +702,7 @@ wallet_transaction_record wallet_impl::scan_transaction(
                   transaction_record->ledger_entries.pop_back();
               }
 
-              for( const auto& yield_item : blockchain_trx_state->yield )
+              for( const auto& yield_item : evaluation_state->yield )
               {
                  auto entry = ledger_entry();
                  entry.amount = asset( yield_item.second, yield_item.first );
@@ -561,7 +713,7 @@ wallet_transaction_record wallet_impl::scan_transaction(
                  self->wallet_claimed_transaction( transaction_record->ledger_entries.back() );
               }
 
-              if( !blockchain_trx_state->yield.empty() )
+              if( !evaluation_state->yield.empty() )
                  _wallet_db.store_transaction( *transaction_record );
           }
        }
@@ -1178,7 +1330,7 @@ bool wallet_impl::scan_burn( const burn_operation& op, wallet_transaction_record
 }
 
 // TODO: optimize
-bool wallet_impl::scan_deposit( const deposit_operation& op, const vector<private_key_type>& keys,
+bool wallet_impl::scan_deposit( const deposit_operation& op, const vector<decrypted_memo>& memos,
                                 wallet_transaction_record& trx_rec, asset& total_fee )
 { try {
     auto amount = asset( op.amount, op.condition.asset_id );
@@ -1196,7 +1348,7 @@ bool wallet_impl::scan_deposit( const deposit_operation& op, const vector<privat
        case withdraw_escrow_type:
        {
           auto deposit = op.condition.as<withdraw_with_escrow>();
-          cache_deposit = scan_condition( deposit, amount, trx_rec, total_fee, keys );
+          cache_deposit = scan_condition( deposit, amount, trx_rec, total_fee, memos );
           break;
        }
        case withdraw_signature_type:
@@ -1206,89 +1358,69 @@ bool wallet_impl::scan_deposit( const deposit_operation& op, const vector<privat
           // if( _wallet_db.has_private_key( deposit.owner ) )
           if( deposit.memo ) /* titan transfer */
           {
-             vector< fc::future<void> > scan_key_progress;
-             scan_key_progress.resize( keys.size() );
-             for( uint32_t i = 0; i < keys.size(); ++i )
+             /* If I've successfully decrypted then it's for me */
+             for( const decrypted_memo& decrypted : memos )
              {
-                const auto& key = keys[i];
-                scan_key_progress[i] = fc::async([&,i](){
-                   omemo_status status;
-                   _scanner_threads[ i % _num_scanner_threads ]->async( [&]()
-                       { status =  deposit.decrypt_memo_data( key ); }, "decrypt memo" ).wait();
-                   /* If I've successfully decrypted then it's for me */
-                   if( status.valid() )
+                const memo_status& status = decrypted.status;
+                cache_deposit = true;
+                _wallet_db.cache_memo( status, decrypted.key, _wallet_password );
+
+                auto new_entry = true;
+                if( status.memo_flags == from_memo )
+                {
+                   for( auto& entry : trx_rec.ledger_entries )
                    {
-                      cache_deposit = true;
-                      _wallet_db.cache_memo( *status, key, _wallet_password );
-
-                      auto new_entry = true;
-                      if( status->memo_flags == from_memo )
-                      {
-                         for( auto& entry : trx_rec.ledger_entries )
-                         {
-                             if( !entry.from_account.valid() ) continue;
-                             if( !entry.memo_from_account.valid() )
-                             {
-                                 const auto a1 = self->get_key_label( *entry.from_account );
-                                 const auto a2 = self->get_key_label( status->from );
-                                 if( a1 != a2 ) continue;
-                             }
-
-                             new_entry = false;
-                             if( !entry.memo_from_account.valid() )
-                                 entry.from_account = status->from;
-                             entry.to_account = key.get_public_key();
-                             entry.amount = amount;
-                             entry.memo = status->get_message();
-                             break;
-                         }
-                         if( new_entry )
-                         {
-                             auto entry = ledger_entry();
-                             entry.from_account = status->from;
-                             entry.to_account = key.get_public_key();
-                             entry.amount = amount;
-                             entry.memo = status->get_message();
-                             trx_rec.ledger_entries.push_back( entry );
-                         }
-                      }
-                      else // to_memo
-                      {
-                         for( auto& entry : trx_rec.ledger_entries )
-                         {
-                             if( !entry.from_account.valid() ) continue;
-                             const auto a1 = self->get_key_label( *entry.from_account );
-                             const auto a2 = self->get_key_label( key.get_public_key() );
-                             if( a1 != a2 ) continue;
-
-                             new_entry = false;
-                             entry.from_account = key.get_public_key();
-                             entry.to_account = status->from;
-                             entry.amount = amount;
-                             entry.memo = status->get_message();
-                             break;
-                         }
-                         if( new_entry )
-                         {
-                             auto entry = ledger_entry();
-                             entry.from_account = key.get_public_key();
-                             entry.to_account = status->from;
-                             entry.amount = amount;
-                             entry.memo = status->get_message();
-                             trx_rec.ledger_entries.push_back( entry );
-                         }
-                      }
+                       if( !entry.from_account.valid() ) continue;
+                       if( !entry.memo_from_account.valid() )
+                       {
+                           const auto a1 = self->get_key_label( *entry.from_account );
+                           const auto a2 = self->get_key_label( status.from );
+                           if( a1 != a2 ) continue;
+                       }
+
+                       new_entry = false;
+                       if( !entry.memo_from_account.valid() )
+                           entry.from_account = status.from;
+                       entry.to_account = decrypted.public_key;
+                       entry.amount = amount;
+                       entry.memo = status.get_message();
+                       break;
+                   }
+                   if( new_entry )
+                   {
+                       auto entry = ledger_entry();
+                       entry.from_account = status.from;
+                       entry.to_account = decrypted.public_key;
+                       entry.amount = amount;
+                       entry.memo = status.get_message();
+                       trx_rec.ledger_entries.push_back( entry );
                    }
-               });
-             } // for each key
-
-             for( auto& fut : scan_key_progress )
-             {
-                try {
-                   fut.wait();
                 }
-                catch ( const fc::exception& e )
+                else // to_memo
                 {
+                   for( auto& entry : trx_rec.ledger_entries )
+                   {
+                       if( !entry.from_account.valid() ) continue;
+                       const auto a1 = self->get_key_label( *entry.from_account );
+                       const auto a2 = self->get_key_label( decrypted.public_key );
+                       if( a1 != a2 ) continue;
+
+                       new_entry = false;
+                       entry.from_account = decrypted.public_key;
+                       entry.to_account = status.from;
+                       entry.amount = amount;
+                       entry.memo = status.get_message();
+                       break;
+                   }
+                   if( new_entry )
+                   {
+                       auto entry = ledger_entry();
+                       entry.from_account = decrypted.public_key;
+                       entry.to_account = status.from;
+                       entry.amount = amount;
+                       entry.memo = status.get_message();
+                       trx_rec.ledger_entries.push_back( entry );
+                   }
                 }
              }
              break;
@@ -1348,13 +1480,9 @@ wallet_transaction_record wallet::scan_transaction( const string& transaction_id
 
    const auto block_num = transaction_record->chain_location.block_num;
    const auto block = my->_blockchain->get_block_header( block_num );
-   const auto keys = my->_wallet_db.get_account_private_keys( my->_wallet_password );
-   vector<private_key_type> private_keys;
-   private_keys.reserve( keys.size() );
-   for( const auto& item : keys )
-       private_keys.push_back( item.first );
+   const auto memos = my->decrypt_transaction_memos( transaction_record->trx, *my->get_memo_scan_keys() );
    const auto now = blockchain::now();
-   return my->scan_transaction( transaction_record->trx, block_num, block.timestamp, private_keys, now, overwrite_existing );
+   return my->scan_transaction( transaction_record->trx, block_num, block.timestamp, memos, now, overwrite_existing );
 } FC_CAPTURE_AND_RETHROW() }
 
 vector<wallet_transaction_record> wallet::get_transactions( const string& transaction_id_prefix )
@@ -1392,6 +1520,117 @@ void wallet::cache_transaction( wallet_transaction_record& transaction_record )
    my->_wallet_db.store_transaction( transaction_record );
 } FC_CAPTURE_AND_RETHROW( (transaction_record) ) }
 
+asset_id_type wallet_impl::get_history_asset_id( const string& asset_symbol )const
+{ try {
+   if( asset_symbol.empty() || asset_symbol == BTS_BLOCKCHAIN_SYMBOL )
+       return 0;
+
+   try
+   {
+       return _blockchain->get_asset_id( asset_symbol );
+   }
+   catch( const fc::exception& )
+   {
+       FC_THROW_EXCEPTION( invalid_asset_symbol, "Invalid asset symbol!", ("asset_symbol",asset_symbol) );
+   }
+} FC_CAPTURE_AND_RETHROW( (asset_symbol) ) }
+
+/**
+ * Walks the history indexes instead of every transaction; returns false if the account is unknown
+ */
+bool wallet_impl::scan_transaction_history( const string& account_name, const asset_id_type asset_id,
+                                            const optional<transaction_history_key>& start, bool reverse,
+                                            const transaction_history_visitor& visitor )const
+{ try {
+   if( account_name.empty() )
+   {
+       if( asset_id != 0 )
+           _wallet_db.scan_asset_transaction_history( asset_id, start, reverse, visitor );
+       else
+           _wallet_db.scan_transaction_history( start, reverse, visitor );
+       return true;
+   }
+
+   const owallet_account_record account_record = _wallet_db.lookup_account( account_name );
+   if( !account_record.valid() )
+       return false;
+
+   if( asset_id == 0 )
+   {
+       _wallet_db.scan_account_transaction_history( account_record->owner_address(), start, reverse, visitor );
+       return true;
+   }
+
+   const auto asset_visitor = [&]( const transaction_history_key& key, const wallet_transaction_record& tx_record ) -> bool
+   {
+       bool match = false;
+       for( const auto& entry : tx_record.ledger_entries )
+           match |= entry.amount.amount > 0 && entry.amount.asset_id == asset_id;
+       match |= tx_record.fee.amount > 0 && tx_record.fee.asset_id == asset_id;
+       if( !match ) return true;
+       return visitor( key, tx_record );
+   };
+   _wallet_db.scan_account_transaction_history( account_record->owner_address(), start, reverse, asset_visitor );
+   return true;
+} FC_CAPTURE_AND_RETHROW( (account_name)(asset_id)(start)(reverse) ) }
+
+void wallet_impl::tally_running_balances( pretty_transaction& trx, const vector<string>& account_names,
+                                          bool account_specified, running_balances_type& account_balances )const
+{
+    for( const auto& name : account_names )
+    {
+        map<asset_id_type, asset>& running_balances = account_balances[ name ];
+
+        const auto fee_asset_id = trx.fee.asset_id;
+        if( running_balances.count( fee_asset_id ) <= 0 )
+            running_balances[ fee_asset_id ] = asset( 0, fee_asset_id );
+
+        auto any_from_me = false;
+        for( auto& entry : trx.ledger_entries )
+        {
+            const auto amount_asset_id = entry.amount.asset_id;
+            if( running_balances.count( amount_asset_id ) <= 0 )
+                running_balances[ amount_asset_id ] = asset( 0, amount_asset_id );
+
+            auto from_me = false;
+            from_me |= name == entry.from_account;
+            from_me |= ( entry.from_account.find( name + " " ) == 0 ); /* If payer != sender */
+            if( from_me )
+            {
+                /* Special check to ignore asset issuing */
+                if( ( running_balances[ amount_asset_id ] - entry.amount ) >= asset( 0, amount_asset_id ) )
+                    running_balances[ amount_asset_id ] -= entry.amount;
+
+                /* Subtract fee once on the first entry */
+                if( !trx.is_virtual && !any_from_me )
+                    running_balances[ fee_asset_id ] -= trx.fee;
+            }
+            any_from_me |= from_me;
+
+            /* Special case to subtract fee if we canceled a bid */
+            if( !trx.is_virtual && trx.is_market_cancel && amount_asset_id != fee_asset_id )
+                running_balances[ fee_asset_id ] -= trx.fee;
+
+            auto to_me = false;
+            to_me |= name == entry.to_account;
+            to_me |= ( entry.to_account.find( name + " " ) == 0 ); /* If payer != sender */
+            if( to_me ) running_balances[ amount_asset_id ] += entry.amount;
+
+            entry.running_balances[ name ][ amount_asset_id ] = running_balances[ amount_asset_id ];
+            entry.running_balances[ name ][ fee_asset_id ] = running_balances[ fee_asset_id ];
+        }
+
+        if( account_specified )
+        {
+            /* Don't return fees we didn't pay */
+            if( trx.is_virtual || ( !any_from_me && !trx.is_market_cancel ) )
+            {
+                trx.fee = asset();
+            }
+        }
+    }
+}
+
 /**
  * @return the list of all transactions related to this wallet
  */
@@ -1404,61 +1643,16 @@ vector<wallet_transaction_record> wallet::get_transaction_history( const string&
    if( end_block_num != -1 ) FC_ASSERT( start_block_num <= end_block_num );
 
    vector<wallet_transaction_record> history_records;
-   const auto& transactions = my->_wallet_db.get_transactions();
-
-   asset_id_type asset_id = 0;
-   if( !asset_symbol.empty() && asset_symbol != BTS_BLOCKCHAIN_SYMBOL )
-   {
-       try
-       {
-           asset_id = my->_blockchain->get_asset_id( asset_symbol );
-       }
-       catch( const fc::exception& )
-       {
-           FC_THROW_EXCEPTION( invalid_asset_symbol, "Invalid asset symbol!", ("asset_symbol",asset_symbol) );
-       }
-   }
+   const asset_id_type asset_id = my->get_history_asset_id( asset_symbol );
 
-   for( const auto& item : transactions )
+   my->scan_transaction_history( account_name, asset_id, optional<transaction_history_key>(), false,
+                                 [&]( const transaction_history_key& key, const wallet_transaction_record& tx_record ) -> bool
    {
-       const auto& tx_record = item.second;
-
-       if( tx_record.block_num < start_block_num ) continue;
-       if( end_block_num != -1 && tx_record.block_num > end_block_num ) continue;
-       if( tx_record.ledger_entries.empty() ) continue; /* TODO: Temporary */
-
-       if( !account_name.empty() )
-       {
-           bool match = false;
-           for( const auto& entry : tx_record.ledger_entries )
-           {
-               if( entry.from_account.valid() )
-               {
-                   const auto account_record = get_account_for_address( *entry.from_account );
-                   if( account_record.valid() ) match |= account_record->name == account_name;
-                   if( match ) break;
-               }
-               if( entry.to_account.valid() )
-               {
-                   const auto account_record = get_account_for_address( *entry.to_account );
-                   if( account_record.valid() ) match |= account_record->name == account_name;
-                   if( match ) break;
-               }
-           }
-           if( !match ) continue;
-       }
-
-       if( asset_id != 0 )
-       {
-           bool match = false;
-           for( const auto& entry : tx_record.ledger_entries )
-               match |= entry.amount.amount > 0 && entry.amount.asset_id == asset_id;
-           match |= tx_record.fee.amount > 0 && tx_record.fee.asset_id == asset_id;
-           if( !match ) continue;
-       }
-
+       if( tx_record.block_num < start_block_num ) return true;
+       if( end_block_num != -1 && tx_record.block_num > end_block_num ) return true;
        history_records.push_back( tx_record );
-   }
+       return true;
+   } );
 
    return history_records;
 } FC_CAPTURE_AND_RETHROW() }
@@ -1468,27 +1662,55 @@ vector<pretty_transaction> wallet::get_pretty_transaction_history( const string&
                                                                    uint32_t end_block_num,
                                                                    const string& asset_symbol )const
 { try {
+    return get_pretty_transaction_history_page( account_name, asset_symbol, 0, start_block_num, end_block_num ).transactions;
+} FC_CAPTURE_AND_RETHROW() }
 
-    // TODO: Validate all input
-
-    const auto& history = get_transaction_history( account_name, start_block_num, end_block_num, asset_symbol );
-    vector<pretty_transaction> pretties;
-    pretties.reserve( history.size() );
-    for( const auto& item : history ) pretties.push_back( to_pretty_trx( item ) );
-
-    const auto sorter = []( const pretty_transaction& a, const pretty_transaction& b ) -> bool
+transaction_history_page wallet::get_pretty_transaction_history_page( const string& account_name,
+                                                                      const string& asset_symbol,
+                                                                      int32_t limit,
+                                                                      uint32_t start_block_num,
+                                                                      uint32_t end_block_num,
+                                                                      const optional<transaction_history_key>& cursor )const
+{ try {
+    FC_ASSERT( is_open() );
+    if( end_block_num != -1 ) FC_ASSERT( start_block_num <= end_block_num );
+
+    transaction_history_page page;
+    const asset_id_type asset_id = my->get_history_asset_id( asset_symbol );
+    const bool reverse = limit < 0;
+    const uint32_t max_count = std::abs( int64_t( limit ) );
+    const uint32_t unconfirmed_block_num = uint32_t( -1 );
+
+    /* Collect the page walking away from the cursor, stopping once past the block range */
+    vector<pair<transaction_history_key, wallet_transaction_record>> records;
+    const bool account_found = my->scan_transaction_history( account_name, asset_id, cursor, reverse,
+            [&]( const transaction_history_key& key, const wallet_transaction_record& tx_record ) -> bool
     {
-        if( a.is_confirmed == b.is_confirmed && a.block_num != b.block_num )
-            return a.block_num < b.block_num;
+        if( max_count > 0 && records.size() >= max_count )
+        {
+            page.next_cursor = records.back().first;
+            return false;
+        }
 
-        if( a.timestamp != b.timestamp)
-            return a.timestamp < b.timestamp;
+        if( reverse && key.block_num != unconfirmed_block_num && key.block_num < start_block_num )
+            return false;
+        if( !reverse && end_block_num != -1 && key.block_num != unconfirmed_block_num && key.block_num > end_block_num )
+            return false;
 
-        return string( a.trx_id ).compare( string( b.trx_id ) ) < 0;
-    };
-    std::sort( pretties.begin(), pretties.end(), sorter );
+        if( tx_record.block_num < start_block_num ) return true;
+        if( end_block_num != -1 && tx_record.block_num > end_block_num ) return true;
 
-    // TODO: Handle pagination
+        records.emplace_back( key, tx_record );
+        return true;
+    } );
+    if( !account_found || records.empty() )
+        return page;
+    if( reverse )
+        std::reverse( records.begin(), records.end() );
+
+    vector<pretty_transaction>& pretties = page.transactions;
+    pretties.reserve( records.size() );
+    for( const auto& item : records ) pretties.push_back( to_pretty_trx( item.second ) );
 
     const auto errors = get_pending_transaction_errors();
     for( auto& trx : pretties )
@@ -1518,64 +1740,35 @@ vector<pretty_transaction> wallet::get_pretty_transaction_history( const string&
         account_names.push_back( account_name );
     }
 
-    /* Tally up running balances */
-    for( const auto& name : account_names )
+    /* Running balances before the page, from the closest remembered checkpoint */
+    const string history_name = account_name + "/" + std::to_string( asset_id );
+    const transaction_history_key& first_key = records.front().first;
+    running_balances_type running_balances;
+    optional<transaction_history_key> tally_start;
+    const auto checkpoint = my->_wallet_db.lookup_running_balance_checkpoint( history_name, first_key );
+    if( checkpoint.valid() )
     {
-        map<asset_id_type, asset> running_balances;
-        for( auto& trx : pretties )
-        {
-            const auto fee_asset_id = trx.fee.asset_id;
-            if( running_balances.count( fee_asset_id ) <= 0 )
-                running_balances[ fee_asset_id ] = asset( 0, fee_asset_id );
-
-            auto any_from_me = false;
-            for( auto& entry : trx.ledger_entries )
-            {
-                const auto amount_asset_id = entry.amount.asset_id;
-                if( running_balances.count( amount_asset_id ) <= 0 )
-                    running_balances[ amount_asset_id ] = asset( 0, amount_asset_id );
-
-                auto from_me = false;
-                from_me |= name == entry.from_account;
-                from_me |= ( entry.from_account.find( name + " " ) == 0 ); /* If payer != sender */
-                if( from_me )
-                {
-                    /* Special check to ignore asset issuing */
-                    if( ( running_balances[ amount_asset_id ] - entry.amount ) >= asset( 0, amount_asset_id ) )
-                        running_balances[ amount_asset_id ] -= entry.amount;
-
-                    /* Subtract fee once on the first entry */
-                    if( !trx.is_virtual && !any_from_me )
-                        running_balances[ fee_asset_id ] -= trx.fee;
-                }
-                any_from_me |= from_me;
-
-                /* Special case to subtract fee if we canceled a bid */
-                if( !trx.is_virtual && trx.is_market_cancel && amount_asset_id != fee_asset_id )
-                    running_balances[ fee_asset_id ] -= trx.fee;
-
-                auto to_me = false;
-                to_me |= name == entry.to_account;
-                to_me |= ( entry.to_account.find( name + " " ) == 0 ); /* If payer != sender */
-                if( to_me ) running_balances[ amount_asset_id ] += entry.amount;
+        tally_start = checkpoint->first;
+        running_balances = checkpoint->second;
+    }
 
-                entry.running_balances[ name ][ amount_asset_id ] = running_balances[ amount_asset_id ];
-                entry.running_balances[ name ][ fee_asset_id ] = running_balances[ fee_asset_id ];
-            }
+    uint32_t tally_count = 0;
+    my->scan_transaction_history( account_name, asset_id, tally_start, false,
+            [&]( const transaction_history_key& key, const wallet_transaction_record& tx_record ) -> bool
+    {
+        if( !( key < first_key ) ) return false;
+        auto trx = to_pretty_trx( tx_record );
+        my->tally_running_balances( trx, account_names, account_specified, running_balances );
+        if( ++tally_count % BTS_WALLET_HISTORY_CHECKPOINT_INTERVAL == 0 )
+            my->_wallet_db.store_running_balance_checkpoint( history_name, key, running_balances );
+        return true;
+    } );
 
-            if( account_specified )
-            {
-                /* Don't return fees we didn't pay */
-                if( trx.is_virtual || ( !any_from_me && !trx.is_market_cancel ) )
-                {
-                    trx.fee = asset();
-                }
-            }
-        }
-    }
+    for( auto& trx : pretties )
+        my->tally_running_balances( trx, account_names, account_specified, running_balances );
 
-    return pretties;
-} FC_CAPTURE_AND_RETHROW() }
+    return page;
+} FC_CAPTURE_AND_RETHROW( (account_name)(asset_symbol)(limit)(start_block_num)(end_block_num)(cursor) ) }
 
 void wallet::remove_transaction_record( const string& record_id )
 {
@@ -33,7 +33,7 @@ transaction_ledger_entry wallet_impl::scan_transaction_experimental( const trans
                                                                      const time_point_sec timestamp,
                                                                      bool overwrite_existing )
 { try {
-    const map<private_key_type, string> account_keys = _wallet_db.get_account_private_keys( _wallet_password );
+    const map<private_key_type, string> account_keys = get_account_private_keys();
 
     // TODO: Move this into a separate function
     map<address, string> account_balances;
@@ -10,6 +10,7 @@
 
 #include <algorithm>
 #include <fstream>
+#include <limits>
 #include <thread>
 
 #include <bts/blockchain/fork_blocks.hpp>
@@ -33,7 +34,9 @@ namespace detail {
 
    void wallet_impl::state_changed( const pending_chain_state_ptr& state )
    {
-       if( !self->is_open() || !self->is_unlocked() ) return;
+       if( !self->is_open() ) return;
+       index_balance_changes( *state, _blockchain->get_head_block_num() );
+       if( !self->is_unlocked() ) return;
 
        const auto last_unlocked_scanned_number = self->get_last_scanned_block_number();
        if ( _blockchain->get_head_block_num() < last_unlocked_scanned_number )
@@ -44,12 +47,190 @@ namespace detail {
 
    void wallet_impl::block_applied( const block_summary& summary )
    {
-       if( !self->is_open() || !self->is_unlocked() ) return;
+       if( !self->is_open() ) return;
+       if( summary.applied_changes ) index_balance_changes( *summary.applied_changes, summary.block_data.block_num );
+       if( !self->is_unlocked() ) return;
        if( !self->get_transaction_scanning() ) return;
-       if( summary.block_data.block_num <= self->get_last_scanned_block_number() ) return;
+       const uint32_t block_num = summary.block_data.block_num;
+       uint32_t last_scanned_block_num = self->get_last_scanned_block_number();
+       if( _summary_scan_done.valid() && !_summary_scan_done.ready() )
+           last_scanned_block_num = std::max( last_scanned_block_num, _last_queued_summary_block_num );
+       if( block_num <= last_scanned_block_num ) return;
        if( _scan_in_progress.valid() && !_scan_in_progress.ready() ) return;
 
-       self->scan_chain( self->get_last_scanned_block_number(), summary.block_data.block_num );
+       // The next block is scanned from what the chain already decoded and evaluated; only gaps need a chain scan
+       if( block_num == last_scanned_block_num + 1 && summary.applied_changes
+           && summary.transaction_states.size() == summary.block_data.user_transactions.size() )
+       {
+           queue_block_summary_scan( summary );
+           return;
+       }
+
+       self->scan_chain( last_scanned_block_num, block_num );
+   }
+
+   void wallet_impl::queue_block_summary_scan( const block_summary& summary )
+   {
+       const uint32_t block_num = summary.block_data.block_num;
+       _last_queued_summary_block_num = block_num;
+
+       // Trial decrypting memos is the slow part, so keep it off the thread applying blocks to the chain
+       const std::shared_ptr<const memo_scan_keys> keys = get_memo_scan_keys();
+       queued_block_summary queued;
+       queued.summary = summary;
+       queued.prescan = _scanner_threads[ block_num % _num_scanner_threads ]->async(
+               [summary, keys]() { return prescan_block_summary( summary, *keys ); },
+               "wallet_prescan_block_summary" );
+       _queued_block_summaries.push_back( std::move( queued ) );
+
+       if( !_summary_scan_done.valid() || _summary_scan_done.ready() )
+           _summary_scan_done = fc::async( [this]() { scan_queued_block_summaries(); }, "wallet_scan_block_summaries" );
+   }
+
+   // Applies the queued blocks in chain order
+   void wallet_impl::scan_queued_block_summaries()
+   {
+       while( !_queued_block_summaries.empty() && !_summary_scan_done.canceled() )
+       {
+           queued_block_summary queued = std::move( _queued_block_summaries.front() );
+           _queued_block_summaries.pop_front();
+           if( !self->is_open() || !self->is_unlocked() ) continue;
+
+           const uint32_t block_num = queued.summary.block_data.block_num;
+           try
+           {
+               scan_block_summary( queued.summary, queued.prescan.wait() );
+           }
+           catch( const fc::canceled_exception& )
+           {
+               throw;
+           }
+           catch( const fc::exception& e )
+           {
+               wlog( "Unable to scan block ${n} from its summary: ${e}", ("n",block_num)("e",e.to_detail_string()) );
+               const uint32_t last_scanned_block_num = self->get_last_scanned_block_number();
+               if( block_num > last_scanned_block_num )
+                   self->scan_chain( last_scanned_block_num, block_num );
+           }
+       }
+   }
+
+   void wallet_impl::scan_block_summary( const block_summary& summary, const prescanned_block& prescanned )
+   { try {
+       // Only accounts the block changed can need updating
+       for( const auto& item : summary.applied_changes->_account_id_to_record )
+       {
+           const blockchain::account_record& record = item.second;
+           if( _wallet_db.lookup_account( record.owner_address() ).valid() )
+               _wallet_db.store_account( record );
+       }
+
+       scan_block( prescanned, blockchain::now() );
+       self->set_last_scanned_block_number( summary.block_data.block_num );
+   } FC_CAPTURE_AND_RETHROW( (summary.block_data.block_num) ) }
+
+   bool wallet_impl::index_balance( const balance_record& record )
+   {
+       const auto owner = record.owner();
+       if( owner.valid() )
+       {
+           const owallet_key_record key_record = _wallet_db.lookup_key( *owner );
+           if( !key_record.valid() || !key_record->has_private_key() ) return false;
+           _owned_balance_ids.insert( record.id() );
+           index_spendable_balance( record );
+           return true;
+       }
+
+       if( record.condition.type == withdraw_escrow_type )
+       {
+           const auto escrow_condition = record.condition.as<withdraw_with_escrow>();
+           if( !_wallet_db.lookup_key( escrow_condition.sender ).valid()
+               && !_wallet_db.lookup_key( escrow_condition.receiver ).valid() )
+               return false;
+           _escrow_balance_ids.insert( record.id() );
+           return true;
+       }
+
+       return false;
+   }
+
+   void wallet_impl::index_balance_changes( const pending_chain_state& changes, uint32_t block_num )
+   { try {
+       if( !_balance_index_valid ) return;
+
+       const bool scanning = self->get_transaction_scanning();
+       for( const auto& item : changes._balance_id_to_record )
+       {
+           if( _owned_balance_ids.count( item.first ) > 0 )
+           {
+               index_spendable_balance( item.second );
+               continue;
+           }
+           if( _escrow_balance_ids.count( item.first ) > 0 ) continue;
+           if( index_balance( item.second ) ) continue;
+           // a deposit to a one time key only becomes recognizable once the wallet scans its block
+           if( scanning ) _unresolved_balance_ids[ item.first ] = block_num;
+       }
+
+       if( _unresolved_balance_ids.size() > BTS_WALLET_MAX_UNRESOLVED_BALANCES )
+           invalidate_balance_index();
+   } FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+   void wallet_impl::index_spendable_balance( const balance_record& record )
+   {
+       const auto owner = record.owner();
+       const owallet_key_record key_record = owner.valid() ? _wallet_db.lookup_key( *owner ) : owallet_key_record();
+       const owallet_account_record account_record = key_record.valid()
+                                                     ? _wallet_db.lookup_account( key_record->account_address )
+                                                     : owallet_account_record();
+       if( !account_record.valid() )
+       {
+           _coin_selector.remove( record.id() );
+           return;
+       }
+       _coin_selector.store( account_record->wallet_record_index, record );
+   }
+
+   void wallet_impl::refresh_balance_index()
+   { try {
+       const uint32_t last_scanned_block_num = self->get_transaction_scanning()
+                                               ? self->get_last_scanned_block_number()
+                                               : std::numeric_limits<uint32_t>::max();
+
+       if( _balance_index_rebuild_block_num > 0 && last_scanned_block_num >= _balance_index_rebuild_block_num )
+           invalidate_balance_index();
+
+       if( !_balance_index_valid )
+       {
+           _blockchain->scan_balances( [&]( const balance_record& record ) { index_balance( record ); }, true );
+           const uint32_t head_block_num = _blockchain->get_head_block_num();
+           _balance_index_rebuild_block_num = last_scanned_block_num < head_block_num ? head_block_num : 0;
+           _balance_index_valid = true;
+           return;
+       }
+
+       for( auto iter = _unresolved_balance_ids.begin(); iter != _unresolved_balance_ids.end(); )
+       {
+           if( iter->second > last_scanned_block_num )
+           {
+               ++iter;
+               continue;
+           }
+
+           const obalance_record record = _blockchain->get_balance_record( iter->first );
+           if( record.valid() ) index_balance( *record );
+           iter = _unresolved_balance_ids.erase( iter );
+       }
+   } FC_CAPTURE_AND_RETHROW() }
+
+   void wallet_impl::invalidate_balance_index()
+   {
+       _owned_balance_ids.clear();
+       _escrow_balance_ids.clear();
+       _coin_selector.clear();
+       _unresolved_balance_ids.clear();
+       _balance_index_valid = false;
+       _balance_index_rebuild_block_num = 0;
    }
 
    vector<wallet_transaction_record> wallet_impl::get_pending_transactions()const
@@ -58,6 +239,36 @@ namespace detail {
    }
 
 
+   unordered_map<balance_id_type, share_type> wallet_impl::get_reserved_balances( const pending_chain_state_ptr& pending_state,
+                                                                                  const signed_transaction& trx )const
+   {
+       unordered_map<balance_id_type, share_type> reserved;
+       const auto reserve = [&]( const signed_transaction& transaction )
+       {
+           for( const operation& op : transaction.operations )
+           {
+               if( operation_type_enum( op.type ) != withdraw_op_type ) continue;
+               const withdraw_operation withdraw_op = op.as<withdraw_operation>();
+               reserved[ withdraw_op.balance_id ] += withdraw_op.amount;
+           }
+       };
+
+       // Transactions in the chain or the pending pool are already reflected in the pending state spendable
+       // balances come from, and ones that expired or no longer evaluate will never spend anything
+       const auto relay_fee = _blockchain->get_relay_fee();
+       for( const wallet_transaction_record& record : _wallet_db.get_pending_transactions() )
+       {
+           if( pending_state->is_known_transaction( record.trx ) ) continue;
+           if( record.trx.expiration <= pending_state->now() ) continue;
+           if( _blockchain->get_transaction_error( record.trx, relay_fee ).valid() ) continue;
+           reserve( record.trx );
+       }
+       reserve( trx );
+       for( const auto& item : _batch_reserved_balances )
+           reserved[ item.first ] += item.second;
+       return reserved;
+   }
+
    void wallet_impl::withdraw_to_transaction(
            const asset& amount_to_withdraw,
            const string& from_account_name,
@@ -66,38 +277,40 @@ namespace detail {
            )
    { try {
       FC_ASSERT( !from_account_name.empty() );
-      auto amount_remaining = amount_to_withdraw;
+      const owallet_account_record account_record = _wallet_db.lookup_account( from_account_name );
+      if( !account_record.valid() )
+         FC_CAPTURE_AND_THROW( insufficient_funds, (from_account_name)(amount_to_withdraw) );
 
-      const account_balance_record_summary_type balance_records = self->get_account_balance_records( from_account_name );
-      if( balance_records.find( from_account_name ) == balance_records.end() )
-         FC_CAPTURE_AND_THROW( insufficient_funds, (from_account_name)(amount_to_withdraw)(balance_records) );
-      for( const auto& record : balance_records.at( from_account_name ) )
+      refresh_balance_index();
+      const auto pending_state = _blockchain->get_pending_state();
+      const auto get_spendable = [&]( const balance_id_type& balance_id ) -> share_type
       {
-          const asset balance = record.get_spendable_balance( _blockchain->get_pending_state()->now() );
-          if( balance.amount <= 0 || balance.asset_id != amount_remaining.asset_id )
-              continue;
+          const obalance_record record = pending_state->get_balance_record( balance_id );
+          return record.valid() ? record->get_spendable_balance( pending_state->now() ).amount : 0;
+      };
 
-          const auto owner = record.owner();
-          if( !owner.valid() )
-              continue;
+      const vector<selected_balance> selected = _coin_selector.select( account_record->wallet_record_index,
+                                                                       amount_to_withdraw,
+                                                                       self->get_coin_selection_strategy(),
+                                                                       get_reserved_balances( pending_state, trx ),
+                                                                       get_spendable );
 
-          if( amount_remaining.amount > balance.amount )
-          {
-              trx.withdraw( record.id(), balance.amount );
-              required_signatures.insert( *owner );
-              amount_remaining -= balance;
-          }
-          else
-          {
-              trx.withdraw( record.id(), amount_remaining.amount );
-              required_signatures.insert( *owner );
-              return;
-          }
+      auto amount_remaining = amount_to_withdraw;
+      for( const selected_balance& balance : selected )
+          amount_remaining.amount -= balance.amount;
+
+      if( amount_remaining.amount > 0 )
+      {
+          const string required = _blockchain->to_pretty_asset( amount_to_withdraw );
+          const string available = _blockchain->to_pretty_asset( amount_to_withdraw - amount_remaining );
+          FC_CAPTURE_AND_THROW( insufficient_funds, (required)(available) );
       }
 
-      const string required = _blockchain->to_pretty_asset( amount_to_withdraw );
-      const string available = _blockchain->to_pretty_asset( amount_to_withdraw - amount_remaining );
-      FC_CAPTURE_AND_THROW( insufficient_funds, (required)(available)(balance_records) );
+      for( const selected_balance& balance : selected )
+      {
+          trx.withdraw( balance.balance_id, balance.amount );
+          required_signatures.insert( balance.owner );
+      }
    } FC_CAPTURE_AND_RETHROW( (amount_to_withdraw)(from_account_name)(trx)(required_signatures) ) }
 
    // TODO: What about retracted accounts?
@@ -158,6 +371,52 @@ namespace detail {
       return fc::ripemd160::hash( enc.result() );
    }
 
+   private_key_type wallet_impl::get_private_key( const wallet_key_record& key_record )const
+   { try {
+      const optional<private_key_type> cached_key = _private_key_cache.find( key_record.get_address() );
+      if( cached_key.valid() )
+         return *cached_key;
+
+      const private_key_type private_key = key_record.decrypt_private_key( _wallet_password );
+      _private_key_cache.insert( key_record.public_key, private_key );
+      return private_key;
+   } FC_CAPTURE_AND_RETHROW( (key_record.public_key) ) }
+
+   // Only returns private keys corresponding to owner and active keys
+   map<private_key_type, string> wallet_impl::get_account_private_keys()const
+   { try {
+      map<private_key_type, string> private_keys;
+      for( const auto& item : _wallet_db.get_account_public_keys() )
+      {
+         const owallet_key_record key_record = _wallet_db.lookup_key( item.first );
+         if( !key_record.valid() || !key_record->has_private_key() )
+            continue;
+
+         try
+         {
+            private_keys[ get_private_key( *key_record ) ] = item.second;
+         }
+         catch( const fc::exception& e )
+         {
+            elog( "Error decrypting private key: ${e}", ("e",e.to_detail_string()) );
+         }
+      }
+      return private_keys;
+   } FC_CAPTURE_AND_RETHROW() }
+
+   void wallet_impl::load_private_key_cache()
+   { try {
+      clear_private_key_cache();
+      // Account keys are needed for every scan and most signatures; other keys are decrypted on first use
+      get_account_private_keys();
+   } FC_CAPTURE_AND_RETHROW() }
+
+   void wallet_impl::clear_private_key_cache()
+   {
+      _memo_scan_keys.reset();
+      _private_key_cache.clear();
+   }
+
    void wallet_impl::reschedule_relocker()
    {
      if( !_relocker_done.valid() || _relocker_done.ready() )
@@ -211,37 +470,61 @@ namespace detail {
           const auto now = blockchain::now();
           _scan_progress = 0;
 
-          // Collect private keys
-          const auto account_keys = _wallet_db.get_account_private_keys( _wallet_password );
-          vector<private_key_type> private_keys;
-          private_keys.reserve( account_keys.size() );
-          for( const auto& item : account_keys )
-              private_keys.push_back( item.first );
+          // Collect private keys, with the parts of memo decryption that only depend on the key done once
+          const std::shared_ptr<const memo_scan_keys> keys = get_memo_scan_keys();
+          const chain_snapshot_ptr snapshot = _blockchain->get_latest_read_snapshot();
+          const uint32_t scan_end = std::min<uint32_t>( min_end, snapshot->get_head_block_num() );
 
           if( min_end > start + 1 )
               ulog( "Beginning scan at block ${n}...", ("n",start) );
 
           uint32_t last_scanned_block_num = std::min( {self->get_last_scanned_block_number(), start - 1, start} );
-          for( auto block_num = start; !_scan_in_progress.canceled() && block_num <= min_end; ++block_num )
+
+          // Fetch and trial decrypt a batch on the scanner threads
+          const auto submit_prescans = [&]( uint32_t batch_start ) -> vector<fc::future<prescanned_block>>
           {
-              try
-              {
-                  scan_block( block_num, private_keys, now );
-                  last_scanned_block_num = block_num;
-              }
-              catch( const fc::exception& )
+              vector<fc::future<prescanned_block>> prescans;
+              if( batch_start > scan_end )
+                  return prescans;
+              const uint32_t batch_end = std::min<uint32_t>( scan_end, batch_start + BTS_WALLET_SCAN_BATCH_SIZE - 1 );
+              prescans.reserve( batch_end - batch_start + 1 );
+              for( uint32_t block_num = batch_start; block_num <= batch_end; ++block_num )
               {
+                  prescans.push_back( _scanner_threads[ block_num % _num_scanner_threads ]->async(
+                          [snapshot, block_num, keys]() { return prescan_block( snapshot, block_num, *keys ); },
+                          "wallet_prescan_block" ) );
               }
+              return prescans;
+          };
 
-              _scan_progress = float(block_num-start)/(min_end-start+1);
-              if( block_num > start )
+          vector<fc::future<prescanned_block>> next_prescans = submit_prescans( start );
+          for( uint32_t batch_start = start; !_scan_in_progress.canceled() && batch_start <= scan_end;
+               batch_start += BTS_WALLET_SCAN_BATCH_SIZE )
+          {
+              // Queue the following batch before applying this one so the scanner threads keep working
+              // while the wallet records are written, then apply this batch in order
+              vector<fc::future<prescanned_block>> prescans = std::move( next_prescans );
+              next_prescans = submit_prescans( batch_start + BTS_WALLET_SCAN_BATCH_SIZE );
+
+              const uint32_t batch_end = batch_start + prescans.size() - 1;
+              for( uint32_t block_num = batch_start; !_scan_in_progress.canceled() && block_num <= batch_end; ++block_num )
               {
-                  if( (block_num - start) % 10000 == 0 )
-                      ulog( "Scanning ${p} done...", ("p",cli::pretty_percent( _scan_progress, 1 )) );
+                  try
+                  {
+                      scan_block( prescans[ block_num - batch_start ].wait(), now );
+                      last_scanned_block_num = block_num;
+                  }
+                  catch( const fc::exception& )
+                  {
+                  }
 
-                  if( !fast_scan && (block_num - start) % 100 == 0 )
-                      fc::usleep( fc::microseconds( 100 ) );
+                  _scan_progress = float(block_num-start)/(min_end-start+1);
+                  if( block_num > start && (block_num - start) % 10000 == 0 )
+                      ulog( "Scanning ${p} done...", ("p",cli::pretty_percent( _scan_progress, 1 )) );
               }
+
+              if( !fast_scan )
+                  fc::usleep( fc::microseconds( 100 ) );
           }
 
           self->set_last_scanned_block_number( last_scanned_block_num );
@@ -604,6 +887,117 @@ namespace detail {
        return addr;
    } FC_CAPTURE_AND_RETHROW( (account_name) ) }
 
+   vector<derived_key> wallet_impl::derive_keys( uint32_t count, const std::function<private_key_type( uint32_t )>& derive_key )const
+   { try {
+       vector<derived_key> keys;
+       if( count == 0 )
+           return keys;
+
+       // One contiguous range per worker thread, so the results come back in order
+       const uint32_t range_size = ( count + _num_scanner_threads - 1 ) / _num_scanner_threads;
+       vector<fc::future<vector<derived_key>>> ranges;
+       for( uint32_t start = 0; start < count; start += range_size )
+       {
+           const uint32_t end = std::min( start + range_size, count );
+           ranges.push_back( _scanner_threads[ ranges.size() ]->async( [&derive_key, start, end]() -> vector<derived_key>
+           {
+               vector<derived_key> range_keys;
+               range_keys.reserve( end - start );
+               for( uint32_t index = start; index < end; ++index )
+               {
+                   try
+                   {
+                       derived_key key;
+                       key.index = index;
+                       key.private_key = derive_key( index );
+                       key.public_key = key.private_key.get_public_key();
+                       range_keys.push_back( std::move( key ) );
+                   }
+                   catch( const fc::exception& e )
+                   {
+                       ulog( "${e}", ("e",e.to_detail_string()) );
+                   }
+               }
+               return range_keys;
+           }, "derive_keys" ) );
+       }
+
+       keys.reserve( count );
+       for( auto& range : ranges )
+       {
+           vector<derived_key> range_keys = range.wait();
+           keys.insert( keys.end(), std::make_move_iterator( range_keys.begin() ), std::make_move_iterator( range_keys.end() ) );
+       }
+       return keys;
+   } FC_CAPTURE_AND_RETHROW( (count) ) }
+
+   uint32_t wallet_impl::import_derived_keys( const string& account_name, const vector<derived_key>& keys )
+   { try {
+       const owallet_account_record named_account_record = _wallet_db.lookup_account( account_name );
+       FC_ASSERT( named_account_record.valid(), "Could not find an account with that name!", ("account_name",account_name) );
+
+       // The keys may already own balances
+       invalidate_balance_index();
+
+       // Same account resolution as import_private_key, with the public keys already derived
+       vector<key_data> keys_to_store;
+       keys_to_store.reserve( keys.size() );
+       for( const derived_key& key : keys )
+       {
+           fc::oexception import_key_error;
+           try
+           {
+               const address key_address( key.public_key );
+               owallet_account_record account_record;
+
+               const oaccount_record blockchain_account_record = _blockchain->get_account_record( key_address );
+               if( blockchain_account_record.valid() )
+               {
+                   FC_ASSERT( account_name == blockchain_account_record->name,
+                              "That key already belongs to a registered account with a different name!",
+                              ("blockchain_account_record",*blockchain_account_record)
+                              ("account_name",account_name) );
+                   _wallet_db.store_account( *blockchain_account_record );
+                   account_record = _wallet_db.lookup_account( blockchain_account_record->name );
+               }
+               else
+               {
+                   account_record = _wallet_db.lookup_account( key_address );
+                   if( !account_record.valid() )
+                   {
+                       const owallet_key_record key_record = _wallet_db.lookup_key( key_address );
+                       if( key_record.valid() && key_record->has_private_key() )
+                           account_record = _wallet_db.lookup_account( key_record->account_address );
+                   }
+                   if( !account_record.valid() )
+                       account_record = named_account_record;
+
+                   FC_ASSERT( account_name == account_record->name,
+                              "That key already belongs to a local account with a different name!",
+                              ("account_record",*account_record)
+                              ("account_name",account_name) );
+               }
+
+               const owallet_key_record key_record = _wallet_db.lookup_key( key_address );
+               key_data key_to_store = key_record.valid() ? key_data( *key_record ) : key_data();
+               key_to_store.account_address = account_record->owner_address();
+               key_to_store.public_key = key.public_key;
+               key_to_store.encrypt_private_key( _wallet_password, key.private_key );
+               keys_to_store.push_back( std::move( key_to_store ) );
+           }
+           catch( const fc::exception& e )
+           {
+               import_key_error = e;
+           }
+
+           if( import_key_error.valid() )
+               ulog( "${e}", ("e",import_key_error->to_detail_string()) );
+       }
+
+       _wallet_db.store_keys( keys_to_store );
+       return keys_to_store.size();
+   } FC_CAPTURE_AND_RETHROW( (account_name) ) }
+
    slate_id_type wallet_impl::select_slate( signed_transaction& transaction, const asset_id_type deposit_asset_id,
                                             vote_selection_method selection_method )
    {
@@ -621,6 +1015,7 @@ namespace detail {
 
    void wallet_impl::scan_state()
    { try {
+      invalidate_balance_index();
       scan_registered_accounts();
       scan_balances();
    } FC_CAPTURE_AND_RETHROW() }
@@ -923,6 +1318,7 @@ namespace detail {
         wlog("Unexpected exception from wallet's relocker()");
       }
 
+      my->invalidate_balance_index();
       my->_wallet_db.close();
       my->_current_wallet_path = fc::path();
    } FC_CAPTURE_AND_RETHROW() }
@@ -1090,6 +1486,7 @@ namespace detail {
           if( !my->_wallet_db.validate_password( my->_wallet_password ) )
               FC_THROW_EXCEPTION( invalid_password, "Invalid password!" );
 
+          my->load_private_key_cache();
           my->upgrade_version_unlocked();
 
           my->_scheduled_lock_time = new_lock_time;
@@ -1129,7 +1526,22 @@ namespace detail {
       {
         wlog("Unexpected exception from wallet's login_map_cleaner()");
       }
+      try
+      {
+        // Queued blocks hold decrypted memos and are only scanned while unlocked
+        my->_summary_scan_done.cancel_and_wait("wallet::lock()");
+      }
+      catch( const fc::exception& e )
+      {
+        wlog("Unexpected exception from wallet's block summary scan : ${e}", ("e", e));
+      }
+      catch( ... )
+      {
+        wlog("Unexpected exception from wallet's block summary scan");
+      }
+      my->_queued_block_summaries.clear();
       my->_wallet_password     = fc::sha512();
+      my->clear_private_key_cache();
       my->_scheduled_lock_time = fc::optional<fc::time_point>();
       wallet_lock_state_changed( true );
       ilog( "Wallet locked at time: ${t}", ("t",blockchain::now()) );
@@ -1301,6 +1713,7 @@ namespace detail {
          }
 
          my->_wallet_db.add_contact_account( *current_registered_account, private_data );
+         my->invalidate_balance_index();
       }
    } FC_CAPTURE_AND_RETHROW( (account_name)(key) ) }
 
@@ -1416,6 +1829,9 @@ namespace detail {
       const public_key_type new_public_key = new_private_key.get_public_key();
       const address new_address = address( new_public_key );
 
+      // The key may already own balances
+      my->invalidate_balance_index();
+
       // Try to associate with an existing registered account
       const oaccount_record blockchain_account_record = my->_blockchain->get_account_record( new_address );
       if( blockchain_account_record.valid() )
@@ -1570,7 +1986,7 @@ namespace detail {
       auto key = my->_wallet_db.lookup_key( addr );
       FC_ASSERT( key.valid() );
       FC_ASSERT( key->has_private_key() );
-      return key->decrypt_private_key( my->_wallet_password );
+      return my->get_private_key( *key );
    } FC_CAPTURE_AND_RETHROW( (addr) ) }
 
    public_key_type  wallet::get_public_key( const address& addr) const
@@ -1749,6 +2165,112 @@ namespace detail {
        return builder;
    } FC_CAPTURE_AND_RETHROW() }
 
+   vector<batch_transfer_result> wallet::batch_transfer( const string& from_account_name,
+                                                         const string& asset_symbol,
+                                                         const vector<batch_transfer_output>& outputs,
+                                                         vote_selection_method vote_method,
+                                                         vector<transaction_builder_ptr>& builders )
+   { try {
+       FC_ASSERT( is_open() );
+       FC_ASSERT( is_unlocked() );
+
+       const wallet_account_record payer = get_account( from_account_name );
+
+       vector<batch_transfer_result> results;
+       results.reserve( outputs.size() );
+       vector<batch_deposit> deposits;
+       vector<uint32_t> deposit_outputs;
+       for( uint32_t i = 0; i < outputs.size(); ++i )
+       {
+           batch_transfer_result result;
+           result.recipient = outputs[ i ].recipient;
+           result.amount = outputs[ i ].amount;
+           try
+           {
+               batch_deposit deposit;
+               deposit.recipient = get_account( outputs[ i ].recipient );
+               deposit.amount = my->_blockchain->to_ugly_asset( outputs[ i ].amount, asset_symbol );
+               deposit.memo = outputs[ i ].memo;
+               deposit.validate();
+
+               deposits.push_back( std::move( deposit ) );
+               deposit_outputs.push_back( i );
+           }
+           catch( const fc::exception& e )
+           {
+               result.error = e.to_string();
+           }
+           results.push_back( std::move( result ) );
+       }
+
+       // Build every transaction first, holding back the balances each one spends so the next is funded from others
+       vector<transaction_builder_ptr> chunk_builders;
+       vector<vector<uint32_t>> chunk_outputs;
+       try
+       {
+           for( uint32_t start = 0; start < deposits.size(); start += BTS_WALLET_BATCH_TRANSFER_OUTPUTS_PER_TRANSACTION )
+           {
+               const uint32_t end = std::min<uint32_t>( start + BTS_WALLET_BATCH_TRANSFER_OUTPUTS_PER_TRANSACTION,
+                                                        deposits.size() );
+               const vector<batch_deposit> chunk( deposits.begin() + start, deposits.begin() + end );
+               const vector<uint32_t> chunk_output_indexes( deposit_outputs.begin() + start, deposit_outputs.begin() + end );
+               try
+               {
+                   transaction_builder_ptr builder = create_transaction_builder();
+                   builder->deposit_asset_batch( payer, chunk, vote_method ).finalize();
+
+                   for( const operation& op : builder->transaction_record.trx.operations )
+                   {
+                       if( operation_type_enum( op.type ) != withdraw_op_type ) continue;
+                       const withdraw_operation withdraw_op = op.as<withdraw_operation>();
+                       my->_batch_reserved_balances[ withdraw_op.balance_id ] += withdraw_op.amount;
+                   }
+
+                   chunk_builders.push_back( builder );
+                   chunk_outputs.push_back( chunk_output_indexes );
+               }
+               catch( const fc::exception& e )
+               {
+                   for( const uint32_t index : chunk_output_indexes )
+                       results[ index ].error = e.to_string();
+               }
+           }
+       }
+       catch( ... )
+       {
+           my->_batch_reserved_balances.clear();
+           throw;
+       }
+       my->_batch_reserved_balances.clear();
+
+       vector<fc::future<void>> signing;
+       signing.reserve( chunk_builders.size() );
+       for( uint32_t i = 0; i < chunk_builders.size(); ++i )
+           signing.push_back( chunk_builders[ i ]->sign_on( *my->_scanner_threads[ i % my->_num_scanner_threads ] ) );
+
+       for( uint32_t i = 0; i < chunk_builders.size(); ++i )
+       {
+           try
+           {
+               signing[ i ].wait();
+               if( !chunk_builders[ i ]->is_signed() )
+                   FC_THROW_EXCEPTION( missing_signature, "Batch transfer transaction is missing signatures!" );
+
+               cache_transaction( chunk_builders[ i ]->transaction_record );
+               for( const uint32_t index : chunk_outputs[ i ] )
+                   results[ index ].transaction_id = chunk_builders[ i ]->transaction_record.trx.id();
+               builders.push_back( chunk_builders[ i ] );
+           }
+           catch( const fc::exception& e )
+           {
+               for( const uint32_t index : chunk_outputs[ i ] )
+                   results[ index ].error = e.to_string();
+           }
+       }
+
+       return results;
+   } FC_CAPTURE_AND_RETHROW( (from_account_name)(asset_symbol)(vote_method) ) }
+
 
    vector<std::pair<string, wallet_transaction_record>> wallet::publish_feeds_multi_experimental(
            map<string,double> amount_per_xts, // map symbol to amount per xts
@@ -2263,82 +2785,48 @@ namespace detail {
        my->scan_registered_accounts();
 
        ulog( "This may take a while..." );
-       uint32_t total_regenerated_key_count = 0;
+       const extended_private_key master_private_key = my->_wallet_db.get_master_private_key( my->_wallet_password );
 
        // Regenerate wallet child keys
-       ulog( "Regenerating wallet child keys and importing into account: ${name}", ("name",account_name) );
-       uint32_t key_index = 0;
-       for( ; key_index < num_keys_to_regenerate; ++key_index )
+       ulog( "Regenerating wallet child keys for account: ${name}", ("name",account_name) );
+       vector<derived_key> keys = my->derive_keys( num_keys_to_regenerate, [&]( uint32_t key_index )
        {
-           fc::oexception regenerate_key_error;
-           try
-           {
-               const private_key_type private_key = my->_wallet_db.get_wallet_child_key( my->_wallet_password, key_index );
-               import_private_key( private_key, account_name );
-               ++total_regenerated_key_count;
-           }
-           catch( const fc::exception& e )
-           {
-               regenerate_key_error = e;
-           }
-
-           if( regenerate_key_error.valid() )
-               ulog( "${e}", ("e",regenerate_key_error->to_detail_string()) );
-       }
-
-       // Update wallet last used child key index
-       my->_wallet_db.set_last_wallet_child_key_index( std::max( my->_wallet_db.get_last_wallet_child_key_index(), key_index - 1 ) );
+           return wallet_db::derive_wallet_child_key( master_private_key, key_index );
+       } );
 
        // Regenerate v1 account child keys
        ulog( "Regenerating type 1 account child keys for account: ${name}", ("name",account_name) );
-       uint32_t seq_num = 0;
-       for( ; seq_num < num_keys_to_regenerate; ++seq_num )
+       const address account_address = account_record->owner_address();
+       const vector<derived_key> v1_keys = my->derive_keys( num_keys_to_regenerate, [&]( uint32_t seq_num )
        {
-           fc::oexception regenerate_key_error;
-           try
-           {
-               const private_key_type private_key = my->_wallet_db.get_account_child_key_v1( my->_wallet_password,
-                                                                                             account_record->owner_address(), seq_num );
-               import_private_key( private_key, account_name );
-               ++total_regenerated_key_count;
-           }
-           catch( const fc::exception& e )
-           {
-               regenerate_key_error = e;
-           }
-
-           if( regenerate_key_error.valid() )
-               ulog( "${e}", ("e",regenerate_key_error->to_detail_string()) );
-       }
+           return wallet_db::derive_account_child_key_v1( master_private_key, account_address, seq_num );
+       } );
+       keys.insert( keys.end(), v1_keys.begin(), v1_keys.end() );
 
        // Regenerate v2 account child keys
        const owallet_key_record key_record = my->_wallet_db.lookup_key( address( account_record->active_key() ) );
        if( key_record.valid() && key_record->has_private_key() )
        {
            ulog( "Regenerating type 2 account child keys for account: ${name}", ("name",account_name) );
-           const private_key_type active_private_key = key_record->decrypt_private_key( my->_wallet_password );
-           seq_num = 0;
-           for( ; seq_num < num_keys_to_regenerate; ++seq_num )
+           const private_key_type active_private_key = my->get_private_key( *key_record );
+           const vector<derived_key> v2_keys = my->derive_keys( num_keys_to_regenerate, [&]( uint32_t seq_num )
            {
-               fc::oexception regenerate_key_error;
-               try
-               {
-                   const private_key_type private_key = my->_wallet_db.get_account_child_key( active_private_key, seq_num );
-                   import_private_key( private_key, account_name );
-                   ++total_regenerated_key_count;
-               }
-               catch( const fc::exception& e )
-               {
-                   regenerate_key_error = e;
-               }
-
-               if( regenerate_key_error.valid() )
-                   ulog( "${e}", ("e",regenerate_key_error->to_detail_string()) );
-           }
+               return wallet_db::derive_account_child_key( active_private_key, seq_num );
+           } );
+           keys.insert( keys.end(), v2_keys.begin(), v2_keys.end() );
        }
 
-       // Update account last used key sequence number
-       account_record->last_used_gen_sequence = std::max( account_record->last_used_gen_sequence, seq_num - 1 );
+       ulog( "Importing regenerated keys into account: ${name}", ("name",account_name) );
+       const uint32_t total_regenerated_key_count = my->import_derived_keys( account_name, keys );
+
+       // Update wallet last used child key index
+       my->_wallet_db.set_last_wallet_child_key_index( std::max( my->_wallet_db.get_last_wallet_child_key_index(),
+                                                                 num_keys_to_regenerate - 1 ) );
+
+       // Update account last used key sequence number; importing may have changed the record
+       account_record = my->_wallet_db.lookup_account( account_name );
+       FC_ASSERT( account_record.valid() );
+       account_record->last_used_gen_sequence = std::max( account_record->last_used_gen_sequence, num_keys_to_regenerate - 1 );
        my->_wallet_db.store_account( *account_record );
 
        ulog( "Successfully generated ${n} keys.", ("n",total_regenerated_key_count) );
@@ -2359,21 +2847,34 @@ namespace detail {
      int attempts = 0;
      int recoveries = 0;
 
+     const extended_private_key master_private_key = my->_wallet_db.get_master_private_key( my->_wallet_password );
      uint32_t key_index = my->_wallet_db.get_last_wallet_child_key_index() + 1;
-     while( recoveries < number_of_accounts && attempts++ < max_number_of_attempts )
+     while( recoveries < number_of_accounts && attempts < max_number_of_attempts )
      {
-        const private_key_type new_priv_key = my->_wallet_db.get_wallet_child_key( my->_wallet_password, key_index );
-        fc::ecc::public_key new_pub_key = new_priv_key.get_public_key();
-        auto recovered_account = my->_blockchain->get_account_record(new_pub_key);
+        // Derive a batch on the worker threads, then check each key against the chain in order
+        const uint32_t batch_size = std::min<int32_t>( BTS_WALLET_KEY_RECOVERY_BATCH_SIZE, max_number_of_attempts - attempts );
+        const uint32_t first_key_index = key_index;
+        const vector<derived_key> keys = my->derive_keys( batch_size, [&]( uint32_t offset )
+        {
+            return wallet_db::derive_wallet_child_key( master_private_key, first_key_index + offset );
+        } );
 
-        if( recovered_account.valid() )
+        for( const derived_key& key : keys )
         {
-          my->_wallet_db.set_last_wallet_child_key_index( key_index );
-          import_private_key(new_priv_key, recovered_account->name, true);
-          ++recoveries;
+           if( recoveries >= number_of_accounts )
+               break;
+
+           auto recovered_account = my->_blockchain->get_account_record( address( key.public_key ) );
+           if( recovered_account.valid() )
+           {
+             my->_wallet_db.set_last_wallet_child_key_index( first_key_index + key.index );
+             import_private_key(key.private_key, recovered_account->name, true);
+             ++recoveries;
+           }
         }
 
-        ++key_index;
+        attempts += batch_size;
+        key_index += batch_size;
      }
 
      if( recoveries )
@@ -2427,7 +2928,7 @@ namespace detail {
        /* We had to have stored the one-time key */
        const auto key_record = my->_wallet_db.lookup_key( withdraw_condition.memo->one_time_key );
        FC_ASSERT( key_record.valid() && key_record->has_private_key() );
-       const auto private_key = key_record->decrypt_private_key( my->_wallet_password );
+       const auto private_key = my->get_private_key( *key_record );
 
        /* Get shared secret and check memo decryption */
        bool found_recipient = false;
@@ -2516,7 +3017,7 @@ namespace detail {
        FC_ASSERT( withdraw_condition.memo.valid() );
 
        omemo_status status;
-       const map<private_key_type, string> account_keys = my->_wallet_db.get_account_private_keys( my->_wallet_password );
+       const map<private_key_type, string> account_keys = my->get_account_private_keys();
        for( const auto& key_item : account_keys )
        {
            const private_key_type& key = key_item.first;
@@ -2585,7 +3086,7 @@ namespace detail {
 
        owallet_key_record delegate_key = my->_wallet_db.lookup_key( delegate_account_record->active_key() );
        FC_ASSERT( delegate_key && delegate_key->has_private_key() );
-       const auto delegate_private_key = delegate_key->decrypt_private_key( my->_wallet_password );
+       const auto delegate_private_key = my->get_private_key( *delegate_key );
        required_signatures.insert( delegate_private_key.get_public_key() );
 
        const auto delegate_public_key = delegate_private_key.get_public_key();
@@ -3227,7 +3728,7 @@ namespace detail {
       FC_ASSERT( issuer.valid() );
       owallet_key_record  issuer_key = my->_wallet_db.lookup_key( issuer->owner_address() );
       FC_ASSERT( issuer_key && issuer_key->has_private_key() );
-      auto sender_private_key = issuer_key->decrypt_private_key( my->_wallet_password );
+      auto sender_private_key = my->get_private_key( *issuer_key );
 
       trx.deposit_to_account( receiver_public_key,
                               shares_to_issue,
@@ -3728,6 +4229,25 @@ namespace detail {
        return my->_wallet_db.get_property( transaction_expiration_sec ).as<uint32_t>();
    } FC_CAPTURE_AND_RETHROW() }
 
+   void wallet::set_coin_selection_strategy( const coin_selection_strategy_enum strategy )
+   { try {
+       FC_ASSERT( is_open() );
+       my->_wallet_db.set_property( coin_selection_strategy, fc::variant( strategy ) );
+   } FC_CAPTURE_AND_RETHROW( (strategy) ) }
+
+   coin_selection_strategy_enum wallet::get_coin_selection_strategy()const
+   { try {
+       FC_ASSERT( is_open() );
+       try
+       {
+           return my->_wallet_db.get_property( coin_selection_strategy ).as<coin_selection_strategy_enum>();
+       }
+       catch( ... )
+       {
+       }
+       return largest_first_selection;
+   } FC_CAPTURE_AND_RETHROW() }
+
    float wallet::get_scan_progress()const
    { try {
        FC_ASSERT( is_open() );
@@ -3908,7 +4428,7 @@ namespace detail {
                 ("name",account_name) );
 
       FC_ASSERT( opt_key->has_private_key() );
-      return opt_key->decrypt_private_key( my->_wallet_password );
+      return my->get_private_key( *opt_key );
    } FC_CAPTURE_AND_RETHROW( (account_name) ) }
 
    public_key_type wallet::get_active_public_key( const string& account_name )const
@@ -4005,7 +4525,6 @@ namespace detail {
       FC_ASSERT( is_open() );
       if( !account_name.empty() ) get_account( account_name ); /* Just to check input */
 
-      map<string, vector<balance_record>> balance_records;
       const auto pending_state = my->_blockchain->get_pending_state();
 
       const auto scan_balance = [&]( const balance_record& record )
@@ -4100,7 +4619,13 @@ namespace detail {
           }
       };
 
-      my->_blockchain->scan_balances( scan_balance, false );
+      my->refresh_balance_index();
+      for( const balance_id_type& balance_id : my->_escrow_balance_ids )
+      {
+          const obalance_record record = pending_state->get_balance_record( balance_id );
+          if( !record.valid() || record->balance == 0 ) continue;
+          scan_balance( *record );
+      }
 
       return result;
    }
@@ -4142,15 +4667,17 @@ namespace detail {
           const auto name = account_record.valid() ? account_record->name : string( key_record->public_key );
           if( !account_name.empty() && name != account_name ) return;
 
-          const auto balance_id = record.id();
-          const auto pending_record = pending_state->get_balance_record( balance_id );
-          if( !pending_record.valid() ) return;
-          if( !include_empty && pending_record->get_spendable_balance( pending_state->now() ).amount == 0 ) return;
+          if( !include_empty && record.get_spendable_balance( pending_state->now() ).amount == 0 ) return;
 
-          balance_records[ name ].push_back( *pending_record );
+          balance_records[ name ].push_back( record );
       };
 
-      my->_blockchain->scan_balances( scan_balance, include_empty );
+      my->refresh_balance_index();
+      for( const balance_id_type& balance_id : my->_owned_balance_ids )
+      {
+          const obalance_record record = pending_state->get_balance_record( balance_id );
+          if( record.valid() ) scan_balance( *record );
+      }
 
       return balance_records;
    } FC_CAPTURE_AND_RETHROW( (account_name)(include_empty)(withdraw_type_mask) ) }
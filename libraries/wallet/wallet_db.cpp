@@ -11,62 +11,396 @@ namespace bts { namespace wallet {
    using namespace bts::blockchain;
 
    namespace detail {
+     typedef bts::db::level_map<int32_t,packed_wallet_record> record_table;
+
      class wallet_db_impl
      {
         public:
            wallet_db*                                        self = nullptr;
-           bts::db::level_map<int32_t,generic_wallet_record> _records;
 
-           void store_and_reload_generic_record( const generic_wallet_record& record )
-           { try {
-               auto index = record.get_wallet_record_index();
-               FC_ASSERT( index != 0 );
-               FC_ASSERT( _records.is_open() );
+           // One table per record type, keyed by wallet record index
+           record_table                                      _master_key_table;
+           record_table                                      _account_table;
+           record_table                                      _key_table;
+           record_table                                      _transaction_table;
+           record_table                                      _property_table;
+           record_table                                      _setting_table;
+
+           // Transaction records are only read on demand, so these map ids to record indexes
+           bts::db::level_map<transaction_id_type,int32_t>   _transaction_id_index;
+           bts::db::level_map<transaction_id_type,int32_t>   _pending_transaction_index;
+
+           // History in display order per account owner address, with address() holding every transaction
+           bts::db::level_map<pair<address,transaction_history_key>,int32_t>         _account_history_index;
+           bts::db::level_map<pair<asset_id_type,transaction_history_key>,int32_t>   _asset_history_index;
+
 #ifndef BTS_TEST_NETWORK
-               _records.store( index, record, true ); // Sync
+           static const bool                                 _durable_writes = true;
 #else
-               _records.store( index, record );
+           static const bool                                 _durable_writes = false;
 #endif
-               load_generic_record( record );
+           bool                                              _sync_writes = _durable_writes;
+
+           /** present while the indexes may disagree with the transaction table; open() rebuilds them if so */
+           fc::path                                          _index_rebuild_marker;
+           bool                                              _indexes_dirty = false;
+
+           /** for migrations and rebuilds: skip syncing each write and sync every table once at the end */
+           struct bulk_write_scope
+           {
+               wallet_db_impl& _impl;
+               bulk_write_scope( wallet_db_impl& impl ):_impl( impl ) { _impl._sync_writes = false; }
+               ~bulk_write_scope() { _impl._sync_writes = _durable_writes; }
+           };
+
+           record_table& get_table( wallet_record_type_enum type )
+           {
+               switch( type )
+               {
+                   case master_key_record_type:  return _master_key_table;
+                   case account_record_type:     return _account_table;
+                   case key_record_type:         return _key_table;
+                   case transaction_record_type: return _transaction_table;
+                   case property_record_type:    return _property_table;
+                   case setting_record_type:     return _setting_table;
+                   default:
+                       FC_THROW_EXCEPTION( fc::invalid_arg_exception, "Unknown wallet record type: ${type}", ("type",type) );
+               }
+           }
+
+           void open_tables( const fc::path& wallet_file )
+           { try {
+               _master_key_table.open( wallet_file / "master_key" );
+               _account_table.open( wallet_file / "accounts" );
+               _key_table.open( wallet_file / "keys" );
+               _transaction_table.open( wallet_file / "transactions" );
+               _property_table.open( wallet_file / "properties" );
+               _setting_table.open( wallet_file / "settings" );
+
+               _transaction_id_index.open( wallet_file / "index/transaction_id" );
+               _pending_transaction_index.open( wallet_file / "index/pending_transactions" );
+               _account_history_index.open( wallet_file / "index/account_history" );
+               _asset_history_index.open( wallet_file / "index/asset_history" );
+               _index_rebuild_marker = wallet_file / "index/transaction_indexes.rebuild";
+           } FC_CAPTURE_AND_RETHROW( (wallet_file) ) }
+
+           // A synced write makes leveldb sync its log, covering every write made before it
+           template<typename Key, typename Value>
+           void sync_table( bts::db::level_map<Key,Value>& table )
+           {
+               auto itr = table.begin();
+               if( itr.valid() )
+                   table.store( itr.key(), itr.value(), _durable_writes );
+           }
+
+           void sync_tables()
+           {
+               sync_table( _master_key_table );
+               sync_table( _account_table );
+               sync_table( _key_table );
+               sync_table( _transaction_table );
+               sync_table( _property_table );
+               sync_table( _setting_table );
+
+               sync_table( _transaction_id_index );
+               sync_table( _pending_transaction_index );
+               sync_table( _account_history_index );
+               sync_table( _asset_history_index );
+           }
+
+           /**
+            *  The indexes are separate databases from the transaction table, so a crash between writing a
+            *  transaction and indexing it would leave them stale.  The marker is written before the first index
+            *  change and only removed once the indexes have been synced.
+            */
+           void mark_indexes_dirty()
+           {
+               if( _indexes_dirty ) return;
+               std::ofstream( _index_rebuild_marker.generic_string().c_str() ).flush();
+               FC_ASSERT( fc::exists( _index_rebuild_marker ), "Unable to write ${marker}", ("marker",_index_rebuild_marker) );
+               _indexes_dirty = true;
+           }
+
+           void mark_indexes_clean()
+           {
+               if( !_indexes_dirty ) return;
+               sync_tables();
+               fc::remove( _index_rebuild_marker );
+               _indexes_dirty = false;
+           }
+
+           template<typename Key, typename Value>
+           void clear_table( bts::db::level_map<Key,Value>& table )
+           {
+               auto batch = table.create_batch();
+               for( auto itr = table.begin(); itr.valid(); ++itr )
+                   batch.remove( itr.key() );
+               batch.commit();
+           }
+
+           void clear_transaction_indexes()
+           {
+               mark_indexes_dirty();
+               clear_table( _transaction_id_index );
+               clear_table( _pending_transaction_index );
+               clear_table( _account_history_index );
+               clear_table( _asset_history_index );
+           }
+
+           void clear_tables()
+           {
+               clear_table( _master_key_table );
+               clear_table( _account_table );
+               clear_table( _key_table );
+               clear_table( _transaction_table );
+               clear_table( _property_table );
+               clear_table( _setting_table );
+               clear_transaction_indexes();
+           }
+
+           uint32_t count_records()const
+           {
+               uint32_t count = 0;
+               for( const record_table* table : { &_master_key_table, &_account_table, &_key_table,
+                                                  &_transaction_table, &_property_table, &_setting_table } )
+               {
+                   for( auto itr = table->begin(); itr.valid(); ++itr )
+                       ++count;
+               }
+               return count;
+           }
+
+           void close_tables()
+           {
+               _master_key_table.close();
+               _account_table.close();
+               _key_table.close();
+               _transaction_table.close();
+               _property_table.close();
+               _setting_table.close();
+
+               _transaction_id_index.close();
+               _pending_transaction_index.close();
+               _account_history_index.close();
+               _asset_history_index.close();
+           }
+
+           /**
+            *  Wallets written before the typed tables kept every record as an fc::variant in a single
+            *  database at the root of the wallet directory.  Copy those records into the tables, and only
+            *  remove the old database once every record is committed and the tables hold as many records
+            *  as it did.  If any record can't be converted the tables are emptied again and the wallet is
+            *  left in the old format; an interrupted migration is simply redone the next time the wallet
+            *  is opened.  The transaction indexes are rebuilt from the tables once the keys and accounts
+            *  they depend on are loaded.
+            */
+           void migrate_generic_records( const fc::path& wallet_file )
+           { try {
+               ulog( "Migrating wallet records to the typed format..." );
+
+               uint32_t count = 0;
+               try
+               {
+                   // Drop anything left by an interrupted migration
+                   clear_tables();
+
+                   bts::db::level_map<int32_t,generic_wallet_record> generic_records;
+                   generic_records.open( wallet_file, false );
+
+                   bulk_write_scope bulk_writes( *this );
+                   for( auto itr = generic_records.begin(); itr.valid(); ++itr )
+                   {
+                       try
+                       {
+                           migrate_generic_record( itr.value() );
+                       }
+                       FC_CAPTURE_AND_RETHROW( (itr.key()) )
+
+                       if( ++count % 1000 == 0 )
+                           std::cout << "\rMigrated " << std::to_string( count ) << " wallet records" << std::flush;
+                   }
+                   generic_records.close();
+                   sync_tables();
+
+                   const uint32_t migrated_count = count_records();
+                   FC_ASSERT( migrated_count == count, "Only ${migrated} of ${count} wallet records were migrated!",
+                              ("migrated",migrated_count)("count",count) );
+               }
+               catch( ... )
+               {
+                   clear_tables();
+                   ulog( "Wallet migration failed, the wallet was left in its old format." );
+                   throw;
+               }
+
+               // Remove CURRENT first so a crash part way through can't leave a database that looks intact
+               fc::remove( wallet_file / "CURRENT" );
+               vector<fc::path> generic_record_files;
+               fc::directory_iterator end_itr;
+               for( fc::directory_iterator itr( wallet_file ); itr != end_itr; ++itr )
+               {
+                   if( !fc::is_directory( *itr ) )
+                       generic_record_files.push_back( *itr );
+               }
+               for( const fc::path& file : generic_record_files )
+                   fc::remove( file );
+
+               ulog( "Migrated ${count} wallet records.", ("count",count) );
+           } FC_CAPTURE_AND_RETHROW( (wallet_file) ) }
+
+           void migrate_generic_record( const generic_wallet_record& record )
+           { try {
+               switch( wallet_record_type_enum( record.type ) )
+               {
+                   case master_key_record_type:
+                       migrate_typed_record<wallet_master_key_record>( record );
+                       break;
+                   case account_record_type:
+                       migrate_typed_record<wallet_account_record>( record );
+                       break;
+                   case key_record_type:
+                       migrate_typed_record<wallet_key_record>( record );
+                       break;
+                   case transaction_record_type:
+                       migrate_typed_record<wallet_transaction_record>( record );
+                       break;
+                   case property_record_type:
+                       migrate_typed_record<wallet_property_record>( record );
+                       break;
+                   case setting_record_type:
+                       migrate_typed_record<wallet_setting_record>( record );
+                       break;
+                   default:
+                       FC_THROW_EXCEPTION( fc::invalid_arg_exception, "Unknown wallet record type: ${type}", ("type",record.type) );
+                }
            } FC_CAPTURE_AND_RETHROW( (record) ) }
 
-           void load_generic_record( const generic_wallet_record& record )
+           // Only the table is written; the indexes are rebuilt after the migration
+           template<typename RecordType>
+           void migrate_typed_record( const generic_wallet_record& record )
+           {
+               const RecordType typed_record = record.as<RecordType>();
+               const int32_t index = typed_record.wallet_record_index;
+               FC_ASSERT( index != 0 );
+               get_table( wallet_record_type_enum( RecordType::type ) ).store( index, packed_wallet_record( typed_record ), _sync_writes );
+           }
+
+           void store_generic_record( const generic_wallet_record& record, bool reload )
            { try {
                switch( wallet_record_type_enum( record.type ) )
                {
                    case master_key_record_type:
-                       load_master_key_record( record.as<wallet_master_key_record>() );
+                       store_typed_record<wallet_master_key_record>( record, reload );
                        break;
                    case account_record_type:
-                       load_account_record( record.as<wallet_account_record>() );
+                       store_typed_record<wallet_account_record>( record, reload );
                        break;
                    case key_record_type:
-                       load_key_record( record.as<wallet_key_record>() );
+                       store_typed_record<wallet_key_record>( record, reload );
                        break;
                    case transaction_record_type:
-                       load_transaction_record( record.as<wallet_transaction_record>() );
+                       store_typed_record<wallet_transaction_record>( record, reload );
                        break;
                    case property_record_type:
-                       load_property_record( record.as<wallet_property_record>() );
+                       store_typed_record<wallet_property_record>( record, reload );
                        break;
                    case setting_record_type:
-                       load_setting_record( record.as<wallet_setting_record>() );
+                       store_typed_record<wallet_setting_record>( record, reload );
                        break;
                    default:
                        elog( "Unknown wallet record type: ${type}", ("type",record.type) );
                        break;
                 }
+           } FC_CAPTURE_AND_RETHROW( (record)(reload) ) }
+
+           template<typename RecordType>
+           void store_typed_record( const generic_wallet_record& record, bool reload )
+           {
+               const RecordType typed_record = record.as<RecordType>();
+               if( reload )
+                   store_and_reload_record( typed_record );
+               else
+                   store_record( typed_record );
+           }
+
+           generic_wallet_record to_generic_record( const packed_wallet_record& record )const
+           { try {
+               switch( wallet_record_type_enum( record.type ) )
+               {
+                   case master_key_record_type:
+                       return generic_wallet_record( record.as<wallet_master_key_record>() );
+                   case account_record_type:
+                       return generic_wallet_record( record.as<wallet_account_record>() );
+                   case key_record_type:
+                       return generic_wallet_record( record.as<wallet_key_record>() );
+                   case transaction_record_type:
+                       return generic_wallet_record( record.as<wallet_transaction_record>() );
+                   case property_record_type:
+                       return generic_wallet_record( record.as<wallet_property_record>() );
+                   case setting_record_type:
+                       return generic_wallet_record( record.as<wallet_setting_record>() );
+                   default:
+                       FC_THROW_EXCEPTION( fc::invalid_arg_exception, "Unknown wallet record type: ${type}", ("type",record.type) );
+                }
+           } FC_CAPTURE_AND_RETHROW( (record.type) ) }
+
+           template<typename RecordType>
+           void store_record( const RecordType& record )
+           { try {
+               const int32_t index = record.wallet_record_index;
+               FC_ASSERT( index != 0 );
+               record_table& table = get_table( wallet_record_type_enum( RecordType::type ) );
+               FC_ASSERT( table.is_open() );
+               unindex_previous_record( record );
+               table.store( index, packed_wallet_record( record ), _sync_writes );
+               index_record( record );
            } FC_CAPTURE_AND_RETHROW( (record) ) }
 
-           void load_master_key_record( const wallet_master_key_record& key )
+           template<typename RecordType>
+           void store_and_reload_record( const RecordType& record )
+           { try {
+               const map<address, address> previous_history_accounts = get_history_accounts( record );
+               store_record( record );
+               load_record( record );
+               reindex_changed_history_accounts( previous_history_accounts );
+           } FC_CAPTURE_AND_RETHROW( (record) ) }
+
+           template<typename RecordType>
+           void load_table( record_table& table )
+           {
+               uint32_t count = 0;
+               for( auto itr = table.begin(); itr.valid(); ++itr )
+               {
+                   try
+                   {
+                       load_record( itr.value().template as<RecordType>() );
+                       // prevent hanging on large wallets
+                       if( ++count % 100 == 0 )
+                           fc::usleep( fc::microseconds(1000) );
+                   }
+                   catch( const fc::canceled_exception& )
+                   {
+                       throw;
+                   }
+                   catch( const fc::exception& e )
+                   {
+                       wlog( "Error loading wallet record ${index}:\nreason: ${e}", ("e",e.to_detail_string())("index",itr.key()) );
+                   }
+               }
+           }
+
+           void load_record( const wallet_master_key_record& key )
            { try {
               self->wallet_master_key = key;
            } FC_CAPTURE_AND_RETHROW() }
 
-           void load_account_record( const wallet_account_record& account_record )
+           void load_record( const wallet_account_record& account_record )
            { try {
                const int32_t& record_index = account_record.wallet_record_index;
                self->accounts[ record_index ] = account_record;
+               ++self->key_revision;
+               // Running balances are tallied by account name, which may have just changed
+               self->running_balance_checkpoints.clear();
 
                // Cache address map
                self->address_to_account_wallet_record_index[ address( account_record.owner_key ) ] = record_index;
@@ -94,11 +428,13 @@ namespace bts { namespace wallet {
                    self->account_id_to_wallet_record_index[ account_record.id ] = record_index;
            } FC_CAPTURE_AND_RETHROW( (account_record) ) }
 
-           void load_key_record( const wallet_key_record& key_record )
+           void load_record( const wallet_key_record& key_record )
            { try {
                const address key_address = key_record.get_address();
 
                self->keys[ key_address ] = key_record;
+               ++self->key_revision;
+               self->running_balance_checkpoints.clear();
 
                // Cache address map
                self->btc_to_bts_address[ key_address ] = key_address;
@@ -108,27 +444,297 @@ namespace bts { namespace wallet {
                self->btc_to_bts_address[ address( pts_address( key_record.public_key, true,  56 ) ) ] = key_address; // Compressed PTS
            } FC_CAPTURE_AND_RETHROW( (key_record) ) }
 
-           void load_transaction_record( const wallet_transaction_record& transaction_record )
+           // Transaction records stay on disk; storing one already indexed them
+           void load_record( const wallet_transaction_record& )
+           {
+           }
+
+           void load_record( const wallet_property_record& property_rec )
+           { try {
+              self->properties[property_rec.key] = property_rec;
+           } FC_CAPTURE_AND_RETHROW( (property_rec) ) }
+
+           void load_record( const wallet_setting_record& rec )
+           { try {
+              self->settings[rec.name] = rec;
+           } FC_CAPTURE_AND_RETHROW( (rec) ) }
+
+           template<typename RecordType>
+           void index_record( const RecordType& )
+           {
+           }
+
+           template<typename RecordType>
+           void unindex_previous_record( const RecordType& )
+           {
+           }
+
+           // The history keys of a transaction change as it confirms, so drop those of the version being replaced
+           void unindex_previous_record( const wallet_transaction_record& transaction_record )
+           { try {
+               mark_indexes_dirty();
+               const owallet_transaction_record previous_record = fetch_transaction_record( transaction_record.wallet_record_index );
+               if( previous_record.valid() )
+                   unindex_transaction_history( *previous_record );
+           } FC_CAPTURE_AND_RETHROW( (transaction_record) ) }
+
+           void index_record( const wallet_transaction_record& transaction_record )
            { try {
+               mark_indexes_dirty();
                const transaction_id_type& record_id = transaction_record.record_id;
-               self->transactions[ record_id ] = transaction_record;
+               const int32_t& record_index = transaction_record.wallet_record_index;
 
-               // Cache id map
-               self->id_to_transaction_record_index[ record_id ] = record_id;
+               _transaction_id_index.store( record_id, record_index, _sync_writes );
                const transaction_id_type transaction_id = transaction_record.trx.id();
                if( transaction_id != signed_transaction().id() )
-                   self->id_to_transaction_record_index[ transaction_id ] = record_id;
+                   _transaction_id_index.store( transaction_id, record_index, _sync_writes );
+
+               if( !transaction_record.is_virtual && !transaction_record.is_confirmed )
+                   _pending_transaction_index.store( record_id, record_index, _sync_writes );
+               else
+                   _pending_transaction_index.remove( record_id, _sync_writes );
+
+               index_transaction_history( transaction_record );
+           } FC_CAPTURE_AND_RETHROW( (transaction_record) ) }
+
+           /** the account a ledger entry address belongs to, identified by owner address, if the wallet knows it */
+           address get_history_account( const address& entry_address )const
+           {
+               const auto address_map_iter = self->btc_to_bts_address.find( entry_address );
+               if( address_map_iter == self->btc_to_bts_address.end() ) return entry_address;
+               const auto key_iter = self->keys.find( address_map_iter->second );
+               if( key_iter == self->keys.end() ) return entry_address;
+
+               const address& account_address = key_iter->second.account_address;
+               const auto account_map_iter = self->address_to_account_wallet_record_index.find( account_address );
+               if( account_map_iter == self->address_to_account_wallet_record_index.end() ) return account_address;
+               const auto account_iter = self->accounts.find( account_map_iter->second );
+               if( account_iter == self->accounts.end() ) return account_address;
+               return account_iter->second.owner_address();
+           }
+
+           /**
+            *  Ledger entry addresses are resolved to accounts when a transaction is indexed, so storing a key or
+            *  account can leave history filed under a stale prefix.  These collect how the addresses a record
+            *  affects resolve before it is stored, then refile the history of every prefix that stopped applying.
+            */
+           template<typename RecordType>
+           map<address, address> get_history_accounts( const RecordType& )const
+           {
+               return map<address, address>();
+           }
+
+           map<address, address> get_history_accounts( const wallet_key_record& key_record )const
+           {
+               map<address, address> history_accounts;
+               const address key_address = key_record.get_address();
+               history_accounts[ key_address ] = get_history_account( key_address );
+               return history_accounts;
+           }
+
+           map<address, address> get_history_accounts( const wallet_account_record& account_record )const
+           {
+               map<address, address> history_accounts;
+               const auto add_keys = [&]( const wallet_account_record& record )
+               {
+                   vector<public_key_type> account_keys{ record.owner_key };
+                   for( const auto& item : record.active_key_history )
+                       account_keys.push_back( item.second );
+                   if( record.is_delegate() )
+                   {
+                       for( const auto& item : record.delegate_info->signing_key_history )
+                           account_keys.push_back( item.second );
+                   }
+                   for( const public_key_type& key : account_keys )
+                   {
+                       if( key == public_key_type() ) continue;
+                       const address key_address( key );
+                       history_accounts[ key_address ] = get_history_account( key_address );
+                   }
+               };
+
+               add_keys( account_record );
+               // The version being replaced may cover keys this one no longer has
+               const auto account_iter = self->accounts.find( account_record.wallet_record_index );
+               if( account_iter != self->accounts.end() )
+                   add_keys( account_iter->second );
+               return history_accounts;
+           }
+
+           void reindex_changed_history_accounts( const map<address, address>& previous_history_accounts )
+           { try {
+               set<address> stale_prefixes;
+               for( const auto& item : previous_history_accounts )
+               {
+                   if( get_history_account( item.first ) != item.second )
+                       stale_prefixes.insert( item.second );
+               }
+               for( const address& prefix : stale_prefixes )
+                   reindex_account_history( prefix );
+           } FC_CAPTURE_AND_RETHROW() }
+
+           /** drops every history entry filed under prefix and indexes those transactions again */
+           void reindex_account_history( const address& prefix )
+           { try {
+               if( prefix == address() ) return;
+               mark_indexes_dirty();
+
+               vector<pair<transaction_history_key, int32_t>> entries;
+               for( auto itr = _account_history_index.lower_bound( std::make_pair( prefix, transaction_history_key() ) );
+                    itr.valid() && itr.key().first == prefix; ++itr )
+               {
+                   entries.emplace_back( itr.key().second, itr.value() );
+               }
+
+               for( const auto& entry : entries )
+               {
+                   _account_history_index.remove( std::make_pair( prefix, entry.first ), _sync_writes );
+                   const owallet_transaction_record transaction_record = fetch_transaction_record( entry.second );
+                   if( transaction_record.valid() )
+                       index_transaction_history( *transaction_record );
+               }
+           } FC_CAPTURE_AND_RETHROW( (prefix) ) }
+
+           void get_history_prefixes( const wallet_transaction_record& transaction_record,
+                                      set<address>& accounts, set<asset_id_type>& assets )const
+           {
+               accounts.insert( address() );
+               for( const auto& entry : transaction_record.ledger_entries )
+               {
+                   if( entry.from_account.valid() ) accounts.insert( get_history_account( *entry.from_account ) );
+                   if( entry.to_account.valid() ) accounts.insert( get_history_account( *entry.to_account ) );
+                   if( entry.amount.amount > 0 ) assets.insert( entry.amount.asset_id );
+               }
+               if( transaction_record.fee.amount > 0 ) assets.insert( transaction_record.fee.asset_id );
+           }
+
+           void index_transaction_history( const wallet_transaction_record& transaction_record )
+           { try {
+               if( transaction_record.ledger_entries.empty() ) return;
+
+               const transaction_history_key key = wallet_db::get_history_key( transaction_record );
+               const int32_t& record_index = transaction_record.wallet_record_index;
+               set<address> accounts;
+               set<asset_id_type> assets;
+               get_history_prefixes( transaction_record, accounts, assets );
+               for( const address& account_address : accounts )
+                   _account_history_index.store( std::make_pair( account_address, key ), record_index, _sync_writes );
+               for( const asset_id_type asset_id : assets )
+                   _asset_history_index.store( std::make_pair( asset_id, key ), record_index, _sync_writes );
+
+               invalidate_running_balance_checkpoints( key );
            } FC_CAPTURE_AND_RETHROW( (transaction_record) ) }
 
-           void load_property_record( const wallet_property_record& property_rec )
+           void unindex_transaction_history( const wallet_transaction_record& transaction_record )
            { try {
-              self->properties[property_rec.key] = property_rec;
-           } FC_CAPTURE_AND_RETHROW( (property_rec) ) }
+               const transaction_history_key key = wallet_db::get_history_key( transaction_record );
+               set<address> accounts;
+               set<asset_id_type> assets;
+               get_history_prefixes( transaction_record, accounts, assets );
+               for( const address& account_address : accounts )
+                   _account_history_index.remove( std::make_pair( account_address, key ), _sync_writes );
+               for( const asset_id_type asset_id : assets )
+                   _asset_history_index.remove( std::make_pair( asset_id, key ), _sync_writes );
+
+               invalidate_running_balance_checkpoints( key );
+           } FC_CAPTURE_AND_RETHROW( (transaction_record) ) }
 
-           void load_setting_record( const wallet_setting_record& rec )
+           /**
+            *  Account resolution depends on the keys and accounts loaded at the time a transaction is indexed, so
+            *  every transaction index is rebuilt from the transaction table after a migration or repair rather
+            *  than trusted.
+            */
+           void rebuild_transaction_indexes()
            { try {
-              self->settings[rec.name] = rec;
-           } FC_CAPTURE_AND_RETHROW( (rec) ) }
+               bulk_write_scope bulk_writes( *this );
+               clear_transaction_indexes();
+
+               for( auto itr = _transaction_table.begin(); itr.valid(); ++itr )
+               {
+                   try
+                   {
+                       index_record( itr.value().as<wallet_transaction_record>() );
+                   }
+                   catch( const fc::exception& e )
+                   {
+                       wlog( "Error indexing wallet record ${index}:\nreason: ${e}", ("e",e.to_detail_string())("index",itr.key()) );
+                   }
+               }
+               mark_indexes_clean();
+               self->running_balance_checkpoints.clear();
+           } FC_CAPTURE_AND_RETHROW() }
+
+           void invalidate_running_balance_checkpoints( const transaction_history_key& key )
+           {
+               for( auto& item : self->running_balance_checkpoints )
+               {
+                   auto& checkpoints = item.second;
+                   checkpoints.erase( checkpoints.lower_bound( key ), checkpoints.end() );
+               }
+           }
+
+           template<typename Prefix>
+           void scan_history_index( const bts::db::level_map<pair<Prefix,transaction_history_key>,int32_t>& index,
+                                    const Prefix& prefix, const optional<transaction_history_key>& start, bool reverse,
+                                    const transaction_history_visitor& visitor )
+           { try {
+               typename bts::db::level_map<pair<Prefix,transaction_history_key>,int32_t>::iterator itr;
+               if( !reverse )
+               {
+                   itr = index.lower_bound( std::make_pair( prefix, start.valid() ? *start : transaction_history_key() ) );
+                   if( start.valid() && itr.valid() && itr.key() == std::make_pair( prefix, *start ) )
+                       ++itr;
+               }
+               else
+               {
+                   transaction_history_key end_key;
+                   if( start.valid() )
+                   {
+                       end_key = *start;
+                   }
+                   else
+                   {
+                       end_key.block_num = uint32_t( -1 );
+                       end_key.timestamp = fc::time_point_sec::maximum();
+                       memset( end_key.record_id._hash, 0xff, sizeof( end_key.record_id._hash ) );
+                   }
+                   itr = index.lower_bound( std::make_pair( prefix, end_key ) );
+                   if( itr.valid() ) --itr;
+                   else itr = index.last();
+               }
+
+               for( ; itr.valid(); reverse ? --itr : ++itr )
+               {
+                   const pair<Prefix,transaction_history_key> key = itr.key();
+                   if( key.first != prefix ) break;
+                   const owallet_transaction_record transaction_record = fetch_transaction_record( itr.value() );
+                   if( !transaction_record.valid() ) continue;
+                   if( !visitor( key.second, *transaction_record ) ) break;
+               }
+           } FC_CAPTURE_AND_RETHROW( (prefix)(start)(reverse) ) }
+
+           void unindex_transaction_record( const wallet_transaction_record& transaction_record )
+           { try {
+               mark_indexes_dirty();
+               _transaction_id_index.remove( transaction_record.record_id, _sync_writes );
+               const transaction_id_type transaction_id = transaction_record.trx.id();
+               if( transaction_id != signed_transaction().id() )
+               {
+                   // Only drop the transaction id if it still points at this record
+                   const optional<int32_t> record_index = _transaction_id_index.fetch_optional( transaction_id );
+                   if( record_index.valid() && *record_index == transaction_record.wallet_record_index )
+                       _transaction_id_index.remove( transaction_id, _sync_writes );
+               }
+               _pending_transaction_index.remove( transaction_record.record_id, _sync_writes );
+               unindex_transaction_history( transaction_record );
+           } FC_CAPTURE_AND_RETHROW( (transaction_record) ) }
+
+           owallet_transaction_record fetch_transaction_record( int32_t record_index )
+           { try {
+               const optional<packed_wallet_record> record = _transaction_table.fetch_optional( record_index );
+               if( !record.valid() ) return owallet_transaction_record();
+               return record->as<wallet_transaction_record>();
+           } FC_CAPTURE_AND_RETHROW( (record_index) ) }
      };
 
    } // namespace detail
@@ -143,32 +749,40 @@ namespace bts { namespace wallet {
    {
    }
 
+   template<typename T>
+   void wallet_db::store_and_reload_record( T& record_to_store )
+   {
+      if( record_to_store.wallet_record_index == 0 )
+         record_to_store.wallet_record_index = new_wallet_record_index();
+      my->store_and_reload_record( record_to_store );
+   }
+
    void wallet_db::open( const fc::path& wallet_file )
    { try {
       try
       {
-          my->_records.open( wallet_file, true );
-          for( auto itr = my->_records.begin(); itr.valid(); ++itr )
-          {
-             auto record = itr.value();
-             try
-             {
-                my->load_generic_record( record );
-                // prevent hanging on large wallets
-                fc::usleep( fc::microseconds(1000) );
-             }
-             catch (const fc::canceled_exception&)
-             {
-                throw;
-             }
-             catch ( const fc::exception& e )
-             {
-                wlog( "Error loading wallet record:\n${r}\nreason: ${e}", ("e",e.to_detail_string())("r",record) );
-             }
-          }
+          my->open_tables( wallet_file );
+          bool rebuild_indexes = fc::exists( wallet_file / "CURRENT" );
+          if( rebuild_indexes )
+              my->migrate_generic_records( wallet_file );
+
+          my->load_table<wallet_master_key_record>( my->_master_key_table );
+          my->load_table<wallet_property_record>( my->_property_table );
+          my->load_table<wallet_setting_record>( my->_setting_table );
+          my->load_table<wallet_account_record>( my->_account_table );
+          my->load_table<wallet_key_record>( my->_key_table );
+
+          // Wallets from before the history indexes existed, and wallets closed while their indexes were dirty
+          rebuild_indexes |= !my->_account_history_index.begin().valid() && my->_transaction_table.begin().valid();
+          my->_indexes_dirty = fc::exists( my->_index_rebuild_marker );
+          rebuild_indexes |= my->_indexes_dirty;
+          if( rebuild_indexes )
+              my->rebuild_transaction_indexes();
       }
       catch( ... )
       {
+          // Leave any rebuild marker in place so the next open tries again
+          my->_indexes_dirty = false;
           close();
           throw;
       }
@@ -176,7 +790,19 @@ namespace bts { namespace wallet {
 
    void wallet_db::close()
    {
-      my->_records.close();
+      if( my->_indexes_dirty )
+      {
+          try
+          {
+              my->mark_indexes_clean();
+          }
+          catch( const fc::exception& e )
+          {
+              wlog( "Error syncing wallet indexes, they will be rebuilt on the next open: ${e}", ("e",e.to_detail_string()) );
+          }
+          my->_indexes_dirty = false;
+      }
+      my->close_tables();
 
       wallet_master_key.reset();
 
@@ -188,22 +814,21 @@ namespace bts { namespace wallet {
       keys.clear();
       btc_to_bts_address.clear();
 
-      transactions.clear();
-      id_to_transaction_record_index.clear();
-
       properties.clear();
       settings.clear();
+
+      running_balance_checkpoints.clear();
    }
 
    bool wallet_db::is_open()const
    {
-       return my->_records.is_open() && wallet_master_key.valid();
+       return my->_property_table.is_open() && wallet_master_key.valid();
    }
 
    void wallet_db::store_and_reload_generic_record( const generic_wallet_record& record )
    {
-       FC_ASSERT( my->_records.is_open() );
-       my->store_and_reload_generic_record( record );
+       FC_ASSERT( my->_property_table.is_open() );
+       my->store_generic_record( record, true );
    }
 
    int32_t wallet_db::new_wallet_record_index()
@@ -242,9 +867,18 @@ namespace bts { namespace wallet {
    } FC_CAPTURE_AND_RETHROW( (key_index) ) }
 
    private_key_type wallet_db::get_wallet_child_key( const fc::sha512& password, uint32_t key_index )const
+   { try {
+       return derive_wallet_child_key( get_master_private_key( password ), key_index );
+   } FC_CAPTURE_AND_RETHROW( (key_index) ) }
+
+   extended_private_key wallet_db::get_master_private_key( const fc::sha512& password )const
    { try {
        FC_ASSERT( is_open() );
-       const extended_private_key master_private_key = wallet_master_key->decrypt_key( password );
+       return wallet_master_key->decrypt_key( password );
+   } FC_CAPTURE_AND_RETHROW() }
+
+   private_key_type wallet_db::derive_wallet_child_key( const extended_private_key& master_private_key, uint32_t key_index )
+   { try {
        return master_private_key.child( key_index );
    } FC_CAPTURE_AND_RETHROW( (key_index) ) }
 
@@ -317,6 +951,11 @@ namespace bts { namespace wallet {
    private_key_type wallet_db::get_account_child_key( const private_key_type& active_private_key, uint32_t seq_num )const
    { try {
        FC_ASSERT( is_open() );
+       return derive_account_child_key( active_private_key, seq_num );
+   } FC_CAPTURE_AND_RETHROW( (seq_num) ) }
+
+   private_key_type wallet_db::derive_account_child_key( const private_key_type& active_private_key, uint32_t seq_num )
+   { try {
        const extended_private_key extended_active_private_key = extended_private_key( active_private_key );
        fc::sha256::encoder enc;
        fc::raw::pack( enc, seq_num );
@@ -326,8 +965,12 @@ namespace bts { namespace wallet {
    // Deprecated but kept for key regeneration
    private_key_type wallet_db::get_account_child_key_v1( const fc::sha512& password, const address& account_address, uint32_t seq_num )const
    { try {
-       FC_ASSERT( is_open() );
-       const extended_private_key master_private_key = wallet_master_key->decrypt_key( password );
+       return derive_account_child_key_v1( get_master_private_key( password ), account_address, seq_num );
+   } FC_CAPTURE_AND_RETHROW( (account_address)(seq_num) ) }
+
+   private_key_type wallet_db::derive_account_child_key_v1( const extended_private_key& master_private_key,
+                                                            const address& account_address, uint32_t seq_num )
+   { try {
        fc::sha256::encoder enc;
        fc::raw::pack( enc, account_address );
        fc::raw::pack( enc, seq_num );
@@ -580,6 +1223,15 @@ namespace bts { namespace wallet {
        }
    } FC_CAPTURE_AND_RETHROW( (key) ) }
 
+   void wallet_db::store_keys( const vector<key_data>& keys )
+   { try {
+       FC_ASSERT( is_open() );
+       detail::wallet_db_impl::bulk_write_scope bulk_writes( *my );
+       for( const key_data& key : keys )
+           store_key( key );
+       my->sync_tables();
+   } FC_CAPTURE_AND_RETHROW() }
+
    void wallet_db::import_key( const fc::sha512& password, const string& account_name, const private_key_type& private_key,
                                bool move_existing )
    { try {
@@ -606,19 +1258,81 @@ namespace bts { namespace wallet {
    owallet_transaction_record wallet_db::lookup_transaction( const transaction_id_type& id )const
    { try {
        FC_ASSERT( is_open() );
-       const auto id_map_iter = id_to_transaction_record_index.find( id );
-       if( id_map_iter != id_to_transaction_record_index.end() )
+       const optional<int32_t> record_index = my->_transaction_id_index.fetch_optional( id );
+       if( record_index.valid() )
+           return my->fetch_transaction_record( *record_index );
+       return owallet_transaction_record();
+   } FC_CAPTURE_AND_RETHROW( (id) ) }
+
+   unordered_map<transaction_id_type, wallet_transaction_record> wallet_db::get_transactions()const
+   { try {
+       FC_ASSERT( is_open() );
+       unordered_map<transaction_id_type, wallet_transaction_record> transaction_records;
+       for( auto itr = my->_transaction_table.begin(); itr.valid(); ++itr )
        {
-           const transaction_id_type& record_id = id_map_iter->second;
-           const auto record_iter = transactions.find( record_id );
-           if( record_iter != transactions.end() )
+           try
            {
-               const wallet_transaction_record& transaction_record = record_iter->second;
-               return transaction_record;
+               const wallet_transaction_record transaction_record = itr.value().as<wallet_transaction_record>();
+               transaction_records[ transaction_record.record_id ] = transaction_record;
+           }
+           catch( const fc::exception& e )
+           {
+               wlog( "Error loading wallet record ${index}:\nreason: ${e}", ("e",e.to_detail_string())("index",itr.key()) );
            }
        }
-       return owallet_transaction_record();
-   } FC_CAPTURE_AND_RETHROW( (id) ) }
+       return transaction_records;
+   } FC_CAPTURE_AND_RETHROW() }
+
+   transaction_history_key wallet_db::get_history_key( const wallet_transaction_record& transaction_record )
+   {
+       transaction_history_key key;
+       key.block_num = transaction_record.is_confirmed ? transaction_record.block_num : uint32_t( -1 );
+       key.timestamp = std::min<time_point_sec>( transaction_record.created_time, transaction_record.received_time );
+       key.record_id = transaction_record.record_id;
+       return key;
+   }
+
+   void wallet_db::scan_account_transaction_history( const address& account_address,
+                                                     const optional<transaction_history_key>& start, bool reverse,
+                                                     const transaction_history_visitor& visitor )const
+   { try {
+       FC_ASSERT( is_open() );
+       my->scan_history_index( my->_account_history_index, account_address, start, reverse, visitor );
+   } FC_CAPTURE_AND_RETHROW( (account_address)(start)(reverse) ) }
+
+   void wallet_db::scan_asset_transaction_history( const asset_id_type asset_id,
+                                                   const optional<transaction_history_key>& start, bool reverse,
+                                                   const transaction_history_visitor& visitor )const
+   { try {
+       FC_ASSERT( is_open() );
+       my->scan_history_index( my->_asset_history_index, asset_id, start, reverse, visitor );
+   } FC_CAPTURE_AND_RETHROW( (asset_id)(start)(reverse) ) }
+
+   void wallet_db::scan_transaction_history( const optional<transaction_history_key>& start, bool reverse,
+                                             const transaction_history_visitor& visitor )const
+   { try {
+       FC_ASSERT( is_open() );
+       my->scan_history_index( my->_account_history_index, address(), start, reverse, visitor );
+   } FC_CAPTURE_AND_RETHROW( (start)(reverse) ) }
+
+   optional<pair<transaction_history_key, running_balances_type>>
+   wallet_db::lookup_running_balance_checkpoint( const string& history_name, const transaction_history_key& before )const
+   {
+       const auto history_iter = running_balance_checkpoints.find( history_name );
+       if( history_iter == running_balance_checkpoints.end() ) return optional<pair<transaction_history_key, running_balances_type>>();
+
+       const auto& checkpoints = history_iter->second;
+       auto checkpoint_iter = checkpoints.lower_bound( before );
+       if( checkpoint_iter == checkpoints.begin() ) return optional<pair<transaction_history_key, running_balances_type>>();
+       --checkpoint_iter;
+       return *checkpoint_iter;
+   }
+
+   void wallet_db::store_running_balance_checkpoint( const string& history_name, const transaction_history_key& key,
+                                                     const running_balances_type& balances )
+   {
+       running_balance_checkpoints[ history_name ][ key ] = balances;
+   }
 
    void wallet_db::store_transaction( const transaction_data& transaction )
    { try {
@@ -654,7 +1368,7 @@ namespace bts { namespace wallet {
    } FC_CAPTURE_AND_RETHROW() }
 
    // Only returns private keys corresponding to owner and active keys
-   map<private_key_type, string> wallet_db::get_account_private_keys( const fc::sha512& password )const
+   map<public_key_type, string> wallet_db::get_account_public_keys()const
    { try {
        map<public_key_type, string> public_keys;
        for( const auto& account_item : accounts )
@@ -668,9 +1382,13 @@ namespace bts { namespace wallet {
                    public_keys[ active_key ] = account.name;
            }
        }
+       return public_keys;
+   } FC_CAPTURE_AND_RETHROW() }
 
+   map<private_key_type, string> wallet_db::get_account_private_keys( const fc::sha512& password )const
+   { try {
        map<private_key_type, string> private_keys;
-       for( const auto& public_key_item : public_keys )
+       for( const auto& public_key_item : get_account_public_keys() )
        {
            const auto& public_key = public_key_item.first;
            const auto& account_name = public_key_item.second;
@@ -695,14 +1413,18 @@ namespace bts { namespace wallet {
    { try {
        FC_ASSERT( is_open() );
 
-       vector<generic_wallet_record> records;
-       for( auto iter = my->_records.begin(); iter.valid(); ++iter )
+       vector<packed_wallet_record> records;
+       for( auto iter = my->_account_table.begin(); iter.valid(); ++iter )
+           records.push_back( iter.value() );
+       for( auto iter = my->_key_table.begin(); iter.valid(); ++iter )
+           records.push_back( iter.value() );
+       for( auto iter = my->_transaction_table.begin(); iter.valid(); ++iter )
            records.push_back( iter.value() );
 
 
        // Repair account_data.is_my_account and key_data.account_address
        uint32_t count = 0;
-       for( generic_wallet_record& record : records )
+       for( const packed_wallet_record& record : records )
        {
            try
            {
@@ -721,7 +1443,7 @@ namespace bts { namespace wallet {
        // Repair key_data.public_key when I have the private key and
        // repair key_data.account_address and account_data.is_my_account
        count = 0;
-       for( generic_wallet_record& record : records )
+       for( const packed_wallet_record& record : records )
        {
            try
            {
@@ -744,7 +1466,7 @@ namespace bts { namespace wallet {
                            btc_to_bts_address.erase( address( pts_address( key_record.public_key, true,  56 ) ) );
 
                            key_record.public_key = public_key;
-                           my->load_key_record( key_record );
+                           my->load_record( key_record );
                        }
                    }
                    store_key( key_record );
@@ -757,7 +1479,7 @@ namespace bts { namespace wallet {
 
        // Repair transaction_data.record_id
        count = 0;
-       for( generic_wallet_record& record : records )
+       for( const packed_wallet_record& record : records )
        {
            try
            {
@@ -770,11 +1492,10 @@ namespace bts { namespace wallet {
                        const transaction_id_type record_id = transaction_record.trx.id();
                        if( transaction_record.record_id != record_id )
                        {
-                           transactions.erase( transaction_record.record_id );
-                           id_to_transaction_record_index.erase( transaction_record.record_id );
+                           my->unindex_transaction_record( transaction_record );
 
                            transaction_record.record_id = record_id;
-                           my->load_transaction_record( transaction_record );
+                           my->index_record( transaction_record );
                        }
                    }
                    store_transaction( transaction_record );
@@ -784,6 +1505,7 @@ namespace bts { namespace wallet {
            {
            }
        }
+       my->rebuild_transaction_indexes();
        std::cout << "\rWallet records repaired.                                  " << std::flush << "\n";
    } FC_CAPTURE_AND_RETHROW() }
 
@@ -840,11 +1562,11 @@ namespace bts { namespace wallet {
    vector<wallet_transaction_record> wallet_db::get_pending_transactions()const
    {
        vector<wallet_transaction_record> transaction_records;
-       for( const auto& item : transactions )
+       for( auto itr = my->_pending_transaction_index.begin(); itr.valid(); ++itr )
        {
-           const auto& transaction_record = item.second;
-           if( !transaction_record.is_virtual && !transaction_record.is_confirmed )
-               transaction_records.push_back( transaction_record );
+           const owallet_transaction_record transaction_record = my->fetch_transaction_record( itr.value() );
+           if( transaction_record.valid() )
+               transaction_records.push_back( *transaction_record );
        }
        return transaction_records;
    }
@@ -861,14 +1583,22 @@ namespace bts { namespace wallet {
       std::ofstream fs( filename.string() );
       fs.write( "[\n", 2 );
 
-      auto itr = my->_records.begin();
-      while( itr.valid() )
+      // Same layout as the single generic record list of older wallets, so backups stay portable
+      const vector<const detail::record_table*> tables = { &my->_master_key_table, &my->_property_table,
+                                                           &my->_setting_table, &my->_account_table,
+                                                           &my->_key_table, &my->_transaction_table };
+      bool first = true;
+      for( const detail::record_table* table : tables )
       {
-          auto str = fc::json::to_pretty_string( itr.value() );
-          if( (++itr).valid() ) str += ",";
-          str += "\n";
-          fs.write( str.c_str(), str.size() );
+          for( auto itr = table->begin(); itr.valid(); ++itr )
+          {
+              string str = first ? "" : ",\n";
+              str += fc::json::to_pretty_string( my->to_generic_record( itr.value() ) );
+              fs.write( str.c_str(), str.size() );
+              first = false;
+          }
       }
+      if( !first ) fs.write( "\n", 1 );
 
       fs.write( "]", 1 );
    } FC_CAPTURE_AND_RETHROW( (filename) ) }
@@ -925,6 +1655,8 @@ namespace bts { namespace wallet {
        const int32_t& record_index = account_record->wallet_record_index;
 
        accounts.erase( record_index );
+       ++key_revision;
+       running_balance_checkpoints.clear();
 
        address_to_account_wallet_record_index.erase( address( account_record->owner_key ) );
        for( const auto& item : account_record->active_key_history )
@@ -971,22 +1703,6 @@ namespace bts { namespace wallet {
       store_and_reload_record( acct );
    }
 
-   void wallet_db::remove_item( int32_t index )
-   { try {
-       try
-       {
-#ifndef BTS_TEST_NETWORK
-           my->_records.remove( index, true ); // Sync
-#else
-           my->_records.remove( index );
-#endif
-       }
-       catch( const fc::key_not_found_exception& )
-       {
-           wlog("wallet_db tried to remove nonexistent index: ${i}", ("i",index) );
-       }
-   } FC_CAPTURE_AND_RETHROW( (index) ) }
-
    bool wallet_db::validate_password( const fc::sha512& password )const
    { try {
       FC_ASSERT( wallet_master_key );
@@ -1024,8 +1740,16 @@ namespace bts { namespace wallet {
    {
       const auto rec = lookup_transaction( record_id );
       if( !rec.valid() ) return;
-      remove_item( rec->wallet_record_index );
-      transactions.erase( record_id );
+      my->mark_indexes_dirty();
+      try
+      {
+          my->_transaction_table.remove( rec->wallet_record_index, my->_sync_writes );
+      }
+      catch( const fc::key_not_found_exception& )
+      {
+          wlog("wallet_db tried to remove nonexistent index: ${i}", ("i",rec->wallet_record_index) );
+      }
+      my->unindex_transaction_record( *rec );
    }
 
 } } // bts::wallet
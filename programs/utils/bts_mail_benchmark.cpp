@@ -0,0 +1,162 @@
+#include <boost/program_options.hpp>
+
+#include <bts/blockchain/address.hpp>
+#include <bts/blockchain/time.hpp>
+#include <bts/mail/server.hpp>
+
+#include <fc/crypto/elliptic.hpp>
+#include <fc/io/buffered_iostream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/network/tcp_socket.hpp>
+#include <fc/time.hpp>
+
+#include <iostream>
+
+using namespace bts::blockchain;
+using namespace bts::mail;
+
+boost::program_options::variables_map parse_option_variables(int argc, char** argv)
+{
+    boost::program_options::options_description option_config("Usage");
+    option_config.add_options()
+        ("help", "Display this help message and exit")
+
+        ("server", boost::program_options::value<std::string>(), "RPC endpoint of a client running a mail server, e.g. 127.0.0.1:1776")
+
+        ("messages", boost::program_options::value<uint32_t>()->default_value(2000), "Number of messages to store")
+        ("recipients", boost::program_options::value<uint32_t>()->default_value(20), "Number of recipients to spread the messages over")
+        ("message-size", boost::program_options::value<uint32_t>()->default_value(256), "Size of each message body in bytes")
+        ;
+
+    boost::program_options::variables_map option_variables;
+    try
+    {
+        boost::program_options::store(boost::program_options::parse_command_line(argc, argv, option_config), option_variables);
+        boost::program_options::notify(option_variables);
+    }
+    catch (boost::program_options::error& cmdline_error)
+    {
+        std::cerr << "Error: " << cmdline_error.what() << "\n";
+        std::cerr << option_config << "\n";
+        exit(1);
+    }
+
+    if (option_variables.count("help"))
+    {
+        std::cout << option_config << "\n";
+        exit(0);
+    }
+
+    if (!option_variables.count("server"))
+    {
+        std::cerr << "Error: --server is required\n";
+        std::cerr << option_config << "\n";
+        exit(1);
+    }
+
+    return option_variables;
+}
+
+/** makes one call on a JSON RPC connection the way the mail client does, throwing if the server reports an error */
+fc::variant call_server( fc::tcp_socket& sock, const std::string& method, const fc::variants& params )
+{
+    fc::mutable_variant_object request;
+    request["id"] = 0;
+    request["method"] = method;
+    request["params"] = params;
+    fc::json::to_stream( sock, fc::variant_object( request ) );
+
+    std::string raw_response;
+    fc::getline( sock, raw_response );
+    const auto response = fc::json::from_string( raw_response ).as<fc::variant_object>();
+    if( response.contains( "error" ) )
+        FC_THROW( "${method} failed: ${error}", ("method",method)("error",response["error"]) );
+    return response["result"];
+}
+
+double per_second( uint64_t count, const fc::microseconds& elapsed )
+{
+    return elapsed.count() > 0 ? count * 1000000.0 / elapsed.count() : 0;
+}
+
+/**
+ *  Measures a mail server's throughput over its RPC port: messages stored per second, then messages served per
+ *  second when a light client pages its inventory and fetches one message per call or BTS_MAIL_BULK_FETCH_LIMIT
+ *  per call. Messages must reach the server within BTS_MAIL_MAX_MESSAGE_AGE of being generated.
+ */
+int main( int argc, char** argv )
+{
+    const auto option_variables = parse_option_variables(argc, argv);
+    const auto endpoint = fc::ip::endpoint::from_string( option_variables["server"].as<std::string>() );
+    const uint32_t message_count = option_variables["messages"].as<uint32_t>();
+    const uint32_t recipient_count = std::max( 1u, option_variables["recipients"].as<uint32_t>() );
+    const uint32_t message_size = option_variables["message-size"].as<uint32_t>();
+
+    vector<address> recipients;
+    for( uint32_t i = 0; i < recipient_count; ++i )
+        recipients.push_back( address( fc::ecc::private_key::generate().get_public_key() ) );
+
+    /* Proof-of-work is done up front so it doesn't count against the server */
+    std::cout << "Generating " << message_count << " messages...\n";
+    vector<message> messages;
+    messages.reserve( message_count );
+    for( uint32_t i = 0; i < message_count; ++i )
+    {
+        message msg;
+        msg.type = encrypted;
+        msg.recipient = recipients[ i % recipient_count ];
+        msg.timestamp = bts::blockchain::now();
+        msg.data.resize( message_size );
+        for( uint32_t j = 0; j < message_size; ++j )
+            msg.data[ j ] = char( i + j );
+        while( msg.id() > BTS_MAIL_PROOF_OF_WORK_TARGET )
+            ++msg.nonce;
+        messages.push_back( std::move( msg ) );
+    }
+
+    fc::tcp_socket sock;
+    sock.connect_to( endpoint );
+
+    fc::time_point start = fc::time_point::now();
+    for( const auto& msg : messages )
+        call_server( sock, "mail_store_message", fc::variants( { fc::variant( msg ) } ) );
+    const fc::microseconds store_time = fc::time_point::now() - start;
+    std::cout << "Stored " << message_count << " messages: " << per_second( message_count, store_time ) << " messages/sec\n";
+
+    const auto fetch_inventory = [&]( const address& recipient )
+    {
+        return call_server( sock, "mail_fetch_inventory",
+                            fc::variants( { fc::variant( recipient ), fc::variant( fc::time_point() ),
+                                            fc::variant( BTS_MAIL_INVENTORY_FETCH_LIMIT ) } ) ).as<inventory_type>();
+    };
+
+    start = fc::time_point::now();
+    uint64_t served = 0;
+    for( const auto& recipient : recipients )
+        for( const auto& item : fetch_inventory( recipient ) )
+        {
+            call_server( sock, "mail_fetch_message", fc::variants( { fc::variant( item.second ) } ) );
+            ++served;
+        }
+    const fc::microseconds single_time = fc::time_point::now() - start;
+    std::cout << "Served " << served << " messages one at a time: " << per_second( served, single_time ) << " messages/sec\n";
+
+    start = fc::time_point::now();
+    served = 0;
+    for( const auto& recipient : recipients )
+    {
+        const auto inventory = fetch_inventory( recipient );
+        for( size_t batch_start = 0; batch_start < inventory.size(); batch_start += BTS_MAIL_BULK_FETCH_LIMIT )
+        {
+            vector<message_id_type> ids;
+            for( size_t i = batch_start; i < std::min<size_t>( inventory.size(), batch_start + BTS_MAIL_BULK_FETCH_LIMIT ); ++i )
+                ids.push_back( inventory[ i ].second );
+            served += call_server( sock, "mail_fetch_messages", fc::variants( { fc::variant( ids ) } ) ).as<vector<message>>().size();
+        }
+    }
+    const fc::microseconds bulk_time = fc::time_point::now() - start;
+    std::cout << "Served " << served << " messages in bulk: " << per_second( served, bulk_time ) << " messages/sec\n";
+
+    sock.close();
+    return 0;
+}
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+
+# Measures RPC throughput against a running client in three modes:
+#   http   - one HTTP POST per call (the server closes the connection after each reply)
+#   batch  - JSON-RPC 2.0 batches of --batch-size calls per HTTP POST
+#   tcp    - one persistent JSON connection (--rpc-port) with --pipeline-depth calls in flight
+#
+# example:
+#   ./rpc_benchmark.py --method blockchain_get_block_count --calls 5000 --batch-size 100
+
+import argparse
+import json
+import socket
+import time
+
+import requests
+
+
+def make_call(args, call_id) :
+    return { "method": args.method, "params": args.params, "jsonrpc": "2.0", "id": call_id }
+
+
+def bench_http(args) :
+    url = "http://%s:%d/rpc" % (args.host, args.http_port)
+    headers = {'content-type': 'application/json'}
+    auth = (args.user, args.password)
+    for i in range(args.calls) :
+        response = requests.post(url, data=json.dumps(make_call(args, i)), headers=headers, auth=auth)
+        response.raise_for_status()
+
+
+def bench_batch(args) :
+    url = "http://%s:%d/rpc" % (args.host, args.http_port)
+    headers = {'content-type': 'application/json'}
+    auth = (args.user, args.password)
+    sent = 0
+    while sent < args.calls :
+        count = min(args.batch_size, args.calls - sent)
+        batch = [make_call(args, sent + i) for i in range(count)]
+        response = requests.post(url, data=json.dumps(batch), headers=headers, auth=auth)
+        response.raise_for_status()
+        assert len(response.json()) == count
+        sent += count
+
+
+class json_connection :
+    def __init__(self, host, port) :
+        self.sock = socket.create_connection((host, port))
+        self.stream = self.sock.makefile("r")
+
+    def send(self, call) :
+        self.sock.sendall((json.dumps(call) + "\n").encode("utf-8"))
+
+    def receive(self) :
+        reply = json.loads(self.stream.readline())
+        if "error" in reply and reply["error"] is not None :
+            raise Exception(reply["error"])
+        return reply
+
+
+def bench_tcp(args) :
+    connection = json_connection(args.host, args.rpc_port)
+    connection.send({ "method": "login", "params": [args.user, args.password], "jsonrpc": "2.0", "id": -1 })
+    connection.receive()
+
+    sent = 0
+    received = 0
+    while received < args.calls :
+        while sent < args.calls and sent - received < args.pipeline_depth :
+            connection.send(make_call(args, sent))
+            sent += 1
+        connection.receive()
+        received += 1
+
+
+def main() :
+    parser = argparse.ArgumentParser(description="Measure RPC calls per second")
+    parser.add_argument("--host", default="localhost")
+    parser.add_argument("--http-port", type=int, default=8899)
+    parser.add_argument("--rpc-port", type=int, default=8898)
+    parser.add_argument("--user", default="user")
+    parser.add_argument("--password", default="password")
+    parser.add_argument("--method", default="blockchain_get_block_count")
+    parser.add_argument("--params", type=json.loads, default=[], help="JSON array of parameters")
+    parser.add_argument("--calls", type=int, default=1000)
+    parser.add_argument("--batch-size", type=int, default=100)
+    parser.add_argument("--pipeline-depth", type=int, default=32)
+    parser.add_argument("--modes", default="http,batch,tcp")
+    args = parser.parse_args()
+
+    benchmarks = { "http": bench_http, "batch": bench_batch, "tcp": bench_tcp }
+    for mode in args.modes.split(",") :
+        start = time.time()
+        benchmarks[mode](args)
+        elapsed = time.time() - start
+        print("%-6s %8d calls in %8.3f s: %10.1f calls/s" % (mode, args.calls, elapsed, args.calls / elapsed))
+
+
+if __name__ == "__main__":
+    main()
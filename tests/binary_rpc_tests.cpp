@@ -0,0 +1,60 @@
+#define BOOST_TEST_MODULE BinaryRpcTests
+#include <boost/test/unit_test.hpp>
+#include "dev_fixture.hpp"
+
+#include <bts/rpc/rpc_server.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/io/raw_variant.hpp>
+
+// Calls method_name through both the JSON and the fc::raw paths of the generated server and checks that
+// the binary result, once unpacked, is the same value the JSON path returned.  Parameters are packed
+// exactly as common_api_binary_rpc_client packs them.
+template<typename Result, typename... Parameters>
+static void check_binary_matches_json( const bts::rpc::rpc_server_ptr& server, const std::string& method_name,
+                                       const Parameters&... parameters )
+{
+   const fc::variants json_parameters{ fc::variant( parameters )... };
+   const fc::variant json_result = server->direct_invoke_method( method_name, json_parameters );
+
+   std::vector<char> packed_parameters;
+   for( const std::vector<char>& packed_parameter : std::vector<std::vector<char>>{ fc::raw::pack( parameters )... } )
+      packed_parameters.insert( packed_parameters.end(), packed_parameter.begin(), packed_parameter.end() );
+   const std::vector<char> packed_result = server->direct_invoke_binary_method( method_name, packed_parameters );
+   const Result binary_result = fc::raw::unpack<Result>( packed_result );
+
+   BOOST_CHECK_EQUAL( fc::json::to_string( fc::variant( binary_result ) ), fc::json::to_string( json_result ) );
+}
+
+BOOST_FIXTURE_TEST_CASE( binary_results_match_json, chain_fixture )
+{ try {
+   produce_block( clienta );
+   const bts::rpc::rpc_server_ptr server = clienta->get_rpc_server();
+
+   check_binary_matches_json<uint32_t>( server, "blockchain_get_block_count" );
+   check_binary_matches_json<std::string>( server, "help", std::string( "help" ) );
+   check_binary_matches_json<fc::optional<account_record>>( server, "blockchain_get_account", std::string( "delegate0" ) );
+   check_binary_matches_json<fc::optional<account_record>>( server, "blockchain_get_account", std::string( "nobody" ) );
+   check_binary_matches_json<vector<account_record>>( server, "blockchain_list_active_delegates", uint32_t( 0 ), uint32_t( 20 ) );
+   check_binary_matches_json<vector<asset_record>>( server, "blockchain_list_assets", std::string(), uint32_t( 10 ) );
+   check_binary_matches_json<fc::optional<block_record>>( server, "blockchain_get_block", std::string( "1" ) );
+   check_binary_matches_json<vector<wallet_account_record>>( server, "wallet_list_accounts" );
+   check_binary_matches_json<uint32_t>( server, "wallet_set_transaction_expiration_time", uint32_t( 7200 ) );
+   check_binary_matches_json<fc::optional<fc::variant>>( server, "wallet_get_setting", std::string( "binary_rpc_test" ) );
+} FC_LOG_AND_RETHROW() }
+
+// methods with no result still have to consume their packed parameters, including fc::variant ones
+BOOST_FIXTURE_TEST_CASE( binary_void_method_applies_parameters, chain_fixture )
+{ try {
+   const bts::rpc::rpc_server_ptr server = clienta->get_rpc_server();
+   const fc::variant value = fc::mutable_variant_object( "list", fc::variants{ 1, "two", 3.5 } )( "flag", true );
+
+   std::vector<char> packed_parameters = fc::raw::pack( std::string( "binary_rpc_test" ) );
+   const std::vector<char> packed_value = fc::raw::pack( value );
+   packed_parameters.insert( packed_parameters.end(), packed_value.begin(), packed_value.end() );
+   BOOST_CHECK( server->direct_invoke_binary_method( "wallet_set_setting", packed_parameters ).empty() );
+
+   const fc::variant stored = server->direct_invoke_method( "wallet_get_setting", fc::variants{ "binary_rpc_test" } );
+   BOOST_CHECK_EQUAL( fc::json::to_string( stored ), fc::json::to_string( value ) );
+   check_binary_matches_json<fc::optional<fc::variant>>( server, "wallet_get_setting", std::string( "binary_rpc_test" ) );
+} FC_LOG_AND_RETHROW() }
@@ -0,0 +1,168 @@
+#define BOOST_TEST_MODULE CoinSelectionTests
+#include <boost/test/unit_test.hpp>
+
+#include <bts/wallet/coin_selection.hpp>
+#include <bts/wallet/config.hpp>
+
+#include <fc/crypto/elliptic.hpp>
+
+using namespace bts::blockchain;
+using namespace bts::wallet;
+
+/** balances of one account, with what the chain would report as spendable from each */
+struct coin_selection_fixture
+{
+   static const int32_t account_index = 2;
+
+   coin_selector                                  selector;
+   unordered_map<balance_id_type, share_type>     spendable;
+   unordered_map<balance_id_type, share_type>     reserved;
+   uint32_t                                       next_owner = 0;
+
+   balance_id_type add_balance( share_type amount, share_type spendable_amount, int32_t owner_account = account_index )
+   {
+      const address owner( fc::ecc::private_key::regenerate( fc::sha256::hash( std::to_string( next_owner++ ) ) ).get_public_key() );
+      balance_record record( owner, asset( amount ), 0 );
+      selector.store( owner_account, record );
+      spendable[ record.id() ] = spendable_amount;
+      return record.id();
+   }
+
+   balance_id_type add_balance( share_type amount )
+   {
+      return add_balance( amount, amount );
+   }
+
+   vector<selected_balance> select( share_type amount, coin_selection_strategy_enum strategy )const
+   {
+      return selector.select( account_index, asset( amount ), strategy, reserved,
+                              [this]( const balance_id_type& balance_id ) -> share_type
+      {
+         const auto iter = spendable.find( balance_id );
+         return iter != spendable.end() ? iter->second : 0;
+      } );
+   }
+
+   static share_type total( const vector<selected_balance>& selected )
+   {
+      share_type sum = 0;
+      for( const selected_balance& balance : selected )
+         sum += balance.amount;
+      return sum;
+   }
+};
+
+BOOST_FIXTURE_TEST_CASE( largest_first_spends_biggest_balances, coin_selection_fixture )
+{
+   const balance_id_type small = add_balance( 10 );
+   const balance_id_type large = add_balance( 50 );
+   const balance_id_type medium = add_balance( 30 );
+
+   const vector<selected_balance> selected = select( 60, largest_first_selection );
+   BOOST_REQUIRE_EQUAL( selected.size(), 2 );
+   BOOST_CHECK( selected[ 0 ].balance_id == large );
+   BOOST_CHECK_EQUAL( selected[ 0 ].amount, 50 );
+   BOOST_CHECK( selected[ 1 ].balance_id == medium );
+   BOOST_CHECK_EQUAL( selected[ 1 ].amount, 10 );
+
+   // Selects what it can when the account can't cover the amount
+   const vector<selected_balance> everything = select( 500, largest_first_selection );
+   BOOST_CHECK_EQUAL( everything.size(), 3 );
+   BOOST_CHECK_EQUAL( total( everything ), 90 );
+   BOOST_CHECK( everything.back().balance_id == small );
+}
+
+BOOST_FIXTURE_TEST_CASE( minimize_inputs_uses_one_covering_balance, coin_selection_fixture )
+{
+   add_balance( 10 );
+   add_balance( 50 );
+   const balance_id_type medium = add_balance( 30 );
+
+   const vector<selected_balance> selected = select( 25, minimize_inputs_selection );
+   BOOST_REQUIRE_EQUAL( selected.size(), 1 );
+   BOOST_CHECK( selected[ 0 ].balance_id == medium );
+   BOOST_CHECK_EQUAL( selected[ 0 ].amount, 25 );
+
+   // No single balance covers it, so fall back to largest first
+   const vector<selected_balance> combined = select( 70, minimize_inputs_selection );
+   BOOST_CHECK_EQUAL( combined.size(), 2 );
+   BOOST_CHECK_EQUAL( total( combined ), 70 );
+}
+
+BOOST_FIXTURE_TEST_CASE( consolidate_dust_sweeps_small_balances, coin_selection_fixture )
+{
+   const balance_id_type dust_a = add_balance( 1 );
+   const balance_id_type dust_b = add_balance( 2 );
+   const balance_id_type large = add_balance( 100 );
+
+   const vector<selected_balance> selected = select( 50, consolidate_dust_selection );
+   BOOST_REQUIRE_EQUAL( selected.size(), 3 );
+   BOOST_CHECK( selected[ 0 ].balance_id == dust_a );
+   BOOST_CHECK( selected[ 1 ].balance_id == dust_b );
+   BOOST_CHECK( selected[ 2 ].balance_id == large );
+   BOOST_CHECK_EQUAL( selected[ 2 ].amount, 47 );
+   BOOST_CHECK_EQUAL( total( selected ), 50 );
+}
+
+BOOST_FIXTURE_TEST_CASE( consolidate_dust_caps_inputs, coin_selection_fixture )
+{
+   for( uint32_t i = 0; i < BTS_WALLET_MAX_DUST_CONSOLIDATION_INPUTS + 5; ++i )
+      add_balance( 1 );
+   const balance_id_type large = add_balance( 1000 );
+
+   const vector<selected_balance> selected = select( 500, consolidate_dust_selection );
+   BOOST_REQUIRE_EQUAL( selected.size(), BTS_WALLET_MAX_DUST_CONSOLIDATION_INPUTS + 1 );
+   BOOST_CHECK( selected.back().balance_id == large );
+   BOOST_CHECK_EQUAL( total( selected ), 500 );
+}
+
+BOOST_FIXTURE_TEST_CASE( reserved_amounts_are_not_selected_again, coin_selection_fixture )
+{
+   const balance_id_type small = add_balance( 10 );
+   const balance_id_type large = add_balance( 50 );
+   reserved[ large ] = 45;
+
+   const vector<selected_balance> selected = select( 12, largest_first_selection );
+   BOOST_REQUIRE_EQUAL( selected.size(), 2 );
+   BOOST_CHECK( selected[ 0 ].balance_id == large );
+   BOOST_CHECK_EQUAL( selected[ 0 ].amount, 5 );
+   BOOST_CHECK( selected[ 1 ].balance_id == small );
+   BOOST_CHECK_EQUAL( selected[ 1 ].amount, 7 );
+
+   // Fully reserved balances are skipped by every strategy
+   reserved[ small ] = 10;
+   reserved[ large ] = 50;
+   BOOST_CHECK( select( 1, largest_first_selection ).empty() );
+   BOOST_CHECK( select( 1, minimize_inputs_selection ).empty() );
+   BOOST_CHECK( select( 1, consolidate_dust_selection ).empty() );
+}
+
+BOOST_FIXTURE_TEST_CASE( balances_become_spendable_without_reindexing, coin_selection_fixture )
+{
+   // A vesting balance with nothing spendable yet when it is indexed
+   const balance_id_type vesting = add_balance( 100, 0 );
+   BOOST_CHECK( select( 10, largest_first_selection ).empty() );
+
+   spendable[ vesting ] = 40;
+   const vector<selected_balance> selected = select( 60, minimize_inputs_selection );
+   BOOST_REQUIRE_EQUAL( selected.size(), 1 );
+   BOOST_CHECK( selected[ 0 ].balance_id == vesting );
+   BOOST_CHECK_EQUAL( selected[ 0 ].amount, 40 );
+}
+
+BOOST_FIXTURE_TEST_CASE( selection_is_per_account_and_asset, coin_selection_fixture )
+{
+   add_balance( 100, 100, account_index + 1 );
+   BOOST_CHECK( select( 10, largest_first_selection ).empty() );
+
+   const balance_id_type own = add_balance( 20 );
+   const vector<selected_balance> selected = select( 10, largest_first_selection );
+   BOOST_REQUIRE_EQUAL( selected.size(), 1 );
+   BOOST_CHECK( selected[ 0 ].balance_id == own );
+
+   BOOST_CHECK( selector.select( account_index, asset( 10, 1 ), largest_first_selection, reserved,
+                                 []( const balance_id_type& ) -> share_type { return 1000; } ).empty() );
+
+   selector.remove( own );
+   BOOST_CHECK( select( 10, largest_first_selection ).empty() );
+}
@@ -0,0 +1,112 @@
+#define BOOST_TEST_MODULE DirectJsonTests
+#include <boost/test/unit_test.hpp>
+
+#include <bts/api/direct_json.hpp>
+#include <bts/blockchain/account_record.hpp>
+#include <bts/blockchain/block_record.hpp>
+#include <bts/blockchain/market_records.hpp>
+
+#include <fc/crypto/elliptic.hpp>
+#include <fc/io/json.hpp>
+#include <fc/reflect/variant.hpp>
+
+#include <iostream>
+
+using namespace bts::blockchain;
+
+// normally emitted by bts_api_generator for the types marked "direct_json" in types.json
+namespace bts { namespace api {
+   template<> struct direct_json_traits<account_record> : std::true_type {};
+   template<> struct direct_json_traits<market_order> : std::true_type {};
+   template<> struct direct_json_traits<block_record> : std::true_type {};
+} }
+
+template<typename T>
+static void check_matches_variant_path( const T& value )
+{
+   BOOST_CHECK_EQUAL( bts::api::to_direct_json( value ), fc::json::to_string( fc::variant( value ) ) );
+}
+
+static public_key_type test_key( uint32_t seed )
+{
+   return fc::ecc::private_key::regenerate( fc::sha256::hash( std::to_string( seed ) ) ).get_public_key();
+}
+
+static vector<market_order> make_orders( uint32_t count )
+{
+   vector<market_order> orders;
+   for( uint32_t i = 0; i < count; ++i )
+   {
+      const price order_price( 0.5 + i / 1000.0, asset_id_type( 1 ), asset_id_type( 0 ) );
+      market_index_key key( order_price, address( test_key( i % 16 ) ) );
+      order_record state( 100000 + i );
+      state.last_update = fc::time_point_sec( 1420000000 + i );
+      if( i % 3 == 0 )
+         orders.emplace_back( short_order, key, state, share_type( 5000 + i ), order_price );
+      else
+         orders.emplace_back( bid_order, key, state );
+   }
+   return orders;
+}
+
+BOOST_AUTO_TEST_CASE( account_record_matches_variant_path )
+{
+   account_record account;
+   account.id = 42;
+   account.name = "direct-json";
+   account.public_data = fc::mutable_variant_object( "website", "https://example.com" )( "quote", "a \"quoted\" \\ string\n" );
+   account.owner_key = test_key( 1 );
+   account.set_active_key( fc::time_point_sec( 1420000000 ), test_key( 2 ) );
+   account.set_active_key( fc::time_point_sec( 1420000100 ), test_key( 3 ) );
+   account.registration_date = fc::time_point_sec( 1420000000 );
+   account.last_update = fc::time_point_sec( 1420000100 );
+
+   check_matches_variant_path( account );
+   check_matches_variant_path( oaccount_record( account ) );
+   check_matches_variant_path( oaccount_record() );
+
+   account.delegate_info = delegate_stats();
+   account.delegate_info->votes_for = -5000000000ll;
+   check_matches_variant_path( vector<account_record>{ account, account } );
+}
+
+BOOST_AUTO_TEST_CASE( market_orders_match_variant_path )
+{
+   const vector<market_order> orders = make_orders( 50 );
+   check_matches_variant_path( orders );
+   check_matches_variant_path( std::make_pair( orders, vector<market_order>() ) );
+}
+
+BOOST_AUTO_TEST_CASE( block_record_matches_variant_path )
+{
+   block_record record;
+   record.block_num = 12345;
+   record.timestamp = fc::time_point_sec( 1420000000 );
+   record.user_transaction_ids.push_back( fc::ripemd160::hash( std::string( "trx" ) ) );
+   record.block_size = 1234;
+   record.latency = fc::milliseconds( 1500 );
+   record.signee_fees_collected = 5000000000ll;
+
+   check_matches_variant_path( record );
+   check_matches_variant_path( oblock_record( record ) );
+   check_matches_variant_path( oblock_record() );
+}
+
+// not a pass/fail test, reports how the two paths compare on an order book sized response
+BOOST_AUTO_TEST_CASE( order_book_benchmark )
+{
+   const vector<market_order> orders = make_orders( 20000 );
+   const auto book = std::make_pair( orders, orders );
+
+   fc::time_point start = fc::time_point::now();
+   const std::string via_variant = fc::json::to_string( fc::variant( book ) );
+   const fc::microseconds variant_time = fc::time_point::now() - start;
+
+   start = fc::time_point::now();
+   const std::string direct = bts::api::to_direct_json( book );
+   const fc::microseconds direct_time = fc::time_point::now() - start;
+
+   BOOST_CHECK( direct == via_variant );
+   std::cout << "order book of " << orders.size() * 2 << " orders (" << direct.size() << " bytes): variant path "
+             << variant_time.count() / 1000 << " ms, direct path " << direct_time.count() / 1000 << " ms\n";
+}
@@ -0,0 +1,65 @@
+#define BOOST_TEST_MODULE PrivateKeyCacheTests
+#include <boost/test/unit_test.hpp>
+
+#include <bts/wallet/private_key_cache.hpp>
+
+#include <fc/crypto/elliptic.hpp>
+
+using namespace bts::blockchain;
+using namespace bts::wallet;
+
+static private_key_type test_key( uint32_t seed )
+{
+   return fc::ecc::private_key::regenerate( fc::sha256::hash( std::to_string( seed ) ) );
+}
+
+// Enough keys to spread over several pages of secrets
+static const uint32_t key_count = 1000;
+
+BOOST_AUTO_TEST_CASE( cached_keys_round_trip )
+{
+   private_key_cache cache;
+   for( uint32_t i = 0; i < key_count; ++i )
+      cache.insert( test_key( i ).get_public_key(), test_key( i ) );
+   BOOST_CHECK_EQUAL( cache.size(), key_count );
+
+   // Inserting a key again keeps the first copy
+   cache.insert( test_key( 0 ).get_public_key(), test_key( 0 ) );
+   BOOST_CHECK_EQUAL( cache.size(), key_count );
+
+   for( uint32_t i = 0; i < key_count; ++i )
+   {
+      const private_key_type key = test_key( i );
+      const address key_address( key.get_public_key() );
+
+      const fc::optional<private_key_type> cached_key = cache.find( key_address );
+      BOOST_REQUIRE( cached_key.valid() );
+      BOOST_CHECK( cached_key->get_secret() == key.get_secret() );
+
+      const fc::optional<memo_receiver_key> receiver_key = cache.find_receiver_key( key_address );
+      BOOST_REQUIRE( receiver_key.valid() );
+      BOOST_CHECK( receiver_key->private_key.get_secret() == key.get_secret() );
+      BOOST_CHECK( public_key_type( receiver_key->public_key ) == public_key_type( key.get_public_key() ) );
+   }
+
+   const address unknown_address( test_key( key_count ).get_public_key() );
+   BOOST_CHECK( !cache.find( unknown_address ).valid() );
+   BOOST_CHECK( !cache.find_receiver_key( unknown_address ).valid() );
+}
+
+BOOST_AUTO_TEST_CASE( cleared_cache_forgets_keys )
+{
+   private_key_cache cache;
+   for( uint32_t i = 0; i < key_count; ++i )
+      cache.insert( test_key( i ).get_public_key(), test_key( i ) );
+
+   cache.clear();
+   BOOST_CHECK_EQUAL( cache.size(), 0 );
+   BOOST_CHECK( !cache.find( address( test_key( 1 ).get_public_key() ) ).valid() );
+
+   // The cache is usable again after being cleared, as when the wallet unlocks a second time
+   cache.insert( test_key( 1 ).get_public_key(), test_key( 1 ) );
+   const fc::optional<private_key_type> cached_key = cache.find( address( test_key( 1 ).get_public_key() ) );
+   BOOST_REQUIRE( cached_key.valid() );
+   BOOST_CHECK( cached_key->get_secret() == test_key( 1 ).get_secret() );
+}
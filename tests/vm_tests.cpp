@@ -0,0 +1,192 @@
+#define BOOST_TEST_MODULE VmTests
+#include <boost/test/unit_test.hpp>
+
+#include <bts/vm/program.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/reflect/variant.hpp>
+
+#include <limits>
+
+using namespace bts::vm;
+
+static engine::operation make_op( engine::op_code code, int16_t arg1, const variant& arg0 = variant(), int16_t arg2 = 0 )
+{
+   engine::operation op;
+   op.code = code;
+   op.arg1 = arg1;
+   op.arg2 = arg2;
+   op.arg3 = 0;
+   op.arg0 = arg0;
+   return op;
+}
+
+/** runs the operations through engine::execute, which has no inputs, so they are pushed as constants first */
+static std::string interpret( const vector<variant>& inputs, const vector<engine::operation>& ops )
+{
+   vector<engine::operation> interpreted_ops;
+   for( const auto& input : inputs )
+      interpreted_ops.push_back( make_op( engine::PUSH, 0, input ) );
+   interpreted_ops.insert( interpreted_ops.end(), ops.begin(), ops.end() );
+
+   engine e;
+   e.execute( interpreted_ops );
+   return fc::json::to_string( variant( e.get_stack() ) );
+}
+
+static std::string compile_and_run( const vector<variant>& inputs, const vector<value_type>& input_types,
+                                    const vector<engine::operation>& ops )
+{
+   return fc::json::to_string( variant( program::compile( ops, input_types ).execute( inputs ) ) );
+}
+
+static void check_matches_engine( const vector<variant>& inputs, const vector<value_type>& input_types,
+                                  const vector<engine::operation>& ops )
+{
+   BOOST_CHECK_EQUAL( compile_and_run( inputs, input_types, ops ), interpret( inputs, ops ) );
+}
+
+static fc::variant_object make_record()
+{
+   fc::mutable_variant_object record;
+   record["owner"] = "init0";
+   record["balance"] = int64_t( 100000 );
+   record["asset"] = "BTS";
+   return record;
+}
+
+BOOST_AUTO_TEST_CASE( arithmetic_matches_engine )
+{
+   vector<engine::operation> ops;
+   ops.push_back( make_op( engine::PUSH, 1 ) );
+   ops.push_back( make_op( engine::ADD, 0, variant( int64_t( 3 ) ) ) );
+   ops.push_back( make_op( engine::MULT, 0, variant( int64_t( -4 ) ) ) );
+   ops.push_back( make_op( engine::SUB, 2 ) );
+   ops.push_back( make_op( engine::DIV, 0, variant( int64_t( 3 ) ) ) );
+   ops.push_back( make_op( engine::PUSH, 0, variant( int64_t( 5 ) ) ) );
+   ops.push_back( make_op( engine::SET, 3, variant(), 1 ) );
+   ops.push_back( make_op( engine::POP, 0 ) );
+   check_matches_engine( { variant( int64_t( 7 ) ) }, { int64_type }, ops );
+}
+
+BOOST_AUTO_TEST_CASE( comparisons_match_engine )
+{
+   const engine::op_code comparisons[] = { engine::LT, engine::GT, engine::LTEQ, engine::GTEQ, engine::EQ, engine::NEQ };
+   for( const engine::op_code code : comparisons )
+      for( const int64_t operand : { int64_t( 6 ), int64_t( 7 ), int64_t( 8 ) } )
+      {
+         vector<engine::operation> ops;
+         ops.push_back( make_op( engine::PUSH, 1 ) );
+         ops.push_back( make_op( code, 0, variant( operand ) ) );
+         ops.push_back( make_op( engine::PUSH, 0, variant( "init0" ) ) );
+         ops.push_back( make_op( code == engine::NEQ ? engine::NEQ : engine::EQ, 0, variant( "init1" ) ) );
+         ops.push_back( make_op( engine::PUSH, 3 ) );
+         ops.push_back( make_op( engine::NOT_OP, 1 ) );
+         check_matches_engine( { variant( int64_t( 7 ) ) }, { int64_type }, ops );
+      }
+}
+
+BOOST_AUTO_TEST_CASE( child_lookups_match_engine )
+{
+   vector<engine::operation> ops;
+   ops.push_back( make_op( engine::PUSH_CHILD, 2, variant( "balance" ) ) );
+   ops.push_back( make_op( engine::GT, 0, variant( int64_t( 500 ) ) ) );
+   ops.push_back( make_op( engine::PUSH_CHILD, 3, variant( "owner" ) ) );
+   ops.push_back( make_op( engine::EQ, 0, variant( "init0" ) ) );
+   ops.push_back( make_op( engine::PUSH_SIZE, 4 ) );
+   // The child's name comes from the stack
+   ops.push_back( make_op( engine::PUSH_CHILD, 5, variant(), 4 ) );
+   check_matches_engine( { variant( make_record() ), variant( "asset" ) }, { object_type, string_type }, ops );
+}
+
+BOOST_AUTO_TEST_CASE( compile_rejects_unsupported_programs )
+{
+   const vector<value_type> int64_input = { int64_type };
+
+   // Values other than int64, bool, string and object
+   BOOST_CHECK_THROW( program::compile( { make_op( engine::PUSH, 0, variant( 1.5 ) ) }, int64_input ), fc::exception );
+   BOOST_CHECK_THROW( program::compile( { make_op( engine::PUSH, 0, variant( fc::variants() ) ) }, int64_input ), fc::exception );
+   BOOST_CHECK_THROW( program::compile( {}, { dynamic_type } ), fc::exception );
+
+   // Operands of the wrong type
+   BOOST_CHECK_THROW( program::compile( { make_op( engine::PUSH, 1 ), make_op( engine::ADD, 0, variant( "1" ) ) }, int64_input ),
+                      fc::exception );
+   BOOST_CHECK_THROW( program::compile( { make_op( engine::PUSH_CHILD, 1, variant( "balance" ) ) }, int64_input ), fc::exception );
+   BOOST_CHECK_THROW( program::compile( { make_op( engine::PUSH, 0, variant( true ) ), make_op( engine::LT, 2 ) }, int64_input ),
+                      fc::exception );
+
+   // Operations that need dynamic typing or allocation
+   BOOST_CHECK_THROW( program::compile( { make_op( engine::PUSH, 1 ), make_op( engine::EQ, 2 ) }, { object_type } ),
+                      fc::exception );
+   engine::operation set_child = make_op( engine::SET_CHILD, 1, variant( "balance" ), 0 );
+   BOOST_CHECK_THROW( program::compile( { set_child }, { object_type } ), fc::exception );
+   BOOST_CHECK_THROW( program::compile( { make_op( engine::PUSH_INDEX, 1 ) }, { object_type } ), fc::exception );
+   BOOST_CHECK_THROW( program::compile( { make_op( engine::SET_INDEX, 1 ) }, { object_type } ), fc::exception );
+
+   // Stack indexes outside the stack
+   BOOST_CHECK_THROW( program::compile( { make_op( engine::PUSH, 2 ) }, int64_input ), fc::exception );
+   BOOST_CHECK_THROW( program::compile( { make_op( engine::POP, 0 ), make_op( engine::POP, 0 ) }, int64_input ), fc::exception );
+   BOOST_CHECK_THROW( program::compile( { make_op( engine::SET, 0, variant( int64_t( 1 ) ) ) }, int64_input ), fc::exception );
+}
+
+BOOST_AUTO_TEST_CASE( run_checks_inputs_and_children )
+{
+   const program compiled = program::compile( { make_op( engine::PUSH_CHILD, 1, variant( "owner" ) ),
+                                                make_op( engine::ADD, 0, variant( int64_t( 1 ) ) ) },
+                                              { object_type } );
+   BOOST_CHECK_THROW( compiled.execute( { variant( int64_t( 1 ) ) } ), fc::exception );
+   BOOST_CHECK_THROW( compiled.execute( {} ), fc::exception );
+
+   // The child is a string, so the type check before the addition fails
+   BOOST_CHECK_THROW( compiled.execute( { variant( make_record() ) } ), fc::exception );
+
+   fc::mutable_variant_object record = fc::mutable_variant_object( make_record() );
+   record["owner"] = int64_t( 41 );
+   BOOST_CHECK_EQUAL( compiled.execute( { variant( record ) } ).back().as_int64(), 42 );
+   record.erase( "owner" );
+   BOOST_CHECK_THROW( compiled.execute( { variant( record ) } ), fc::exception );
+}
+
+BOOST_AUTO_TEST_CASE( run_rejects_overflow )
+{
+   const int64_t min = std::numeric_limits<int64_t>::min();
+   const int64_t max = std::numeric_limits<int64_t>::max();
+
+   const auto run = [&]( engine::op_code code, int64_t a, int64_t b ) -> int64_t
+   {
+      const program compiled = program::compile( { make_op( code, 2 ) }, { int64_type, int64_type } );
+      return compiled.execute( { variant( b ), variant( a ) } ).back().as_int64();
+   };
+
+   BOOST_CHECK_EQUAL( run( engine::ADD, max - 1, 1 ), max );
+   BOOST_CHECK_THROW( run( engine::ADD, max, 1 ), fc::exception );
+   BOOST_CHECK_THROW( run( engine::ADD, min, -1 ), fc::exception );
+
+   BOOST_CHECK_EQUAL( run( engine::SUB, min + 1, 1 ), min );
+   BOOST_CHECK_THROW( run( engine::SUB, min, 1 ), fc::exception );
+   BOOST_CHECK_THROW( run( engine::SUB, 0, min ), fc::exception );
+
+   BOOST_CHECK_EQUAL( run( engine::MULT, max / 2, 2 ), max - 1 );
+   BOOST_CHECK_EQUAL( run( engine::MULT, min / 2, 2 ), min );
+   BOOST_CHECK_THROW( run( engine::MULT, max / 2 + 1, 2 ), fc::exception );
+   BOOST_CHECK_THROW( run( engine::MULT, min, -1 ), fc::exception );
+   BOOST_CHECK_THROW( run( engine::MULT, -1, min ), fc::exception );
+
+   BOOST_CHECK_EQUAL( run( engine::DIV, min, 1 ), min );
+   BOOST_CHECK_THROW( run( engine::DIV, min, -1 ), fc::exception );
+   BOOST_CHECK_THROW( run( engine::DIV, 1, 0 ), fc::exception );
+}
+
+BOOST_AUTO_TEST_CASE( operations_round_trip_through_variants )
+{
+   BOOST_CHECK_EQUAL( std::string( fc::reflector<engine::op_code>::to_string( engine::PUSH_SIZE ) ), "PUSH_SIZE" );
+
+   engine::operation op = make_op( engine::SET_CHILD, 1, variant( "balance" ), 2 );
+   op.arg3 = 3;
+   const engine::operation copy = variant( op ).as<engine::operation>();
+   BOOST_CHECK( engine::op_code( copy.code ) == engine::SET_CHILD );
+   BOOST_CHECK_EQUAL( copy.arg1, 1 );
+   BOOST_CHECK_EQUAL( copy.arg2, 2 );
+   BOOST_CHECK_EQUAL( copy.arg3, 3 );
+   BOOST_CHECK_EQUAL( copy.arg0.as_string(), "balance" );
+}
@@ -0,0 +1,318 @@
+#define BOOST_TEST_MODULE WalletDbTests
+#include <boost/test/unit_test.hpp>
+
+#include <bts/db/level_map.hpp>
+#include <bts/wallet/wallet_db.hpp>
+
+#include <fc/crypto/elliptic.hpp>
+#include <fc/filesystem.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+using namespace bts::blockchain;
+using namespace bts::wallet;
+
+typedef bts::db::level_map<int32_t,generic_wallet_record> generic_record_table;
+
+static fc::sha512 test_password()
+{
+   return fc::sha512::hash( std::string( "wallet_db_tests password" ) );
+}
+
+static private_key_type test_key( uint32_t seed )
+{
+   return fc::ecc::private_key::regenerate( fc::sha256::hash( std::to_string( seed ) ) );
+}
+
+/** writes a wallet the way releases before the typed tables did: every record as a variant in one database */
+static void write_old_format_wallet( const fc::path& wallet_file, const vector<generic_wallet_record>& records )
+{
+   generic_record_table generic_records;
+   generic_records.open( wallet_file );
+   for( const generic_wallet_record& record : records )
+      generic_records.store( record.get_wallet_record_index(), record );
+   generic_records.close();
+}
+
+static wallet_transaction_record make_pending_transfer( const public_key_type& to_key, int32_t record_index )
+{
+   transaction_data transaction;
+   transaction.trx.expiration = fc::time_point_sec( 1000000 );
+   transaction.record_id = transaction.trx.id();
+   transaction.created_time = fc::time_point_sec( 1000 );
+   transaction.received_time = transaction.created_time;
+
+   ledger_entry entry;
+   entry.to_account = to_key;
+   entry.amount = asset( 5000 );
+   entry.memo = "migrated";
+   transaction.ledger_entries.push_back( entry );
+   transaction.fee = asset( 10 );
+
+   return wallet_transaction_record( transaction, record_index );
+}
+
+static vector<generic_wallet_record> make_old_format_records( wallet_transaction_record& transaction_record )
+{
+   const private_key_type owner_key = test_key( 1 );
+
+   master_key master;
+   master.encrypt_key( test_password(), extended_private_key( fc::sha512::hash( std::string( "master" ) ) ) );
+
+   account_data account;
+   account.name = "alice";
+   account.owner_key = owner_key.get_public_key();
+   account.set_active_key( fc::time_point_sec( 1000 ), owner_key.get_public_key() );
+   account.is_my_account = true;
+
+   key_data key;
+   key.account_address = address( owner_key.get_public_key() );
+   key.public_key = owner_key.get_public_key();
+   key.encrypt_private_key( test_password(), owner_key );
+
+   transaction_record = make_pending_transfer( key.public_key, 5 );
+
+   vector<generic_wallet_record> records;
+   records.push_back( generic_wallet_record( wallet_master_key_record( master, 1 ) ) );
+   records.push_back( generic_wallet_record( wallet_account_record( account, 2 ) ) );
+   records.push_back( generic_wallet_record( wallet_key_record( key, 3 ) ) );
+   records.push_back( generic_wallet_record( wallet_property_record( wallet_property( next_record_number, 6 ), 4 ) ) );
+   records.push_back( generic_wallet_record( transaction_record ) );
+   return records;
+}
+
+BOOST_AUTO_TEST_CASE( migrate_old_format_wallet )
+{
+   fc::temp_directory dir;
+   const fc::path wallet_file = dir.path() / "wallet";
+
+   wallet_transaction_record transaction_record;
+   write_old_format_wallet( wallet_file, make_old_format_records( transaction_record ) );
+   BOOST_REQUIRE( fc::exists( wallet_file / "CURRENT" ) );
+
+   wallet_db db;
+   db.open( wallet_file );
+
+   BOOST_CHECK( db.is_open() );
+   BOOST_CHECK( db.validate_password( test_password() ) );
+   BOOST_CHECK( !fc::exists( wallet_file / "CURRENT" ) );
+
+   const owallet_account_record account = db.lookup_account( "alice" );
+   BOOST_REQUIRE( account.valid() );
+   BOOST_CHECK_EQUAL( account->wallet_record_index, 2 );
+   BOOST_CHECK( db.lookup_key( account->owner_address() ).valid() );
+   BOOST_CHECK_EQUAL( db.get_property( next_record_number ).as<int32_t>(), 6 );
+
+   // The transaction indexes come from the migrated table
+   const owallet_transaction_record transaction = db.lookup_transaction( transaction_record.record_id );
+   BOOST_REQUIRE( transaction.valid() );
+   BOOST_CHECK_EQUAL( transaction->wallet_record_index, 5 );
+   BOOST_CHECK_EQUAL( db.get_pending_transactions().size(), 1 );
+
+   uint32_t history_count = 0;
+   db.scan_account_transaction_history( account->owner_address(), optional<transaction_history_key>(), false,
+                                        [&]( const transaction_history_key&, const wallet_transaction_record& record ) -> bool
+   {
+      BOOST_CHECK( record.record_id == transaction_record.record_id );
+      ++history_count;
+      return true;
+   } );
+   BOOST_CHECK_EQUAL( history_count, 1 );
+
+   // Reopening uses the tables and leaves them as they are
+   db.close();
+   db.open( wallet_file );
+   BOOST_CHECK( db.lookup_account( "alice" ).valid() );
+   BOOST_CHECK( db.lookup_transaction( transaction_record.record_id ).valid() );
+}
+
+BOOST_AUTO_TEST_CASE( failed_migration_keeps_old_wallet )
+{
+   fc::temp_directory dir;
+   const fc::path wallet_file = dir.path() / "wallet";
+
+   wallet_transaction_record transaction_record;
+   vector<generic_wallet_record> records = make_old_format_records( transaction_record );
+   generic_wallet_record broken_record;
+   broken_record.type = account_record_type;
+   broken_record.data = fc::mutable_variant_object( "index", 7 )( "name", fc::variants() );
+   records.push_back( broken_record );
+   write_old_format_wallet( wallet_file, records );
+
+   {
+      wallet_db db;
+      BOOST_CHECK_THROW( db.open( wallet_file ), fc::exception );
+      BOOST_CHECK( !db.is_open() );
+   }
+
+   BOOST_REQUIRE( fc::exists( wallet_file / "CURRENT" ) );
+   generic_record_table generic_records;
+   generic_records.open( wallet_file, false );
+   uint32_t count = 0;
+   for( auto itr = generic_records.begin(); itr.valid(); ++itr )
+      ++count;
+   BOOST_CHECK_EQUAL( count, records.size() );
+   generic_records.close();
+
+   // Nothing from the failed attempt is left in the tables
+   bts::db::level_map<int32_t,packed_wallet_record> master_key_table;
+   master_key_table.open( wallet_file / "master_key" );
+   BOOST_CHECK( !master_key_table.begin().valid() );
+}
+
+static transaction_data make_confirmed_transfer( const public_key_type& to_key, uint32_t block_num, uint32_t seed )
+{
+   transaction_data transaction = make_pending_transfer( to_key, 0 );
+   transaction.trx.expiration = fc::time_point_sec( 2000000 + seed );
+   transaction.record_id = transaction.trx.id();
+   transaction.block_num = block_num;
+   transaction.is_confirmed = true;
+   transaction.created_time = fc::time_point_sec( 1000 + seed );
+   transaction.received_time = transaction.created_time;
+   return transaction;
+}
+
+/** opens an empty wallet holding one account, alice */
+static void open_test_wallet( wallet_db& db, const fc::path& wallet_file )
+{
+   db.open( wallet_file );
+   db.set_master_key( extended_private_key( fc::sha512::hash( std::string( "master" ) ) ), test_password() );
+   db.generate_new_account( test_password(), "alice", fc::variant() );
+}
+
+static vector<transaction_history_key> scan_history_page( const wallet_db& db, const address& account_address,
+                                                          const optional<transaction_history_key>& cursor,
+                                                          bool reverse, uint32_t limit )
+{
+   vector<transaction_history_key> keys;
+   db.scan_account_transaction_history( account_address, cursor, reverse,
+                                        [&]( const transaction_history_key& key, const wallet_transaction_record& ) -> bool
+   {
+      keys.push_back( key );
+      return keys.size() < limit;
+   } );
+   return keys;
+}
+
+BOOST_AUTO_TEST_CASE( history_pages_follow_cursors )
+{
+   fc::temp_directory dir;
+   wallet_db db;
+   open_test_wallet( db, dir.path() / "wallet" );
+   const owallet_account_record alice = db.lookup_account( "alice" );
+   BOOST_REQUIRE( alice.valid() );
+
+   // Several transactions in block 0 so a cursor can sit there
+   const uint32_t blocks[] = { 0, 0, 1, 3, 3, 7 };
+   uint32_t seed = 0;
+   for( const uint32_t block_num : blocks )
+      db.store_transaction( make_confirmed_transfer( alice->owner_key, block_num, seed++ ) );
+   db.store_transaction( make_pending_transfer( alice->owner_key, 0 ) );
+
+   vector<transaction_history_key> forward;
+   optional<transaction_history_key> cursor;
+   while( true )
+   {
+      const vector<transaction_history_key> page = scan_history_page( db, alice->owner_address(), cursor, false, 2 );
+      if( page.empty() ) break;
+      forward.insert( forward.end(), page.begin(), page.end() );
+      cursor = page.back();
+   }
+   BOOST_REQUIRE_EQUAL( forward.size(), 7 );
+   BOOST_CHECK( std::is_sorted( forward.begin(), forward.end() ) );
+   BOOST_CHECK_EQUAL( forward.front().block_num, 0 );
+   BOOST_CHECK_EQUAL( forward.back().block_num, uint32_t( -1 ) );
+   for( size_t i = 1; i < forward.size(); ++i )
+      BOOST_CHECK( forward[ i - 1 ] < forward[ i ] );
+
+   // A cursor at block 0 continues with the rest of block 0, not from the start
+   const vector<transaction_history_key> after_first = scan_history_page( db, alice->owner_address(), forward.front(), false, 1 );
+   BOOST_REQUIRE_EQUAL( after_first.size(), 1 );
+   BOOST_CHECK( after_first.front() == forward[ 1 ] );
+
+   vector<transaction_history_key> backward;
+   cursor.reset();
+   while( true )
+   {
+      const vector<transaction_history_key> page = scan_history_page( db, alice->owner_address(), cursor, true, 3 );
+      if( page.empty() ) break;
+      backward.insert( backward.end(), page.begin(), page.end() );
+      cursor = page.back();
+   }
+   std::reverse( backward.begin(), backward.end() );
+   BOOST_CHECK( backward == forward );
+
+   // The all-accounts history holds the same transactions
+   vector<transaction_history_key> everything;
+   db.scan_transaction_history( optional<transaction_history_key>(), false,
+                                [&]( const transaction_history_key& key, const wallet_transaction_record& ) -> bool
+   {
+      everything.push_back( key );
+      return true;
+   } );
+   BOOST_CHECK( everything == forward );
+}
+
+BOOST_AUTO_TEST_CASE( history_follows_keys_added_later )
+{
+   fc::temp_directory dir;
+   wallet_db db;
+   open_test_wallet( db, dir.path() / "wallet" );
+   const owallet_account_record alice = db.lookup_account( "alice" );
+   BOOST_REQUIRE( alice.valid() );
+
+   // Received by a key the wallet doesn't know about yet
+   const private_key_type later_key = test_key( 2 );
+   db.store_transaction( make_confirmed_transfer( later_key.get_public_key(), 4, 0 ) );
+   BOOST_CHECK( scan_history_page( db, alice->owner_address(), optional<transaction_history_key>(), false, 10 ).empty() );
+
+   transaction_history_key checkpoint_key;
+   checkpoint_key.block_num = 10;
+   transaction_history_key later_history_key;
+   later_history_key.block_num = 11;
+   db.store_running_balance_checkpoint( "alice/0", checkpoint_key, running_balances_type() );
+   BOOST_CHECK( db.lookup_running_balance_checkpoint( "alice/0", later_history_key ).valid() );
+
+   db.import_key( test_password(), "alice", later_key, false );
+
+   BOOST_CHECK_EQUAL( scan_history_page( db, alice->owner_address(), optional<transaction_history_key>(), false, 10 ).size(), 1 );
+   BOOST_CHECK( scan_history_page( db, address( later_key.get_public_key() ), optional<transaction_history_key>(), false, 10 ).empty() );
+
+   // Balances tallied before the key was added no longer apply
+   BOOST_CHECK( !db.lookup_running_balance_checkpoint( "alice/0", later_history_key ).valid() );
+}
+
+BOOST_AUTO_TEST_CASE( indexes_left_dirty_are_rebuilt )
+{
+   fc::temp_directory dir;
+   const fc::path wallet_file = dir.path() / "wallet";
+   const fc::path marker = wallet_file / "index/transaction_indexes.rebuild";
+
+   transaction_data transaction;
+   {
+      wallet_db db;
+      open_test_wallet( db, wallet_file );
+      const owallet_account_record alice = db.lookup_account( "alice" );
+      BOOST_REQUIRE( alice.valid() );
+      transaction = make_confirmed_transfer( alice->owner_key, 2, 0 );
+      db.store_transaction( transaction );
+      BOOST_CHECK( fc::exists( marker ) );
+      db.close();
+      BOOST_CHECK( !fc::exists( marker ) );
+   }
+
+   // A crash after the transaction table was written but before its indexes were
+   {
+      bts::db::level_map<transaction_id_type,int32_t> transaction_id_index;
+      transaction_id_index.open( wallet_file / "index/transaction_id" );
+      transaction_id_index.remove( transaction.record_id );
+      transaction_id_index.close();
+      std::ofstream( marker.generic_string().c_str() ).flush();
+   }
+
+   wallet_db db;
+   db.open( wallet_file );
+   BOOST_CHECK( db.lookup_transaction( transaction.record_id ).valid() );
+   BOOST_CHECK( !fc::exists( marker ) );
+}